@@ -7,6 +7,7 @@
 #include "Image_Type.h"
 #include "Helper.h"
 #include "Block.h"
+#include "Block_Matcher.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -23,10 +24,14 @@ const struct BM3D_Para_Base
     PCType BMstep;
     double thMSE;
     double lambda;
+    bool parallel;
+    int BMalgorithm; // 0, 1: direct SSD of each candidate, 2: incremental matching by BlockMatcher (last bits of the distances differ)
 
     explicit BM3D_Para_Base(std::string _profile = "fast")
         : profile(_profile), sigma({ 10.0, 10.0, 10.0 })
     {
+        parallel = true;
+        BMalgorithm = 0;
         BlockSize = 8;
         BMrange = 16;
         BMstep = 1;
@@ -195,10 +200,14 @@ struct BM3D_FilterData
         wienerSigmaSqr(std::move(right.wienerSigmaSqr))
     {}
 
+    ~BM3D_FilterData();
+
     _Myt &operator=(const _Myt &right) = delete;
 
     _Myt &operator=(_Myt &&right)
     {
+        std::lock_guard<std::mutex> lock(PlannerMutex());
+
         fp = std::move(right.fp);
         bp = std::move(right.bp);
         finalAMP = std::move(right.finalAMP);
@@ -207,6 +216,10 @@ struct BM3D_FilterData
 
         return *this;
     }
+
+    // The FFTW planner isn't thread-safe, creation and destruction of plans are serialized by this mutex,
+    // so that filters can be constructed in concurrent image workers
+    static std::mutex &PlannerMutex();
 };
 
 
@@ -229,6 +242,30 @@ public:
     typedef block_type::PosCode PosCode;
     typedef block_type::PosPairCode PosPairCode;
 
+    typedef BlockGroup<FLType, FLType> group_type;
+    typedef BlockMatcher<FLType, FLType> matcher_type;
+
+    // Filtered group of one plane and its weights for aggregation
+    // The groups are reused for the following reference blocks, to avoid allocation
+    struct GroupResult
+    {
+        group_type group;
+        group_type refGroup;
+        FLType numWeight = 0;
+        FLType denWeight = 0;
+    };
+
+    // Reusable buffers of block matching for one reference block
+    struct MatchBuffer
+    {
+        block_type refBlock;
+        PosPairCode code;
+
+        explicit MatchBuffer(PCType BlockSize)
+            : refBlock(BlockSize, BlockSize, PosType(0, 0), false)
+        {}
+    };
+
 protected:
     BM3D_Para_Base para;
     std::vector<BM3D_FilterData> f;
@@ -258,6 +295,18 @@ public:
             para.GroupSize, para.BlockSize, para.lambda);
     }
 
+    // Reference blocks overlapping a tile search up to BMrange away, and the matched blocks are
+    // aggregated up to BMrange away, hence the halo of twice the search range
+    virtual PCType TileHalo() const override
+    {
+        return para.BMrange * 2 + para.BlockSize;
+    }
+
+    virtual PCType TileAlign() const override
+    {
+        return para.BlockStep;
+    }
+
     void Kernel(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref) const;
 
     void Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
@@ -275,12 +324,38 @@ protected:
     virtual Frame &process_Frame(Frame &dst, const Frame &src, const Frame &ref) override;
 
 protected:
-    PosPairCode BlockMatching(const Plane_FL &ref, PCType j, PCType i) const;
+    std::vector<PCType> BlockPos(PCType size) const;
+
+    void KernelLoop(int planes, const bool *process,
+        Plane_FL *const *ResNum, Plane_FL *const *ResDen,
+        const Plane_FL *const *src, const Plane_FL *const *ref) const;
+
+    void KernelLoop_PPL(int planes, const bool *process,
+        Plane_FL *const *ResNum, Plane_FL *const *ResDen,
+        const Plane_FL *const *src, const Plane_FL *const *ref) const;
+
+    const PosPairCode &BlockMatching(MatchBuffer &buffer, const Plane_FL &ref, PCType j, PCType i) const;
 
-    virtual void CollaborativeFilter(int plane,
-        Plane_FL &ResNum, Plane_FL &ResDen,
+    std::unique_ptr<matcher_type> CreateMatcher(const Plane_FL &ref,
+        const std::vector<PCType> &rows, const std::vector<PCType> &cols) const;
+
+    PCType MatchRows() const;
+
+    virtual void CollaborativeFilter(int plane, GroupResult &result,
         const Plane_FL &src, const Plane_FL &ref,
         const PosPairCode &code) const = 0;
+
+    static void Aggregate(Plane_FL &ResNum, Plane_FL &ResDen, const GroupResult &result)
+    {
+        result.group.AddTo(ResNum, result.numWeight);
+        result.group.CountTo(ResDen, result.denWeight);
+    }
+
+    static void Aggregate(Plane_FL &ResNum, Plane_FL &ResDen, const GroupResult &result, PCType lower, PCType upper)
+    {
+        result.group.AddTo(ResNum.data(), ResNum.Stride(), result.numWeight, lower, upper);
+        result.group.CountTo(ResDen.data(), ResDen.Stride(), result.denWeight, lower, upper);
+    }
 };
 
 
@@ -302,8 +377,7 @@ public:
         const Plane &refR, const Plane &refG, const Plane &refB) const override;
 
 protected:
-    virtual void CollaborativeFilter(int plane,
-        Plane_FL &ResNum, Plane_FL &ResDen,
+    virtual void CollaborativeFilter(int plane, GroupResult &result,
         const Plane_FL &src, const Plane_FL &ref,
         const PosPairCode &code) const override;
 };
@@ -327,8 +401,7 @@ public:
         const Plane &refR, const Plane &refG, const Plane &refB) const override;
 
 protected:
-    virtual void CollaborativeFilter(int plane,
-        Plane_FL &ResNum, Plane_FL &ResDen,
+    virtual void CollaborativeFilter(int plane, GroupResult &result,
         const Plane_FL &src, const Plane_FL &ref,
         const PosPairCode &code) const override;
 };
@@ -350,6 +423,26 @@ public:
         : basic(_para.basic), final(_para.final)
     {}
 
+    // The final estimate is computed from the basic estimate of its whole halo
+    virtual PCType TileHalo() const override
+    {
+        return basic.TileHalo() + final.TileHalo();
+    }
+
+    virtual PCType TileAlign() const override
+    {
+        PCType a = basic.TileAlign(), b = final.TileAlign();
+
+        while (b)
+        {
+            PCType t = a % b;
+            a = b;
+            b = t;
+        }
+
+        return basic.TileAlign() / a * final.TileAlign();
+    }
+
 protected:
     virtual Plane_FL &process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref) override;
     virtual Plane &process_Plane(Plane &dst, const Plane &src, const Plane &ref) override;
@@ -438,6 +531,11 @@ protected:
                 ArgsObj.GetPara(i, para.basic.BMstep);
                 continue;
             }
+            if (args[i] == "-MA1" || args[i] == "--BMalgorithm1")
+            {
+                ArgsObj.GetPara(i, para.basic.BMalgorithm);
+                continue;
+            }
             if (args[i] == "-TH1" || args[i] == "--thMSE1")
             {
                 ArgsObj.GetPara(i, para.basic.thMSE);
@@ -474,12 +572,23 @@ protected:
                 ArgsObj.GetPara(i, para.final.BMstep);
                 continue;
             }
+            if (args[i] == "-MA2" || args[i] == "--BMalgorithm2")
+            {
+                ArgsObj.GetPara(i, para.final.BMalgorithm);
+                continue;
+            }
             if (args[i] == "-TH2" || args[i] == "--thMSE2")
             {
                 ArgsObj.GetPara(i, para.final.thMSE);
                 thMSE2_def = true;
                 continue;
             }
+            if (args[i] == "-MT" || args[i] == "--parallel")
+            {
+                ArgsObj.GetPara(i, para.basic.parallel);
+                para.final.parallel = para.basic.parallel;
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
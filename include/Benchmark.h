@@ -0,0 +1,61 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+
+#include <string>
+#include <vector>
+#include "Filter.h"
+#include "Image_Type.h"
+#include "Memory_Pool.h"
+
+
+struct Benchmark_Para
+{
+    typedef Benchmark_Para _Myt;
+
+    int warmup = 2;
+    int iterations = 10;
+    std::vector<std::pair<PCType, PCType>> sizes; // Synthetic images of (width, height)
+    std::vector<std::string> inputs;
+    std::string output; // JSON file, empty means standard output
+};
+
+extern const Benchmark_Para Benchmark_Default;
+
+
+// Timing statistics of one filter on one image
+struct Benchmark_Result
+{
+    typedef Benchmark_Result _Myt;
+
+    std::string source;
+    PCType width = 0;
+    PCType height = 0;
+    int iterations = 0;
+
+    double min = 0; // in seconds
+    double median = 0;
+    double p95 = 0;
+    double mean = 0;
+    double MPps = 0; // megapixels per second of the median
+    size_t peakMemory = 0; // peak memory of the process after the runs, in bytes
+    size_t poolHits = 0; // buffers reused from the memory pool during the timed runs
+    size_t poolMisses = 0; // buffers allocated from the system during the timed runs
+};
+
+
+// Peak memory usage (working set) of the current process in bytes, 0 if unavailable
+size_t PeakMemoryUsage();
+
+// Deterministic noisy gradient image, a stand-in for photos when no input is given
+Frame SyntheticFrame(PCType width, PCType height, unsigned int seed = 0);
+
+// Run the filter para.warmup times, then time para.iterations runs
+// The frame is stored in 16 bit like the images processed by FilterIO, see FilterIO::processIO()
+Benchmark_Result Benchmark(FilterIO &filter, const Frame16 &src, const Benchmark_Para &para, std::string source);
+
+std::string BenchmarkJSON(const std::string &filter, const Benchmark_Para &para,
+    const std::vector<Benchmark_Result> &results);
+
+
+#endif
@@ -2,6 +2,7 @@
 #define BILATERAL_H_
 
 
+#include <memory>
 #include "Filter.h"
 #include "Image_Type.h"
 #include "Helper.h"
@@ -9,15 +10,97 @@
 #include "Gaussian.h"
 
 
+// Costs per pixel in the unit of a tap of the truncated window measured at 1080p, see algorithm_select
+const double PBFICCost = 6; // each PBFIC
+const double GridSplatCost = 8; // splatting and slicing of the bilateral grid
+const double GridBlurCost = 11; // blur of the bilateral grid for each cell per pixel
+
+// Max cells of the bilateral grid (2 FLType each, 512 MiB), algorithm 1 is used instead for larger grids
+const size_t GridCellLimit = size_t(1) << 25;
+
+
 const struct Bilateral2D_Para
 {
     double sigmaS = 3.0;
     double sigmaR = 0.02;
-    int algorithm = 0;
+    int algorithm = 0; // 0: automatic, 1: O(1) PBFIC, 2: truncated window with sub-sampling, 3: truncated window,
+                       // 4: bilateral grid, 5: permutohedral lattice (guided by all the planes of ref for Frame)
     int PBFICnum = 0;
+    int RangeLevels = 0; // max levels of the range LUT, 0: one level for each value, otherwise interpolated linearly
 } Bilateral2D_Default;
 
 
+// Range LUT indexed by the absolute difference of 2 values.
+// With fewer levels than the values within sigmaR * sigmaRMul, the Gaussian function is sampled every 2^shift values
+// and interpolated linearly, so that the table of a high bit depth fits in L1 cache.
+class Bilateral2D_Range_LUT
+{
+public:
+    typedef Bilateral2D_Range_LUT _Myt;
+
+private:
+    LUT<FLType> table; // full table, or interleaved value and slope of each level
+    int shift = 0;
+    DType upper = 0;
+    DType mask = 0;
+
+public:
+    Bilateral2D_Range_LUT(double sigmaR, int BPS, int levels = 0)
+    {
+        const DType ValueRange = (1 << BPS) - 1;
+        upper = Min(ValueRange, static_cast<DType>(sigmaR * sigmaRMul * ValueRange + 0.5));
+
+        while (levels > 1 && (upper >> shift) + 2 > levels)
+        {
+            shift++;
+        }
+
+        if (shift == 0)
+        {
+            table = Gaussian_Function_Range_LUT_Generation(ValueRange, sigmaR);
+            return;
+        }
+
+        NormalizedGaussianFunctionX<ldbl> NGFuncX(sigmaR);
+
+        const DType count = (upper >> shift) + 1;
+        mask = (1 << shift) - 1;
+        table = LUT<FLType>(count * 2);
+
+        for (DType i = 0; i < count; i++)
+        {
+            const DType lower = i << shift;
+            const DType next = Min(upper, (i + 1) << shift);
+            const ldbl value = NGFuncX(static_cast<ldbl>(lower) / ValueRange);
+
+            table[i * 2] = static_cast<FLType>(value);
+            table[i * 2 + 1] = next > lower
+                ? static_cast<FLType>((NGFuncX(static_cast<ldbl>(next) / ValueRange) - value) / (next - lower)) : 0;
+        }
+    }
+
+    FLType operator[](DType diff) const
+    {
+        if (shift == 0)
+        {
+            return table[diff];
+        }
+
+        // Differences beyond upper get the value at upper, as the full table does
+        diff = Min(diff, upper);
+        const PCType i = (diff >> shift) * 2;
+        return table[i] + table[i + 1] * (diff & mask);
+    }
+
+    FLType operator()(DType Value1, DType Value2) const
+    {
+        return operator[](Value1 > Value2 ? Value1 - Value2 : Value2 - Value1);
+    }
+
+    PCType Levels() const { return static_cast<PCType>(shift == 0 ? table.Levels() : table.Levels() / 2); }
+};
+
+
 class Bilateral2D_Data
 {
 private:
@@ -25,6 +108,7 @@ private:
     bool isChroma = false;
     bool isYUV = false;
     int BPS = 16;
+    int RangeLevels = 0;
 
 public:
     std::vector<double> sigmaS;
@@ -40,21 +124,27 @@ public:
     std::vector<int> samples;
     std::vector<int> step;
 
-    std::vector<LUT<FLType>> GS_LUT;
-    std::vector<LUT<FLType>> GR_LUT;
+    std::vector<double> gridS;
+    std::vector<double> gridR;
+
+    // Shared with the other Bilateral2D_Data of the same parameters through the process-wide cache
+    std::vector<std::shared_ptr<const LUT<FLType>>> GS_LUT;
+    std::vector<std::shared_ptr<const Bilateral2D_Range_LUT>> GR_LUT;
 
 public:
     Bilateral2D_Data(const Plane &src, const Bilateral2D_Para &para = Bilateral2D_Default)
-        : PlaneCount(1), isChroma(src.isChroma()), BPS(src.BitDepth()),
+        : PlaneCount(1), isChroma(src.isChroma()), BPS(src.BitDepth()), RangeLevels(para.RangeLevels),
         sigmaS(PlaneCount, para.sigmaS), sigmaR(PlaneCount, para.sigmaR), process(PlaneCount),
         algorithm(PlaneCount, para.algorithm), radius0(PlaneCount), PBFICnum(PlaneCount, para.PBFICnum),
-        radius(PlaneCount), samples(PlaneCount), step(PlaneCount), GS_LUT(PlaneCount), GR_LUT(PlaneCount)
+        radius(PlaneCount), samples(PlaneCount), step(PlaneCount), gridS(PlaneCount), gridR(PlaneCount),
+        GS_LUT(PlaneCount), GR_LUT(PlaneCount)
     {
         process_define();
 
         Bilateral2D_0_Paras();
         Bilateral2D_1_Paras();
         Bilateral2D_2_Paras();
+        Bilateral2D_4_Paras();
 
         algorithm_select();
 
@@ -63,16 +153,18 @@ public:
     }
 
     Bilateral2D_Data(const Frame &src, const Bilateral2D_Para &para = Bilateral2D_Default)
-        : PlaneCount(src.PlaneCount()), isYUV(src.isYUV()), BPS(src.BitDepth()),
+        : PlaneCount(src.PlaneCount()), isYUV(src.isYUV()), BPS(src.BitDepth()), RangeLevels(para.RangeLevels),
         sigmaS(PlaneCount, para.sigmaS), sigmaR(PlaneCount, para.sigmaR), process(PlaneCount),
         algorithm(PlaneCount, para.algorithm), radius0(PlaneCount), PBFICnum(PlaneCount, para.PBFICnum),
-        radius(PlaneCount), samples(PlaneCount), step(PlaneCount), GS_LUT(PlaneCount), GR_LUT(PlaneCount)
+        radius(PlaneCount), samples(PlaneCount), step(PlaneCount), gridS(PlaneCount), gridR(PlaneCount),
+        GS_LUT(PlaneCount), GR_LUT(PlaneCount)
     {
         process_define();
 
         Bilateral2D_0_Paras();
         Bilateral2D_1_Paras();
         Bilateral2D_2_Paras();
+        Bilateral2D_4_Paras();
 
         algorithm_select();
 
@@ -115,6 +207,10 @@ public:
                 if ((isChroma || i > 0 && isYUV) && PBFICnum[i] % 2 == 0 && PBFICnum[i] < 256) // Set odd PBFIC number to chroma planes by default
                     PBFICnum[i]++;
             }
+
+            // Each pixel is interpolated between 2 PBFICs, thus at least 2 of them are required
+            if (process[i] && PBFICnum[i] < 2)
+                PBFICnum[i] = 2;
         }
 
         return *this;
@@ -122,9 +218,9 @@ public:
 
     Bilateral2D_Data &Bilateral2D_2_Paras()
     {
-        int orad[3];
+        std::vector<int> orad(PlaneCount);
 
-        for (int i = 0; i < 3; i++)
+        for (int i = 0; i < PlaneCount; i++)
         {
             if (process[i])
             {
@@ -152,6 +248,22 @@ public:
         return *this;
     }
 
+    // Sampling rates of the bilateral grid in pixels and in the normalized range,
+    // the blur of 1 cell together with the linear splatting and slicing has a standard deviation of sqrt(4/3) cells
+    Bilateral2D_Data &Bilateral2D_4_Paras()
+    {
+        for (int i = 0; i < PlaneCount; i++)
+        {
+            if (process[i])
+            {
+                gridS[i] = sigmaS[i] / sqrt(4.0 / 3.0);
+                gridR[i] = sigmaR[i] / sqrt(4.0 / 3.0);
+            }
+        }
+
+        return *this;
+    }
+
     Bilateral2D_Data &process_define()
     {
         for (int i = 0; i < PlaneCount; i++)
@@ -170,8 +282,17 @@ public:
         for (int i = 0; i < PlaneCount; i++)
         {
             if (algorithm[i] <= 0)
+            {
                 algorithm[i] = step[i] == 1 ? 2 : sigmaR[i] < 0.08 && samples[i] < 5 ? 2
-                : 4 * samples[i] * samples[i] <= 15 * PBFICnum[i] ? 2 : 1;
+                    : 4 * samples[i] * samples[i] <= 15 * PBFICnum[i] ? 2 : 1;
+
+                // The bilateral grid costs a constant for splatting and slicing, plus the blur over the cells per pixel
+                double cost = algorithm[i] == 2 ? 4.0 * samples[i] * samples[i] : PBFICCost * PBFICnum[i];
+                double cells = (1 / gridR[i] + 5) / (gridS[i] * gridS[i]);
+
+                if (process[i] && GridSplatCost + GridBlurCost * cells < cost)
+                    algorithm[i] = 4;
+            }
         }
 
         return *this;
@@ -183,11 +304,11 @@ public:
         {
             if (process[i] && algorithm[i] == 2)
             {
-                GS_LUT[i] = Gaussian_Function_Spatial_LUT_Generation(radius[i] + 1, radius[i] + 1, sigmaS[i]);
+                GS_LUT[i] = Spatial_LUT(sigmaS[i], radius[i]);
             }
-            else if (process[i] && algorithm[i] > 2)
+            else if (process[i] && algorithm[i] > 2 && algorithm[i] != 4 && algorithm[i] != 5)
             {
-                GS_LUT[i] = Gaussian_Function_Spatial_LUT_Generation(radius0[i] + 1, radius0[i] + 1, sigmaS[i]);
+                GS_LUT[i] = Spatial_LUT(sigmaS[i], radius0[i]);
             }
         }
 
@@ -200,12 +321,17 @@ public:
         {
             if (process[i])
             {
-                GR_LUT[i] = Gaussian_Function_Range_LUT_Generation((1 << BPS) - 1, sigmaR[i]);
+                GR_LUT[i] = Range_LUT(sigmaR[i], BPS, RangeLevels);
             }
         }
 
         return *this;
     }
+
+    // Process-wide cache of the LUTs keyed by (sigmaR, BPS, sigmaS, radius), thread-safe,
+    // the most recently used ones are kept so that repeated constructions don't rebuild the tables
+    static std::shared_ptr<const LUT<FLType>> Spatial_LUT(double sigmaS, int radius);
+    static std::shared_ptr<const Bilateral2D_Range_LUT> Range_LUT(double sigmaR, int BPS, int levels);
 };
 
 
@@ -214,6 +340,13 @@ Plane &Bilateral2D_0(Plane &dst, const Plane &src, const Plane &ref, const Bilat
 Plane &Bilateral2D_1(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane = 0);
 Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane = 0);
 Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, int plane = 0);
+Plane &Bilateral2D_4(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane = 0);
+Plane &Bilateral2D_5(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane = 0);
+Frame &Bilateral2D_5(Frame &dst, const Frame &src, const Frame &ref, const Bilateral2D_Data &d);
+
+// Whether the planes are filtered together by the permutohedral lattice guided by all the planes of ref,
+// which requires algorithm 5 and the same size for all the planes
+bool Bilateral2D_Color(const Frame &src, const Frame &ref, const Bilateral2D_Data &d);
 
 
 inline Plane Bilateral2D(const Plane &src, const Plane &ref, const Bilateral2D_Data &d)
@@ -234,6 +367,11 @@ inline Frame Bilateral2D(const Frame &src, const Frame &ref, const Bilateral2D_D
 {
     Frame dst(src, false);
 
+    if (Bilateral2D_Color(src, ref, d))
+    {
+        return Bilateral2D_5(dst, src, ref, d);
+    }
+
     for (Frame::PlaneCountType i = 0; i < src.PlaneCount(); i++)
     {
         Bilateral2D(dst.P(i), src.P(i), ref.P(i), d, i);
@@ -246,6 +384,11 @@ inline Frame Bilateral2D(const Frame &src, const Bilateral2D_Data &d)
 {
     Frame dst(src, false);
 
+    if (Bilateral2D_Color(src, src, d))
+    {
+        return Bilateral2D_5(dst, src, src, d);
+    }
+
     for (Frame::PlaneCountType i = 0; i < src.PlaneCount(); i++)
     {
         Bilateral2D(dst.P(i), src.P(i), src.P(i), d, i);
@@ -299,6 +442,11 @@ protected:
                 ArgsObj.GetPara(i, para.PBFICnum);
                 continue;
             }
+            if (args[i] == "-L" || args[i] == "--RangeLevels")
+            {
+                ArgsObj.GetPara(i, para.RangeLevels);
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
@@ -3,6 +3,8 @@
 
 
 #include "Image_Type.h"
+#include "Block_SIMD.h"
+#include "Memory_Pool.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -85,7 +87,7 @@ public:
     Block(PCType _Height, PCType _Width, const PosType &pos, bool Init = true, value_type Value = 0)
         : Height_(_Height), Width_(_Width), PixelCount_(Height_ * Width_), pos_(pos)
     {
-        AlignedMalloc(Data_, size());
+        PoolMalloc(Data_, size());
 
         InitValue(Init, Value);
     }
@@ -133,7 +135,7 @@ public:
     // Destructor
     ~Block()
     {
-        AlignedFree(Data_);
+        PoolFree(Data_);
     }
 
     // Copy assignment operator
@@ -167,7 +169,7 @@ public:
         PixelCount_ = src.PixelCount_;
         pos_ = src.pos_;
 
-        AlignedFree(Data_);
+        PoolFree(Data_);
         Data_ = src.Data_;
 
         src.Height_ = 0;
@@ -586,28 +588,31 @@ public:
         size_t index = match_code.size();
         match_code.resize(index + search_pos.size());
 
-        for (auto pos : search_pos)
-        {
-            dist_type dist = 0;
+        // Distances are calculated by the SIMD kernels in chunks of search positions
+        static const PCType chunk = 64;
+        PCType offset[chunk];
+        dist_type dist[chunk];
 
-            auto refp = data();
-            auto srcp = src + pos.y * src_stride + pos.x;
+        const PCType search_count = static_cast<PCType>(search_pos.size());
 
-            for (PCType y = 0; y < Height(); ++y)
-            {
-                PCType x = y * src_stride;
+        for (PCType k0 = 0; k0 < search_count; k0 += chunk)
+        {
+            const PCType count = Min(chunk, search_count - k0);
 
-                for (PCType upper = x + Width(); x < upper; ++x, ++refp)
-                {
-                    dist_type temp = static_cast<dist_type>(*refp) - static_cast<dist_type>(srcp[x]);
-                    dist += temp * temp;
-                }
+            for (PCType k = 0; k < count; ++k)
+            {
+                offset[k] = search_pos[k0 + k].y * src_stride + search_pos[k0 + k].x;
             }
 
-            // Only match similar blocks but not identical blocks
-            if (dist <= thSSE && dist != 0)
+            BlockSSD_Multi(dist, data(), Height(), Width(), src, src_stride, offset, count, thSSE);
+
+            for (PCType k = 0; k < count; ++k)
             {
-                match_code[index++] = PosPair(static_cast<KeyType>(dist * distMul), pos);
+                // Only match similar blocks but not identical blocks
+                if (dist[k] <= thSSE && dist[k] != 0)
+                {
+                    match_code[index++] = PosPair(static_cast<KeyType>(dist[k] * distMul), search_pos[k0 + k]);
+                }
             }
         }
 
@@ -655,18 +660,56 @@ public:
     //     0 - include current position in search positions
     //     1 - exclude current position in search positions but take it as the first element in matched code
     //     2 - exclude current position in search positions
+    // The matched code is stored in match_code owned by the caller, its capacity is reused by the following calls.
+    // When match_size > 0, the best matches are selected by a bounded max-heap during matching,
+    // and once it's full, the threshold is lowered to the worst selected match to terminate hopeless candidates early.
     template < typename _St1 >
-    PosPairCode BlockMatchingMulti(const _St1 *src, PCType src_height, PCType src_width, PCType src_stride, _St1 src_range,
-        PCType range, PCType step, double thMSE, int excludeCurPos = 1, size_t match_size = 0, bool sorted = true) const
+    void BlockMatchingMulti(PosPairCode &match_code, const _St1 *src, PCType src_height, PCType src_width, PCType src_stride,
+        _St1 src_range, PCType range, PCType step, double thMSE, int excludeCurPos = 1, size_t match_size = 0, bool sorted = true) const
     {
+        double MSE2SSE = static_cast<double>(PixelCount()) * src_range * src_range / double(255 * 255);
+        double distMul = double(1) / MSE2SSE;
+        dist_type thSSE = static_cast<dist_type>(thMSE * MSE2SSE);
+
         range = range / step * step;
         const PCType l = SearchBoundary(PCType(0), range, step, false);
         const PCType r = SearchBoundary(src_width - Width(), range, step, false);
         const PCType t = SearchBoundary(PCType(0), range, step, true);
         const PCType b = SearchBoundary(src_height - Height(), range, step, true);
 
-        PosCode search_pos(((r - l) / step + 1) * ((b - t) / step + 1));
-        size_t index = 0;
+        match_code.clear();
+        if (excludeCurPos == 1) MatchInsert(match_code, PosPair(static_cast<KeyType>(0), PosType(PosY(), PosX())), match_size);
+
+        // Search positions are collected and matched in chunks
+        static const PCType chunk = 64;
+        PCType offset[chunk];
+        PosType pos[chunk];
+        dist_type dist[chunk];
+        PCType count = 0;
+
+        auto match = [&]()
+        {
+            dist_type th = thSSE;
+
+            if (match_size > 0 && match_code.size() >= match_size)
+            {
+                // Slightly larger than the worst selected match, to be safe from rounding of the keys
+                th = Min(thSSE, static_cast<dist_type>(match_code.front().first * MSE2SSE * 1.000001));
+            }
+
+            BlockSSD_Multi(dist, data(), Height(), Width(), src, src_stride, offset, count, th);
+
+            for (PCType k = 0; k < count; ++k)
+            {
+                // Only match similar blocks but not identical blocks
+                if (dist[k] <= thSSE && dist[k] != 0)
+                {
+                    MatchInsert(match_code, PosPair(static_cast<KeyType>(dist[k] * distMul), pos[k]), match_size);
+                }
+            }
+
+            count = 0;
+        };
 
         for (PCType j = t; j <= b; j += step)
         {
@@ -677,27 +720,34 @@ public:
                     continue;
                 }
 
-                search_pos[index++] = PosType(j, i);
+                offset[count] = j * src_stride + i;
+                pos[count] = PosType(j, i);
+
+                if (++count == chunk) match();
             }
         }
 
-        PosPairCode match_code;
-        if (excludeCurPos == 1) match_code.push_back(PosPair(static_cast<KeyType>(0), PosType(PosY(), PosX())));
+        if (count > 0) match();
 
-        BlockMatchingMulti(match_code, src, src_stride, src_range, search_pos, thMSE);
+        MatchFinalize(match_code, match_size, sorted);
+    }
 
-        // When match_size > 0, it's the upper limit of the number of matched blocks
-        if (match_size > 0 && match_code.size() > match_size)
-        {
-            // Always sorted when size of match code is larger than match_size,
-            // since std::partial_sort is faster than std::nth_element
-            std::partial_sort(match_code.begin(), match_code.begin() + match_size, match_code.end());
-            match_code.resize(match_size);
-        }
-        else if (sorted)
-        {
-            std::stable_sort(match_code.begin(), match_code.end());
-        }
+    template < typename _St1 >
+    void BlockMatchingMulti(PosPairCode &match_code, const _St1 &src, PCType range, PCType step, double thMSE,
+        int excludeCurPos = 1, size_t match_size = 0, bool sorted = true) const
+    {
+        BlockMatchingMulti(match_code, src.data(), src.Height(), src.Width(), src.Stride(), src.ValueRange(),
+            range, step, thMSE, excludeCurPos, match_size, sorted);
+    }
+
+    template < typename _St1 >
+    PosPairCode BlockMatchingMulti(const _St1 *src, PCType src_height, PCType src_width, PCType src_stride, _St1 src_range,
+        PCType range, PCType step, double thMSE, int excludeCurPos = 1, size_t match_size = 0, bool sorted = true) const
+    {
+        PosPairCode match_code;
+
+        BlockMatchingMulti(match_code, src, src_height, src_width, src_stride, src_range,
+            range, step, thMSE, excludeCurPos, match_size, sorted);
 
         return match_code;
     }
@@ -710,6 +760,49 @@ public:
             range, step, thMSE, excludeCurPos, match_size, sorted);
     }
 
+    ////////////////////////////////////////////////////////////////
+    // Matched code helper functions
+
+    // Matched blocks are ordered by key and then position,
+    // which is the same as std::stable_sort by key for search positions in raster order
+    static bool MatchOrder(const PosPair &left, const PosPair &right)
+    {
+        return left.first < right.first || (left.first == right.first && left.second < right.second);
+    }
+
+    // When match_size > 0, match_code is kept as a max-heap of at most match_size elements
+    static void MatchInsert(PosPairCode &match_code, const PosPair &pair, size_t match_size)
+    {
+        if (match_size == 0)
+        {
+            match_code.push_back(pair);
+        }
+        else if (match_code.size() < match_size)
+        {
+            match_code.push_back(pair);
+            std::push_heap(match_code.begin(), match_code.end(), MatchOrder);
+        }
+        else if (MatchOrder(pair, match_code.front()))
+        {
+            std::pop_heap(match_code.begin(), match_code.end(), MatchOrder);
+            match_code.back() = pair;
+            std::push_heap(match_code.begin(), match_code.end(), MatchOrder);
+        }
+    }
+
+    // The heap is always sorted, since its order is meaningless
+    static void MatchFinalize(PosPairCode &match_code, size_t match_size, bool sorted)
+    {
+        if (match_size > 0)
+        {
+            std::sort_heap(match_code.begin(), match_code.end(), MatchOrder);
+        }
+        else if (sorted)
+        {
+            std::sort(match_code.begin(), match_code.end(), MatchOrder);
+        }
+    }
+
     ////////////////////////////////////////////////////////////////
     // Search window helper functions
 
@@ -850,6 +943,7 @@ private:
     PCType Height_ = 0;
     PCType Width_ = 0;
     PCType PixelCount_ = 0;
+    PCType Capacity_ = 0;
     bool isPos3_ = false;
     PosCode posCode_;
     Pos3Code pos3Code_;
@@ -902,7 +996,7 @@ public:
         PixelCount_(GroupSize_ * Height_ * Width_),
         isPos3_(_isPos3)
     {
-        AlignedMalloc(Data_, size());
+        Reserve();
 
         InitValue(Init, Value);
     }
@@ -940,7 +1034,7 @@ public:
         : GroupSize_(src.GroupSize_), Height_(src.Height_), Width_(src.Width_), PixelCount_(src.PixelCount_),
         isPos3_(src.isPos3_), posCode_(src.posCode_), pos3Code_(src.pos3Code_)
     {
-        AlignedMalloc(Data_, size());
+        Reserve();
 
         memcpy(Data_, src.Data_, sizeof(value_type) * size());
     }
@@ -948,7 +1042,7 @@ public:
     // Move constructor
     BlockGroup(_Myt &&src)
         : GroupSize_(src.GroupSize_), Height_(src.Height_), Width_(src.Width_), PixelCount_(src.PixelCount_),
-        isPos3_(src.isPos3_), posCode_(std::move(src.posCode_)), pos3Code_(std::move(src.pos3Code_))
+        Capacity_(src.Capacity_), isPos3_(src.isPos3_), posCode_(std::move(src.posCode_)), pos3Code_(std::move(src.pos3Code_))
     {
         Data_ = src.Data_;
 
@@ -956,13 +1050,14 @@ public:
         src.Height_ = 0;
         src.Width_ = 0;
         src.PixelCount_ = 0;
+        src.Capacity_ = 0;
         src.Data_ = nullptr;
     }
 
     // Destructor
     ~BlockGroup()
     {
-        AlignedFree(Data_);
+        PoolFree(Data_);
     }
 
     // Copy assignment operator
@@ -981,6 +1076,7 @@ public:
         posCode_ = src.posCode_;
         pos3Code_ = src.pos3Code_;
 
+        Reserve();
         memcpy(Data_, src.Data_, sizeof(value_type) * size());
 
         return *this;
@@ -1002,13 +1098,15 @@ public:
         posCode_ = std::move(src.posCode_);
         pos3Code_ = std::move(src.pos3Code_);
 
-        AlignedFree(Data_);
+        PoolFree(Data_);
         Data_ = src.Data_;
+        Capacity_ = src.Capacity_;
 
         src.GroupSize_ = 0;
         src.Height_ = 0;
         src.Width_ = 0;
         src.PixelCount_ = 0;
+        src.Capacity_ = 0;
         src.Data_ = nullptr;
 
         return *this;
@@ -1043,6 +1141,17 @@ public:
     ////////////////////////////////////////////////////////////////
     // Initialization functions
 
+    // Allocate memory for PixelCount() elements, the allocated memory is reused when it's large enough
+    void Reserve()
+    {
+        if (PixelCount_ > Capacity_)
+        {
+            PoolFree(Data_);
+            PoolMalloc(Data_, size());
+            Capacity_ = PixelCount_;
+        }
+    }
+
     void InitValue(bool Init = true, value_type Value = 0)
     {
         if (Init)
@@ -1075,7 +1184,7 @@ public:
 
         PixelCount_ = GroupSize_ * Height_ * Width_;
 
-        AlignedMalloc(Data_, size());
+        Reserve();
 
         posCode_.resize(GroupSize());
 
@@ -1098,7 +1207,7 @@ public:
 
         PixelCount_ = GroupSize_ * Height_ * Width_;
 
-        AlignedMalloc(Data_, size());
+        Reserve();
 
         pos3Code_.resize(GroupSize());
 
@@ -1138,6 +1247,18 @@ public:
         From(src.data(), src.Stride());
     }
 
+    // Reuse this group for another PosPairCode, no allocation happens unless it grows
+    template < typename _St1 >
+    void From(const _St1 &src, const PosPairCode &code, PCType _GroupSize, PCType _Height, PCType _Width)
+    {
+        Height_ = _Height;
+        Width_ = _Width;
+
+        FromCode(code, _GroupSize);
+
+        From(src);
+    }
+
     template < typename _St1 >
     void From(const std::vector<const _St1 *> &src, PCType src_stride)
     {
@@ -1264,6 +1385,31 @@ public:
         AddTo(dst.data(), dst.Stride(), gain);
     }
 
+    // Only accumulate to rows in [lower, upper) of dst, used for aggregation in row stripes
+    template < typename _Dt1, typename _Gt1 >
+    void AddTo(_Dt1 *dst, PCType dst_stride, _Gt1 gain, PCType row_lower, PCType row_upper) const
+    {
+        for (PCType z = 0; z < GroupSize(); ++z)
+        {
+            const PosType pos = GetPos(z);
+            const PCType ylower = Max(row_lower - pos.y, PCType(0));
+            const PCType yupper = Min(row_upper - pos.y, Height());
+
+            auto srcp = data() + (z * Height() + ylower) * Stride();
+            auto dstp = dst + pos.y * dst_stride + pos.x;
+
+            for (PCType y = ylower; y < yupper; ++y)
+            {
+                PCType x = y * dst_stride;
+
+                for (PCType upper = x + Width(); x < upper; ++x, ++srcp)
+                {
+                    dstp[x] += static_cast<_Dt1>(*srcp * gain);
+                }
+            }
+        }
+    }
+
     template < typename _Dt1 >
     void AddTo(const std::vector<_Dt1 *> &dst, PCType dst_stride) const
     {
@@ -1356,6 +1502,30 @@ public:
         CountTo(dst.data(), dst.Stride(), value);
     }
 
+    // Only accumulate to rows in [lower, upper) of dst, used for aggregation in row stripes
+    template < typename _Dt1 >
+    void CountTo(_Dt1 *dst, PCType dst_stride, _Dt1 value, PCType row_lower, PCType row_upper) const
+    {
+        for (PCType z = 0; z < GroupSize(); ++z)
+        {
+            const PosType pos = GetPos(z);
+            const PCType ylower = Max(row_lower - pos.y, PCType(0));
+            const PCType yupper = Min(row_upper - pos.y, Height());
+
+            auto dstp = dst + pos.y * dst_stride + pos.x;
+
+            for (PCType y = ylower; y < yupper; ++y)
+            {
+                PCType x = y * dst_stride;
+
+                for (PCType upper = x + Width(); x < upper; ++x)
+                {
+                    dstp[x] += value;
+                }
+            }
+        }
+    }
+
     template < typename _Dt1 >
     void CountTo(const std::vector<_Dt1 *> &dst, PCType dst_stride) const
     {
@@ -0,0 +1,273 @@
+#ifndef BLOCK_MATCHER_H_
+#define BLOCK_MATCHER_H_
+
+
+#include "Block.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Positions of reference blocks along one dimension, the last block is aligned to the border
+inline std::vector<PCType> BlockGridPos(PCType size, PCType BlockSize, PCType BlockStep)
+{
+    std::vector<PCType> pos;
+
+    PCType BlockPosLast = size - BlockSize;
+
+    for (PCType p = 0;; p += BlockStep)
+    {
+        if (p >= BlockPosLast + BlockStep)
+        {
+            break;
+        }
+        else if (p > BlockPosLast)
+        {
+            p = BlockPosLast;
+        }
+
+        pos.push_back(p);
+    }
+
+    return pos;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Incremental block matching of all the reference blocks on a grid, searched in the same plane
+// Instead of a full SSD for every (reference block, candidate) pair, each displacement (dy, dx) of the search lattice
+// is processed once for all the reference blocks: squared differences of the plane and its shifted copy are
+// accumulated into running sums down the columns and then along each row of blocks, so the SSD of each block is got
+// from 4 running sums. The cost per displacement is proportional to the area covered, regardless of the block size.
+// Search windows, thresholds, keys, selection and ordering of the matched code follow Block::BlockMatchingMulti,
+// while the distances are accumulated in a different order and may differ in the last bits.
+template < typename _Ty = double,
+    typename _DTy = double >
+class BlockMatcher
+{
+public:
+    typedef BlockMatcher<_Ty, _DTy> _Myt;
+    typedef Block<_Ty, _DTy> block_type;
+
+    typedef typename block_type::dist_type dist_type;
+    typedef typename block_type::KeyType KeyType;
+    typedef typename block_type::PosType PosType;
+    typedef typename block_type::PosPair PosPair;
+    typedef typename block_type::PosPairCode PosPairCode;
+
+    // Scratch buffers of Match(), reused across calls to avoid allocation
+    struct Buffer
+    {
+        std::vector<double> colSum;
+        std::vector<double> topSum;
+        std::vector<double> rowSum;
+    };
+
+private:
+    const _Ty *src_ = nullptr;
+    PCType height_ = 0;
+    PCType width_ = 0;
+    PCType stride_ = 0;
+
+    PCType BlockHeight_ = 0;
+    PCType BlockWidth_ = 0;
+    std::vector<PCType> rows_;
+    std::vector<PCType> cols_;
+
+    PCType range_ = 0;
+    PCType step_ = 1;
+    double distMul_ = 0;
+    dist_type thSSE_ = 0;
+    int excludeCurPos_ = 1;
+    size_t match_size_ = 0;
+    bool sorted_ = true;
+
+public:
+    // excludeCurPos, match_size and sorted have the same meaning as in Block::BlockMatchingMulti
+    BlockMatcher(const _Ty *src, PCType src_height, PCType src_width, PCType src_stride, _Ty src_range,
+        PCType BlockHeight, PCType BlockWidth, std::vector<PCType> rows, std::vector<PCType> cols,
+        PCType range, PCType step, double thMSE, int excludeCurPos = 1, size_t match_size = 0, bool sorted = true)
+        : src_(src), height_(src_height), width_(src_width), stride_(src_stride),
+        BlockHeight_(BlockHeight), BlockWidth_(BlockWidth), rows_(std::move(rows)), cols_(std::move(cols)),
+        range_(range / step * step), step_(step), excludeCurPos_(excludeCurPos), match_size_(match_size), sorted_(sorted)
+    {
+        double MSE2SSE = static_cast<double>(BlockHeight * BlockWidth) * src_range * src_range / double(255 * 255);
+        distMul_ = double(1) / MSE2SSE;
+        thSSE_ = static_cast<dist_type>(thMSE * MSE2SSE);
+    }
+
+    template < typename _St1 >
+    BlockMatcher(const _St1 &src, PCType BlockHeight, PCType BlockWidth, std::vector<PCType> rows, std::vector<PCType> cols,
+        PCType range, PCType step, double thMSE, int excludeCurPos = 1, size_t match_size = 0, bool sorted = true)
+        : _Myt(src.data(), src.Height(), src.Width(), src.Stride(), src.ValueRange(), BlockHeight, BlockWidth,
+        std::move(rows), std::move(cols), range, step, thMSE, excludeCurPos, match_size, sorted)
+    {}
+
+    PCType RowCount() const { return static_cast<PCType>(rows_.size()); }
+    PCType ColCount() const { return static_cast<PCType>(cols_.size()); }
+    const std::vector<PCType> &Rows() const { return rows_; }
+    const std::vector<PCType> &Cols() const { return cols_; }
+
+    // Match the reference blocks in grid rows [row_lower, row_upper) and grid columns [col_lower, col_upper)
+    // The matched code of block (r, c) is stored in codes[(r - row_lower) * code_stride + (c - col_lower)],
+    // the capacity of the codes is reused, and the best matches are selected by bounded max-heaps.
+    // Different ranges can be matched concurrently with different buffers, since no state is modified.
+    void Match(PosPairCode *codes, PCType code_stride, Buffer &buffer,
+        PCType row_lower, PCType row_upper, PCType col_lower, PCType col_upper) const;
+
+    void Match(PosPairCode *codes, PCType code_stride,
+        PCType row_lower, PCType row_upper, PCType col_lower, PCType col_upper) const
+    {
+        Buffer buffer;
+        Match(codes, code_stride, buffer, row_lower, row_upper, col_lower, col_upper);
+    }
+
+private:
+    // Match one row of blocks for displacement (dy, dx) from the column running sums at its top and bottom
+    void MatchRow(PosPairCode *codes, PCType j, PCType dy, PCType dx,
+        const PCType *cols, PCType c0, PCType c1, PCType xl, PCType span,
+        const double *upperp, const double *lowerp, double *sump) const
+    {
+        // Vertical box sums accumulated into running sums along the row
+        double sum = 0;
+
+        sump[0] = 0;
+
+        for (PCType x = 0; x < span; ++x)
+        {
+            sum += lowerp[x] - upperp[x];
+            sump[x + 1] = sum;
+        }
+
+        // SSD of each block from 4 running sums
+        for (PCType c = c0; c < c1; ++c)
+        {
+            // The difference of the running sums may be negative from cancellation
+            const dist_type dist = Max(static_cast<dist_type>(sump[cols[c] - xl + BlockWidth_] - sump[cols[c] - xl]),
+                dist_type(0));
+
+            // Only match similar blocks but not identical blocks
+            if (dist <= thSSE_ && dist != 0)
+            {
+                block_type::MatchInsert(codes[c], PosPair(static_cast<KeyType>(dist * distMul_),
+                    PosType(j + dy, cols[c] + dx)), match_size_);
+            }
+        }
+    }
+};
+
+
+template < typename _Ty, typename _DTy >
+void BlockMatcher<_Ty, _DTy>::Match(PosPairCode *codes, PCType code_stride, Buffer &buffer,
+    PCType row_lower, PCType row_upper, PCType col_lower, PCType col_upper) const
+{
+    const PCType rowCount = row_upper - row_lower;
+    const PCType colCount = col_upper - col_lower;
+
+    if (rowCount <= 0 || colCount <= 0) return;
+
+    const PCType *rows = rows_.data() + row_lower;
+    const PCType *cols = cols_.data() + col_lower;
+
+    for (PCType r = 0; r < rowCount; ++r)
+    {
+        for (PCType c = 0; c < colCount; ++c)
+        {
+            PosPairCode &code = codes[r * code_stride + c];
+            code.clear();
+
+            if (excludeCurPos_ == 1) block_type::MatchInsert(code,
+                PosPair(static_cast<KeyType>(0), PosType(rows[r], cols[c])), match_size_);
+        }
+    }
+
+    // Columns covered by the reference blocks, grid positions are in ascending order
+    const PCType left = cols[0];
+    const PCType right = cols[colCount - 1] + BlockWidth_;
+
+    const PCType BlockPosBottom = height_ - BlockHeight_;
+    const PCType BlockPosRight = width_ - BlockWidth_;
+
+    // Running sums down each pixel column, their values at the top of each row of blocks,
+    // and running sums of the vertical box sums along one row
+    std::vector<double> &colSum = buffer.colSum;
+    std::vector<double> &topSum = buffer.topSum;
+    std::vector<double> &rowSum = buffer.rowSum;
+
+    colSum.resize(right - left);
+    topSum.resize(rowCount * (right - left));
+    rowSum.resize(right - left + 1);
+
+    // Displacements are scanned in raster order, so the candidates of every block are appended in raster order
+    for (PCType dy = -range_; dy <= range_; dy += step_)
+    {
+        // Reference blocks whose search window contains this displacement form a continuous range
+        PCType r0 = 0;
+        PCType r1 = rowCount;
+        while (r0 < r1 && rows[r0] + dy < 0) ++r0;
+        while (r1 > r0 && rows[r1 - 1] + dy > BlockPosBottom) --r1;
+
+        if (r0 >= r1) continue;
+
+        for (PCType dx = -range_; dx <= range_; dx += step_)
+        {
+            if (excludeCurPos_ > 0 && dy == 0 && dx == 0) continue;
+
+            PCType c0 = 0;
+            PCType c1 = colCount;
+            while (c0 < c1 && cols[c0] + dx < 0) ++c0;
+            while (c1 > c0 && cols[c1 - 1] + dx > BlockPosRight) --c1;
+
+            if (c0 >= c1) continue;
+
+            const PCType xl = cols[c0];
+            const PCType xr = cols[c1 - 1] + BlockWidth_;
+
+            const PCType yl = rows[r0];
+            const PCType yr = rows[r1 - 1] + BlockHeight_;
+            const PCType span = xr - xl;
+
+            // Running sums of squared differences down each pixel column, saved at the top of each row of blocks
+            double *accp = colSum.data();
+            PCType rTop = r0;
+            PCType rBottom = r0;
+
+            for (PCType x = 0; x < span; ++x)
+            {
+                accp[x] = 0;
+            }
+
+            for (PCType y = yl;; ++y)
+            {
+                for (; rTop < r1 && rows[rTop] == y; ++rTop)
+                {
+                    memcpy(topSum.data() + rTop * span, accp, sizeof(double) * span);
+                }
+
+                // Rows of blocks ending at this row
+                for (; rBottom < r1 && rows[rBottom] + BlockHeight_ == y; ++rBottom)
+                {
+                    MatchRow(codes + rBottom * code_stride, rows[rBottom], dy, dx,
+                        cols, c0, c1, xl, span, topSum.data() + rBottom * span, accp, rowSum.data());
+                }
+
+                if (y >= yr) break;
+
+                SqrDiffAccumulate(accp, src_ + y * stride_ + xl, src_ + (y + dy) * stride_ + dx + xl, span);
+            }
+        }
+    }
+
+    for (PCType r = 0; r < rowCount; ++r)
+    {
+        for (PCType c = 0; c < colCount; ++c)
+        {
+            block_type::MatchFinalize(codes[r * code_stride + c], match_size_, sorted_);
+        }
+    }
+}
+
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef BLOCK_SIMD_H_
+#define BLOCK_SIMD_H_
+
+
+#include "Helper.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+enum class SIMD_Level
+{
+    None = 0,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+
+// Highest instruction set supported by both the CPU and the OS, limited by SetSIMDLevel()
+SIMD_Level GetSIMDLevel();
+
+// Limit the instruction set used by the SIMD kernels, mainly for verification and benchmark
+void SetSIMDLevel(SIMD_Level level);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Sum of squared differences between the reference block and the candidate blocks at src + offset[k], k in [0, count)
+// Every candidate accumulates its pixels in the same order as the scalar loop, thus the distances are bit-exact.
+// A candidate is terminated once its partial sum exceeds thSSE,
+// then its distance is only guaranteed to be larger than thSSE.
+template < typename _Dt1, typename _Ty, typename _St1 >
+void BlockSSD_Multi(_Dt1 *dist, const _Ty *ref, PCType height, PCType width,
+    const _St1 *src, PCType src_stride, const PCType *offset, PCType count, _Dt1 thSSE)
+{
+    for (PCType k = 0; k < count; ++k)
+    {
+        _Dt1 sum = 0;
+
+        auto refp = ref;
+        auto srcp = src + offset[k];
+
+        for (PCType y = 0; y < height; ++y)
+        {
+            PCType x = y * src_stride;
+
+            for (PCType upper = x + width; x < upper; ++x, ++refp)
+            {
+                _Dt1 temp = static_cast<_Dt1>(*refp) - static_cast<_Dt1>(srcp[x]);
+                sum += temp * temp;
+            }
+
+            if (sum > thSSE) break;
+        }
+
+        dist[k] = sum;
+    }
+}
+
+
+// SSE2/AVX2/AVX-512 kernels with runtime dispatch, specialized for 8x8 and 11x11 blocks
+void BlockSSD_Multi(double *dist, const double *ref, PCType height, PCType width,
+    const double *src, PCType src_stride, const PCType *offset, PCType count, double thSSE);
+
+void BlockSSD_Multi(float *dist, const float *ref, PCType height, PCType width,
+    const float *src, PCType src_stride, const PCType *offset, PCType count, float thSSE);
+
+
+// acc[x] += (src1[x] - src2[x])^2, x in [0, count)
+template < typename _Dt1, typename _Ty >
+void SqrDiffAccumulate(_Dt1 *acc, const _Ty *src1, const _Ty *src2, PCType count)
+{
+    for (PCType x = 0; x < count; ++x)
+    {
+        _Dt1 temp = static_cast<_Dt1>(src1[x]) - static_cast<_Dt1>(src2[x]);
+        acc[x] += temp * temp;
+    }
+}
+
+
+// SSE2/AVX2/AVX-512 kernel with runtime dispatch
+void SqrDiffAccumulate(double *acc, const double *src1, const double *src2, PCType count);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Horizontal pass of RecursiveGaussian on height rows of width pixels, dst can be the same as src
+// The causal recursion P0 = B * x + B1 * P1 + B2 * P2 + B3 * P3 runs from left to right starting from the first pixel,
+// then the anti-causal one from right to left starting from the last pixel.
+// Negative results of the anti-causal pass are set to 0 if allow_negative is false.
+template < typename _Ty >
+void RecursiveGaussianH(_Ty *dst, const _Ty *src, PCType height, PCType width, PCType stride,
+    _Ty B, _Ty B1, _Ty B2, _Ty B3, bool allow_negative)
+{
+    for (PCType j = 0; j < height; ++j)
+    {
+        const PCType lower = j * stride;
+        const PCType upper = lower + width - 1;
+
+        PCType i = lower;
+        _Ty P0, P1, P2, P3;
+        P3 = P2 = P1 = src[i];
+        dst[i] = src[i];
+
+        while (i < upper)
+        {
+            ++i;
+            P0 = B * src[i] + B1 * P1 + B2 * P2 + B3 * P3;
+            P3 = P2;
+            P2 = P1;
+            P1 = P0;
+            dst[i] = P0;
+        }
+
+        P3 = P2 = P1 = dst[i];
+
+        while (i > lower)
+        {
+            --i;
+            P0 = B * dst[i] + B1 * P1 + B2 * P2 + B3 * P3;
+            P3 = P2;
+            P2 = P1;
+            P1 = P0;
+            if (allow_negative || P0 >= 0) dst[i] = P0;
+            else dst[i] = 0;
+        }
+    }
+}
+
+
+// SSE2/AVX2/AVX-512 kernels with runtime dispatch, each lane runs the recursion of one row
+// The lanes compute in the same order as the scalar loop, thus the results are the same except the sign of zeros.
+void RecursiveGaussianH(float *dst, const float *src, PCType height, PCType width, PCType stride,
+    float B, float B1, float B2, float B3, bool allow_negative);
+
+void RecursiveGaussianH(double *dst, const double *src, PCType height, PCType width, PCType stride,
+    double B, double B1, double B2, double B3, bool allow_negative);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// dst[x] = sum of weight[k] * src[k][x], k in [0, count), x in [0, width)
+// The sums are exact in integers as long as they don't overflow _Dt1.
+template < typename _Dt1, typename _St1, typename _Wt >
+void WeightedSum(_Dt1 *dst, const _St1 *const *src, const _Wt *weight, PCType count, PCType width)
+{
+    for (PCType x = 0; x < width; ++x)
+    {
+        _Dt1 sum = 0;
+
+        for (PCType k = 0; k < count; ++k)
+        {
+            sum += static_cast<_Dt1>(weight[k]) * static_cast<_Dt1>(src[k][x]);
+        }
+
+        dst[x] = sum;
+    }
+}
+
+
+// SSE2/AVX2 kernels with runtime dispatch, each pmaddwd multiplies the pixels of 2 rows and adds them in 32-bit
+// The sums are exact as long as they fit in 32-bit, thus the results are the same as the scalar loop.
+void WeightedSum(sint32 *dst, const sint16 *const *src, const sint16 *weight, PCType count, PCType width);
+
+
+#endif
@@ -583,6 +583,28 @@ void CUDA_MemcpyD2D(_Dt1 *dst, const _St1 *src, size_t count = 1)
 }
 
 
+// 2D copy of height rows of width elements, strides are in elements
+template < typename _Ty >
+void CUDA_Memcpy2D(_Ty *dst, size_t dst_stride, const _Ty *src, size_t src_stride,
+    size_t height, size_t width, ::cudaMemcpyKind kind)
+{
+    checkCudaErrors(::cudaMemcpy2D(reinterpret_cast<void *>(dst), sizeof(_Ty) * dst_stride,
+        reinterpret_cast<const void *>(src), sizeof(_Ty) * src_stride, sizeof(_Ty) * width, height, kind));
+}
+
+template < typename _Ty >
+void CUDA_Memcpy2DH2D(_Ty *dst, size_t dst_stride, const _Ty *src, size_t src_stride, size_t height, size_t width)
+{
+    CUDA_Memcpy2D(dst, dst_stride, src, src_stride, height, width, ::cudaMemcpyHostToDevice);
+}
+
+template < typename _Ty >
+void CUDA_Memcpy2DD2H(_Ty *dst, size_t dst_stride, const _Ty *src, size_t src_stride, size_t height, size_t width)
+{
+    CUDA_Memcpy2D(dst, dst_stride, src, src_stride, height, width, ::cudaMemcpyDeviceToHost);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
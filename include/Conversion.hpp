@@ -195,7 +195,7 @@ void RangeConvert(_Dt1 *dst, const _St1 *src,
 
                 LOOP_VH_PPL(height, width, dst_stride, src_stride, [&](PCType i0, PCType i1)
                 {
-                    dst[i0] = static_cast<dstType>(Clip(src[i1] + offset, lowerL, upperL));
+                    dst[i0] = static_cast<dstType>(Clip(static_cast<srcType>(src[i1] + offset), lowerL, upperL));
                 });
             }
             else
@@ -263,7 +263,7 @@ void RangeConvert(_Dt1 &dst, const _St1 &src,
     typename _St1::value_type sFloor, typename _St1::value_type sNeutral, typename _St1::value_type sCeil,
     bool clip = true)
 {
-    dst.ReSize(src.Width(), src.Height());
+    dst.ReSize(src.Width(), src.Height(), src.Stride());
 
     const PCType height = dst.Height();
     const PCType width = dst.Width();
@@ -330,9 +330,9 @@ void RangeConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const _St1 &srcR, const _S
         srcChroma = false;
     }
 
-    dstR.ReSize(srcR.Width(), srcR.Height());
-    dstG.ReSize(srcG.Width(), srcG.Height());
-    dstB.ReSize(srcB.Width(), srcB.Height());
+    dstR.ReSize(srcR.Width(), srcR.Height(), srcR.Stride());
+    dstG.ReSize(srcG.Width(), srcG.Height(), srcG.Stride());
+    dstB.ReSize(srcB.Width(), srcB.Height(), srcB.Stride());
 
     const PCType height = dstR.Height();
     const PCType width = dstR.Width();
@@ -491,7 +491,7 @@ void ConvertToY(_Dt1 &dst, const _St1 &srcR, const _St1 &srcG, const _St1 &srcB,
         dst.ReSetChroma(false);
     }
 
-    dst.ReSize(srcR.Width(), srcR.Height());
+    dst.ReSize(srcR.Width(), srcR.Height(), srcR.Stride());
 
     ConvertToY(dst.data(), srcR.data(), srcG.data(), srcB.data(),
         dst.Height(), dst.Width(), dst.Stride(), srcR.Stride(),
@@ -632,9 +632,9 @@ void MatrixConvert_RGB2YUV(_Dt1 &dstY, _Dt1 &dstU, _Dt1 &dstV,
     const _St1 &srcR, const _St1 &srcG, const _St1 &srcB,
     ColorMatrix matrix = ColorMatrix::OPP, bool clip = true)
 {
-    dstY.ReSize(srcR.Width(), srcR.Height());
-    dstU.ReSize(srcR.Width(), srcR.Height());
-    dstV.ReSize(srcR.Width(), srcR.Height());
+    dstY.ReSize(srcR.Width(), srcR.Height(), srcR.Stride());
+    dstU.ReSize(srcR.Width(), srcR.Height(), srcR.Stride());
+    dstV.ReSize(srcR.Width(), srcR.Height(), srcR.Stride());
 
     if (matrix == ColorMatrix::GBR)
     {
@@ -791,9 +791,9 @@ void MatrixConvert_YUV2RGB(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB,
     const _St1 &srcY, const _St1 &srcU, const _St1 &srcV,
     ColorMatrix matrix = ColorMatrix::OPP, bool clip = true)
 {
-    dstR.ReSize(srcY.Width(), srcY.Height());
-    dstG.ReSize(srcY.Width(), srcY.Height());
-    dstB.ReSize(srcY.Width(), srcY.Height());
+    dstR.ReSize(srcY.Width(), srcY.Height(), srcY.Stride());
+    dstG.ReSize(srcY.Width(), srcY.Height(), srcY.Stride());
+    dstB.ReSize(srcY.Width(), srcY.Height(), srcY.Stride());
 
     dstR.ReSetChroma(false);
     dstG.ReSetChroma(false);
@@ -843,11 +843,10 @@ void MatrixConvert(_Dt1 &dst, const _St1 &src, ColorMatrix _ColorMatrix = ColorM
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-template < typename _Dt1 >
-void TransferConvert(_Dt1 &dst, const Plane &src, TransferChar dstTransferChar, TransferChar srcTransferChar)
+template < typename _Dt1, typename _St1 >
+void TransferConvert(_Dt1 &dst, const PlaneT<_St1> &src, TransferChar dstTransferChar, TransferChar srcTransferChar)
 {
-    typedef Plane _St1;
-    typedef typename _St1::value_type srcType;
+    typedef _St1 srcType;
     typedef typename _Dt1::value_type dstType;
 
     const bool dstFloat = isFloat(dstType);
@@ -902,7 +901,7 @@ void TransferConvert(_Dt1 &dst, const Plane &src, TransferChar dstTransferChar,
     }
 
     // Conversion
-    dst.ReSize(src.Width(), src.Height());
+    dst.ReSize(src.Width(), src.Height(), src.Stride());
     _LUT.Lookup(dst, src);
 }
 
@@ -947,7 +946,7 @@ void TransferConvert(_Dt1 &dst, const Plane_FL &src, TransferChar dstTransferCha
     };
 
     // Conversion
-    dst.ReSize(src.Width(), src.Height());
+    dst.ReSize(src.Width(), src.Height(), src.Stride());
 
     if (src.Floor() == 0 && src.ValueRange() == 1)
     {
@@ -997,11 +996,10 @@ void TransferConvert(_Dt1 &dst, const _St1 &src)
     TransferConvert(dst, src, dst.GetTransferChar(), src.GetTransferChar());
 }
 
-template < typename _Dt1 >
-void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const Plane &srcR, const Plane &srcG, const Plane &srcB, TransferChar dstTransferChar, TransferChar srcTransferChar)
+template < typename _Dt1, typename _St1 >
+void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const PlaneT<_St1> &srcR, const PlaneT<_St1> &srcG, const PlaneT<_St1> &srcB, TransferChar dstTransferChar, TransferChar srcTransferChar)
 {
-    typedef Plane _St1;
-    typedef typename _St1::value_type srcType;
+    typedef _St1 srcType;
     typedef typename _Dt1::value_type dstType;
 
     const bool dstFloat = isFloat(dstType);
@@ -1058,9 +1056,9 @@ void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const Plane &srcR, cons
     }
 
     // Conversion
-    dstR.ReSize(srcR.Width(), srcR.Height());
-    dstG.ReSize(srcG.Width(), srcG.Height());
-    dstB.ReSize(srcB.Width(), srcB.Height());
+    dstR.ReSize(srcR.Width(), srcR.Height(), srcR.Stride());
+    dstG.ReSize(srcG.Width(), srcG.Height(), srcG.Stride());
+    dstB.ReSize(srcB.Width(), srcB.Height(), srcB.Stride());
     _LUT.Lookup(dstR, srcR);
     _LUT.Lookup(dstG, srcG);
     _LUT.Lookup(dstB, srcB);
@@ -1109,9 +1107,9 @@ void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const Plane_FL &srcR, c
     };
 
     // Conversion
-    dstR.ReSize(srcR.Width(), srcR.Height());
-    dstG.ReSize(srcG.Width(), srcG.Height());
-    dstB.ReSize(srcB.Width(), srcB.Height());
+    dstR.ReSize(srcR.Width(), srcR.Height(), srcR.Stride());
+    dstG.ReSize(srcG.Width(), srcG.Height(), srcG.Stride());
+    dstB.ReSize(srcB.Width(), srcB.Height(), srcB.Stride());
 
     const PCType height = dstR.Height();
     const PCType width = dstR.Width();
@@ -1173,7 +1171,8 @@ void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const _St1 &srcR, const
     TransferConvert(dstR, dstG, dstB, srcR, srcG, srcB, dstR.GetTransferChar(), srcR.GetTransferChar());
 }
 
-inline void TransferConvert(Frame &dst, const Frame &src, TransferChar dstTransferChar, TransferChar srcTransferChar)
+template < typename _Ty > inline
+void TransferConvert(FrameT<_Ty> &dst, const FrameT<_Ty> &src, TransferChar dstTransferChar, TransferChar srcTransferChar)
 {
     if (dst.GetPixelType() != src.GetPixelType())
     {
@@ -1257,8 +1256,8 @@ void SimplestColorBalance(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const _St1 &srcR,
         lower_thr > 0 || upper_thr > 0);
 }
 
-template < typename _St1 > inline
-void SimplestColorBalance(Frame &dst, const _St1 &srcR, const _St1 &srcG, const _St1 &srcB,
+template < typename _Ty, typename _St1 > inline
+void SimplestColorBalance(FrameT<_Ty> &dst, const _St1 &srcR, const _St1 &srcG, const _St1 &srcB,
 double lower_thr = 0., double upper_thr = 0., int HistBins = 1024)
 {
     SimplestColorBalance(dst.R(), dst.G(), dst.B(), srcR, srcG, srcB, lower_thr, upper_thr, HistBins);
@@ -22,43 +22,53 @@ const struct EdgeDetect_Para
 } ED_Default;
 
 
-Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true);
-Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true);
-Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true);
-Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm = true);
-Plane & EdgeDetect(Plane &dst, const Plane &src, EdgeKernel Kernel = ED_Default.Kernel);
+// Halo of the tiles of the 3x3 convolutions, see TileExecute
+const PCType Convolution3_Halo = 1;
 
 
-inline Plane Convolution3V(const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true)
+// The 3x3 convolutions and edge detection run on the storage type of the plane, instantiated for Plane, Plane16 and Plane8
+template < typename _Ty > PlaneT<_Ty> & Convolution3V(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true);
+template < typename _Ty > PlaneT<_Ty> & Convolution3H(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true);
+template < typename _Ty > PlaneT<_Ty> & Convolution3(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true);
+template < typename _Ty > PlaneT<_Ty> & FirstOrderDerivative3(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm = true);
+template < typename _Ty > PlaneT<_Ty> & EdgeDetect(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, EdgeKernel Kernel = ED_Default.Kernel);
+
+
+template < typename _Ty >
+PlaneT<_Ty> Convolution3V(const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true)
 {
-    Plane dst(src, false);
+    PlaneT<_Ty> dst(src, false);
     return Convolution3V(dst, src, K0, K1, K2, norm);
 }
 
-inline Plane Convolution3H(const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true)
+template < typename _Ty >
+PlaneT<_Ty> Convolution3H(const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true)
 {
-    Plane dst(src, false);
+    PlaneT<_Ty> dst(src, false);
     return Convolution3H(dst, src, K0, K1, K2, norm);
 }
 
-inline Plane Convolution3(const Plane &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true)
+template < typename _Ty >
+PlaneT<_Ty> Convolution3(const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true)
 {
-    Plane dst(src, false);
+    PlaneT<_Ty> dst(src, false);
     return Convolution3(dst, src, K0, K1, K2, K3, K4, K5, K6, K7, K8, norm);
 }
 
-inline Plane EdgeDetect(const Plane &src, EdgeKernel Kernel = ED_Default.Kernel)
+template < typename _Ty >
+PlaneT<_Ty> EdgeDetect(const PlaneT<_Ty> &src, EdgeKernel Kernel = ED_Default.Kernel)
 {
-    Plane dst(src, false);
+    PlaneT<_Ty> dst(src, false);
     return EdgeDetect(dst, src, Kernel);
 }
 
 
-inline Frame Convolution3V(const Frame &src, FLType K0, FLType K1, FLType K2, bool norm = true)
+template < typename _Ty >
+FrameT<_Ty> Convolution3V(const FrameT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true)
 {
-    Frame dst(src, false);
+    FrameT<_Ty> dst(src, false);
 
-    for (Frame::PlaneCountType i = 0; i < src.PlaneCount(); i++)
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); i++)
     {
         Convolution3V(dst.P(i), src.P(i), K0, K1, K2, norm);
     }
@@ -66,11 +76,12 @@ inline Frame Convolution3V(const Frame &src, FLType K0, FLType K1, FLType K2, bo
     return dst;
 }
 
-inline Frame Convolution3H(const Frame &src, FLType K0, FLType K1, FLType K2, bool norm = true)
+template < typename _Ty >
+FrameT<_Ty> Convolution3H(const FrameT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true)
 {
-    Frame dst(src, false);
+    FrameT<_Ty> dst(src, false);
 
-    for (Frame::PlaneCountType i = 0; i < src.PlaneCount(); i++)
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); i++)
     {
         Convolution3H(dst.P(i), src.P(i), K0, K1, K2, norm);
     }
@@ -78,11 +89,12 @@ inline Frame Convolution3H(const Frame &src, FLType K0, FLType K1, FLType K2, bo
     return dst;
 }
 
-inline Frame Convolution3(const Frame &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true)
+template < typename _Ty >
+FrameT<_Ty> Convolution3(const FrameT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true)
 {
-    Frame dst(src, false);
+    FrameT<_Ty> dst(src, false);
 
-    for (Frame::PlaneCountType i = 0; i < src.PlaneCount(); i++)
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); i++)
     {
         Convolution3(dst.P(i), src.P(i), K0, K1, K2, K3, K4, K5, K6, K7, K8, norm);
     }
@@ -90,11 +102,12 @@ inline Frame Convolution3(const Frame &src, FLType K0, FLType K1, FLType K2, FLT
     return dst;
 }
 
-inline Frame EdgeDetect(const Frame &src, EdgeKernel Kernel = ED_Default.Kernel)
+template < typename _Ty >
+FrameT<_Ty> EdgeDetect(const FrameT<_Ty> &src, EdgeKernel Kernel = ED_Default.Kernel)
 {
-    Frame dst(src, false);
+    FrameT<_Ty> dst(src, false);
 
-    for (Frame::PlaneCountType i = 0; i < src.PlaneCount(); i++)
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); i++)
     {
         EdgeDetect(dst.P(i), src.P(i), Kernel);
     }
@@ -154,6 +167,16 @@ protected:
         return EdgeDetect(src, Kernel);
     }
 
+    virtual Frame16 process_Frame16(Frame16 src)
+    {
+        return EdgeDetect(src, Kernel);
+    }
+
+    virtual Frame8 process_Frame8(Frame8 src)
+    {
+        return EdgeDetect(src, Kernel);
+    }
+
 public:
     EdgeDetect_IO(std::string _Tag = ".EdgeDetect")
         : _Mybase(std::move(_Tag)) {}
@@ -0,0 +1,500 @@
+#ifndef EXPRESSION_HPP_
+#define EXPRESSION_HPP_
+
+
+#include <cmath>
+#include <utility>
+#include <type_traits>
+#include "Image_Type.h"
+#include "Thread_Pool.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Lazy element-wise expressions over Plane and Plane_FL
+// The operators and functions below build a tree of nodes instead of temporary planes,
+// and Evaluate(dst, expr) computes the whole tree in a single pass, e.g.
+//     Evaluate(dst, Log(src / gauss + 1) * scale);
+// reads src and gauss once and writes dst once, without any intermediate plane.
+// The planes are referenced by the nodes, thus an expression shouldn't outlive its operands.
+// dst may also be an operand, since each pixel only depends on the same position of the operands.
+// Evaluate runs in parallel on pieces of PPL_HP rows in any source file, regardless of ENABLE_PPL.
+
+
+// Base of the nodes, each node defines:
+// value_type - the type of its values
+// row_type Row(PCType j) - an object whose operator[](i) is the value at (j, i)
+// bool Check(PCType width, PCType height) - whether all the planes in the node are of this size
+template < typename _Dt >
+class Expr
+{
+public:
+    const _Dt &derived() const { return static_cast<const _Dt &>(*this); }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Leaf node of a plane
+template < typename _St1 >
+class ExprPlane
+    : public Expr<ExprPlane<_St1>>
+{
+public:
+    typedef ExprPlane<_St1> _Myt;
+    typedef typename _St1::value_type value_type;
+    typedef typename _St1::const_pointer row_type;
+
+private:
+    row_type Data_;
+    PCType Width_;
+    PCType Height_;
+    PCType Stride_;
+
+public:
+    explicit ExprPlane(const _St1 &src)
+        : Data_(src.data()), Width_(src.Width()), Height_(src.Height()), Stride_(src.Stride())
+    {}
+
+    row_type Row(PCType j) const { return Data_ + j * Stride_; }
+    bool Check(PCType width, PCType height) const { return Width_ == width && Height_ == height; }
+};
+
+
+// Leaf node of a constant
+template < typename _Ty >
+class ExprScalar
+    : public Expr<ExprScalar<_Ty>>
+{
+public:
+    typedef ExprScalar<_Ty> _Myt;
+    typedef _Ty value_type;
+    typedef _Myt row_type;
+
+private:
+    value_type Value_;
+
+public:
+    explicit ExprScalar(value_type Value)
+        : Value_(Value)
+    {}
+
+    row_type Row(PCType) const { return *this; }
+    bool Check(PCType, PCType) const { return true; }
+
+    value_type operator[](PCType) const { return Value_; }
+};
+
+
+// Node applying _Func to the values of one node
+template < typename _Fn1, typename _E1 >
+class ExprUnary
+    : public Expr<ExprUnary<_Fn1, _E1>>
+{
+public:
+    typedef ExprUnary<_Fn1, _E1> _Myt;
+    typedef typename std::decay<decltype(std::declval<const _Fn1 &>()(
+        std::declval<typename _E1::value_type>()))>::type value_type;
+
+    class row_type
+    {
+        const _Fn1 &Func_;
+        typename _E1::row_type Row1_;
+
+    public:
+        row_type(const _Fn1 &_Func, typename _E1::row_type Row1)
+            : Func_(_Func), Row1_(Row1)
+        {}
+
+        value_type operator[](PCType i) const { return Func_(Row1_[i]); }
+    };
+
+private:
+    _Fn1 Func_;
+    _E1 E1_;
+
+public:
+    ExprUnary(const _E1 &e1, _Fn1 _Func)
+        : Func_(_Func), E1_(e1)
+    {}
+
+    row_type Row(PCType j) const { return row_type(Func_, E1_.Row(j)); }
+    bool Check(PCType width, PCType height) const { return E1_.Check(width, height); }
+};
+
+
+// Node applying _Func to the values of two nodes
+template < typename _Fn1, typename _E1, typename _E2 >
+class ExprBinary
+    : public Expr<ExprBinary<_Fn1, _E1, _E2>>
+{
+public:
+    typedef ExprBinary<_Fn1, _E1, _E2> _Myt;
+    typedef typename std::decay<decltype(std::declval<const _Fn1 &>()(
+        std::declval<typename _E1::value_type>(), std::declval<typename _E2::value_type>()))>::type value_type;
+
+    class row_type
+    {
+        const _Fn1 &Func_;
+        typename _E1::row_type Row1_;
+        typename _E2::row_type Row2_;
+
+    public:
+        row_type(const _Fn1 &_Func, typename _E1::row_type Row1, typename _E2::row_type Row2)
+            : Func_(_Func), Row1_(Row1), Row2_(Row2)
+        {}
+
+        value_type operator[](PCType i) const { return Func_(Row1_[i], Row2_[i]); }
+    };
+
+private:
+    _Fn1 Func_;
+    _E1 E1_;
+    _E2 E2_;
+
+public:
+    ExprBinary(const _E1 &e1, const _E2 &e2, _Fn1 _Func)
+        : Func_(_Func), E1_(e1), E2_(e2)
+    {}
+
+    row_type Row(PCType j) const { return row_type(Func_, E1_.Row(j), E2_.Row(j)); }
+    bool Check(PCType width, PCType height) const { return E1_.Check(width, height) && E2_.Check(width, height); }
+};
+
+
+// Node applying _Func to the values of three nodes
+template < typename _Fn1, typename _E1, typename _E2, typename _E3 >
+class ExprTernary
+    : public Expr<ExprTernary<_Fn1, _E1, _E2, _E3>>
+{
+public:
+    typedef ExprTernary<_Fn1, _E1, _E2, _E3> _Myt;
+    typedef typename std::decay<decltype(std::declval<const _Fn1 &>()(std::declval<typename _E1::value_type>(),
+        std::declval<typename _E2::value_type>(), std::declval<typename _E3::value_type>()))>::type value_type;
+
+    class row_type
+    {
+        const _Fn1 &Func_;
+        typename _E1::row_type Row1_;
+        typename _E2::row_type Row2_;
+        typename _E3::row_type Row3_;
+
+    public:
+        row_type(const _Fn1 &_Func, typename _E1::row_type Row1, typename _E2::row_type Row2, typename _E3::row_type Row3)
+            : Func_(_Func), Row1_(Row1), Row2_(Row2), Row3_(Row3)
+        {}
+
+        value_type operator[](PCType i) const { return Func_(Row1_[i], Row2_[i], Row3_[i]); }
+    };
+
+private:
+    _Fn1 Func_;
+    _E1 E1_;
+    _E2 E2_;
+    _E3 E3_;
+
+public:
+    ExprTernary(const _E1 &e1, const _E2 &e2, const _E3 &e3, _Fn1 _Func)
+        : Func_(_Func), E1_(e1), E2_(e2), E3_(e3)
+    {}
+
+    row_type Row(PCType j) const { return row_type(Func_, E1_.Row(j), E2_.Row(j), E3_.Row(j)); }
+    bool Check(PCType width, PCType height) const
+    {
+        return E1_.Check(width, height) && E2_.Check(width, height) && E3_.Check(width, height);
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Conversion of the operands to nodes
+// value - whether it can be an operand, lazy - whether it's a node or a plane rather than a constant
+template < typename _Ty, typename _En = void >
+struct ExprOperand
+{
+    static const bool value = false;
+    static const bool lazy = false;
+};
+
+template < typename _Ty >
+struct ExprOperand<_Ty, typename std::enable_if<std::is_base_of<Expr<_Ty>, _Ty>::value>::type>
+{
+    static const bool value = true;
+    static const bool lazy = true;
+    typedef _Ty type;
+    static const type &Make(const _Ty &x) { return x; }
+};
+
+template < typename _Ty >
+struct ExprOperand<PlaneT<_Ty>, void>
+{
+    static const bool value = true;
+    static const bool lazy = true;
+    typedef ExprPlane<PlaneT<_Ty>> type;
+    static type Make(const PlaneT<_Ty> &x) { return type(x); }
+};
+
+template < >
+struct ExprOperand<Plane_FL, void>
+{
+    static const bool value = true;
+    static const bool lazy = true;
+    typedef ExprPlane<Plane_FL> type;
+    static type Make(const Plane_FL &x) { return type(x); }
+};
+
+template < typename _Ty >
+struct ExprOperand<_Ty, typename std::enable_if<std::is_arithmetic<_Ty>::value>::type>
+{
+    static const bool value = true;
+    static const bool lazy = false;
+    typedef ExprScalar<_Ty> type;
+    static type Make(_Ty x) { return type(x); }
+};
+
+
+template < typename _E1 > inline
+typename ExprOperand<_E1>::type ToExpr(const _E1 &e1)
+{
+    return ExprOperand<_E1>::Make(e1);
+}
+
+
+// Result of an operator, only defined if one of the operands is a node or a plane
+template < typename _Fn1, typename _E1, typename _E2,
+    bool = ExprOperand<_E1>::value && ExprOperand<_E2>::value && (ExprOperand<_E1>::lazy || ExprOperand<_E2>::lazy) >
+struct ExprBinaryResult
+{};
+
+template < typename _Fn1, typename _E1, typename _E2 >
+struct ExprBinaryResult<_Fn1, _E1, _E2, true>
+{
+    typedef ExprBinary<_Fn1, typename ExprOperand<_E1>::type, typename ExprOperand<_E2>::type> type;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+struct ExprAdd
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(_Ty1 a, _Ty2 b) const -> decltype(a + b) { return a + b; }
+};
+
+struct ExprSub
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(_Ty1 a, _Ty2 b) const -> decltype(a - b) { return a - b; }
+};
+
+struct ExprMul
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(_Ty1 a, _Ty2 b) const -> decltype(a * b) { return a * b; }
+};
+
+struct ExprDiv
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(_Ty1 a, _Ty2 b) const -> decltype(a / b) { return a / b; }
+};
+
+struct ExprNeg
+{
+    template < typename _Ty >
+    auto operator()(_Ty a) const -> decltype(-a) { return -a; }
+};
+
+struct ExprLog
+{
+    template < typename _Ty >
+    auto operator()(_Ty a) const -> decltype(std::log(a)) { return std::log(a); }
+};
+
+struct ExprExp
+{
+    template < typename _Ty >
+    auto operator()(_Ty a) const -> decltype(std::exp(a)) { return std::exp(a); }
+};
+
+struct ExprSqrt
+{
+    template < typename _Ty >
+    auto operator()(_Ty a) const -> decltype(std::sqrt(a)) { return std::sqrt(a); }
+};
+
+template < typename _Ty >
+struct ExprClip
+{
+    _Ty lower;
+    _Ty upper;
+
+    _Ty operator()(_Ty a) const { return ::Clip(a, lower, upper); }
+};
+
+// Rounded to the nearest integer for integer types, the same as PlaneT::Quantize() and Plane_FL::Quantize()
+template < typename _Ty >
+struct ExprQuantize
+{
+    _Ty Floor;
+    _Ty Ceil;
+
+    template < typename T >
+    _Ty operator()(T a) const
+    {
+        const T a_up = std::is_floating_point<_Ty>::value ? a : a + T(0.5);
+        return a <= Floor ? Floor : a_up >= Ceil ? Ceil : static_cast<_Ty>(a_up);
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template < typename _E1, typename _E2 > inline
+typename ExprBinaryResult<ExprAdd, _E1, _E2>::type operator+(const _E1 &left, const _E2 &right)
+{
+    return typename ExprBinaryResult<ExprAdd, _E1, _E2>::type(ToExpr(left), ToExpr(right), ExprAdd());
+}
+
+template < typename _E1, typename _E2 > inline
+typename ExprBinaryResult<ExprSub, _E1, _E2>::type operator-(const _E1 &left, const _E2 &right)
+{
+    return typename ExprBinaryResult<ExprSub, _E1, _E2>::type(ToExpr(left), ToExpr(right), ExprSub());
+}
+
+template < typename _E1, typename _E2 > inline
+typename ExprBinaryResult<ExprMul, _E1, _E2>::type operator*(const _E1 &left, const _E2 &right)
+{
+    return typename ExprBinaryResult<ExprMul, _E1, _E2>::type(ToExpr(left), ToExpr(right), ExprMul());
+}
+
+template < typename _E1, typename _E2 > inline
+typename ExprBinaryResult<ExprDiv, _E1, _E2>::type operator/(const _E1 &left, const _E2 &right)
+{
+    return typename ExprBinaryResult<ExprDiv, _E1, _E2>::type(ToExpr(left), ToExpr(right), ExprDiv());
+}
+
+template < typename _E1 > inline
+typename std::enable_if<ExprOperand<_E1>::lazy, ExprUnary<ExprNeg, typename ExprOperand<_E1>::type>>::type
+operator-(const _E1 &e1)
+{
+    return ExprUnary<ExprNeg, typename ExprOperand<_E1>::type>(ToExpr(e1), ExprNeg());
+}
+
+
+template < typename _E1 > inline
+typename std::enable_if<ExprOperand<_E1>::lazy, ExprUnary<ExprLog, typename ExprOperand<_E1>::type>>::type
+Log(const _E1 &e1)
+{
+    return ExprUnary<ExprLog, typename ExprOperand<_E1>::type>(ToExpr(e1), ExprLog());
+}
+
+template < typename _E1 > inline
+typename std::enable_if<ExprOperand<_E1>::lazy, ExprUnary<ExprExp, typename ExprOperand<_E1>::type>>::type
+Exp(const _E1 &e1)
+{
+    return ExprUnary<ExprExp, typename ExprOperand<_E1>::type>(ToExpr(e1), ExprExp());
+}
+
+template < typename _E1 > inline
+typename std::enable_if<ExprOperand<_E1>::lazy, ExprUnary<ExprSqrt, typename ExprOperand<_E1>::type>>::type
+Sqrt(const _E1 &e1)
+{
+    return ExprUnary<ExprSqrt, typename ExprOperand<_E1>::type>(ToExpr(e1), ExprSqrt());
+}
+
+template < typename _E1, typename _Ty > inline
+typename std::enable_if<ExprOperand<_E1>::lazy, ExprUnary<ExprClip<_Ty>, typename ExprOperand<_E1>::type>>::type
+Clip(const _E1 &e1, _Ty lower, _Ty upper)
+{
+    return ExprUnary<ExprClip<_Ty>, typename ExprOperand<_E1>::type>(ToExpr(e1), ExprClip<_Ty>{ lower, upper });
+}
+
+// Clipped to [Floor, Ceil] and converted to _Ty, e.g. Quantize(expr, dst.Floor(), dst.Ceil()) for an integer dst
+template < typename _E1, typename _Ty > inline
+typename std::enable_if<ExprOperand<_E1>::lazy, ExprUnary<ExprQuantize<_Ty>, typename ExprOperand<_E1>::type>>::type
+Quantize(const _E1 &e1, _Ty Floor, _Ty Ceil)
+{
+    return ExprUnary<ExprQuantize<_Ty>, typename ExprOperand<_E1>::type>(ToExpr(e1), ExprQuantize<_Ty>{ Floor, Ceil });
+}
+
+
+// Custom nodes, _Func is called with the values of the operands at each position
+template < typename _E1, typename _Fn1 > inline
+typename std::enable_if<ExprOperand<_E1>::lazy, ExprUnary<_Fn1, typename ExprOperand<_E1>::type>>::type
+Transform(const _E1 &e1, _Fn1 _Func)
+{
+    return ExprUnary<_Fn1, typename ExprOperand<_E1>::type>(ToExpr(e1), _Func);
+}
+
+template < typename _E1, typename _E2, typename _Fn1 > inline
+typename std::enable_if<ExprOperand<_E1>::value && ExprOperand<_E2>::value && !ExprOperand<_Fn1>::value,
+    ExprBinary<_Fn1, typename ExprOperand<_E1>::type, typename ExprOperand<_E2>::type>>::type
+Transform(const _E1 &e1, const _E2 &e2, _Fn1 _Func)
+{
+    return ExprBinary<_Fn1, typename ExprOperand<_E1>::type, typename ExprOperand<_E2>::type>(
+        ToExpr(e1), ToExpr(e2), _Func);
+}
+
+template < typename _E1, typename _E2, typename _E3, typename _Fn1 > inline
+typename std::enable_if<ExprOperand<_E1>::value && ExprOperand<_E2>::value && ExprOperand<_E3>::value && !ExprOperand<_Fn1>::value,
+    ExprTernary<_Fn1, typename ExprOperand<_E1>::type, typename ExprOperand<_E2>::type, typename ExprOperand<_E3>::type>>::type
+Transform(const _E1 &e1, const _E2 &e2, const _E3 &e3, _Fn1 _Func)
+{
+    return ExprTernary<_Fn1, typename ExprOperand<_E1>::type, typename ExprOperand<_E2>::type, typename ExprOperand<_E3>::type>(
+        ToExpr(e1), ToExpr(e2), ToExpr(e3), _Func);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Compute the expression into dst in a single pass, the values are converted to the value_type of dst by static_cast
+template < typename _Dt1, typename _E1 >
+typename std::enable_if<ExprOperand<_E1>::lazy, _Dt1 &>::type Evaluate(_Dt1 &dst, const _E1 &expr)
+{
+    typedef typename _Dt1::value_type dstType;
+
+    const typename ExprOperand<_E1>::type e = ToExpr(expr);
+
+    if (!e.Check(dst.Width(), dst.Height()))
+    {
+        DEBUG_FAIL("Evaluate: Width() and Height() of the operands and dst must be the same.");
+    }
+
+    const PCType width = dst.Width();
+    const PCType stride = dst.Stride();
+    auto dstp0 = dst.data();
+
+    const PCType height = dst.Height();
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    // LOOP_V_PPL is serial in the source files not defining ENABLE_PPL, such as BM3D.cpp and NLMeans.cpp
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            const auto row = e.Row(j);
+            auto dstp = dstp0 + j * stride;
+
+            for (PCType i = 0; i < width; ++i)
+            {
+                dstp[i] = static_cast<dstType>(row[i]);
+            }
+        }
+    });
+
+    return dst;
+}
+
+
+#endif
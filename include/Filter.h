@@ -5,6 +5,9 @@
 #include <cstdlib>
 #include "Args.h"
 #include "ImageIO.h"
+#include "Thread_Pool.h"
+#include "Memory_Pool.h"
+#include "Tile.h"
 
 
 template < typename _Ty = FLType >
@@ -110,20 +113,116 @@ protected:
         return dst;
     }
 
+    // Kernels of the narrow storage types, filters without them go through the DType code path by process_Widen()
+    virtual Plane16 &process_Plane16(Plane16 &dst, const Plane16 &src)
+    {
+        return process_Widen(dst, src);
+    }
+
+    virtual Plane8 &process_Plane8(Plane8 &dst, const Plane8 &src)
+    {
+        return process_Widen(dst, src);
+    }
+
+    virtual Frame16 &process_Frame16(Frame16 &dst, const Frame16 &src)
+    {
+        return process_Widen(dst, src);
+    }
+
+    virtual Frame8 &process_Frame8(Frame8 &dst, const Frame8 &src)
+    {
+        return process_Widen(dst, src);
+    }
+
+    // src is widened to DType only for the duration of the call,
+    // the content of dst is never read, thus it's not widened.
+    template < typename _Ty >
+    PlaneT<_Ty> &process_Widen(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
+    {
+        const Plane srcW(src);
+        Plane temp(srcW, false);
+        process_Plane(temp, srcW);
+        dst = PlaneT<_Ty>(temp);
+        return dst;
+    }
+
+    template < typename _Ty >
+    FrameT<_Ty> &process_Widen(FrameT<_Ty> &dst, const FrameT<_Ty> &src)
+    {
+        const Frame srcW(src);
+        Frame temp(srcW, false);
+        process_Frame(temp, srcW);
+        dst = FrameT<_Ty>(temp);
+        return dst;
+    }
+
+    // For filters processing the planes independently, i.e. not overriding process_Frame()
+    template < typename _Ty >
+    FrameT<_Ty> &process_Planes(FrameT<_Ty> &dst, const FrameT<_Ty> &src)
+    {
+        for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); i++)
+        {
+            process_Narrow(dst.P(i), src.P(i));
+        }
+
+        return dst;
+    }
+
+private:
+    Plane16 &process_Narrow(Plane16 &dst, const Plane16 &src) { return process_Plane16(dst, src); }
+    Plane8 &process_Narrow(Plane8 &dst, const Plane8 &src) { return process_Plane8(dst, src); }
+    Frame16 &process_Narrow(Frame16 &dst, const Frame16 &src) { return process_Frame16(dst, src); }
+    Frame8 &process_Narrow(Frame8 &dst, const Frame8 &src) { return process_Frame8(dst, src); }
+
 public:
+    // Halo needed around each tile for tiled processing to give the same result as the whole plane,
+    // negative if the filter can't be processed in tiles, see TileExecute()
+    virtual PCType TileHalo() const { return -1; }
+
+    // Tiles start at multiples of this, such as the block step of block-based filters
+    virtual PCType TileAlign() const { return 1; }
+
     Plane_FL &process(Plane_FL &dst, const Plane_FL &src)
     {
-        return process_Plane_FL(dst, src);
+        return TileExecute(dst, src, TileHalo(), TileAlign(), [this](Plane_FL &d, const Plane_FL &s)
+        {
+            process_Plane_FL(d, s);
+        });
     }
 
     Plane &process(Plane &dst, const Plane &src)
     {
-        return process_Plane(dst, src);
+        return TileExecute(dst, src, TileHalo(), TileAlign(), [this](Plane &d, const Plane &s)
+        {
+            process_Plane(d, s);
+        });
     }
 
     Frame &process(Frame &dst, const Frame &src)
     {
-        return process_Frame(dst, src);
+        return TileExecute(dst, src, TileHalo(), TileAlign(), [this](Frame &d, const Frame &s)
+        {
+            process_Frame(d, s);
+        });
+    }
+
+    // Plane16/Plane8 and Frame16/Frame8
+    template < typename _Ty >
+    PlaneT<_Ty> &process(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
+    {
+        return TileExecute(dst, src, TileHalo(), TileAlign(), [this](PlaneT<_Ty> &d, const PlaneT<_Ty> &s)
+        {
+            process_Narrow(d, s);
+        });
+    }
+
+    template < typename _Ty >
+    FrameT<_Ty> &process(FrameT<_Ty> &dst, const FrameT<_Ty> &src)
+    {
+        return TileExecute(dst, src, TileHalo(), TileAlign(), [this](FrameT<_Ty> &d, const FrameT<_Ty> &s)
+        {
+            process_Narrow(d, s);
+        });
     }
 
     template < typename _St1 >
@@ -171,19 +270,75 @@ protected:
     }
 
 public:
+    // Halo needed around each tile for tiled processing to give the same result as the whole plane,
+    // negative if the filter can't be processed in tiles, see TileExecute()
+    virtual PCType TileHalo() const { return -1; }
+
+    // Tiles start at multiples of this, such as the block step of block-based filters
+    virtual PCType TileAlign() const { return 1; }
+
     Plane_FL &process(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref)
     {
-        return process_Plane_FL(dst, src, ref);
+        return TileExecute(dst, src, ref, TileHalo(), TileAlign(), [this](Plane_FL &d, const Plane_FL &s, const Plane_FL &r)
+        {
+            process_Plane_FL(d, s, r);
+        });
     }
 
     Plane &process(Plane &dst, const Plane &src, const Plane &ref)
     {
-        return process_Plane(dst, src, ref);
+        return TileExecute(dst, src, ref, TileHalo(), TileAlign(), [this](Plane &d, const Plane &s, const Plane &r)
+        {
+            process_Plane(d, s, r);
+        });
     }
 
     Frame &process(Frame &dst, const Frame &src, const Frame &ref)
     {
-        return process_Frame(dst, src, ref);
+        return TileExecute(dst, src, ref, TileHalo(), TileAlign(), [this](Frame &d, const Frame &s, const Frame &r)
+        {
+            process_Frame(d, s, r);
+        });
+    }
+
+    // Narrow storage types go through the DType code path, widened only for the duration of the call
+    // The content of dst is never read, thus only src and ref are widened.
+    template < typename _Ty >
+    PlaneT<_Ty> &process(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, const PlaneT<_Ty> &ref)
+    {
+        const Plane srcW(src);
+        Plane temp(srcW, false);
+
+        if (&src == &ref)
+        {
+            process(temp, srcW, srcW);
+        }
+        else
+        {
+            process(temp, srcW, Plane(ref));
+        }
+
+        dst = PlaneT<_Ty>(temp);
+        return dst;
+    }
+
+    template < typename _Ty >
+    FrameT<_Ty> &process(FrameT<_Ty> &dst, const FrameT<_Ty> &src, const FrameT<_Ty> &ref)
+    {
+        const Frame srcW(src);
+        Frame temp(srcW, false);
+
+        if (&src == &ref)
+        {
+            process(temp, srcW, srcW);
+        }
+        else
+        {
+            process(temp, srcW, Frame(ref));
+        }
+
+        dst = FrameT<_Ty>(temp);
+        return dst;
     }
 
     template < typename _St1 >
@@ -195,17 +350,29 @@ public:
 
     Plane_FL &process(Plane_FL &dst, const Plane_FL &src)
     {
-        return process_Plane_FL(dst, src, src);
+        return process(dst, src, src);
     }
 
     Plane &process(Plane &dst, const Plane &src)
     {
-        return process_Plane(dst, src, src);
+        return process(dst, src, src);
     }
 
     Frame &process(Frame &dst, const Frame &src)
     {
-        return process_Frame(dst, src, src);
+        return process(dst, src, src);
+    }
+
+    template < typename _Ty >
+    PlaneT<_Ty> &process(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
+    {
+        return process(dst, src, src);
+    }
+
+    template < typename _Ty >
+    FrameT<_Ty> &process(FrameT<_Ty> &dst, const FrameT<_Ty> &src)
+    {
+        return process(dst, src, src);
     }
 
     template < typename _St1 >
@@ -227,12 +394,15 @@ private:
     static const int PATHLEN = 256;
     static const int EXTLEN = 64;
 
-    std::string IPath;
-    std::string OPath;
+    std::vector<std::string> IPaths;
     std::string Tag;
     std::string Format = ".png";
 
-    void generate_OPath()
+    DType BitDepth = 16; // Bit depth of the decoded images, stored in Frame8 up to 8 bit and in Frame16 above
+    int Workers = 1; // Concurrent image workers in batch mode, 0 means the thread count
+    double MemoryLimit = 0; // Memory budget of the images in flight in batch mode (MiB), 0 means unlimited
+
+    std::string generate_OPath(const std::string &IPath) const
     {
         char Drive[DRIVELEN];
         char Dir[PATHLEN];
@@ -240,14 +410,101 @@ private:
         char Ext[EXTLEN];
 
         _splitpath_s(IPath.c_str(), Drive, PATHLEN, Dir, PATHLEN, FileName, PATHLEN, Ext, PATHLEN);
-        OPath = std::string(Drive) + std::string(Dir) + std::string(FileName) + Tag + Format;
+        return std::string(Drive) + std::string(Dir) + std::string(FileName) + Tag + Format;
+    }
+
+    // Directories are expanded to the image files in them
+    void add_IPath(const std::string &path)
+    {
+        if (IsDirectory(path))
+        {
+            const std::vector<std::string> files = ImageFileList(path);
+            IPaths.insert(IPaths.end(), files.begin(), files.end());
+        }
+        else
+        {
+            IPaths.push_back(path);
+        }
+    }
+
+    // Rough estimate of the memory held by one image in flight:
+    // source and destination frames plus 2 floating point working copies
+    static size_t MemoryEstimate(PCType width, PCType height, int planes = 3)
+    {
+        return static_cast<size_t>(width) * height * planes
+            * (sizeof(DType) * 2 + sizeof(FLType) * 2);
+    }
+
+    // The budget is reserved by the size in the header of the image before decoding it,
+    // or after decoding when the header can't be parsed
+    bool processIO(const std::string &IPath, const std::string &OPath, Memory_Budget *budget = nullptr)
+    {
+        if (BitDepth <= StorageBitDepth<uint8>())
+        {
+            return processIOT<uint8>(IPath, OPath, budget);
+        }
+        else
+        {
+            return processIOT<uint16>(IPath, OPath, budget);
+        }
     }
 
-    void processIO()
+    template < typename _Ty >
+    bool processIOT(const std::string &IPath, const std::string &OPath, Memory_Budget *budget)
     {
-        const Frame src = ImageReader(IPath);
-        Frame dst = process(src);
-        ImageWriter(dst, OPath);
+        PCType width = 0;
+        PCType height = 0;
+        const bool sized = budget && ImageSize(IPath, width, height);
+
+        Memory_Budget::Guard guard(budget, sized ? MemoryEstimate(width, height) : 0);
+
+        FrameT<_Ty> src;
+
+        if (!ImageRead(src, IPath, 0, BitDepth))
+        {
+            return false;
+        }
+
+        if (!sized) guard.Acquire(MemoryEstimate(src.Width(), src.Height(), src.PlaneCount()));
+
+        const FrameT<_Ty> dst = Process(std::move(src));
+
+        if (!ImageWriter(dst, OPath))
+        {
+            std::cerr << "FilterIO: Failed to write the output of " << IPath << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // All the inputs are processed in one process, arguments are only parsed once.
+    // Each image worker takes the next input until all are done,
+    // while the filters running in the workers share the same thread pool.
+    void processBatch()
+    {
+        const PCType count = static_cast<PCType>(IPaths.size());
+        const PCType workers = Min(count, static_cast<PCType>(Workers > 0 ? Workers : GetThreadCount()));
+
+        Memory_Budget budget(static_cast<size_t>(MemoryLimit * 1024 * 1024));
+        std::atomic<PCType> next(0);
+        std::atomic<PCType> failed(0);
+
+        _Parallel_for(PCType(0), workers, [&](PCType)
+        {
+            for (PCType n = next++; n < count; n = next++)
+            {
+                if (!processIO(IPaths[n], generate_OPath(IPaths[n]), &budget))
+                {
+                    ++failed;
+                }
+            }
+        });
+
+        if (failed > 0)
+        {
+            std::cerr << "FilterIO: " << failed << " of " << count << " images failed!\n";
+        }
     }
 
 protected:
@@ -258,6 +515,8 @@ protected:
     {
         Args ArgsObj(argc, args);
 
+        IPaths.clear();
+
         for (int i = 0; i < argc; i++)
         {
             if (args[i] == "-T" || args[i] == "--tag")
@@ -270,13 +529,97 @@ protected:
                 ArgsObj.GetPara(i, Format);
                 continue;
             }
+            if (args[i] == "--list")
+            {
+                std::string ListPath;
+                ArgsObj.GetPara(i, ListPath);
+
+                for (const auto &path : ReadFileList(ListPath))
+                {
+                    add_IPath(path);
+                }
+
+                continue;
+            }
+            if (args[i] == "--bit_depth")
+            {
+                ArgsObj.GetPara(i, BitDepth);
+                BitDepth = Clip(BitDepth, DType(1), StorageBitDepth<uint16>());
+                continue;
+            }
+            if (args[i] == "--workers")
+            {
+                ArgsObj.GetPara(i, Workers);
+                continue;
+            }
+            if (args[i] == "--memory")
+            {
+                ArgsObj.GetPara(i, MemoryLimit);
+                continue;
+            }
+            if (args[i] == "--threads")
+            {
+                int threads = 0;
+                ArgsObj.GetPara(i, threads);
+                SetThreadCount(threads);
+                continue;
+            }
+            if (args[i] == "--pool_limit")
+            {
+                double limit = 0;
+                ArgsObj.GetPara(i, limit);
+                SetMemoryPoolLimit(static_cast<size_t>(Max(limit, 0.0) * 1024 * 1024));
+                continue;
+            }
+            if (args[i] == "--ppl_hp")
+            {
+                PCType piece = 0;
+                ArgsObj.GetPara(i, piece);
+                SetPPLPieceSize(piece, 0);
+                continue;
+            }
+            if (args[i] == "--ppl_wp")
+            {
+                PCType piece = 0;
+                ArgsObj.GetPara(i, piece);
+                SetPPLPieceSize(0, piece);
+                continue;
+            }
+            if (args[i] == "--tile_hp")
+            {
+                PCType piece = 0;
+                ArgsObj.GetPara(i, piece);
+                SetTileSize(piece, -1);
+                continue;
+            }
+            if (args[i] == "--tile_wp")
+            {
+                PCType piece = 0;
+                ArgsObj.GetPara(i, piece);
+                SetTileSize(-1, piece);
+                continue;
+            }
+            if (args[i] == "--stride_align")
+            {
+                PCType align = 0;
+                ArgsObj.GetPara(i, align);
+                SetPlaneStride(align);
+                continue;
+            }
+            if (args[i] == "--stride_skew")
+            {
+                int skew = 0;
+                ArgsObj.GetPara(i, skew);
+                SetPlaneStride(-1, skew);
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
                 continue;
             }
 
-            IPath = args[i];
+            add_IPath(args[i]);
         }
 
         ArgsObj.Check();
@@ -284,6 +627,32 @@ protected:
 
     virtual Frame process(const Frame &src) = 0;
 
+    // Frames of the narrow storage types are widened to DType only while the filter runs,
+    // the narrow source is released before and the wide result is released after narrowing it.
+    // Filters with kernels of the narrow storage types override them to process the narrow frames directly,
+    // and Filter_Chain_IO overrides them to keep the narrow frames between the stages.
+    virtual Frame16 process_Frame16(Frame16 src)
+    {
+        return processT(std::move(src));
+    }
+
+    virtual Frame8 process_Frame8(Frame8 src)
+    {
+        return processT(std::move(src));
+    }
+
+    template < typename _Ty >
+    FrameT<_Ty> processT(FrameT<_Ty> src)
+    {
+        Frame srcW(src);
+        src = FrameT<_Ty>();
+
+        Frame dstW = process(srcW);
+        srcW = Frame();
+
+        return FrameT<_Ty>(dstW);
+    }
+
 public:
     FilterIO(std::string _Tag = "")
         : Tag(std::move(_Tag))
@@ -302,13 +671,51 @@ public:
         Tag = std::move(_Tag);
     }
 
+    const std::string &GetTag() const
+    {
+        return Tag;
+    }
+
+    // Parse the arguments and process frames in memory, used by Filter_Chain_IO
+    void ParseArgs()
+    {
+        arguments_process();
+    }
+
+    Frame Process(const Frame &src)
+    {
+        return process(src);
+    }
+
+    Frame16 Process(Frame16 src)
+    {
+        return process_Frame16(std::move(src));
+    }
+
+    Frame8 Process(Frame8 src)
+    {
+        return process_Frame8(std::move(src));
+    }
+
+    // Any number of input files, directories and file lists (--list) can be specified,
+    // the output path is only used when there's exactly one input
     void operator()(std::string _IPath = "", std::string _OPath = "")
     {
         arguments_process();
-        if(_IPath != "") IPath = std::move(_IPath);
-        if(_OPath != "") OPath = std::move(_OPath);
-        else generate_OPath();
-        processIO();
+        if (_IPath != "") IPaths.assign(1, std::move(_IPath));
+
+        if (IPaths.size() == 0)
+        {
+            std::cerr << "FilterIO: No input file specified!\n";
+        }
+        else if (IPaths.size() == 1)
+        {
+            processIO(IPaths[0], _OPath != "" ? _OPath : generate_OPath(IPaths[0]));
+        }
+        else
+        {
+            processBatch();
+        }
     }
 
     FilterIO(const _Myt &src) = default;
@@ -318,4 +725,83 @@ public:
 };
 
 
+// Pipeline of several filters in one process
+// Only the input is decoded and only the final output is encoded, while the frames are passed between
+// the stages in memory, keeping the bit depth of ImageReader instead of the 8 bit intermediate files.
+class Filter_Chain_IO
+    : public FilterIO
+{
+public:
+    typedef Filter_Chain_IO _Myt;
+    typedef FilterIO _Mybase;
+
+private:
+    std::vector<std::unique_ptr<FilterIO>> stages;
+
+    // The default tag is the concatenation of the tags of all the stages
+    static std::string ChainTag(const std::vector<std::unique_ptr<FilterIO>> &stages)
+    {
+        std::string tag;
+
+        for (const auto &stage : stages)
+        {
+            tag += stage->GetTag();
+        }
+
+        return tag;
+    }
+
+protected:
+    virtual void arguments_process()
+    {
+        _Mybase::arguments_process();
+
+        for (auto &stage : stages)
+        {
+            stage->ParseArgs();
+        }
+    }
+
+    virtual Frame process(const Frame &src)
+    {
+        Frame dst = stages[0]->Process(src);
+
+        for (size_t i = 1; i < stages.size(); ++i)
+        {
+            dst = stages[i]->Process(dst);
+        }
+
+        return dst;
+    }
+
+    virtual Frame16 process_Frame16(Frame16 src)
+    {
+        return processStages(std::move(src));
+    }
+
+    virtual Frame8 process_Frame8(Frame8 src)
+    {
+        return processStages(std::move(src));
+    }
+
+    // The frame passed between the stages stays in the narrow storage type
+    template < typename _Ty >
+    FrameT<_Ty> processStages(FrameT<_Ty> frame)
+    {
+        for (auto &stage : stages)
+        {
+            frame = stage->Process(std::move(frame));
+        }
+
+        return frame;
+    }
+
+public:
+    // Each stage should have its own arguments set by SetArgs()
+    Filter_Chain_IO(std::vector<std::unique_ptr<FilterIO>> _stages)
+        : _Mybase(ChainTag(_stages)), stages(std::move(_stages))
+    {}
+};
+
+
 #endif
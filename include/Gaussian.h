@@ -3,6 +3,8 @@
 
 
 #include <cmath>
+#include <vector>
+#include <functional>
 #include "Filter.h"
 #include "Image_Type.h"
 #include "LUT.h"
@@ -23,6 +25,7 @@ const ldbl sigmaRMul = sizeof(FLType) < 8 ? 8.0L : 32.0L; // 8. when FLType is f
 struct Gaussian2D_Para
 {
     ldbl sigma = 3.0L;
+    int algorithm = 0; // 0: automatic, 1: recursive Gaussian (IIR), 2: stacked box filters, 3: fixed-point FIR for Plane (IIR for Plane_FL)
 };
 
 extern const Gaussian2D_Para Gaussian2D_Default;
@@ -43,8 +46,23 @@ public:
         : para(_para)
     {}
 
+    // The recursive filter is split into tiles by TiledRecursiveGaussian with the states handed over between them,
+    // while the stacked box filters and the fixed-point FIR have a finite support, thus the tiled result is the same in all cases
+    virtual PCType TileHalo() const override;
+
+    // The algorithm used for sigma and the data type, resolving the automatic mode
+    static int Algorithm(ldbl sigma, int algorithm, bool integer);
+
 protected:
+    virtual Plane_FL &process_Plane_FL(Plane_FL &dst, const Plane_FL &src);
     virtual Plane &process_Plane(Plane &dst, const Plane &src);
+    virtual Plane16 &process_Plane16(Plane16 &dst, const Plane16 &src);
+    virtual Plane8 &process_Plane8(Plane8 &dst, const Plane8 &src);
+    virtual Frame16 &process_Frame16(Frame16 &dst, const Frame16 &src);
+    virtual Frame8 &process_Frame8(Frame8 &dst, const Frame8 &src);
+
+    // The integer algorithms run on the storage type of the plane
+    template < typename _Ty > PlaneT<_Ty> &process_PlaneT(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src);
 };
 
 
@@ -71,6 +89,11 @@ protected:
                 ArgsObj.GetPara(i, para.sigma);
                 continue;
             }
+            if (args[i] == "-A" || args[i] == "--algorithm")
+            {
+                ArgsObj.GetPara(i, para.algorithm);
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
@@ -87,6 +110,18 @@ protected:
         return filter(src);
     }
 
+    virtual Frame16 process_Frame16(Frame16 src)
+    {
+        Gaussian2D filter(para);
+        return filter(src);
+    }
+
+    virtual Frame8 process_Frame8(Frame8 src)
+    {
+        Gaussian2D filter(para);
+        return filter(src);
+    }
+
 public:
     Gaussian2D_IO(std::string _Tag = ".Gaussian")
         : _Mybase(std::move(_Tag))
@@ -136,6 +171,9 @@ public:
 
     void setPara(ldbl sigma, bool _allow_negative = true);
 
+    // Variance of the impulse response of filterH or filterV, which is somewhat different from sigma^2
+    ldbl Variance() const;
+
     virtual void filterV(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride);
     virtual void filterH(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride);
     virtual void filter(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride);
@@ -151,6 +189,214 @@ public:
 protected:
     virtual void filterV_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const;
     virtual void filterH_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const;
+
+    // The vertical pass is the causal pass over the plane followed by the anti-causal pass of each row,
+    // from the bottom row to the top row, on the pixels [lower, upper) of row j
+    void filterV_Causal(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const;
+    void filterV_AntiCausal(FLType *dst, PCType j, PCType height, PCType lower, PCType upper, PCType stride) const;
+
+    friend class PyramidGaussian;
+    friend class RecursiveGaussianBank;
+};
+
+
+// Recursive Gaussian filter processed in tiles of tile_height x tile_width, which are filtered in parallel
+// Each line is split into segments along the filter direction, and each segment is filtered as if its first pixel were the border,
+// then the response to the difference between the actual state handed over from the previous segment and the assumed one is added.
+// The response decays below the rounding error of FLType within a length depending on sigma, only the heads of the segments
+// are corrected, and the result is the same as RecursiveGaussian up to the rounding error.
+// Different from RecursiveGaussian, the vertical pass sets negative results to 0 after the anti-causal recursion
+// like the horizontal pass, rather than inside it, when allow_negative is false.
+// A pass is the same as RecursiveGaussian when its tile size is 0 or not less than the size of the plane.
+class TiledRecursiveGaussian
+    : public RecursiveGaussian
+{
+public:
+    typedef TiledRecursiveGaussian _Myt;
+    typedef RecursiveGaussian _Mybase;
+
+public:
+    PCType tile_height = 0; // Segment length of the vertical pass, 0 means no segmentation
+    PCType tile_width = 0; // Segment length of the horizontal pass, 0 means no segmentation
+
+protected:
+    // response[n * 3 + c] is the n-th output of the recursion with zero input from the state y[-1-c] = 1,
+    // until all of them decay below the rounding error
+    std::vector<FLType> response;
+
+public:
+    TiledRecursiveGaussian()
+    {}
+
+    TiledRecursiveGaussian(ldbl sigma, bool _allow_negative = true, PCType _tile_height = TILE_HP, PCType _tile_width = TILE_WP)
+    {
+        setPara(sigma, _allow_negative, _tile_height, _tile_width);
+    }
+
+    void setPara(ldbl sigma, bool _allow_negative = true, PCType _tile_height = TILE_HP, PCType _tile_width = TILE_WP);
+
+protected:
+    virtual void filterV_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const override;
+    virtual void filterH_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const override;
+
+    // Both recursions of a pass over lanes lines of length pixels, the pixels of a line are step apart
+    // and the lines are lane_step apart, each task filters a segment of seg pixels of lane_piece lines
+    void filterLines(FLType *dst, const FLType *src, PCType length, PCType lanes, PCType step, PCType lane_step,
+        PCType seg, PCType lane_piece) const;
+};
+
+
+// Approximate Gaussian filter for large sigmas, which averages blocks of factor x factor pixels,
+// applies the recursive Gaussian filter to the decimated plane and interpolates it back bilinearly.
+// The factor is the largest one keeping the estimated error against RecursiveGaussian below error,
+// relative to the range of the source (see Factor), thus a few passes over the decimated plane replace
+// the iterations at full resolution, while the result is visually equivalent for illumination estimation.
+// Without decimation (error <= 0 or sigma too small for the given error), it's the same as RecursiveGaussian.
+class PyramidGaussian
+{
+public:
+    typedef PyramidGaussian _Myt;
+
+public:
+    PCType factor = 1;
+    RecursiveGaussian GFilter; // Recursive Gaussian filter on the decimated plane
+
+public:
+    PyramidGaussian()
+    {}
+
+    PyramidGaussian(ldbl sigma, ldbl error = 0, bool allow_negative = true)
+    {
+        setPara(sigma, error, allow_negative);
+    }
+
+    Plane_FL operator()(const Plane_FL &src) const
+    {
+        Plane_FL dst(src, false);
+        return operator()(dst, src);
+    }
+
+    Plane_FL &operator()(Plane_FL &dst, const Plane_FL &src) const;
+
+    void setPara(ldbl sigma, ldbl error = 0, bool allow_negative = true);
+
+    bool isDecimated() const { return factor > 1; }
+
+    // Largest decimation factor of which the estimated error is within error, 1 means no decimation
+    static PCType Factor(ldbl sigma, ldbl error);
+};
+
+
+// Gaussian filter approximated by stacked box filters with running sums, each pass costs O(1) per pixel for any sigma
+// Plane is filtered by plain box filters of integer widths in exact integer arithmetic,
+// with the widths chosen to approximate the variance of the Gaussian ("Peter Kovesi - Fast Almost-Gaussian Filtering").
+// Plane_FL is filtered by extended box filters, whose fractional end weights match the variance exactly
+// ("Pascal Gwosdek, Sven Grewenig, Andres Bruhn, Joachim Weickert - Theoretical Foundations of Gaussian Convolution by Extended Box Filtering").
+// The support is finite, the borders are extended by replicating the edge pixels.
+class BoxGaussian
+{
+public:
+    typedef BoxGaussian _Myt;
+
+    static const int PassNum = 4;
+
+protected:
+    PCType radiusInt[PassNum]; // Radii of the plain box filters for Plane
+    PCType radiusFL = 0; // Radius of the extended box filters for Plane_FL, excluding the fractional ends
+    FLType weightFL = 1; // Weight of the pixels in the extended box filter
+    FLType weightEnd = 0; // Weight of the fractional ends of the extended box filter
+
+public:
+    BoxGaussian(ldbl sigma = 0)
+    {
+        setPara(sigma);
+    }
+
+    void setPara(ldbl sigma);
+
+    // Distance of the farthest pixel contributing to a result pixel
+    PCType Radius(bool integer) const;
+
+    // Whether Plane can be filtered in 64-bit integers without overflow
+    bool isIntegerValid() const;
+
+    Plane_FL &operator()(Plane_FL &dst, const Plane_FL &src) const;
+    template < typename _Ty > PlaneT<_Ty> &operator()(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src) const;
+
+    template < typename _St1 >
+    _St1 operator()(const _St1 &src) const
+    {
+        _St1 dst(src, false);
+        return operator()(dst, src);
+    }
+};
+
+
+// Gaussian filter for Plane in fixed-point arithmetic, with a separable kernel of integer weights summing to 1 << WeightBits
+// The pixels are biased to 16-bit signed integers and accumulated in 32-bit integers by WeightedSum without overflow,
+// the horizontal pass rounds half up to 16 - bit depth fractional bits (stored in 16-bit), and the vertical pass rounds half up
+// to integers, thus the result differs from the exact convolution with the integer kernel by less than 0.5 + 2^(bit depth - 17).
+// The kernel is the Gaussian truncated where the weights round to 0, with the support of Radius() for tiled processing.
+// Only PlaneT of which the range is within [0, 65535] is supported, see isValid(), thus all of Plane16 and Plane8.
+class FixedPointGaussian
+{
+public:
+    typedef FixedPointGaussian _Myt;
+
+    static const int WeightBits = 14;
+
+protected:
+    std::vector<sint16> weight; // 2 * radius + 1 taps
+
+public:
+    FixedPointGaussian(ldbl sigma = 0)
+    {
+        setPara(sigma);
+    }
+
+    void setPara(ldbl sigma);
+
+    PCType Radius() const { return static_cast<PCType>(weight.size() / 2); }
+
+    template < typename _Ty >
+    static bool isValid(const PlaneT<_Ty> &src) { return src.Floor() >= 0 && src.Ceil() <= 65535; }
+
+    template < typename _Ty > PlaneT<_Ty> &operator()(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src) const;
+
+    template < typename _Ty >
+    PlaneT<_Ty> operator()(const PlaneT<_Ty> &src) const
+    {
+        PlaneT<_Ty> dst(src, false);
+        return operator()(dst, src);
+    }
+};
+
+
+// Recursive Gaussian filters of several sigmas applied to the same source in a single sweep
+// The horizontal passes of all the scales share the reads of each group of source rows,
+// and the last vertical passes run in lockstep from the bottom row to the top row,
+// handing each finished row of all the scales to _Func(j, lower, upper, gauss),
+// where gauss[s][i] for i in [lower, upper) is the row j of scale s (the source for sigma <= 0).
+// Scales decimated by PyramidGaussian (error > 0) are filtered beforehand.
+// Thus the scales are combined without a separate pass over the filtered planes.
+// _Func is called in parallel for different pieces of columns, and in order from the bottom row within a piece.
+// The anti-causal pass needs the causal result of the whole plane, thus each scale still holds a buffer of the plane size.
+class RecursiveGaussianBank
+{
+public:
+    typedef RecursiveGaussianBank _Myt;
+    typedef std::function<void(PCType j, PCType lower, PCType upper, const FLType *const *gauss)> Combiner;
+
+protected:
+    std::vector<ldbl> sigma;
+    std::vector<PyramidGaussian> filters;
+
+public:
+    explicit RecursiveGaussianBank(const std::vector<ldbl> &sigmaVector, bool allow_negative = true, ldbl error = 0);
+
+    size_t size() const { return sigma.size(); }
+
+    void operator()(const Plane_FL &src, const Combiner &_Func) const;
 };
 
 
@@ -26,6 +26,7 @@ struct Haze_Removal_Para
 
     int Ymode = 1;
     std::vector<ldbl> sigmaVector;
+    ldbl approx_error = 0; // Maximum error of PyramidGaussian for large sigmas, 0 for the exact recursive Gaussian
 
     Haze_Removal_Para() : sigmaVector({ 15.0L, sizeof(FLType) ? 80.0L : 250.0L }) {}
 };
@@ -223,6 +224,11 @@ protected:
                 para.sigmaVector.push_back(sigma);
                 continue;
             }
+            if (args[i] == "-AE" || args[i] == "--approx_error")
+            {
+                ArgsObj.GetPara(i, para.approx_error);
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
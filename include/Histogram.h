@@ -33,9 +33,9 @@ public:
     Histogram() {} // Default constructor
     Histogram(const Histogram &src); // Copy constructor
     Histogram(Histogram &&src); // Move constructor
-    explicit Histogram(const Plane &src); // Convertor/Constructor from Plane
-    Histogram(const Plane &src, BinType Bins);
-    Histogram(const Plane &src, _Ty Lower, _Ty Upper, BinType Bins);
+    template < typename _St1 > explicit Histogram(const PlaneT<_St1> &src); // Convertor/Constructor from PlaneT
+    template < typename _St1 > Histogram(const PlaneT<_St1> &src, BinType Bins);
+    template < typename _St1 > Histogram(const PlaneT<_St1> &src, _Ty Lower, _Ty Upper, BinType Bins);
     explicit Histogram(const Plane_FL &src, BinType Bins = 256);
     Histogram(const Plane_FL &src, _Ty Lower, _Ty Upper, BinType Bins = 256);
     Histogram(const _Ty *src, CountType _pcount, _Ty Lower, _Ty Upper); // Template constructor from array
@@ -60,8 +60,8 @@ public:
     template < > double BinToValue<double>(BinType i) const { return static_cast<double>(i / Scale_) + Lower_; }
     template < > ldbl BinToValue<ldbl>(BinType i) const { return static_cast<ldbl>(i / Scale_) + Lower_; }
 
-    void Generate(const _Ty *src, CountType _pcount);
-    void Add(const _Ty *src, CountType _pcount);
+    template < typename _St1 > void Generate(const _St1 *src, CountType _pcount);
+    template < typename _St1 > void Add(const _St1 *src, CountType _pcount);
     template < typename _St1 > void Generate(const _St1 &src);
     template < typename _St1 > void Add(const _St1 &src);
 
@@ -96,17 +96,20 @@ Histogram<_Ty>::Histogram(Histogram<_Ty> &&src)
 }
 
 template < typename _Ty >
-Histogram<_Ty>::Histogram(const Plane &src)
-    : Histogram(src, src.Floor(), src.Ceil(), Upper_ - Lower_ + 1)
+template < typename _St1 >
+Histogram<_Ty>::Histogram(const PlaneT<_St1> &src)
+    : Histogram(src, src.Floor(), src.Ceil(), static_cast<BinType>(src.Ceil() - src.Floor() + 1))
 {}
 
 template < typename _Ty >
-Histogram<_Ty>::Histogram(const Plane &src, BinType Bins)
+template < typename _St1 >
+Histogram<_Ty>::Histogram(const PlaneT<_St1> &src, BinType Bins)
     : Histogram(src, src.Floor(), src.Ceil(), Bins)
 {}
 
 template < typename _Ty >
-Histogram<_Ty>::Histogram(const Plane &src, _Ty Lower, _Ty Upper, BinType Bins)
+template < typename _St1 >
+Histogram<_Ty>::Histogram(const PlaneT<_St1> &src, _Ty Lower, _Ty Upper, BinType Bins)
     : Lower_(Lower), Upper_(Upper), Bins_(Bins), Scale_((Bins_ - 1) / static_cast<FLType>(Upper_ - Lower_))
 {
     if (Scale_ > 1)
@@ -136,7 +139,7 @@ Histogram<_Ty>::Histogram(const Plane_FL &src, _Ty Lower, _Ty Upper, BinType Bin
 
 template < typename _Ty >
 Histogram<_Ty>::Histogram(const _Ty *src, CountType _pcount, _Ty Lower, _Ty Upper)
-    : Histogram(src, _pcount, Lower, Upper, Upper_ - Lower_ + 1)
+    : Histogram(src, _pcount, Lower, Upper, static_cast<BinType>(Upper - Lower + 1))
 {}
 
 template < typename _Ty >
@@ -206,7 +209,8 @@ Histogram<_Ty> &Histogram<_Ty>::operator=(Histogram<_Ty> &&src)
 
 
 template < typename _Ty >
-void Histogram<_Ty>::Generate(const _Ty *src, CountType _pcount)
+template < typename _St1 >
+void Histogram<_Ty>::Generate(const _St1 *src, CountType _pcount)
 {
     Count_ = 0;
     memset(Data_, 0, sizeof(CountType) * Bins_);
@@ -215,7 +219,8 @@ void Histogram<_Ty>::Generate(const _Ty *src, CountType _pcount)
 }
 
 template < typename _Ty >
-void Histogram<_Ty>::Add(const _Ty *src, CountType _pcount)
+template < typename _St1 >
+void Histogram<_Ty>::Add(const _St1 *src, CountType _pcount)
 {
     Count_ += _pcount;
 
@@ -240,14 +245,20 @@ template < typename _Ty >
 template < typename _St1 >
 void Histogram<_Ty>::Generate(const _St1 &src)
 {
-    Generate(src.data(), src.PixelCount());
+    Count_ = 0;
+    memset(Data_, 0, sizeof(CountType) * Bins_);
+
+    Add(src);
 }
 
 template < typename _Ty >
 template < typename _St1 >
 void Histogram<_Ty>::Add(const _St1 &src)
 {
-    Add(src.data(), src.PixelCount());
+    for (PCType j = 0; j < src.Height(); ++j)
+    {
+        Add(src.data() + j * src.Stride(), src.Width());
+    }
 }
 
 
@@ -15,29 +15,34 @@ const struct HE_Para
 } HE_Default;
 
 
-LUT<DType> Equalization_LUT(const Histogram<DType> &hist, const Plane &dst, const Plane &src, FLType strength = 1.0);
-inline LUT<DType> Equalization_LUT(const Histogram<DType> &hist, const Plane &src, FLType strength = 1.0)
+// The equalization runs on the storage type of the planes, instantiated for Plane, Plane16 and Plane8
+template < typename _Ty > LUT<DType> Equalization_LUT(const Histogram<DType> &hist, const PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType strength = 1.0);
+template < typename _Ty >
+LUT<DType> Equalization_LUT(const Histogram<DType> &hist, const PlaneT<_Ty> &src, FLType strength = 1.0)
 {
     return Equalization_LUT(hist, src, src, strength);
 }
 
-LUT<FLType> Equalization_LUT_Gain(const Histogram<DType> &hist, const Plane &dst, const Plane &src, FLType strength = 1.0);
-inline LUT<FLType> Equalization_LUT_Gain(const Histogram<DType> &hist, const Plane &src, FLType strength = 1.0)
+template < typename _Ty > LUT<FLType> Equalization_LUT_Gain(const Histogram<DType> &hist, const PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType strength = 1.0);
+template < typename _Ty >
+LUT<FLType> Equalization_LUT_Gain(const Histogram<DType> &hist, const PlaneT<_Ty> &src, FLType strength = 1.0)
 {
     return Equalization_LUT_Gain(hist, src, src, strength);
 }
 
-Plane &Histogram_Equalization(Plane &dst, const Plane &src, FLType strength = HE_Default.strength);
-Frame &Histogram_Equalization(Frame &dst, const Frame &src, FLType strength = HE_Default.strength, bool separate = HE_Default.separate);
+template < typename _Ty > PlaneT<_Ty> &Histogram_Equalization(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType strength = HE_Default.strength);
+template < typename _Ty > FrameT<_Ty> &Histogram_Equalization(FrameT<_Ty> &dst, const FrameT<_Ty> &src, FLType strength = HE_Default.strength, bool separate = HE_Default.separate);
 
-inline Plane Histogram_Equalization(const Plane &src, FLType strength = HE_Default.strength)
+template < typename _Ty >
+PlaneT<_Ty> Histogram_Equalization(const PlaneT<_Ty> &src, FLType strength = HE_Default.strength)
 {
-    Plane dst(src, false);
+    PlaneT<_Ty> dst(src, false);
     return Histogram_Equalization(dst, src, strength);
 }
-inline Frame Histogram_Equalization(const Frame &src, FLType strength = HE_Default.strength, bool separate = HE_Default.separate)
+template < typename _Ty >
+FrameT<_Ty> Histogram_Equalization(const FrameT<_Ty> &src, FLType strength = HE_Default.strength, bool separate = HE_Default.separate)
 {
-    Frame dst(src, false);
+    FrameT<_Ty> dst(src, false);
     return Histogram_Equalization(dst, src, strength, separate);
 }
 
@@ -85,6 +90,16 @@ protected:
         return Histogram_Equalization(src, para.strength, para.separate);
     }
 
+    virtual Frame16 process_Frame16(Frame16 src)
+    {
+        return Histogram_Equalization(src, para.strength, para.separate);
+    }
+
+    virtual Frame8 process_Frame8(Frame8 src)
+    {
+        return Histogram_Equalization(src, para.strength, para.separate);
+    }
+
 public:
     Histogram_Equalization_IO(std::string _Tag = ".HE")
         : _Mybase(std::move(_Tag)) {}
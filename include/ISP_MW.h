@@ -15,6 +15,7 @@
 #include "Block.h"
 #include "ImageIO.h"
 #include "Filter.h"
+#include "Benchmark.h"
 
 #include "Transform.h"
 #include "Convolution.h"
@@ -42,6 +43,10 @@ typedef Haze_Removal_Retinex_IO _Haze_Removal_Retinex_IO;
 
 
 int Filtering(const int argc, char ** argv);
+int Filtering_Chain(const int argc, const std::vector<std::string> &args);
+int Benchmarking(const int argc, const std::vector<std::string> &args);
+
+FilterIO *CreateFilterIO(std::string FilterName);
 
 
 #endif
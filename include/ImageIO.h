@@ -3,13 +3,39 @@
 
 
 #include <string>
+#include <vector>
 #include "Image_Type.h"
 
 
+// Read into dst, returns false and leaves dst unchanged when the image can't be read
+template < typename _Ty >
+bool ImageRead(FrameT<_Ty> &dst, const std::string &filename, const FCType FrameNum = 0, const DType BitDepth = 16);
+
+// Read into a frame of the storage type _Ty, e.g. ImageReader<uint16> for Frame16
+// The bit depth should be within StorageBitDepth<_Ty>()
+// A blank 1920x1080 frame is returned when the image can't be read
+template < typename _Ty >
+FrameT<_Ty> ImageReader(const std::string &filename, const FCType FrameNum = 0, const DType BitDepth = 16);
 Frame ImageReader(const std::string &filename, const FCType FrameNum = 0, const DType BitDepth = 16);
 
-bool ImageWriter(const Frame &src, const std::string &filename);
-bool ImageWriter(const Frame &src, const std::string &filename, int _type);
+template < typename _Ty >
+bool ImageWriter(const FrameT<_Ty> &src, const std::string &filename);
+template < typename _Ty >
+bool ImageWriter(const FrameT<_Ty> &src, const std::string &filename, int _type);
+
+
+// Size of an image from the header of the file without decoding it, for PNG, BMP, JPEG and PNM
+// Returns false for the other formats or when the header can't be read
+bool ImageSize(const std::string &filename, PCType &width, PCType &height);
+
+// Whether the path is an existing directory
+bool IsDirectory(const std::string &path);
+
+// Image files supported by ImageReader in a directory, not recursive, sorted by name
+std::vector<std::string> ImageFileList(const std::string &dir);
+
+// Paths listed in a text file, one per line, empty lines and lines starting with '#' are skipped
+std::vector<std::string> ReadFileList(const std::string &filename);
 
 
 #endif
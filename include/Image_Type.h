@@ -9,10 +9,43 @@
 #include "Type.h"
 #include "Helper.h"
 #include "Specification.h"
+#include "Memory_Pool.h"
 
 
 const DType MaxBitDepth = sizeof(DType) * 8 * 3 / 4;
 
+// Maximum bit depth of the integer pixels stored in type _Ty
+template < typename _Ty >
+inline DType StorageBitDepth()
+{
+    return Min(MaxBitDepth, static_cast<DType>(sizeof(_Ty) * 8 - (isSInt(_Ty) ? 1 : 0)));
+}
+
+
+// Row stride of planes in elements, so that the start of each row is aligned for SIMD
+// Rows are padded to a multiple of PLANE_ALIGN elements regardless of the element type,
+// thus Plane and Plane_FL of the same width always share the same stride.
+// With PLANE_SKEW, a stride of a multiple of PLANE_SKEW_PERIOD elements is increased by PLANE_ALIGN,
+// to avoid the rows accessed by vertical passes mapping to the same cache sets.
+extern PCType PLANE_ALIGN; // 1 means no padding
+extern bool PLANE_SKEW;
+const PCType PLANE_SKEW_PERIOD = 1024;
+
+// Set the stride parameters of the planes allocated afterwards, a negative value keeps the current one
+void SetPlaneStride(PCType align, int skew = -1);
+
+inline PCType PlaneStride(PCType width)
+{
+    PCType stride = (width + PLANE_ALIGN - 1) / PLANE_ALIGN * PLANE_ALIGN;
+
+    if (PLANE_SKEW && PLANE_ALIGN > 1 && stride % PLANE_SKEW_PERIOD == 0)
+    {
+        stride += PLANE_ALIGN;
+    }
+
+    return stride;
+}
+
 
 enum class PixelType
 {
@@ -43,17 +76,26 @@ enum class QuantRange
 };
 
 
-class Plane;
+template < typename _Ty > class PlaneT;
 class Plane_FL;
-class Frame;
+template < typename _Ty > class FrameT;
 
+// Integer planes and frames of each storage type
+// DType holds any bit depth up to MaxBitDepth, while 8-bit and 16-bit storage of images up to that bit depth
+// takes 1/4 and 1/2 of the memory and bandwidth. Parameters of the narrow types are of the storage type as well.
+typedef PlaneT<DType> Plane;
+typedef PlaneT<uint16> Plane16;
+typedef PlaneT<uint8> Plane8;
+typedef FrameT<DType> Frame;
+typedef FrameT<uint16> Frame16;
+typedef FrameT<uint8> Frame8;
 
-class Plane
+
+template < typename _Ty >
+class PlaneT
 {
 public:
-    typedef DType _Ty;
-
-    typedef Plane _Myt;
+    typedef PlaneT<_Ty> _Myt;
     typedef _Ty value_type;
     typedef size_t size_type;
     typedef ptrdiff_t difference_type;
@@ -66,12 +108,13 @@ public:
     typedef const_pointer const_iterator;
 
 public:
-    const value_type value_type_MIN = IntMin(value_type);
-    const value_type value_type_MAX = IntMax(value_type);
+    const value_type value_type_MIN = TypeMin<value_type>();
+    const value_type value_type_MAX = TypeMax<value_type>();
     
 private:
     PCType Width_ = 0;
     PCType Height_ = 0;
+    PCType Stride_ = 0;
     PCType PixelCount_ = 0;
     value_type BitDepth_;
     value_type Floor_;
@@ -79,6 +122,16 @@ private:
     value_type Ceil_;
     TransferChar TransferChar_;
     pointer Data_ = nullptr;
+    pointer Buffer_ = nullptr; // The reference counted allocation holding the data, nullptr for views
+    bool View_ = false; // The memory is owned by a parent plane or the caller
+    bool Slab_ = false; // The memory is a part of the storage of a frame, whose reference is held by the frame
+
+    template < typename _St1 > friend class FrameT;
+
+    void Release();
+    void SlabAttach(pointer Data, pointer Slab);
+    void Unshare();
+    _Myt MakeView(PCType y, PCType x, PCType height, PCType width) const;
 
 protected:
     void DefaultPara(bool Chroma, value_type _BitDepth = 16, QuantRange _QuantRange = QuantRange::PC);
@@ -87,42 +140,47 @@ protected:
 public:
     void InitValue(value_type Value, bool Init = true);
 
-    Plane() {} // Default constructor
-    explicit Plane(value_type Value, PCType _Width = 1920, PCType _Height = 1080, value_type _BitDepth = 16, bool Init = true); // Convertor/Constructor from value_type
-    Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init = true);
+    PlaneT() {} // Default constructor
+    explicit PlaneT(value_type Value, PCType _Width = 1920, PCType _Height = 1080, value_type _BitDepth = 16, bool Init = true); // Convertor/Constructor from value_type
+    PlaneT(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init = true, PCType _Stride = 0);
 
-    Plane(const _Myt &src); // Copy constructor
-    Plane(const _Myt &src, bool Init, value_type Value = 0);
-    Plane(_Myt &&src); // Move constructor
-    explicit Plane(const Plane_FL &src, value_type _BitDepth = 16); // Convertor/Constructor from Plane_FL
-    Plane(const Plane_FL &src, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil);
-    Plane(const Plane_FL &src, bool Init, value_type Value = 0, value_type _BitDepth = 16);
-    Plane(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil);
+    PlaneT(const _Myt &src); // Copy constructor
+    PlaneT(const _Myt &src, bool Init, value_type Value = 0);
+    PlaneT(_Myt &&src); // Move constructor
+    template < typename _St1 > explicit PlaneT(const PlaneT<_St1> &src); // Convertor/Constructor from another storage type
+    explicit PlaneT(const Plane_FL &src, value_type _BitDepth = 16); // Convertor/Constructor from Plane_FL
+    PlaneT(const Plane_FL &src, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil);
+    PlaneT(const Plane_FL &src, bool Init, value_type Value = 0, value_type _BitDepth = 16);
+    PlaneT(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil);
+    PlaneT(pointer Data, PCType _Stride, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar); // View of external memory
 
-    ~Plane(); // Destructor
+    ~PlaneT(); // Destructor
 
     _Myt &operator=(const _Myt &src); // Copy assignment operator
     _Myt &operator=(_Myt &&src); // Move assignment operator
     bool operator==(const _Myt &b) const;
     bool operator!=(const _Myt &b) const { return !(*this == b); }
-    reference operator[](PCType i) { return Data_[i]; }
+    reference operator[](PCType i) { Detach(); return Data_[i]; }
     const_reference operator[](PCType i) const { return Data_[i]; }
-    reference operator()(PCType j, PCType i) { return Data_[j * Stride() + i]; }
+    reference operator()(PCType j, PCType i) { Detach(); return Data_[j * Stride() + i]; }
     const_reference operator()(PCType j, PCType i) const { return Data_[j * Stride() + i]; }
 
-    iterator begin() { return Data_; }
+    // The buffer of Height() rows of Stride() elements, including the padding at the end of each row
+    // Copies share the buffer until written, the non-const accessors make it unique with Detach(),
+    // loops writing many elements should take data() once instead, which leaves only a pointer in the loop.
+    iterator begin() { Detach(); return Data_; }
     const_iterator begin() const { return Data_; }
-    iterator end() { return Data_ + PixelCount_; }
-    const_iterator end() const { return Data_ + PixelCount_; }
-    size_type size() const { return PixelCount_; }
-    pointer data() { return Data_; }
+    iterator end() { Detach(); return Data_ + size(); }
+    const_iterator end() const { return Data_ + size(); }
+    size_type size() const { return static_cast<size_type>(Stride_) * Height_; }
+    pointer data() { Detach(); return Data_; }
     const_pointer data() const { return Data_; }
     value_type value(PCType i) { return Data_[i]; }
     value_type value(PCType i) const { return Data_[i]; }
 
     PCType Height() const { return Height_; }
     PCType Width() const { return Width_; }
-    PCType Stride() const { return Width_; }
+    PCType Stride() const { return Stride_; }
     PCType PixelCount() const { return PixelCount_; }
     value_type BitDepth() const { return BitDepth_; }
     value_type Floor() const { return Floor_; }
@@ -131,9 +189,21 @@ public:
     value_type ValueRange() const { return Ceil_ - Floor_; }
     TransferChar GetTransferChar() const { return TransferChar_; }
 
-    pointer Data() { return Data_; }
+    pointer Data() { Detach(); return Data_; }
     const_pointer Data() const { return Data_; }
 
+    // Copy the data if the buffer is shared, it's done once before the elements are written in a loop
+    // Concurrent calls on the same plane are serialized, and only the first one copies.
+    void Detach() { if (Buffer_ != nullptr && PoolShared(Buffer_)) Unshare(); }
+    bool isShared() const { return Buffer_ != nullptr && PoolShared(Buffer_); }
+
+    // Non-owning view of the rectangle of height x width at (y, x), sharing the memory and the stride of this plane
+    // Copying a view gives an owning plane, while assigning to a view writes to the viewed memory.
+    // A writable view makes the buffer unique first, while a const view shares it.
+    _Myt View(PCType y, PCType x, PCType height, PCType width) { Detach(); return MakeView(y, x, height, width); }
+    const _Myt View(PCType y, PCType x, PCType height, PCType width) const { return MakeView(y, x, height, width); }
+    bool isView() const { return View_; }
+
     bool isChroma() const;
     bool isPCChroma() const;
     value_type Min() const;
@@ -145,7 +215,7 @@ public:
 
     _Myt &Width(PCType _Width) { return ReSize(_Width, Height()); }
     _Myt &Height(PCType _Height) { return ReSize(Width(), _Height); }
-    _Myt &ReSize(PCType _Width, PCType _Height);
+    _Myt &ReSize(PCType _Width, PCType _Height, PCType _Stride = 0); // The stride of PlaneStride() if not specified
     void ReSetChroma(bool Chroma = false);
     _Myt &ReQuantize(value_type _BitDepth = 16, QuantRange _QuantRange = QuantRange::PC, bool scale = true, bool clip = false);
     _Myt &ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale = true, bool clip = false);
@@ -199,12 +269,18 @@ public:
 private:
     PCType Width_ = 0;
     PCType Height_ = 0;
+    PCType Stride_ = 0;
     PCType PixelCount_ = 0;
     value_type Floor_ = 0;
     value_type Neutral_ = 0;
     value_type Ceil_ = 1;
     TransferChar TransferChar_;
     pointer Data_ = nullptr;
+    pointer Buffer_ = nullptr; // The reference counted allocation holding the data, nullptr for views
+    bool View_ = false; // The memory is owned by a parent plane or the caller
+
+    void Unshare();
+    _Myt MakeView(PCType y, PCType x, PCType height, PCType width) const;
 
 protected:
     void DefaultPara(bool Chroma, value_type range = 1);
@@ -215,13 +291,14 @@ public:
 
     Plane_FL() {} // Default constructor
     explicit Plane_FL(value_type Value, PCType _Width = 1920, PCType _Height = 1080, bool RGB = true, bool Chroma = false, bool Init = true); // Convertor/Constructor from value_type
-    Plane_FL(value_type Value, PCType _Width, PCType _Height, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init = true);
+    Plane_FL(value_type Value, PCType _Width, PCType _Height, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init = true, PCType _Stride = 0);
 
     Plane_FL(const _Myt &src); // Copy constructor
     Plane_FL(const _Myt &src, bool Init, value_type Value = 0);
     Plane_FL(_Myt &&src); // Move constructor
-    explicit Plane_FL(const Plane &src, value_type range = 1.); // Convertor/Constructor from Plane
-    Plane_FL(const Plane &src, bool Init, value_type Value = 0, value_type range = 1.);
+    template < typename _St1 > explicit Plane_FL(const PlaneT<_St1> &src, value_type range = 1.); // Convertor/Constructor from PlaneT
+    template < typename _St1 > Plane_FL(const PlaneT<_St1> &src, bool Init, value_type Value = 0, value_type range = 1.);
+    Plane_FL(pointer Data, PCType _Stride, PCType _Width, PCType _Height, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar); // View of external memory
 
     ~Plane_FL(); // Destructor
 
@@ -229,24 +306,27 @@ public:
     _Myt &operator=(_Myt &&src); // Move assignment operator
     bool operator==(const _Myt &b) const;
     bool operator!=(const _Myt &b) const { return !(*this == b); }
-    reference operator[](PCType i) { return Data_[i]; }
+    reference operator[](PCType i) { Detach(); return Data_[i]; }
     const_reference operator[](PCType i) const { return Data_[i]; }
-    reference operator()(PCType j, PCType i) { return Data_[j * Stride() + i]; }
+    reference operator()(PCType j, PCType i) { Detach(); return Data_[j * Stride() + i]; }
     const_reference operator()(PCType j, PCType i) const { return Data_[j * Stride() + i]; }
 
-    iterator begin() { return Data_; }
+    // The buffer of Height() rows of Stride() elements, including the padding at the end of each row
+    // Copies share the buffer until written, the non-const accessors make it unique with Detach(),
+    // loops writing many elements should take data() once instead, which leaves only a pointer in the loop.
+    iterator begin() { Detach(); return Data_; }
     const_iterator begin() const { return Data_; }
-    iterator end() { return Data_ + PixelCount_; }
-    const_iterator end() const { return Data_ + PixelCount_; }
-    size_type size() const { return PixelCount_; }
-    pointer data() { return Data_; }
+    iterator end() { Detach(); return Data_ + size(); }
+    const_iterator end() const { return Data_ + size(); }
+    size_type size() const { return static_cast<size_type>(Stride_) * Height_; }
+    pointer data() { Detach(); return Data_; }
     const_pointer data() const { return Data_; }
     value_type value(PCType i) { return Data_[i]; }
     value_type value(PCType i) const { return Data_[i]; }
 
     PCType Height() const { return Height_; }
     PCType Width() const { return Width_; }
-    PCType Stride() const { return Width_; }
+    PCType Stride() const { return Stride_; }
     PCType PixelCount() const { return PixelCount_; }
     value_type Floor() const { return Floor_; }
     value_type Neutral() const { return Neutral_; }
@@ -254,9 +334,21 @@ public:
     value_type ValueRange() const { return Ceil_ - Floor_; }
     TransferChar GetTransferChar() const { return TransferChar_; }
 
-    pointer Data() { return Data_; }
+    pointer Data() { Detach(); return Data_; }
     const_pointer Data() const { return Data_; }
 
+    // Copy the data if the buffer is shared, it's done once before the elements are written in a loop
+    // Concurrent calls on the same plane are serialized, and only the first one copies.
+    void Detach() { if (Buffer_ != nullptr && PoolShared(Buffer_)) Unshare(); }
+    bool isShared() const { return Buffer_ != nullptr && PoolShared(Buffer_); }
+
+    // Non-owning view of the rectangle of height x width at (y, x), sharing the memory and the stride of this plane
+    // Copying a view gives an owning plane, while assigning to a view writes to the viewed memory.
+    // A writable view makes the buffer unique first, while a const view shares it.
+    _Myt View(PCType y, PCType x, PCType height, PCType width) { Detach(); return MakeView(y, x, height, width); }
+    const _Myt View(PCType y, PCType x, PCType height, PCType width) const { return MakeView(y, x, height, width); }
+    bool isView() const { return View_; }
+
     bool isChroma() const;
     bool isPCChroma() const;
     value_type Min() const;
@@ -268,7 +360,7 @@ public:
 
     _Myt &Width(PCType _Width) { return ReSize(_Width, Height()); }
     _Myt &Height(PCType _Height) { return ReSize(Width(), _Height); }
-    _Myt &ReSize(PCType _Width, PCType _Height);
+    _Myt &ReSize(PCType _Width, PCType _Height, PCType _Stride = 0); // The stride of PlaneStride() if not specified
     void ReSetChroma(bool Chroma = false);
     _Myt &ReQuantize(value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale = true, bool clip = false);
     _Myt &SetTransferChar(TransferChar _TransferChar) { TransferChar_ = _TransferChar; return *this; }
@@ -291,13 +383,12 @@ public:
 };
 
 
-class Frame
+template < typename _Ty >
+class FrameT
 {
 public:
-    typedef DType _Ty;
-
-    typedef Frame _Myt;
-    typedef Plane _Mysub;
+    typedef FrameT<_Ty> _Myt;
+    typedef PlaneT<_Ty> _Mysub;
     typedef _Ty value_type;
     typedef size_t size_type;
     typedef ptrdiff_t difference_type;
@@ -321,8 +412,11 @@ private:
     TransferChar TransferChar_;
     ColorMatrix ColorMatrix_;
 
+    // The planes are stored inline in the order of creation, and their data is laid out in a single slab
     PlaneCountType PlaneCount_ = 0;
-    std::vector<_Mysub *> P_;
+    _Mysub P_[MaxPlaneCount];
+    pointer Slab_ = nullptr;
+    size_type SlabSize_ = 0;
 
     _Mysub *R_ = nullptr;
     _Mysub *G_ = nullptr;
@@ -336,24 +430,31 @@ protected:
     bool isYUV(PixelType _PixelType) const { return _PixelType >= PixelType::Y && _PixelType < PixelType::R; }
     bool isRGB(PixelType _PixelType) const { return _PixelType >= PixelType::R && _PixelType <= PixelType::RGB; }
 
+    _Mysub *AddPlane(PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, PCType _Stride = 0);
+    _Mysub *AddPlane(const _Mysub &src);
+    void AllocPlanes(bool Init);
+    _Mysub *MapPlane(const _Myt &src, const _Mysub *Plane) { return Plane ? P_ + (Plane - src.P_) : nullptr; }
+    _Myt MakeView(PCType y, PCType x, PCType height, PCType width) const;
+
     void InitPlanes(PCType _Width = 1920, PCType _Height = 1080, value_type _BitDepth = 16, bool Init = true);
     void CopyPlanes(const _Myt &src, bool Copy = true, bool Init = false);
     void MovePlanes(_Myt &src);
     void FreePlanes();
 
 public:
-    Frame() {} // Default constructor
-    explicit Frame(FCType _FrameNum, PixelType _PixelType = PixelType::RGB, PCType _Width = 1920, PCType _Height = 1080,
+    FrameT() {} // Default constructor
+    explicit FrameT(FCType _FrameNum, PixelType _PixelType = PixelType::RGB, PCType _Width = 1920, PCType _Height = 1080,
         value_type _BitDepth = 16, bool Init = true); // Convertor/Constructor from FCType
-    Frame(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth,
+    FrameT(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth,
         QuantRange _QuantRange, ChromaPlacement _ChromaPlacement = ChromaPlacement::MPEG2, bool Init = true);
-    Frame(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth, QuantRange _QuantRange,
+    FrameT(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth, QuantRange _QuantRange,
         ChromaPlacement _ChromaPlacement, ColorPrim _ColorPrim, TransferChar _TransferChar, ColorMatrix _ColorMatrix, bool Init = true);
 
-    Frame(const _Myt &src, bool Copy = true, bool Init = false); // Copy constructor
-    Frame(_Myt &&src); // Move constructor
+    FrameT(const _Myt &src, bool Copy = true, bool Init = false); // Copy constructor
+    FrameT(_Myt &&src); // Move constructor
+    template < typename _St1 > explicit FrameT(const FrameT<_St1> &src); // Convertor/Constructor from another storage type
 
-    ~Frame(); // Destructor
+    ~FrameT(); // Destructor
 
     _Myt &operator=(const _Myt &src); // Copy assignment operator
     _Myt &operator=(_Myt &&src); // Move assignment operator
@@ -369,7 +470,7 @@ public:
     ColorMatrix GetColorMatrix() const { return ColorMatrix_; }
     PlaneCountType PlaneCount() const { return PlaneCount_; }
 
-    _Mysub &P(PlaneCountType PlaneNum) { return *P_[PlaneNum]; }
+    _Mysub &P(PlaneCountType PlaneNum) { return P_[PlaneNum]; }
     _Mysub &R() { return *R_; }
     _Mysub &G() { return *G_; }
     _Mysub &B() { return *B_; }
@@ -377,7 +478,7 @@ public:
     _Mysub &U() { return *U_; }
     _Mysub &V() { return *V_; }
     _Mysub &A() { return *A_; }
-    const _Mysub &P(PlaneCountType PlaneNum) const { return *P_[PlaneNum]; }
+    const _Mysub &P(PlaneCountType PlaneNum) const { return P_[PlaneNum]; }
     const _Mysub &R() const { return *R_; }
     const _Mysub &G() const { return *G_; }
     const _Mysub &B() const { return *B_; }
@@ -389,11 +490,27 @@ public:
     bool isYUV() const { return PixelType_ >= PixelType::Y && PixelType_ < PixelType::R; }
     bool isRGB() const { return PixelType_ >= PixelType::R && PixelType_ <= PixelType::RGB; }
 
-    PCType Height() const { return P_[0]->Height(); }
-    PCType Width() const { return P_[0]->Width(); }
-    PCType Stride() const { return P_[0]->Stride(); }
-    PCType PixelCount() const { return P_[0]->PixelCount(); }
-    value_type BitDepth() const { return P_[0]->BitDepth(); }
+    // Frame of views of the rectangle of height x width at (y, x) of each plane, in the coordinates of the first plane
+    // The rectangle of subsampled chroma planes is scaled down, thus it should be aligned to the subsampling.
+    _Myt View(PCType y, PCType x, PCType height, PCType width) { Detach(); return MakeView(y, x, height, width); }
+    const _Myt View(PCType y, PCType x, PCType height, PCType width) const { return MakeView(y, x, height, width); }
+    bool isView() const { return PlaneCount_ > 0 && P_[0].isView(); }
+
+    // The slab holding the data of all the planes, at aligned offsets in the order of P()
+    // Copies of a frame share the slab, a plane leaves it when it's resized, assigned or written while shared.
+    bool isContiguous() const;
+    pointer data() { Detach(); return Slab_; }
+    const_pointer data() const { return Slab_; }
+    size_type size() const { return SlabSize_; }
+
+    // Copy the shared data of all the planes, see Plane::Detach()
+    void Detach();
+
+    PCType Height() const { return P_[0].Height(); }
+    PCType Width() const { return P_[0].Width(); }
+    PCType Stride() const { return P_[0].Stride(); }
+    PCType PixelCount() const { return P_[0].PixelCount(); }
+    value_type BitDepth() const { return P_[0].BitDepth(); }
 
     _Myt &SetQuantRange(QuantRange _QuantRange) { QuantRange_ = _QuantRange; return *this; }
     _Myt &SetChromaPlacement(ChromaPlacement _ChromaPlacement) { ChromaPlacement_ = _ChromaPlacement; return *this; }
@@ -406,10 +523,10 @@ public:
 #include "Image_Type.hpp"
 
 
-// Inline functions for class Plane
-inline bool Plane::isChroma() const { return ::isChroma(Floor(), Neutral()); }
-inline bool Plane::isPCChroma() const { return ::isPCChroma(Floor(), Neutral(), Ceil()); }
-inline void Plane::ReSetChroma(bool Chroma) { ::ReSetChroma(Floor_, Neutral_, Ceil_, Chroma); }
+// Inline functions for class PlaneT
+template < typename _Ty > inline bool PlaneT<_Ty>::isChroma() const { return ::isChroma(Floor(), Neutral()); }
+template < typename _Ty > inline bool PlaneT<_Ty>::isPCChroma() const { return ::isPCChroma(Floor(), Neutral(), Ceil()); }
+template < typename _Ty > inline void PlaneT<_Ty>::ReSetChroma(bool Chroma) { ::ReSetChroma(Floor_, Neutral_, Ceil_, Chroma); }
 
 
 // Inline functions for class Plane_FL
@@ -418,59 +535,82 @@ inline bool Plane_FL::isPCChroma() const { return ::isPCChroma(Floor(), Neutral(
 inline void Plane_FL::ReSetChroma(bool Chroma) { ::ReSetChroma(Floor_, Neutral_, Ceil_, Chroma); }
 
 
-// Template functions for class Plane
+// Template functions for class PlaneT
+template < typename _Ty >
+template < typename _St1 >
+PlaneT<_Ty>::PlaneT(const PlaneT<_St1> &src)
+    : _Myt(static_cast<value_type>(src.Floor()), src.Width(), src.Height(), static_cast<value_type>(src.BitDepth()),
+    static_cast<value_type>(src.Floor()), static_cast<value_type>(src.Neutral()), static_cast<value_type>(src.Ceil()),
+    src.GetTransferChar(), false)
+{
+    TRANSFORM(*this, src, [](_St1 x)
+    {
+        return static_cast<_Ty>(x);
+    });
+}
+
+
+template < typename _Ty >
 template < typename T > inline
-Plane::value_type Plane::Quantize(T input) const
+typename PlaneT<_Ty>::value_type PlaneT<_Ty>::Quantize(T input) const
 {
     T input_up = input + T(0.5);
-    return input <= Floor_ ? Floor_ : input_up >= Ceil_ ? Ceil_ : static_cast<Plane::value_type>(input_up);
+    return input <= Floor_ ? Floor_ : input_up >= Ceil_ ? Ceil_ : static_cast<value_type>(input_up);
 }
 
 
+template < typename _Ty >
 template < typename _Fn1 > inline
-void Plane::for_each(_Fn1 _Func) const
+void PlaneT<_Ty>::for_each(_Fn1 _Func) const
 {
     FOR_EACH(*this, _Func);
 }
 
+template < typename _Ty >
 template < typename _Fn1 > inline
-void Plane::for_each(_Fn1 _Func)
+void PlaneT<_Ty>::for_each(_Fn1 _Func)
 {
     FOR_EACH(*this, _Func);
 }
 
+template < typename _Ty >
 template < typename _Fn1 > inline
-void Plane::transform(_Fn1 _Func)
+void PlaneT<_Ty>::transform(_Fn1 _Func)
 {
     TRANSFORM(*this, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _Fn1 > inline
-void Plane::transform(const _St1 &src, _Fn1 _Func)
+void PlaneT<_Ty>::transform(const _St1 &src, _Fn1 _Func)
 {
     TRANSFORM(*this, src, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _St2, typename _Fn1 > inline
-void Plane::transform(const _St1 &src1, const _St2 &src2, _Fn1 _Func)
+void PlaneT<_Ty>::transform(const _St1 &src1, const _St2 &src2, _Fn1 _Func)
 {
     TRANSFORM(*this, src1, src2, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _St2, typename _St3, typename _Fn1 > inline
-void Plane::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, _Fn1 _Func)
+void PlaneT<_Ty>::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, _Fn1 _Func)
 {
     TRANSFORM(*this, src1, src2, src3, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _St2, typename _St3, typename _St4, typename _Fn1 > inline
-void Plane::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, const _St4 &src4, _Fn1 _Func)
+void PlaneT<_Ty>::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, const _St4 &src4, _Fn1 _Func)
 {
     TRANSFORM(*this, src1, src2, src3, src4, _Func);
 }
 
+template < typename _Ty >
 template < PCType VRad, PCType HRad, typename _St1, typename _Fn1 > inline
-void Plane::convolute(const _St1 &src, _Fn1 _Func)
+void PlaneT<_Ty>::convolute(const _St1 &src, _Fn1 _Func)
 {
     CONVOLUTE<VRad, HRad>(*this, src, _Func);
 }
@@ -533,4 +673,27 @@ void Plane_FL::convolute(const _St1 &src, _Fn1 _Func)
 }
 
 
+// Template functions for class FrameT
+template < typename _Ty >
+template < typename _St1 >
+FrameT<_Ty>::FrameT(const FrameT<_St1> &src)
+    : _Myt(src.FrameNum(), src.GetPixelType(), src.Width(), src.Height(), static_cast<value_type>(src.BitDepth()),
+    src.GetQuantRange(), src.GetChromaPlacement(), src.GetColorPrim(), src.GetTransferChar(), src.GetColorMatrix(), false)
+{
+    for (PlaneCountType i = 0; i < PlaneCount(); ++i)
+    {
+        _Mysub &dstP = P(i);
+        const auto &srcP = src.P(i);
+
+        dstP.ReQuantize(static_cast<value_type>(srcP.BitDepth()), static_cast<value_type>(srcP.Floor()),
+            static_cast<value_type>(srcP.Neutral()), static_cast<value_type>(srcP.Ceil()), false);
+        dstP.SetTransferChar(srcP.GetTransferChar());
+        dstP.transform(srcP, [](_St1 x)
+        {
+            return static_cast<_Ty>(x);
+        });
+    }
+}
+
+
 #endif
@@ -11,6 +11,7 @@
 
 // Enable C++ PPL Support
 // Define it in the source file before #include "Image_Type.h" for fast compiling
+// Microsoft PPL is used with MSVC, otherwise the portable thread pool in "Thread_Pool.h"
 //#define ENABLE_PPL
 
 // Enable C++ AMP Support
@@ -27,8 +28,7 @@
 #define CONVOLUTE _Convolute
 
 #ifdef ENABLE_PPL
-#include <ppl.h>
-#include <ppltasks.h>
+#include "Thread_Pool.h"
 #define LOOP_V_PPL _Loop_V_PPL
 #define LOOP_H_PPL _Loop_H_PPL
 #define LOOP_Hinv_PPL _Loop_Hinv_PPL
@@ -36,8 +36,6 @@
 #define FOR_EACH_PPL _For_each_PPL
 #define TRANSFORM_PPL _Transform_PPL
 #define CONVOLUTE_PPL _Convolute_PPL
-const PCType PPL_HP = 256; // Height piece size for PPL
-const PCType PPL_WP = 256; // Width piece size for PPL
 #else
 #define LOOP_V_PPL LOOP_V
 #define LOOP_H_PPL LOOP_H
@@ -282,22 +280,98 @@ void _Loop_VH(const PCType height, const PCType width, const PCType stride0, con
     }
 }
 
+// Each operand is indexed with its own stride, a single index is used when all the strides are the same
+template < typename _Fn1 >
+void _Loop_VH(const PCType height, const PCType width, const PCType stride0, const PCType stride1, const PCType stride2, _Fn1 &&_Func)
+{
+    if (stride0 == stride1 && stride0 == stride2)
+    {
+        _Loop_VH(height, width, stride0, [&](PCType i) { _Func(i, i, i); });
+        return;
+    }
+
+    for (PCType j = 0; j < height; ++j)
+    {
+        PCType i0 = j * stride0;
+        PCType i1 = j * stride1;
+        PCType i2 = j * stride2;
+
+        for (const PCType upper = i0 + width; i0 < upper; ++i0, ++i1, ++i2)
+        {
+            _Func(i0, i1, i2);
+        }
+    }
+}
+
+template < typename _Fn1 >
+void _Loop_VH(const PCType height, const PCType width, const PCType stride0, const PCType stride1, const PCType stride2,
+    const PCType stride3, _Fn1 &&_Func)
+{
+    if (stride0 == stride1 && stride0 == stride2 && stride0 == stride3)
+    {
+        _Loop_VH(height, width, stride0, [&](PCType i) { _Func(i, i, i, i); });
+        return;
+    }
+
+    for (PCType j = 0; j < height; ++j)
+    {
+        PCType i0 = j * stride0;
+        PCType i1 = j * stride1;
+        PCType i2 = j * stride2;
+        PCType i3 = j * stride3;
+
+        for (const PCType upper = i0 + width; i0 < upper; ++i0, ++i1, ++i2, ++i3)
+        {
+            _Func(i0, i1, i2, i3);
+        }
+    }
+}
+
+template < typename _Fn1 >
+void _Loop_VH(const PCType height, const PCType width, const PCType stride0, const PCType stride1, const PCType stride2,
+    const PCType stride3, const PCType stride4, _Fn1 &&_Func)
+{
+    if (stride0 == stride1 && stride0 == stride2 && stride0 == stride3 && stride0 == stride4)
+    {
+        _Loop_VH(height, width, stride0, [&](PCType i) { _Func(i, i, i, i, i); });
+        return;
+    }
+
+    for (PCType j = 0; j < height; ++j)
+    {
+        PCType i0 = j * stride0;
+        PCType i1 = j * stride1;
+        PCType i2 = j * stride2;
+        PCType i3 = j * stride3;
+        PCType i4 = j * stride4;
+
+        for (const PCType upper = i0 + width; i0 < upper; ++i0, ++i1, ++i2, ++i3, ++i4)
+        {
+            _Func(i0, i1, i2, i3, i4);
+        }
+    }
+}
+
 
 template < typename _St1, typename _Fn1 >
 void _For_each(_St1 &data, _Fn1 &&_Func)
 {
+    auto datap = data.data();
+
     LOOP_VH(data.Height(), data.Width(), data.Stride(), [&](PCType i)
     {
-        _Func(data[i]);
+        _Func(datap[i]);
     });
 }
 
 template < typename _St1, typename _Fn1 >
 void _Transform(_St1 &data, _Fn1 &&_Func)
 {
+    auto datap = data.data();
+
     LOOP_VH(data.Height(), data.Width(), data.Stride(), [&](PCType i)
     {
-        data[i] = _Func(data[i]);
+        datap[i] = _Func(datap[i]);
     });
 }
 
@@ -309,9 +383,11 @@ void _Transform(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform: Width() and Height() of dst and src must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), src.Stride(), [&](PCType i0, PCType i1)
     {
-        dst[i] = _Func(src[i]);
+        dstp[i0] = _Func(src[i1]);
     });
 }
 
@@ -324,9 +400,11 @@ void _Transform(_Dt1 &dst, const _St1 &src1, const _St2 &src2, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform: Width() and Height() of dst, src1 and src2 must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), src1.Stride(), src2.Stride(), [&](PCType i0, PCType i1, PCType i2)
     {
-        dst[i] = _Func(src1[i], src2[i]);
+        dstp[i0] = _Func(src1[i1], src2[i2]);
     });
 }
 
@@ -340,9 +418,12 @@ void _Transform(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &src3,
         DEBUG_FAIL("_Transform: Width() and Height() of dst, src1, src2 and src3 must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), src1.Stride(), src2.Stride(), src3.Stride(),
+        [&](PCType i0, PCType i1, PCType i2, PCType i3)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i]);
+        dstp[i0] = _Func(src1[i1], src2[i2], src3[i3]);
     });
 }
 
@@ -357,9 +438,12 @@ void _Transform(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &src3,
         DEBUG_FAIL("_Transform: Width() and Height() of dst, src1, src2, src3 and src4 must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), src1.Stride(), src2.Stride(), src3.Stride(), src4.Stride(),
+        [&](PCType i0, PCType i1, PCType i2, PCType i3, PCType i4)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i], src4[i]);
+        dstp[i0] = _Func(src1[i1], src2[i2], src3[i3], src4[i4]);
     });
 }
 
@@ -371,9 +455,11 @@ void _Convolute(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
         DEBUG_FAIL("_Convolute: Width() and Height() of dst and src must be the same.");
     }
 
+    auto dstp0 = dst.data();
+
     LOOP_V(dst.Height(), [&](PCType j)
     {
-        auto dstp = dst.data() + j * dst.Stride();
+        auto dstp = dstp0 + j * dst.Stride();
 
         typename _St1::const_pointer srcpV[VRad * 2 + 1];
         typename _St1::value_type srcb2D[VRad * 2 + 1][HRad * 2 + 1];
@@ -437,7 +523,7 @@ void _Loop_V_PPL(const PCType height, _Fn1 &&_Func)
 {
     const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
     {
         const PCType lower = p * PPL_HP;
         const PCType upper = Min(height, lower + PPL_HP);
@@ -454,7 +540,7 @@ void _Loop_H_PPL(const PCType height, const PCType width, const PCType stride, _
 {
     const PCType pNum = (width + PPL_WP - 1) / PPL_WP;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
     {
         const PCType offset = p * PPL_WP;
         const PCType range = Min(width - offset, PPL_WP);
@@ -474,7 +560,7 @@ void _Loop_Hinv_PPL(const PCType height, const PCType width, const PCType stride
 {
     const PCType pNum = (width + PPL_WP - 1) / PPL_WP;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
     {
         const PCType offset = p * PPL_WP;
         const PCType range = Min(width - offset, PPL_WP);
@@ -494,7 +580,7 @@ void _Loop_VH_PPL(const PCType height, const PCType width, const PCType stride,
 {
     const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
     {
         const PCType lower = p * PPL_HP;
         const PCType upper = Min(height, lower + PPL_HP);
@@ -516,7 +602,7 @@ void _Loop_VH_PPL(const PCType height, const PCType width, const PCType dst_stri
 {
     const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
     {
         const PCType lower = p * PPL_HP;
         const PCType upper = Min(height, lower + PPL_HP);
@@ -534,22 +620,124 @@ void _Loop_VH_PPL(const PCType height, const PCType width, const PCType dst_stri
     });
 }
 
+template < typename _Fn1 >
+void _Loop_VH_PPL(const PCType height, const PCType width, const PCType stride0, const PCType stride1, const PCType stride2, _Fn1 &&_Func)
+{
+    if (stride0 == stride1 && stride0 == stride2)
+    {
+        _Loop_VH_PPL(height, width, stride0, [&](PCType i) { _Func(i, i, i); });
+        return;
+    }
+
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            PCType i0 = j * stride0;
+            PCType i1 = j * stride1;
+            PCType i2 = j * stride2;
+
+
+            for (const PCType upper = i0 + width; i0 < upper; ++i0, ++i1, ++i2)
+            {
+                _Func(i0, i1, i2);
+            }
+        }
+    });
+}
+
+template < typename _Fn1 >
+void _Loop_VH_PPL(const PCType height, const PCType width, const PCType stride0, const PCType stride1, const PCType stride2,
+    const PCType stride3, _Fn1 &&_Func)
+{
+    if (stride0 == stride1 && stride0 == stride2 && stride0 == stride3)
+    {
+        _Loop_VH_PPL(height, width, stride0, [&](PCType i) { _Func(i, i, i, i); });
+        return;
+    }
+
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            PCType i0 = j * stride0;
+            PCType i1 = j * stride1;
+            PCType i2 = j * stride2;
+            PCType i3 = j * stride3;
+
+
+            for (const PCType upper = i0 + width; i0 < upper; ++i0, ++i1, ++i2, ++i3)
+            {
+                _Func(i0, i1, i2, i3);
+            }
+        }
+    });
+}
+
+template < typename _Fn1 >
+void _Loop_VH_PPL(const PCType height, const PCType width, const PCType stride0, const PCType stride1, const PCType stride2,
+    const PCType stride3, const PCType stride4, _Fn1 &&_Func)
+{
+    if (stride0 == stride1 && stride0 == stride2 && stride0 == stride3 && stride0 == stride4)
+    {
+        _Loop_VH_PPL(height, width, stride0, [&](PCType i) { _Func(i, i, i, i, i); });
+        return;
+    }
+
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            PCType i0 = j * stride0;
+            PCType i1 = j * stride1;
+            PCType i2 = j * stride2;
+            PCType i3 = j * stride3;
+            PCType i4 = j * stride4;
+
+
+            for (const PCType upper = i0 + width; i0 < upper; ++i0, ++i1, ++i2, ++i3, ++i4)
+            {
+                _Func(i0, i1, i2, i3, i4);
+            }
+        }
+    });
+}
+
 
 template < typename _St1, typename _Fn1 >
 void _For_each_PPL(_St1 &data, _Fn1 &&_Func)
 {
+    auto datap = data.data();
+
     LOOP_VH_PPL(data.Height(), data.Width(), data.Stride(), [&](PCType i)
     {
-        _Func(data[i]);
+        _Func(datap[i]);
     });
 }
 
 template < typename _St1, typename _Fn1 >
 void _Transform_PPL(_St1 &data, _Fn1 &&_Func)
 {
+    auto datap = data.data();
+
     LOOP_VH_PPL(data.Height(), data.Width(), data.Stride(), [&](PCType i)
     {
-        data[i] = _Func(data[i]);
+        datap[i] = _Func(datap[i]);
     });
 }
 
@@ -561,9 +749,11 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst and src must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), src.Stride(), [&](PCType i0, PCType i1)
     {
-        dst[i] = _Func(src[i]);
+        dstp[i0] = _Func(src[i1]);
     });
 }
 
@@ -575,9 +765,11 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src1, const _St2 &src2, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst, src1 and src2 must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), src1.Stride(), src2.Stride(), [&](PCType i0, PCType i1, PCType i2)
     {
-        dst[i] = _Func(src1[i], src2[i]);
+        dstp[i0] = _Func(src1[i1], src2[i2]);
     });
 }
 
@@ -591,9 +783,12 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &s
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst, src1, src2 and src3 must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), src1.Stride(), src2.Stride(), src3.Stride(),
+        [&](PCType i0, PCType i1, PCType i2, PCType i3)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i]);
+        dstp[i0] = _Func(src1[i1], src2[i2], src3[i3]);
     });
 }
 
@@ -608,9 +803,12 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &s
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst, src1, src2, src3 and src4 must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    auto dstp = dst.data();
+
+    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), src1.Stride(), src2.Stride(), src3.Stride(), src4.Stride(),
+        [&](PCType i0, PCType i1, PCType i2, PCType i3, PCType i4)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i], src4[i]);
+        dstp[i0] = _Func(src1[i1], src2[i2], src3[i3], src4[i4]);
     });
 }
 
@@ -622,9 +820,11 @@ void _Convolute_PPL(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
         DEBUG_FAIL("_Convolute_PPL: Width() and Height() of dst and src must be the same.");
     }
 
+    auto dstp0 = dst.data();
+
     LOOP_V_PPL(dst.Height(), [&](PCType j)
     {
-        auto dstp = dst.data() + j * dst.Stride();
+        auto dstp = dstp0 + j * dst.Stride();
 
         typename _St1::const_pointer srcpV[VRad * 2 + 1];
         typename _St1::value_type srcb2D[VRad * 2 + 1][HRad * 2 + 1];
@@ -687,7 +887,7 @@ void _Convolute_PPL(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
 template < typename _St1, typename _Fn1 >
 void _For_each_AMP(_St1 &data, _Fn1 &&_Func)
 {
-    concurrency::array_view<decltype(data.value(0)), 1> datav(data.PixelCount(), datap);
+    concurrency::array_view<decltype(data.value(0)), 1> datav(static_cast<int>(data.size()), datap);
 
     concurrency::parallel_for_each(datav.extent, [=](concurrency::index<1> idx) restrict(amp)
     {
@@ -698,7 +898,7 @@ void _For_each_AMP(_St1 &data, _Fn1 &&_Func)
 template < typename _St1, typename _Fn1 >
 void _Transform_AMP(_St1 &data, _Fn1 &&_Func)
 {
-    concurrency::array_view<decltype(data.value(0)), 1> datav(data.PixelCount(), data);
+    concurrency::array_view<decltype(data.value(0)), 1> datav(static_cast<int>(data.size()), data);
 
     concurrency::parallel_for_each(datav.extent, [=](concurrency::index<1> idx) restrict(amp)
     {
@@ -714,8 +914,8 @@ void _Transform_AMP(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform_AMP: Width() and Height() of dst and src must be the same.");
     }
 
-    concurrency::array_view<decltype(dst.value(0)), 1> dstv(dst.PixelCount(), dst);
-    concurrency::array_view<const decltype(src.value(0)), 1> srcv(src.PixelCount(), src);
+    concurrency::array_view<decltype(dst.value(0)), 1> dstv(static_cast<int>(dst.size()), dst);
+    concurrency::array_view<const decltype(src.value(0)), 1> srcv(static_cast<int>(src.size()), src);
     dstv.discard_data();
 
     concurrency::parallel_for_each(dstv.extent, [=](concurrency::index<1> idx) restrict(amp)
@@ -733,9 +933,9 @@ void _Transform_AMP(_Dt1 &dst, const _St1 &src1, const _St2 &src2, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform_AMP: Width() and Height() of dst, src1 and src2 must be the same.");
     }
 
-    concurrency::array_view<decltype(dst.value(0)), 1> dstv(dst.PixelCount(), dst);
-    concurrency::array_view<const decltype(src1.value(0)), 1> src1v(src1.PixelCount(), src1);
-    concurrency::array_view<const decltype(src2.value(0)), 1> src2v(src2.PixelCount(), src2);
+    concurrency::array_view<decltype(dst.value(0)), 1> dstv(static_cast<int>(dst.size()), dst);
+    concurrency::array_view<const decltype(src1.value(0)), 1> src1v(static_cast<int>(src1.size()), src1);
+    concurrency::array_view<const decltype(src2.value(0)), 1> src2v(static_cast<int>(src2.size()), src2);
     dstv.discard_data();
 
     concurrency::parallel_for_each(dstv.extent, [=](concurrency::index<1> idx) restrict(amp)
@@ -754,10 +954,10 @@ void _Transform_AMP(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &s
         DEBUG_FAIL("_Transform_AMP: Width() and Height() of dst, src1, src2 and src3 must be the same.");
     }
 
-    concurrency::array_view<decltype(dst.value(0)), 1> dstv(dst.PixelCount(), dst);
-    concurrency::array_view<const decltype(src1.value(0)), 1> src1v(src1.PixelCount(), src1);
-    concurrency::array_view<const decltype(src2.value(0)), 1> src2v(src2.PixelCount(), src2);
-    concurrency::array_view<const decltype(src3.value(0)), 1> src3v(src3.PixelCount(), src3);
+    concurrency::array_view<decltype(dst.value(0)), 1> dstv(static_cast<int>(dst.size()), dst);
+    concurrency::array_view<const decltype(src1.value(0)), 1> src1v(static_cast<int>(src1.size()), src1);
+    concurrency::array_view<const decltype(src2.value(0)), 1> src2v(static_cast<int>(src2.size()), src2);
+    concurrency::array_view<const decltype(src3.value(0)), 1> src3v(static_cast<int>(src3.size()), src3);
     dstv.discard_data();
 
     concurrency::parallel_for_each(dstv.extent, [=](concurrency::index<1> idx) restrict(amp)
@@ -777,11 +977,11 @@ void _Transform_AMP(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &s
         DEBUG_FAIL("_Transform_AMP: Width() and Height() of dst, src1, src2, src3 and src4 must be the same.");
     }
 
-    concurrency::array_view<decltype(dst.value(0)), 1> dstv(dst.PixelCount(), dst);
-    concurrency::array_view<const decltype(src1.value(0)), 1> src1v(src1.PixelCount(), src1);
-    concurrency::array_view<const decltype(src2.value(0)), 1> src2v(src2.PixelCount(), src2);
-    concurrency::array_view<const decltype(src3.value(0)), 1> src3v(src3.PixelCount(), src3);
-    concurrency::array_view<const decltype(src4.value(0)), 1> src4v(src4.PixelCount(), src4);
+    concurrency::array_view<decltype(dst.value(0)), 1> dstv(static_cast<int>(dst.size()), dst);
+    concurrency::array_view<const decltype(src1.value(0)), 1> src1v(static_cast<int>(src1.size()), src1);
+    concurrency::array_view<const decltype(src2.value(0)), 1> src2v(static_cast<int>(src2.size()), src2);
+    concurrency::array_view<const decltype(src3.value(0)), 1> src3v(static_cast<int>(src3.size()), src3);
+    concurrency::array_view<const decltype(src4.value(0)), 1> src4v(static_cast<int>(src4.size()), src4);
     dstv.discard_data();
 
     concurrency::parallel_for_each(dstv.extent, [=](concurrency::index<1> idx) restrict(amp)
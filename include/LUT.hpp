@@ -30,7 +30,8 @@ LUT<T>::LUT(LevelType Levels)
 }
 
 template < typename T >
-LUT<T>::LUT(const Plane &src)
+template < typename _St1 >
+LUT<T>::LUT(const PlaneT<_St1> &src)
     : Levels_(src.ValueRange() + 1)
 {
     Table_ = new T[Levels_];
@@ -81,7 +82,8 @@ LUT<T> &LUT<T>::operator=(_Myt &&src)
 
 
 template < typename T >
-void LUT<T>::Set(const Plane &src, LevelType i, T o)
+template < typename _St1 >
+void LUT<T>::Set(const PlaneT<_St1> &src, LevelType i, T o)
 {
     if (i >= src.Floor() && i <= src.Ceil())
     {
@@ -94,7 +96,8 @@ void LUT<T>::Set(const Plane &src, LevelType i, T o)
 }
 
 template < typename T >
-void LUT<T>::SetRange(const Plane &src, T o, LevelType start, LevelType end)
+template < typename _St1 >
+void LUT<T>::SetRange(const PlaneT<_St1> &src, T o, LevelType start, LevelType end)
 {
     sint64 length = static_cast<sint64>(end) - static_cast<sint64>(start) + 1;
     start = Max(LevelType(0), start - src.Floor());
@@ -113,19 +116,19 @@ template < typename T >
 template < typename _St1, typename _Fn1 >
 void LUT<T>::Set(const _St1 &src, _Fn1 &&_Func)
 {
-    for (auto i = src.Floor(); i <= src.Ceil(); ++i)
+    // Counted in LevelType, since the Ceil of a narrow storage type may be its maximum value
+    for (LevelType i = src.Floor(); i <= src.Ceil(); ++i)
     {
-        Table_[i - src.Floor()] = _Func(i);
+        Table_[i - src.Floor()] = _Func(static_cast<typename _St1::value_type>(i));
     }
 }
 
 
 template < typename T >
-template < typename _Dt1 >
-void LUT<T>::Lookup(_Dt1 &dst, const Plane &src) const
+template < typename _Dt1, typename _St1 >
+void LUT<T>::Lookup(_Dt1 &dst, const PlaneT<_St1> &src) const
 {
-    typedef Plane _St1;
-    typedef typename _St1::value_type srcType;
+    typedef _St1 srcType;
     typedef typename _Dt1::value_type dstType;
 
     TRANSFORM_PPL(dst, src, [&](srcType x)
@@ -171,13 +174,13 @@ void LUT<T>::Lookup_Gain(_Dt1 &dst, const _St1 &src, const _Rt1 &ref) const
 }
 
 template < typename T >
-template < typename _Rt1 >
-void LUT<T>::Lookup_Gain(Frame &dst, const Frame &src, const _Rt1 &ref) const
+template < typename _St1, typename _Rt1 >
+void LUT<T>::Lookup_Gain(FrameT<_St1> &dst, const FrameT<_St1> &src, const _Rt1 &ref) const
 {
     PCType i, j, upper;
     PCType height = ref.Height();
     PCType width = ref.Width();
-    PCType stride = ref.Width();
+    PCType stride = ref.Stride();
     DType rFloor = ref.Floor();
 
     FLType gain, offset;
@@ -214,9 +217,9 @@ void LUT<T>::Lookup_Gain(Frame &dst, const Frame &src, const _Rt1 &ref) const
                 Vval = srcV[i] - sNeutral;
                 gain = Table_[ref[i] - rFloor];
                 gain = Min(sRangeFL / Yval, Min(sRangeC2FL / Max(Abs(Uval), Abs(Vval)), gain));
-                dstY[i] = static_cast<DType>(Yval * gain + offsetY);
-                dstU[i] = static_cast<DType>(Uval * gain + offset);
-                dstV[i] = static_cast<DType>(Vval * gain + offset);
+                dstY[i] = static_cast<_St1>(Yval * gain + offsetY);
+                dstU[i] = static_cast<_St1>(Uval * gain + offset);
+                dstV[i] = static_cast<_St1>(Vval * gain + offset);
             }
         }
     }
@@ -245,9 +248,9 @@ void LUT<T>::Lookup_Gain(Frame &dst, const Frame &src, const _Rt1 &ref) const
                 Bval = srcB[i] - sFloor;
                 gain = Table_[ref[i] - rFloor];
                 gain = Min(sRangeFL / Max(Rval, Max(Gval, Bval)), gain);
-                dstR[i] = static_cast<DType>(Rval * gain + offset);
-                dstG[i] = static_cast<DType>(Gval * gain + offset);
-                dstB[i] = static_cast<DType>(Bval * gain + offset);
+                dstR[i] = static_cast<_St1>(Rval * gain + offset);
+                dstG[i] = static_cast<_St1>(Gval * gain + offset);
+                dstB[i] = static_cast<_St1>(Bval * gain + offset);
             }
         }
     }
@@ -0,0 +1,86 @@
+#ifndef MEMORY_POOL_H_
+#define MEMORY_POOL_H_
+
+
+#include <atomic>
+#include "Helper.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Size-bucketed pool of aligned buffers shared by all the threads
+// Plane, Plane_FL, Block and BlockGroup allocate from it, so that the temporaries of the filters reuse warm memory
+// instead of going through the system allocator (and page faults on first touch) for every call.
+// Freed buffers are kept for reuse until the cached size exceeds the limit.
+// The buffers are reference counted, so that planes can share them and copy on write.
+
+struct Memory_Pool_Stats
+{
+    size_t hits = 0; // Allocations served by a cached buffer
+    size_t misses = 0; // Allocations served by the system allocator
+    size_t cached = 0; // Bytes of the free buffers currently cached
+    size_t limit = 0; // Maximum bytes of the cached buffers
+};
+
+
+// Maximum bytes of the cached buffers, 0 disables caching, the buffers above the limit are released immediately
+// The initial value can be set with environment variable ISP_MW_POOL_LIMIT (MiB), the default is 1024 MiB
+void SetMemoryPoolLimit(size_t limit);
+
+Memory_Pool_Stats GetMemoryPoolStats();
+
+// Release all the cached buffers to the system
+void MemoryPoolRelease();
+
+
+// Allocate at least Size bytes aligned to MEMORY_ALIGNMENT
+void *PoolMalloc(size_t Size);
+
+// Drop a reference to memory allocated by PoolMalloc, which returns to the pool with the last one, nullptr is ignored
+void PoolFree(void *Memory);
+
+// Add a reference to memory allocated by PoolMalloc, nullptr is ignored
+void PoolRetain(const void *Memory);
+
+// The reference count is stored after the capacity in the header of the buffer
+inline std::atomic<size_t> &PoolRefCount(const void *Memory)
+{
+    return *reinterpret_cast<std::atomic<size_t> *>(const_cast<char *>(reinterpret_cast<const char *>(Memory)) - MEMORY_ALIGNMENT + sizeof(size_t));
+}
+
+// Whether other owners hold references to the buffer, thus it shouldn't be written
+inline bool PoolShared(const void *Memory)
+{
+    return PoolRefCount(Memory).load(std::memory_order_acquire) > 1;
+}
+
+
+template < typename _Ty >
+void PoolMalloc(_Ty *&Memory, size_t Count)
+{
+    Memory = reinterpret_cast<_Ty *>(PoolMalloc(Count * sizeof(_Ty)));
+}
+
+template < typename _Ty >
+void PoolFree(_Ty *&Memory)
+{
+    PoolFree(reinterpret_cast<void *>(Memory));
+    Memory = nullptr;
+}
+
+// The buffer is kept if it's large enough and not shared, otherwise the content is not preserved
+size_t PoolCapacity(const void *Memory);
+
+template < typename _Ty >
+void PoolRealloc(_Ty *&Memory, size_t NewCount)
+{
+    if (Memory == nullptr || PoolShared(Memory) || PoolCapacity(Memory) < NewCount * sizeof(_Ty))
+    {
+        PoolFree(Memory);
+        PoolMalloc(Memory, NewCount);
+    }
+}
+
+
+#endif
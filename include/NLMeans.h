@@ -6,6 +6,7 @@
 #include "Image_Type.h"
 #include "Helper.h"
 #include "Block.h"
+#include "Block_Matcher.h"
 
 
 const struct NLMeans_Para
@@ -19,6 +20,7 @@ const struct NLMeans_Para
     PCType BMrange = 24;
     PCType BMstep = 3;
     double thMSE = correction ? sigma * 50 : sigma * 25;
+    int BMalgorithm = 0; // 0, 1: direct SSD of each candidate, 2: incremental matching by BlockMatcher (last bits of the distances differ)
 } NLMeans_Default;
 
 
@@ -38,6 +40,8 @@ public:
     typedef block_type::PosCode PosCode;
     typedef block_type::PosPairCode PosPairCode;
 
+    typedef BlockMatcher<FLType, FLType> matcher_type;
+
 protected:
     NLMeans_Para para;
 
@@ -46,19 +50,37 @@ public:
         : para(_para)
     {}
 
+    // Reference blocks overlapping a tile search up to BMrange away
+    virtual PCType TileHalo() const override
+    {
+        return para.BMrange + para.BlockSize;
+    }
+
+    virtual PCType TileAlign() const override
+    {
+        return para.BlockStep;
+    }
+
 protected:
     virtual Plane_FL &process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref);
     virtual Plane &process_Plane(Plane &dst, const Plane &src, const Plane &ref);
     virtual Frame &process_Frame(Frame &dst, const Frame &src, const Frame &ref);
 
 protected:
+    std::unique_ptr<matcher_type> CreateMatcher(const Plane_FL &ref,
+        const std::vector<PCType> &rows, const std::vector<PCType> &cols) const;
+
+    PCType MatchRows() const;
+
+    // sumX1 and sumX2 are accumulation blocks owned by the caller and reused for all the reference blocks,
+    // the filter object keeps no scratch, so concurrent calls on one instance don't share them
     template < typename _St1 >
     void WeightedAverage(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-        const PosPairCode &code);
+        const PosPairCode &code, block_type &sumX1) const;
 
     template < typename _St1 >
     void WeightedAverage_Correction(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-        const PosPairCode &code);
+        const PosPairCode &code, block_type &sumX1, block_type &sumX2) const;
 };
 
 
@@ -130,6 +152,11 @@ protected:
                 ArgsObj.GetPara(i, para.BMstep);
                 continue;
             }
+            if (args[i] == "-MA" || args[i] == "--BMalgorithm")
+            {
+                ArgsObj.GetPara(i, para.BMalgorithm);
+                continue;
+            }
             if (args[i] == "-TH" || args[i] == "--thMSE")
             {
                 ArgsObj.GetPara(i, para.thMSE);
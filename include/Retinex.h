@@ -11,6 +11,7 @@ const struct Retinex_Para
 {
     ldbl sigma = 80.0L;
     std::vector<ldbl> sigmaVector;
+    ldbl approx_error = 0; // Maximum error of PyramidGaussian for large sigmas, 0 for the exact recursive Gaussian
 
     double lower_thr = 0.01;
     double upper_thr = 0.01;
@@ -199,6 +200,11 @@ protected:
                 ArgsObj.GetPara(i, para.upper_thr);
                 continue;
             }
+            if (args[i] == "-AE" || args[i] == "--approx_error")
+            {
+                ArgsObj.GetPara(i, para.approx_error);
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
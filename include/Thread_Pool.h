@@ -0,0 +1,261 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "Helper.h"
+
+// Use the portable thread pool instead of Microsoft PPL even if it's available
+//#define USE_THREAD_POOL
+
+#if defined(_MSC_VER) && !defined(USE_THREAD_POOL)
+#define _PPL_NATIVE_
+#include <ppl.h>
+#include <ppltasks.h>
+#endif
+
+// VS2013 (v120) doesn't support thread_local, and doesn't initialize function-local statics thread-safely either,
+// thus the objects used by several threads are kept at namespace scope instead,
+// or published through an atomic pointer when they must be constructed on first use.
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL thread_local
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Piece sizes for the *_PPL loops, tunable at run time
+extern PCType PPL_HP; // Height piece size for PPL
+extern PCType PPL_WP; // Width piece size for PPL
+
+// Number of worker threads for the *_PPL loops, 0 means hardware concurrency
+// The initial value can be set with environment variable ISP_MW_THREADS
+void SetThreadCount(int count);
+int GetThreadCount();
+
+void SetPPLPieceSize(PCType height_piece, PCType width_piece);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Work-stealing thread pool
+// Each worker owns a task deque, pops its own tasks from the back and steals from the front of the others
+class Thread_Pool
+{
+public:
+    typedef Thread_Pool _Myt;
+    typedef std::function<void()> Task;
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<size_t> pending;
+    std::atomic<size_t> next_queue;
+    bool stop = false;
+
+    static THREAD_LOCAL int worker_index;
+
+    bool PopTask(int index, Task &task);
+    bool StealTask(int index, Task &task);
+    void WorkerLoop(int index);
+
+public:
+    explicit Thread_Pool(int count = 0);
+    ~Thread_Pool();
+
+    Thread_Pool(const _Myt &src) = delete;
+    _Myt &operator=(const _Myt &src) = delete;
+
+    // Number of worker threads, excluding the calling thread
+    int Count() const { return static_cast<int>(threads.size()); }
+
+    void Submit(Task task);
+
+    // Run _Func(p) for every p in [lower, upper)
+    // The calling thread takes part in the work, so nested calls from inside a task don't dead-lock
+    template < typename _Fn1 >
+    void parallel_for(PCType lower, PCType upper, _Fn1 &&_Func);
+
+    // The pool is created on first use, the pointer is cached so that a parallel loop doesn't lock
+    static _Myt &Instance();
+    static void Reset(int count);
+};
+
+
+template < typename _Fn1 >
+void Thread_Pool::parallel_for(PCType lower, PCType upper, _Fn1 &&_Func)
+{
+    const PCType count = upper - lower;
+
+    if (count <= 0) return;
+
+    if (count == 1 || Count() < 1)
+    {
+        for (PCType p = lower; p < upper; ++p)
+        {
+            _Func(p);
+        }
+
+        return;
+    }
+
+    // Shared state outlives this call, helpers starting late find no work left and never touch _Func
+    struct State
+    {
+        std::atomic<PCType> next;
+        std::atomic<PCType> done;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    auto state = std::make_shared<State>();
+    state->next = lower;
+    state->done = 0;
+
+    auto func = &_Func;
+
+    auto kernel = [state, func, upper, count]()
+    {
+        PCType p;
+        PCType finished = 0;
+
+        while ((p = state->next++) < upper)
+        {
+            (*func)(p);
+            ++finished;
+        }
+
+        if (finished > 0 && (state->done += finished) == count)
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->cv.notify_all();
+        }
+    };
+
+    const int helpers = static_cast<int>(Min(static_cast<PCType>(Count()), count - 1));
+
+    for (int t = 0; t < helpers; ++t)
+    {
+        Submit(kernel);
+    }
+
+    kernel();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&]() { return state->done == count; });
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Budget shared by concurrent workers, such as the memory held by the images in flight
+// Acquire() blocks while the request doesn't fit in the remaining budget,
+// but a request is always granted when nothing is held, so a single large request can't dead-lock
+class Memory_Budget
+{
+public:
+    typedef Memory_Budget _Myt;
+
+private:
+    const size_t limit;
+    size_t used = 0;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+
+public:
+    // 0 means unlimited
+    explicit Memory_Budget(size_t _limit = 0)
+        : limit(_limit)
+    {}
+
+    Memory_Budget(const _Myt &src) = delete;
+    _Myt &operator=(const _Myt &src) = delete;
+
+    void Acquire(size_t size)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return limit == 0 || used == 0 || used + size <= limit; });
+        used += size;
+    }
+
+    void Release(size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            used -= size;
+        }
+
+        cv.notify_all();
+    }
+
+    // Holds the acquired part of a budget until destruction, so that it's also released when an exception is thrown
+    // A null budget is unlimited
+    class Guard
+    {
+    private:
+        Memory_Budget *budget;
+        size_t size = 0;
+
+    public:
+        explicit Guard(Memory_Budget *_budget, size_t _size = 0)
+            : budget(_budget)
+        {
+            Acquire(_size);
+        }
+
+        ~Guard()
+        {
+            if (budget && size > 0) budget->Release(size);
+        }
+
+        Guard(const Guard &src) = delete;
+        Guard &operator=(const Guard &src) = delete;
+
+        void Acquire(size_t _size)
+        {
+            if (!budget || _size == 0) return;
+
+            budget->Acquire(_size);
+            size += _size;
+        }
+    };
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template < typename _Fn1 >
+void _Parallel_for(PCType lower, PCType upper, _Fn1 &&_Func)
+{
+#ifdef _PPL_NATIVE_
+    concurrency::parallel_for(lower, upper, _Func);
+#else
+    Thread_Pool::Instance().parallel_for(lower, upper, _Func);
+#endif
+}
+
+
+#endif
@@ -0,0 +1,334 @@
+#ifndef TILE_H_
+#define TILE_H_
+
+
+#include <cstring>
+#include "Image_Type.h"
+#include "Thread_Pool.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Tile sizes for tiled processing, tunable at run time, 0 means no tiling in this dimension
+extern PCType TILE_HP; // Height piece size of tiles
+extern PCType TILE_WP; // Width piece size of tiles
+
+void SetTileSize(PCType height_piece, PCType width_piece);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// PlaneT/FrameT of the same format as src with another size, the data is not initialized
+template < typename _Ty >
+PlaneT<_Ty> TileAlloc(const PlaneT<_Ty> &src, PCType width, PCType height)
+{
+    return PlaneT<_Ty>(src.Floor(), width, height, src.BitDepth(), src.Floor(), src.Neutral(), src.Ceil(),
+        src.GetTransferChar(), false);
+}
+
+inline Plane_FL TileAlloc(const Plane_FL &src, PCType width, PCType height)
+{
+    return Plane_FL(src.Floor(), width, height, src.Floor(), src.Neutral(), src.Ceil(),
+        src.GetTransferChar(), false);
+}
+
+template < typename _Ty >
+FrameT<_Ty> TileAlloc(const FrameT<_Ty> &src, PCType width, PCType height)
+{
+    return FrameT<_Ty>(src.FrameNum(), src.GetPixelType(), width, height, src.BitDepth(), src.GetQuantRange(),
+        src.GetChromaPlacement(), src.GetColorPrim(), src.GetTransferChar(), src.GetColorMatrix(), false);
+}
+
+
+// Copy a rectangle of height x width from (src_y, src_x) of src to (dst_y, dst_x) of dst
+// For Frame, the rectangle is in the coordinates of the frame, and scaled for the subsampled planes.
+template < typename _St1 >
+void TileCopy(_St1 &dst, PCType dst_y, PCType dst_x, const _St1 &src, PCType src_y, PCType src_x,
+    PCType height, PCType width)
+{
+    for (PCType j = 0; j < height; ++j)
+    {
+        memcpy(dst.data() + (dst_y + j) * dst.Stride() + dst_x, src.data() + (src_y + j) * src.Stride() + src_x,
+            sizeof(typename _St1::value_type) * width);
+    }
+}
+
+template < typename _Ty >
+void TileCopy(FrameT<_Ty> &dst, PCType dst_y, PCType dst_x, const FrameT<_Ty> &src, PCType src_y, PCType src_x,
+    PCType height, PCType width)
+{
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); ++i)
+    {
+        const PCType sh = src.Height() / src.P(i).Height();
+        const PCType sw = src.Width() / src.P(i).Width();
+
+        TileCopy(dst.P(i), dst_y / sh, dst_x / sw, src.P(i), src_y / sh, src_x / sw, height / sh, width / sw);
+    }
+}
+
+
+// Subsampling of the planes relative to the frame, 1 for PlaneT and Plane_FL
+template < typename _St1 >
+void TileSubsampling(const _St1 &src, PCType &sub_h, PCType &sub_w)
+{
+    sub_h = 1;
+    sub_w = 1;
+}
+
+template < typename _Ty >
+void TileSubsampling(const FrameT<_Ty> &src, PCType &sub_h, PCType &sub_w)
+{
+    sub_h = 1;
+    sub_w = 1;
+
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); ++i)
+    {
+        sub_h = Max(sub_h, src.Height() / src.P(i).Height());
+        sub_w = Max(sub_w, src.Width() / src.P(i).Width());
+    }
+}
+
+
+// Whether the planes have the stride of a newly allocated plane of their width, see PlaneStride()
+// Views and copies of views keep the stride of the parent plane.
+template < typename _St1 >
+bool TileStrideDefault(const _St1 &src)
+{
+    return src.Stride() == PlaneStride(src.Width());
+}
+
+template < typename _Ty >
+bool TileStrideDefault(const FrameT<_Ty> &src)
+{
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); ++i)
+    {
+        if (!TileStrideDefault(src.P(i))) return false;
+    }
+
+    return true;
+}
+
+// Copy of src with the stride of a newly allocated plane
+template < typename _St1 >
+_St1 TileCompact(const _St1 &src)
+{
+    _St1 dst = TileAlloc(src, src.Width(), src.Height());
+    TileCopy(dst, 0, 0, src, 0, 0, src.Height(), src.Width());
+    return dst;
+}
+
+template < typename _Ty >
+FrameT<_Ty> TileCompact(const FrameT<_Ty> &src)
+{
+    FrameT<_Ty> dst = TileAlloc(src, src.Width(), src.Height());
+
+    for (typename FrameT<_Ty>::PlaneCountType i = 0; i < src.PlaneCount(); ++i)
+    {
+        TileCopy(dst.P(i), 0, 0, src.P(i), 0, 0, src.P(i).Height(), src.P(i).Width());
+    }
+
+    return dst;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Tile grid along one dimension for tiled processing
+struct TileRange
+{
+    PCType lower; // Output range of this tile
+    PCType upper;
+    PCType ext_lower; // Input range of this tile, extended by the halo
+    PCType ext_upper;
+};
+
+inline std::vector<TileRange> TileRanges(PCType size, PCType piece, PCType halo, PCType align)
+{
+    std::vector<TileRange> ranges;
+
+    if (piece <= 0 || piece >= size)
+    {
+        ranges.push_back(TileRange{ 0, size, 0, size });
+        return ranges;
+    }
+
+    piece = (piece + align - 1) / align * align;
+    halo = (halo + align - 1) / align * align;
+
+    for (PCType lower = 0; lower < size; lower += piece)
+    {
+        const PCType upper = Min(size, lower + piece);
+        ranges.push_back(TileRange{ lower, upper, Max(PCType(0), lower - halo), Min(size, upper + halo) });
+    }
+
+    return ranges;
+}
+
+
+// Apply _Func(dstTile, srcTile) to tiles of TILE_HP x TILE_WP in parallel, and stitch the results into dst
+// Each tile is extended by the halo (clipped to the plane), and only its inner part is copied to dst.
+// The tiles start at multiples of align, so that block-based filters see the same block grid as the whole plane.
+// For Frame of subsampled chroma, halo and align are scaled by the subsampling, so that they hold in the chroma planes,
+// and the tiles are cut at whole chroma samples.
+// Tiles spanning the whole width are views of src when the strides match, others are copied out of src.
+// The filter is applied to the whole plane when halo is negative or tiling is disabled.
+// The filter may be called concurrently, and shouldn't change the format of dstTile.
+// Filters index dst and src with the same stride, thus both are given the stride of a newly allocated plane:
+// src of another stride (a view or a copy of a view) is copied, and such a dst is written through a temporary.
+template < typename _St1, typename _Fn1 >
+_St1 &TileExecute(_St1 &dst, const _St1 &src, PCType halo, PCType align, _Fn1 &&_Func)
+{
+    if (!TileStrideDefault(src))
+    {
+        return TileExecute(dst, TileCompact(src), halo, align, std::forward<_Fn1>(_Func));
+    }
+
+    if (!TileStrideDefault(dst))
+    {
+        _St1 temp(src, false);
+        TileExecute(temp, src, halo, align, std::forward<_Fn1>(_Func));
+        dst = temp;
+        return dst;
+    }
+
+    // dst is written by the filter or all the tiles, thus its buffer is made unique beforehand,
+    // instead of by the first writer among the parallel tasks
+    dst.Detach();
+
+    if (halo < 0 || (TILE_HP <= 0 && TILE_WP <= 0))
+    {
+        _Func(dst, src);
+        return dst;
+    }
+
+    PCType sub_h, sub_w;
+    TileSubsampling(src, sub_h, sub_w);
+
+    const std::vector<TileRange> rows = TileRanges(src.Height(), TILE_HP, halo * sub_h, align * sub_h);
+    const std::vector<TileRange> cols = TileRanges(src.Width(), TILE_WP, halo * sub_w, align * sub_w);
+
+    if (rows.size() * cols.size() == 1)
+    {
+        _Func(dst, src);
+        return dst;
+    }
+
+    const PCType colCount = static_cast<PCType>(cols.size());
+    const PCType count = static_cast<PCType>(rows.size()) * colCount;
+
+    _Parallel_for(PCType(0), count, [&](PCType n)
+    {
+        const TileRange &r = rows[n / colCount];
+        const TileRange &c = cols[n % colCount];
+
+        const PCType height = r.ext_upper - r.ext_lower;
+        const PCType width = c.ext_upper - c.ext_lower;
+
+        _St1 dstTile = TileAlloc(dst, width, height);
+
+        if (width == src.Width() && dstTile.Stride() == src.Stride())
+        {
+            _Func(dstTile, src.View(r.ext_lower, 0, height, width));
+        }
+        else
+        {
+            _St1 srcTile = TileAlloc(src, width, height);
+            TileCopy(srcTile, 0, 0, src, r.ext_lower, c.ext_lower, height, width);
+            _Func(dstTile, srcTile);
+        }
+
+        TileCopy(dst, r.lower, c.lower, dstTile, r.lower - r.ext_lower, c.lower - c.ext_lower,
+            r.upper - r.lower, c.upper - c.lower);
+    });
+
+    return dst;
+}
+
+
+// Tiled processing with a reference, the reference tile is the source tile when they are the same object
+// The strides of src and ref are handled as the one of src in TileExecute() above.
+template < typename _St1, typename _Fn1 >
+_St1 &TileExecute(_St1 &dst, const _St1 &src, const _St1 &ref, PCType halo, PCType align, _Fn1 &&_Func)
+{
+    if (&src == &ref)
+    {
+        return TileExecute(dst, src, halo, align, [&](_St1 &dstTile, const _St1 &srcTile)
+        {
+            _Func(dstTile, srcTile, srcTile);
+        });
+    }
+
+    if (!TileStrideDefault(src) || !TileStrideDefault(ref))
+    {
+        return TileExecute(dst, TileStrideDefault(src) ? src : TileCompact(src),
+            TileStrideDefault(ref) ? ref : TileCompact(ref), halo, align, std::forward<_Fn1>(_Func));
+    }
+
+    if (!TileStrideDefault(dst))
+    {
+        _St1 temp(src, false);
+        TileExecute(temp, src, ref, halo, align, std::forward<_Fn1>(_Func));
+        dst = temp;
+        return dst;
+    }
+
+    // dst is written by the filter or all the tiles, thus its buffer is made unique beforehand,
+    // instead of by the first writer among the parallel tasks
+    dst.Detach();
+
+    if (halo < 0 || (TILE_HP <= 0 && TILE_WP <= 0))
+    {
+        _Func(dst, src, ref);
+        return dst;
+    }
+
+    PCType sub_h, sub_w;
+    TileSubsampling(src, sub_h, sub_w);
+
+    const std::vector<TileRange> rows = TileRanges(src.Height(), TILE_HP, halo * sub_h, align * sub_h);
+    const std::vector<TileRange> cols = TileRanges(src.Width(), TILE_WP, halo * sub_w, align * sub_w);
+
+    if (rows.size() * cols.size() == 1)
+    {
+        _Func(dst, src, ref);
+        return dst;
+    }
+
+    const PCType colCount = static_cast<PCType>(cols.size());
+    const PCType count = static_cast<PCType>(rows.size()) * colCount;
+
+    _Parallel_for(PCType(0), count, [&](PCType n)
+    {
+        const TileRange &r = rows[n / colCount];
+        const TileRange &c = cols[n % colCount];
+
+        const PCType height = r.ext_upper - r.ext_lower;
+        const PCType width = c.ext_upper - c.ext_lower;
+
+        _St1 dstTile = TileAlloc(dst, width, height);
+
+        if (width == src.Width() && dstTile.Stride() == src.Stride() && dstTile.Stride() == ref.Stride())
+        {
+            _Func(dstTile, src.View(r.ext_lower, 0, height, width), ref.View(r.ext_lower, 0, height, width));
+        }
+        else
+        {
+            _St1 srcTile = TileAlloc(src, width, height);
+            _St1 refTile = TileAlloc(ref, width, height);
+            TileCopy(srcTile, 0, 0, src, r.ext_lower, c.ext_lower, height, width);
+            TileCopy(refTile, 0, 0, ref, r.ext_lower, c.ext_lower, height, width);
+            _Func(dstTile, srcTile, refTile);
+        }
+
+        TileCopy(dst, r.lower, c.lower, dstTile, r.lower - r.ext_lower, c.lower - c.ext_lower,
+            r.upper - r.lower, c.upper - c.lower);
+    });
+
+    return dst;
+}
+
+
+#endif
@@ -14,10 +14,12 @@ const struct AGTM_Para
 } AGTM_Default;
 
 
-Frame &Adaptive_Global_Tone_Mapping(Frame &dst, const Frame &src);
-inline Frame Adaptive_Global_Tone_Mapping(const Frame &src)
+// The tone mapping runs on the storage type of the frame, instantiated for Frame, Frame16 and Frame8
+template < typename _Ty > FrameT<_Ty> &Adaptive_Global_Tone_Mapping(FrameT<_Ty> &dst, const FrameT<_Ty> &src);
+template < typename _Ty >
+FrameT<_Ty> Adaptive_Global_Tone_Mapping(const FrameT<_Ty> &src)
 {
-    Frame dst(src, false);
+    FrameT<_Ty> dst(src, false);
     return Adaptive_Global_Tone_Mapping(dst, src);
 }
 
@@ -35,13 +37,23 @@ protected:
         return Adaptive_Global_Tone_Mapping(src);
     }
 
+    virtual Frame16 process_Frame16(Frame16 src)
+    {
+        return Adaptive_Global_Tone_Mapping(src);
+    }
+
+    virtual Frame8 process_Frame8(Frame8 src)
+    {
+        return Adaptive_Global_Tone_Mapping(src);
+    }
+
 public:
     Adaptive_Global_Tone_Mapping_IO(std::string _Tag = ".AGTM")
         : _Mybase(std::move(_Tag)) {}
 };
 
 
-LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation(const Plane &src);
+template < typename _Ty > LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation(const PlaneT<_Ty> &src);
 
 
 #endif
@@ -1,5 +1,6 @@
 #include "BM3D.h"
 #include "Conversion.hpp"
+#include "Expression.hpp"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -14,6 +15,8 @@ BM3D_FilterData::BM3D_FilterData(bool wiener, double sigma, PCType GroupSize, PC
     const fftw::r2r_kind fkind = FFTW_REDFT10;
     const fftw::r2r_kind bkind = FFTW_REDFT01;
 
+    std::lock_guard<std::mutex> lock(PlannerMutex());
+
     FLType *temp = nullptr;
 
     for (PCType i = 1; i <= GroupSize; ++i)
@@ -73,6 +76,24 @@ BM3D_FilterData::BM3D_FilterData(bool wiener, double sigma, PCType GroupSize, PC
 }
 
 
+BM3D_FilterData::~BM3D_FilterData()
+{
+    std::lock_guard<std::mutex> lock(PlannerMutex());
+
+    fp.clear();
+    bp.clear();
+}
+
+
+// Not a function-local static, see THREAD_LOCAL in Thread_Pool.h
+static std::mutex FFTWPlannerMutex;
+
+std::mutex &BM3D_FilterData::PlannerMutex()
+{
+    return FFTWPlannerMutex;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Functions of class BM3D_Base
 
@@ -86,53 +107,32 @@ void BM3D_Base::Kernel(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref)
         return;
     }
 
-    Plane_FL ResNum(dst, true, 0);
-    Plane_FL ResDen(dst, true, 0);
+    Plane_FL ResNum(src, true, 0);
+    Plane_FL ResDen(src, true, 0);
 
     PCType height = src.Height();
     PCType width = src.Width();
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
+    Plane_FL *ResNumP[1] = { &ResNum };
+    Plane_FL *ResDenP[1] = { &ResDen };
+    const Plane_FL *srcP[1] = { &src };
+    const Plane_FL *refP[1] = { &ref };
+    const bool process[1] = { true };
 
-    for (PCType j = 0;; j += para.BlockStep)
+    // Get the filtered result through block matching, collaborative filtering and aggregation of matched blocks
+    if (para.parallel && GetThreadCount() > 1)
     {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
-        {
-            break;
-        }
-        else if (j > BlockPosBottom)
-        {
-            j = BlockPosBottom;
-        }
-
-        for (PCType i = 0;; i += para.BlockStep)
-        {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
-            {
-                break;
-            }
-            else if (i > BlockPosRight)
-            {
-                i = BlockPosRight;
-            }
-
-            PosPairCode matchCode = BlockMatching(ref, j, i);
-
-            // Get the filtered result through collaborative filtering and aggregation of matched blocks
-            CollaborativeFilter(0, ResNum, ResDen, src, ref, matchCode);
-        }
+        KernelLoop_PPL(1, process, ResNumP, ResDenP, srcP, refP);
+    }
+    else
+    {
+        KernelLoop(1, process, ResNumP, ResDenP, srcP, refP);
     }
 
     // The filtered blocks are sumed and averaged to form the final filtered image
     dst.ReSize(width, height);
 
-    _Transform(dst, ResNum, ResDen, [](FLType num, FLType den)
-    {
-        return num / den;
-    });
+    Evaluate(dst, ResNum / ResDen);
 }
 
 
@@ -160,79 +160,248 @@ void BM3D_Base::Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
     PCType height = srcY.Height();
     PCType width = srcY.Width();
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
+    Plane_FL *ResNumP[3] = { &ResNumY, &ResNumU, &ResNumV };
+    Plane_FL *ResDenP[3] = { &ResDenY, &ResDenU, &ResDenV };
+    const Plane_FL *srcP[3] = { &srcY, &srcU, &srcV };
+    const Plane_FL *refP[3] = { &refY, &refU, &refV };
+    const bool process[3] = { para.sigma[0] > 0, para.sigma[1] > 0, para.sigma[2] > 0 };
 
-    for (PCType j = 0;; j += para.BlockStep)
+    // Get the filtered result through block matching, collaborative filtering and aggregation of matched blocks
+    if (para.parallel && GetThreadCount() > 1)
     {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
-        {
-            break;
-        }
-        else if (j > BlockPosBottom)
-        {
-            j = BlockPosBottom;
-        }
+        KernelLoop_PPL(3, process, ResNumP, ResDenP, srcP, refP);
+    }
+    else
+    {
+        KernelLoop(3, process, ResNumP, ResDenP, srcP, refP);
+    }
+
+    // The filtered blocks are sumed and averaged to form the final filtered image
+    dstY.ReSize(width, height);
+    dstU.ReSize(width, height);
+    dstV.ReSize(width, height);
+
+    if (para.sigma[0] > 0) Evaluate(dstY, ResNumY / ResDenY);
+    if (para.sigma[1] > 0) Evaluate(dstU, ResNumU / ResDenU);
+    if (para.sigma[2] > 0) Evaluate(dstV, ResNumV / ResDenV);
+}
+
+
+// Positions of reference blocks along one dimension, the last block is aligned to the border
+std::vector<PCType> BM3D_Base::BlockPos(PCType size) const
+{
+    return BlockGridPos(size, para.BlockSize, para.BlockStep);
+}
+
+
+// Serial scan of reference blocks, block matching is always performed on the first plane
+void BM3D_Base::KernelLoop(int planes, const bool *process,
+    Plane_FL *const *ResNum, Plane_FL *const *ResDen,
+    const Plane_FL *const *src, const Plane_FL *const *ref) const
+{
+    const std::vector<PCType> rows = BlockPos(ref[0]->Height());
+    const std::vector<PCType> cols = BlockPos(ref[0]->Width());
+
+    const PCType rowCount = static_cast<PCType>(rows.size());
+    const PCType colCount = static_cast<PCType>(cols.size());
+
+    // With incremental block matching, a batch of rows is matched at a time
+    const auto matcher = CreateMatcher(*ref[0], rows, cols);
+    const PCType matchRows = matcher ? MatchRows() : 1;
+
+    // All the buffers are reused, no allocation happens in the loop once they're large enough
+    std::vector<PosPairCode> matchCodes(matcher ? matchRows * colCount : 0);
+    matcher_type::Buffer matcherBuffer;
+    MatchBuffer matchBuffer(para.BlockSize);
+    GroupResult result;
 
-        for (PCType i = 0;; i += para.BlockStep)
+    for (PCType r0 = 0; r0 < rowCount; r0 += matchRows)
+    {
+        const PCType r1 = Min(rowCount, r0 + matchRows);
+
+        if (matcher) matcher->Match(matchCodes.data(), colCount, matcherBuffer, r0, r1, 0, colCount);
+
+        for (PCType r = r0; r < r1; ++r)
         {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
+            for (PCType c = 0; c < colCount; ++c)
             {
-                break;
-            }
-            else if (i > BlockPosRight)
-            {
-                i = BlockPosRight;
-            }
+                const PosPairCode &matchCode = matcher ? matchCodes[(r - r0) * colCount + c]
+                    : BlockMatching(matchBuffer, *ref[0], rows[r], cols[c]);
 
-            PosPairCode matchCode = BlockMatching(refY, j, i);
+                for (int p = 0; p < planes; ++p)
+                {
+                    if (!process[p]) continue;
 
-            // Get the filtered result through collaborative filtering and aggregation of matched blocks
-            if (para.sigma[0] > 0) CollaborativeFilter(0, ResNumY, ResDenY, srcY, refY, matchCode);
-            if (para.sigma[1] > 0) CollaborativeFilter(1, ResNumU, ResDenU, srcU, refU, matchCode);
-            if (para.sigma[2] > 0) CollaborativeFilter(2, ResNumV, ResDenV, srcV, refV, matchCode);
+                    CollaborativeFilter(p, result, *src[p], *ref[p], matchCode);
+                    Aggregate(*ResNum[p], *ResDen[p], result);
+                }
+            }
         }
     }
+}
 
-    // The filtered blocks are sumed and averaged to form the final filtered image
-    dstY.ReSize(width, height);
-    dstU.ReSize(width, height);
-    dstV.ReSize(width, height);
 
-    if (para.sigma[0] > 0) _Transform(dstY, ResNumY, ResDenY, [](FLType num, FLType den)
-    {
-        return num / den;
-    });
+// Parallel scan of reference blocks, processed in batches of rows
+// Block matching and collaborative filtering of each reference block run concurrently,
+// then the filtered groups are aggregated by row stripes, each stripe owned by one task.
+// The groups are always added in the raster order of their reference blocks,
+// so every pixel accumulates in exactly the same order as the serial scan and the result is identical.
+void BM3D_Base::KernelLoop_PPL(int planes, const bool *process,
+    Plane_FL *const *ResNum, Plane_FL *const *ResDen,
+    const Plane_FL *const *src, const Plane_FL *const *ref) const
+{
+    const PCType height = ref[0]->Height();
+
+    const std::vector<PCType> rows = BlockPos(height);
+    const std::vector<PCType> cols = BlockPos(ref[0]->Width());
+
+    const PCType rowCount = static_cast<PCType>(rows.size());
+    const PCType colCount = static_cast<PCType>(cols.size());
 
-    if (para.sigma[1] > 0) _Transform(dstU, ResNumU, ResDenU, [](FLType num, FLType den)
+    if (rowCount <= 0 || colCount <= 0) return;
+
+    // The results are written by all the tasks, thus their buffers are made unique beforehand
+    for (int p = 0; p < planes; ++p)
     {
-        return num / den;
-    });
+        if (!process[p]) continue;
+
+        ResNum[p]->Detach();
+        ResDen[p]->Detach();
+    }
 
-    if (para.sigma[2] > 0) _Transform(dstV, ResNumV, ResDenV, [](FLType num, FLType den)
+    // Rows in a batch are chosen to give enough reference blocks to every thread,
+    // while the filtered groups of a batch are kept in memory until aggregated
+    const PCType threads = GetThreadCount();
+    const PCType batchRows = Max(PCType(1), (threads * 8 + colCount - 1) / colCount);
+
+    // With incremental block matching, several batches are matched at a time in column chunks,
+    // only the matched codes are kept for them
+    const auto matcher = CreateMatcher(*ref[0], rows, cols);
+    const PCType matchRows = matcher ? (MatchRows() + batchRows - 1) / batchRows * batchRows : batchRows;
+    const PCType chunkCols = Max(PCType(16), (colCount + threads * 4 - 1) / (threads * 4));
+    const PCType chunkCount = (colCount + chunkCols - 1) / chunkCols;
+
+    // All the buffers are reused, no allocation happens in the loop once they're large enough
+    std::vector<PosPairCode> matchCodes(matcher ? matchRows * colCount : 0);
+    std::vector<matcher_type::Buffer> matcherBuffers(matcher ? chunkCount : 0);
+    std::vector<MatchBuffer> matchBuffers(matcher ? 0 : batchRows * colCount, MatchBuffer(para.BlockSize));
+    std::vector<GroupResult> results(batchRows * colCount * planes);
+
+    for (PCType m0 = 0; m0 < rowCount; m0 += matchRows)
     {
-        return num / den;
-    });
+        const PCType m1 = Min(rowCount, m0 + matchRows);
+
+        if (matcher) _Parallel_for(PCType(0), chunkCount, [&](PCType k)
+        {
+            const PCType c0 = k * chunkCols;
+            const PCType c1 = Min(colCount, c0 + chunkCols);
+
+            matcher->Match(matchCodes.data() + c0, colCount, matcherBuffers[k], m0, m1, c0, c1);
+        });
+
+        for (PCType r0 = m0; r0 < m1; r0 += batchRows)
+        {
+            const PCType r1 = Min(m1, r0 + batchRows);
+            const PCType count = (r1 - r0) * colCount;
+
+            // Block matching and collaborative filtering
+            _Parallel_for(PCType(0), count, [&](PCType n)
+            {
+                const PCType r = r0 + n / colCount;
+                const PCType c = n % colCount;
+
+                const PosPairCode &matchCode = matcher ? matchCodes[(r - m0) * colCount + c]
+                    : BlockMatching(matchBuffers[n], *ref[0], rows[r], cols[c]);
+
+                for (int p = 0; p < planes; ++p)
+                {
+                    if (!process[p]) continue;
+
+                    CollaborativeFilter(p, results[n * planes + p], *src[p], *ref[p], matchCode);
+                }
+            });
+
+            // Aggregation in row stripes covering all the matched blocks of this batch
+            PCType lower = height;
+            PCType upper = 0;
+
+            for (PCType n = 0; n < count * planes; ++n)
+            {
+                for (const auto &pos : results[n].group.GetPosCode())
+                {
+                    lower = Min(lower, pos.y);
+                    upper = Max(upper, pos.y + para.BlockSize);
+                }
+            }
+
+            if (upper <= lower) continue;
+
+            const PCType stripe = Max(PCType(para.BlockSize), (upper - lower + threads - 1) / threads);
+            const PCType stripeCount = (upper - lower + stripe - 1) / stripe;
+
+            _Parallel_for(PCType(0), stripeCount, [&](PCType s)
+            {
+                const PCType slower = lower + s * stripe;
+                const PCType supper = Min(upper, slower + stripe);
+
+                for (PCType n = 0; n < count; ++n)
+                {
+                    for (int p = 0; p < planes; ++p)
+                    {
+                        if (!process[p]) continue;
+
+                        Aggregate(*ResNum[p], *ResDen[p], results[n * planes + p], slower, supper);
+                    }
+                }
+            });
+        }
+    }
 }
 
 
-BM3D_Base::PosPairCode BM3D_Base::BlockMatching(
+const BM3D_Base::PosPairCode &BM3D_Base::BlockMatching(MatchBuffer &buffer,
     const Plane_FL &ref, PCType j, PCType i) const
 {
+    PosPairCode &code = buffer.code;
+
     // Skip block matching if GroupSize is 1 or thMSE is not positive,
     // and take the reference block as the only element in the group
     if (para.GroupSize == 1 || para.thMSE <= 0)
     {
-        return PosPairCode(1, PosPair(KeyType(0), PosType(j, i)));
+        code.assign(1, PosPair(KeyType(0), PosType(j, i)));
+        return code;
     }
 
     // Get reference block from the reference plane
-    block_type refBlock(ref, para.BlockSize, para.BlockSize, PosType(j, i));
+    buffer.refBlock.From(ref, PosType(j, i));
 
     // Block matching
-    return refBlock.BlockMatchingMulti(ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+    buffer.refBlock.BlockMatchingMulti(code, ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+
+    return code;
+}
+
+
+// Incremental block matching pays off when the reference blocks overlap a lot, but it's only used on request,
+// since the distances may differ in the last bits and so may the output, returns nullptr for the direct matching
+std::unique_ptr<BM3D_Base::matcher_type> BM3D_Base::CreateMatcher(const Plane_FL &ref,
+    const std::vector<PCType> &rows, const std::vector<PCType> &cols) const
+{
+    if (para.GroupSize == 1 || para.thMSE <= 0 || para.BMalgorithm != 2)
+    {
+        return nullptr;
+    }
+
+    return std::unique_ptr<matcher_type>(new matcher_type(ref, para.BlockSize, para.BlockSize, rows, cols,
+        para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true));
+}
+
+
+// Rows of reference blocks matched together by the incremental block matching,
+// so that the pixel rows computed again by adjacent batches are at most half of the rows processed
+PCType BM3D_Base::MatchRows() const
+{
+    return (para.BlockSize + para.BlockStep - 1) / para.BlockStep * 2;
 }
 
 
@@ -336,8 +505,7 @@ bool BM3D_Basic::RGB2YUV(Plane_FL &srcY, Plane_FL &srcU, Plane_FL &srcV,
 }
 
 
-void BM3D_Basic::CollaborativeFilter(int plane,
-    Plane_FL &ResNum, Plane_FL &ResDen,
+void BM3D_Basic::CollaborativeFilter(int plane, GroupResult &result,
     const Plane_FL &src, const Plane_FL &ref,
     const PosPairCode &code) const
 {
@@ -349,7 +517,8 @@ void BM3D_Basic::CollaborativeFilter(int plane,
     }
 
     // Construct source group guided by matched pos code
-    BlockGroup<FLType, FLType> srcGroup(src, code, GroupSize, para.BlockSize, para.BlockSize);
+    group_type &srcGroup = result.group;
+    srcGroup.From(src, code, GroupSize, para.BlockSize, para.BlockSize);
 
     // Initialize retianed coefficients of hard threshold filtering
     int retainedCoefs = 0;
@@ -378,10 +547,10 @@ void BM3D_Basic::CollaborativeFilter(int plane,
     FLType denWeight = retainedCoefs < 1 ? 1 : FLType(1) / static_cast<FLType>(retainedCoefs);
     FLType numWeight = static_cast<FLType>(denWeight / f[plane].finalAMP[GroupSize - 1]);
 
-    // Store the weighted filtered group to the numerator part of the final estimation
-    // Store the weight to the denominator part of the final estimation
-    srcGroup.AddTo(ResNum, numWeight);
-    srcGroup.CountTo(ResDen, denWeight);
+    // The weighted filtered group is stored to the numerator part of the final estimation
+    // The weight is stored to the denominator part of the final estimation
+    result.numWeight = numWeight;
+    result.denWeight = denWeight;
 }
 
 
@@ -408,8 +577,7 @@ bool BM3D_Final::RGB2YUV(Plane_FL &srcY, Plane_FL &srcU, Plane_FL &srcV,
 }
 
 
-void BM3D_Final::CollaborativeFilter(int plane,
-    Plane_FL &ResNum, Plane_FL &ResDen,
+void BM3D_Final::CollaborativeFilter(int plane, GroupResult &result,
     const Plane_FL &src, const Plane_FL &ref,
     const PosPairCode &code) const
 {
@@ -421,8 +589,10 @@ void BM3D_Final::CollaborativeFilter(int plane,
     }
 
     // Construct source group and reference group guided by matched pos code
-    BlockGroup<FLType, FLType> srcGroup(src, code, GroupSize, para.BlockSize, para.BlockSize);
-    BlockGroup<FLType, FLType> refGroup(ref, code, GroupSize, para.BlockSize, para.BlockSize);
+    group_type &srcGroup = result.group;
+    group_type &refGroup = result.refGroup;
+    srcGroup.From(src, code, GroupSize, para.BlockSize, para.BlockSize);
+    refGroup.From(ref, code, GroupSize, para.BlockSize, para.BlockSize);
 
     // Initialize L2-norm of Wiener coefficients
     FLType L2Wiener = 0;
@@ -450,10 +620,10 @@ void BM3D_Final::CollaborativeFilter(int plane,
     FLType denWeight = L2Wiener <= 0 ? 1 : FLType(1) / L2Wiener;
     FLType numWeight = static_cast<FLType>(denWeight / f[plane].finalAMP[GroupSize - 1]);
 
-    // Store the weighted filtered group to the numerator part of the final estimation
-    // Store the weight to the denominator part of the final estimation
-    srcGroup.AddTo(ResNum, numWeight);
-    srcGroup.CountTo(ResDen, denWeight);
+    // The weighted filtered group is stored to the numerator part of the final estimation
+    // The weight is stored to the denominator part of the final estimation
+    result.numWeight = numWeight;
+    result.denWeight = denWeight;
 }
 
 
@@ -0,0 +1,196 @@
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include "Benchmark.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+
+const Benchmark_Para Benchmark_Default;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+size_t PeakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return static_cast<size_t>(counters.PeakWorkingSetSize);
+    }
+
+    return 0;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        return static_cast<size_t>(usage.ru_maxrss) * 1024; // in KB on Linux
+    }
+
+    return 0;
+#endif
+}
+
+
+Frame SyntheticFrame(PCType width, PCType height, unsigned int seed)
+{
+    Frame dst(0, PixelType::RGB, width, height, 16, false);
+
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> noise(0, 0.03);
+
+    for (Frame::PlaneCountType p = 0; p < dst.PlaneCount(); ++p)
+    {
+        Plane &plane = dst.P(p);
+
+        for (PCType j = 0; j < height; ++j)
+        {
+            PCType i = j * plane.Stride();
+
+            for (PCType x = 0; x < width; ++x, ++i)
+            {
+                // Smooth gradient, some texture and white noise
+                double value = 0.1 + 0.5 * x / width + 0.3 * j / height + 0.02 * p
+                    + 0.05 * sin(x * 0.05) * cos(j * 0.07) + noise(engine);
+
+                plane[i] = plane.GetD(static_cast<FLType>(Clip(value, 0.0, 1.0)));
+            }
+        }
+    }
+
+    return dst;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+Benchmark_Result Benchmark(FilterIO &filter, const Frame16 &src, const Benchmark_Para &para, std::string source)
+{
+    typedef std::chrono::steady_clock clock_type;
+
+    Benchmark_Result result;
+
+    result.source = std::move(source);
+    result.width = src.Width();
+    result.height = src.Height();
+    result.iterations = Max(1, para.iterations);
+
+    for (int l = 0; l < para.warmup; ++l)
+    {
+        filter.Process(src);
+    }
+
+    std::vector<double> times(result.iterations);
+    const Memory_Pool_Stats pool = GetMemoryPoolStats();
+
+    for (int l = 0; l < result.iterations; ++l)
+    {
+        const auto start = clock_type::now();
+        filter.Process(src);
+        times[l] = std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    result.poolHits = GetMemoryPoolStats().hits - pool.hits;
+    result.poolMisses = GetMemoryPoolStats().misses - pool.misses;
+
+    std::sort(times.begin(), times.end());
+
+    const size_t count = times.size();
+    double sum = 0;
+
+    for (auto t : times)
+    {
+        sum += t;
+    }
+
+    result.min = times[0];
+    result.median = count % 2 ? times[count / 2] : (times[count / 2 - 1] + times[count / 2]) / 2;
+    result.p95 = times[static_cast<size_t>(ceil(count * 0.95)) - 1];
+    result.mean = sum / count;
+    result.MPps = result.median > 0 ? static_cast<double>(src.PixelCount()) / result.median / 1e6 : 0;
+    result.peakMemory = PeakMemoryUsage();
+
+    return result;
+}
+
+
+static std::string JSONString(const std::string &str)
+{
+    std::string dst = "\"";
+
+    for (auto c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            dst += '\\';
+            dst += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            std::ostringstream code;
+            code << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+            dst += code.str();
+        }
+        else
+        {
+            dst += c;
+        }
+    }
+
+    return dst + "\"";
+}
+
+
+std::string BenchmarkJSON(const std::string &filter, const Benchmark_Para &para,
+    const std::vector<Benchmark_Result> &results)
+{
+    std::ostringstream os;
+    os.precision(9);
+
+    os << "{\n"
+        << "  \"filter\": " << JSONString(filter) << ",\n"
+        << "  \"threads\": " << GetThreadCount() << ",\n"
+        << "  \"warmup\": " << para.warmup << ",\n"
+        << "  \"iterations\": " << para.iterations << ",\n"
+        << "  \"results\": [";
+
+    for (size_t n = 0; n < results.size(); ++n)
+    {
+        const Benchmark_Result &r = results[n];
+
+        os << (n ? ",\n" : "\n")
+            << "    {\n"
+            << "      \"source\": " << JSONString(r.source) << ",\n"
+            << "      \"width\": " << r.width << ",\n"
+            << "      \"height\": " << r.height << ",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"min_s\": " << r.min << ",\n"
+            << "      \"median_s\": " << r.median << ",\n"
+            << "      \"p95_s\": " << r.p95 << ",\n"
+            << "      \"mean_s\": " << r.mean << ",\n"
+            << "      \"megapixels_per_s\": " << r.MPps << ",\n"
+            << "      \"peak_memory_bytes\": " << r.peakMemory << ",\n"
+            << "      \"pool_hits\": " << r.poolHits << ",\n"
+            << "      \"pool_misses\": " << r.poolMisses << "\n"
+            << "    }";
+    }
+
+    os << (results.size() ? "\n  ]\n" : "]\n") << "}\n";
+
+    return os.str();
+}
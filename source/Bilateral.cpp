@@ -1,7 +1,97 @@
 #include <cmath>
+#include <mutex>
 #include "Bilateral.h"
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Process-wide LUT cache of Bilateral2D_Data
+
+
+template < typename _Ty >
+class Bilateral2D_LUT_Cache
+{
+public:
+    typedef Bilateral2D_LUT_Cache<_Ty> _Myt;
+
+    static const size_t Capacity = 16;
+
+private:
+    struct Entry
+    {
+        double sigmaR;
+        int BPS;
+        double sigmaS;
+        int radius;
+        int levels;
+        std::shared_ptr<const _Ty> lut;
+        size_t used;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    size_t clock = 0;
+
+public:
+    // The table is generated under the lock, thus concurrent requests of the same key share a single generation
+    template < typename _Fn1 >
+    std::shared_ptr<const _Ty> Get(double sigmaR, int BPS, double sigmaS, int radius, int levels, _Fn1 &&generate)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto &e : entries)
+        {
+            if (e.sigmaR == sigmaR && e.BPS == BPS && e.sigmaS == sigmaS && e.radius == radius && e.levels == levels)
+            {
+                e.used = ++clock;
+                return e.lut;
+            }
+        }
+
+        std::shared_ptr<const _Ty> lut = std::make_shared<const _Ty>(generate());
+
+        if (entries.size() >= Capacity)
+        {
+            auto lru = entries.begin();
+            for (auto iter = entries.begin(); iter != entries.end(); ++iter)
+            {
+                if (iter->used < lru->used) lru = iter;
+            }
+            entries.erase(lru);
+        }
+
+        entries.push_back({ sigmaR, BPS, sigmaS, radius, levels, lut, ++clock });
+
+        return lut;
+    }
+};
+
+
+// Not function-local statics, see THREAD_LOCAL in Thread_Pool.h
+static Bilateral2D_LUT_Cache<LUT<FLType>> Spatial_LUT_Cache;
+static Bilateral2D_LUT_Cache<Bilateral2D_Range_LUT> Range_LUT_Cache;
+
+
+std::shared_ptr<const LUT<FLType>> Bilateral2D_Data::Spatial_LUT(double sigmaS, int radius)
+{
+    return Spatial_LUT_Cache.Get(0, 0, sigmaS, radius, 0, [&]()
+    {
+        return Gaussian_Function_Spatial_LUT_Generation(radius + 1, radius + 1, sigmaS);
+    });
+}
+
+std::shared_ptr<const Bilateral2D_Range_LUT> Bilateral2D_Data::Range_LUT(double sigmaR, int BPS, int levels)
+{
+    return Range_LUT_Cache.Get(sigmaR, BPS, 0, 0, levels, [&]()
+    {
+        return Bilateral2D_Range_LUT(sigmaR, BPS, levels);
+    });
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of Bilateral2D
+
+
 Plane &Bilateral2D(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane)
 {
     // Skip processing if either sigma is not positive
@@ -24,6 +114,12 @@ Plane &Bilateral2D(Plane &dst, const Plane &src, const Plane &ref, const Bilater
         else
             Bilateral2D_2(dst, src, d, plane);
         break;
+    case 4:
+        Bilateral2D_4(dst, src, ref, d, plane);
+        break;
+    case 5:
+        Bilateral2D_5(dst, src, ref, d, plane);
+        break;
     default:
         Bilateral2D_0(dst, src, ref, d, plane);
         break;
@@ -45,13 +141,16 @@ Plane &Bilateral2D_0(Plane &dst, const Plane &src, const Plane &ref, const Bilat
     FLType Weight, WeightSum;
     FLType Sum;
 
-    const LUT<FLType> &GS_LUT = d.GS_LUT[plane];
-    const LUT<FLType> &GR_LUT = d.GR_LUT[plane];
+    const LUT<FLType> &GS_LUT = *d.GS_LUT[plane];
+    const Bilateral2D_Range_LUT &GR_LUT = *d.GR_LUT[plane];
+
+    const int stride = src.Stride();
 
-    index0 = radiusy*src.Width();
+    index0 = radiusy*stride;
     memcpy(dst.data(), src.data(), index0 * sizeof(DType));
     for (j = radiusy; j < src.Height() - radiusy; ++j)
     {
+        index0 = j*stride;
         for (i = 0; i < radiusx; ++i, ++index0)
         {
             dst[index0] = src[index0];
@@ -62,10 +161,10 @@ Plane &Bilateral2D_0(Plane &dst, const Plane &src, const Plane &ref, const Bilat
             Sum = 0;
             for (y = -radiusy; y < yUpper; ++y)
             {
-                index1 = index0 + y*src.Width() - radiusx;
+                index1 = index0 + y*stride - radiusx;
                 for (x = -radiusx; x < xUpper; ++x, ++index1)
                 {
-                    Weight = Gaussian_Distribution2D_Spatial_LUT_Lookup(GS_LUT, xUpper, Abs(x), Abs(y)) * Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, ref[index0], ref[index1]);
+                    Weight = Gaussian_Distribution2D_Spatial_LUT_Lookup(GS_LUT, xUpper, Abs(x), Abs(y)) * GR_LUT(ref[index0], ref[index1]);
                     WeightSum += Weight;
                     Sum += src[index1] * Weight;
                 }
@@ -77,28 +176,29 @@ Plane &Bilateral2D_0(Plane &dst, const Plane &src, const Plane &ref, const Bilat
             dst[index0] = src[index0];
         }
     }
-    memcpy(dst.data() + index0, src.data() + index0, radiusy*src.Width()*sizeof(DType));
+    index0 = j*stride;
+    memcpy(dst.data() + index0, src.data() + index0, radiusy*stride*sizeof(DType));
 
     return dst;
 }
 
 
 // Implementation of O(1) cross/joint Bilateral filter algorithm from "Qingxiong Yang, Kar-Han Tan, Narendra Ahuja - Real-Time O(1) Bilateral Filtering"
+// The PBFICs are generated in ascending order, and each pixel is interpolated as soon as the 2 PBFICs bracketing it are ready,
+// thus only the previous and the current PBFIC are kept besides the buffers of the weights, instead of PBFICnum planes.
 Plane &Bilateral2D_1(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane)
 {
-    int i, j, upper;
     int k;
 
-    int height = ref.Height();
-    int width = ref.Width();
-    int stride = ref.Width();
-    int pcount = ref.PixelCount();
+    const PCType height = ref.Height();
+    const PCType width = ref.Width();
+    const PCType stride = ref.Stride();
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
 
     double sigmaS = d.sigmaS[plane];
-    double sigmaR = d.sigmaR[plane];
     int PBFICnum = d.PBFICnum[plane];
 
-    const LUT<FLType> &GR_LUT = d.GR_LUT[plane];
+    const Bilateral2D_Range_LUT &GR_LUT = *d.GR_LUT[plane];
 
     // Value range of Plane "ref"
     DType rLower, rUpper, rRange;
@@ -108,7 +208,7 @@ Plane &Bilateral2D_1(Plane &dst, const Plane &src, const Plane &ref, const Bilat
     rRange = rUpper - rLower;
 
     // Generate quantized PBFICs' parameters
-    DType * PBFICk = new DType[PBFICnum];
+    std::vector<DType> PBFICk(PBFICnum);
 
     for (k = 0; k < PBFICnum; ++k)
     {
@@ -118,57 +218,78 @@ Plane &Bilateral2D_1(Plane &dst, const Plane &src, const Plane &ref, const Bilat
     // Generate recursive Gaussian filter object
     RecursiveGaussian GFilter(sigmaS, true);
 
-    // Generate quantized PBFICs
-    Plane_FL * PBFIC = new Plane_FL[PBFICnum];
+    const DType *srcp = src.data();
+    const DType *refp = ref.data();
+    DType *dstp = dst.data();
+
     Plane_FL Wk(ref, false);
-    Plane_FL Jk(ref, false);
-    
+    Plane_FL PBFIC0(ref, false); // PBFIC k - 1
+    Plane_FL PBFIC1(ref, false); // PBFIC k
+
     for (k = 0; k < PBFICnum; ++k)
     {
-        PBFIC[k] = Plane_FL(ref, false);
+        FLType *Wkp = Wk.data();
+        FLType *Jkp = PBFIC1.data();
+        const DType Rk = PBFICk[k];
 
-        for (j = 0; j < height; ++j)
+        _Parallel_for(PCType(0), pNum, [&](PCType p)
         {
-            i = stride * j;
-            for (upper = i + width; i < upper; ++i)
+            const PCType lower = p * PPL_HP;
+            const PCType upper = Min(height, lower + PPL_HP);
+
+            for (PCType j = lower; j < upper; ++j)
             {
-                Wk[i] = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, PBFICk[k], ref[i]);
-                Jk[i] = Wk[i] * src[i];
+                for (PCType i = stride * j, end = i + width; i < end; ++i)
+                {
+                    Wkp[i] = GR_LUT(Rk, refp[i]);
+                    Jkp[i] = Wkp[i] * srcp[i];
+                }
             }
-        }
+        });
 
         GFilter(Wk, Wk);
-        GFilter(Jk, Jk);
+        GFilter(PBFIC1, PBFIC1);
 
-        for (j = 0; j < height; ++j)
-        {
-            i = stride * j;
-            for (upper = i + width; i < upper; ++i)
-            {
-                PBFIC[k][i] = Wk[i] == 0 ? 0 : Jk[i] / Wk[i];
-            }
-        }
-    }
+        Wkp = Wk.data();
+        Jkp = PBFIC1.data();
+        const FLType *P0p = PBFIC0.data();
+        const int interval = k - 1;
 
-    // Generate filtered result from PBFICs using linear interpolation
-    for (j = 0; j < height; ++j)
-    {
-        i = stride * j;
-        for (upper = i + width; i < upper; ++i)
+        _Parallel_for(PCType(0), pNum, [&](PCType p)
         {
-            for (k = 0; k < PBFICnum - 2; ++k)
+            const PCType lower = p * PPL_HP;
+            const PCType upper = Min(height, lower + PPL_HP);
+
+            for (PCType j = lower; j < upper; ++j)
             {
-                if (ref[i] < PBFICk[k + 1] && ref[i] >= PBFICk[k]) break;
+                for (PCType i = stride * j, end = i + width; i < end; ++i)
+                {
+                    Jkp[i] = Wkp[i] == 0 ? 0 : Jkp[i] / Wkp[i];
+                }
+
+                // Generate filtered result of the pixels between PBFIC k - 1 and PBFIC k using linear interpolation
+                if (interval < 0) continue;
+
+                // PBFICk is ascending, thus each pixel is in one interval, and the last one also takes the values out of range
+                const DType R0 = PBFICk[interval];
+                const DType R1 = PBFICk[interval + 1];
+                const bool last = interval == PBFICnum - 2;
+
+                for (PCType i = stride * j, end = i + width; i < end; ++i)
+                {
+                    const DType r = refp[i];
+
+                    if (last ? r >= R0 || r < PBFICk[0] : r >= R0 && r < R1)
+                    {
+                        dstp[i] = dst.Quantize(((R1 - r)*P0p[i] + (r - R0)*Jkp[i]) / (R1 - R0));
+                    }
+                }
             }
+        });
 
-            dst[i] = dst.Quantize(((PBFICk[k + 1] - ref[i])*PBFIC[k][i] + (ref[i] - PBFICk[k])*PBFIC[k + 1][i]) / (PBFICk[k + 1] - PBFICk[k]));
-        }
+        std::swap(PBFIC0, PBFIC1);
     }
 
-    // Clear and output
-    delete[] PBFIC;
-    delete[] PBFICk;
-
     return dst;
 }
 
@@ -222,7 +343,7 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilat
 
     int height = src.Height();
     int width = src.Width();
-    int stride = src.Width();
+    int stride = src.Stride();
     int bufheight = src.Height() + radiusy * 2;
     int bufwidth = src.Width() + radiusx * 2;
     int bufstride = src.Width() + radiusx * 2;
@@ -231,8 +352,8 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilat
     const DType * refp = ref.data();
     DType * dstp = dst.data();
 
-    const LUT<FLType> &GS_LUT = d.GS_LUT[plane];
-    const LUT<FLType> &GR_LUT = d.GR_LUT[plane];
+    const LUT<FLType> &GS_LUT = *d.GS_LUT[plane];
+    const Bilateral2D_Range_LUT &GR_LUT = *d.GR_LUT[plane];
 
     // Allocate buffs
     DType *srcbuff = new DType[bufstride * bufheight];
@@ -267,10 +388,10 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilat
                 for (x = 1; x < xUpper; x += samplestep)
                 {
                     SWei = Gaussian_Distribution2D_Spatial_LUT_Lookup(GS_LUT, xUpper, x, y);
-                    RWei1 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, refp[i], refbuffp2[+y*bufstride + x]);
-                    RWei2 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, refp[i], refbuffp2[+y*bufstride - x]);
-                    RWei3 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, refp[i], refbuffp2[-y*bufstride - x]);
-                    RWei4 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, refp[i], refbuffp2[-y*bufstride + x]);
+                    RWei1 = GR_LUT(refp[i], refbuffp2[+y*bufstride + x]);
+                    RWei2 = GR_LUT(refp[i], refbuffp2[+y*bufstride - x]);
+                    RWei3 = GR_LUT(refp[i], refbuffp2[-y*bufstride - x]);
+                    RWei4 = GR_LUT(refp[i], refbuffp2[-y*bufstride + x]);
 
                     WeightSum += SWei * (RWei1 + RWei2 + RWei3 + RWei4);
                     Sum += SWei * (
@@ -306,7 +427,7 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, in
 
     int height = src.Height();
     int width = src.Width();
-    int stride = src.Width();
+    int stride = src.Stride();
     int bufheight = src.Height() + radiusy * 2;
     int bufwidth = src.Width() + radiusx * 2;
     int bufstride = src.Width() + radiusx * 2;
@@ -314,8 +435,8 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, in
     const DType * srcp = src.data();
     DType * dstp = dst.data();
 
-    const LUT<FLType> &GS_LUT = d.GS_LUT[plane];
-    const LUT<FLType> &GR_LUT = d.GR_LUT[plane];
+    const LUT<FLType> &GS_LUT = *d.GS_LUT[plane];
+    const Bilateral2D_Range_LUT &GR_LUT = *d.GR_LUT[plane];
 
     // Allocate buffs
     DType *srcbuff = new DType[bufstride * bufheight];
@@ -346,10 +467,10 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, in
                 for (x = 1; x < xUpper; x += samplestep)
                 {
                     SWei = Gaussian_Distribution2D_Spatial_LUT_Lookup(GS_LUT, xUpper, x, y);
-                    RWei1 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, srcp[i], srcbuffp2[+y*bufstride + x]);
-                    RWei2 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, srcp[i], srcbuffp2[+y*bufstride - x]);
-                    RWei3 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, srcp[i], srcbuffp2[-y*bufstride - x]);
-                    RWei4 = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, srcp[i], srcbuffp2[-y*bufstride + x]);
+                    RWei1 = GR_LUT(srcp[i], srcbuffp2[+y*bufstride + x]);
+                    RWei2 = GR_LUT(srcp[i], srcbuffp2[+y*bufstride - x]);
+                    RWei3 = GR_LUT(srcp[i], srcbuffp2[-y*bufstride - x]);
+                    RWei4 = GR_LUT(srcp[i], srcbuffp2[-y*bufstride + x]);
 
                     WeightSum += SWei * (RWei1 + RWei2 + RWei3 + RWei4);
                     Sum += SWei * (
@@ -369,3 +490,622 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, in
 
     return dst;
 }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Blur the elements of a line of the bilateral grid by [1 4 6 4 1] / 16, each element is a vector of vec values
+// The grid is zero outside, line is a buffer of (count + 4) * vec values
+static void Bilateral2D_4_Blur(FLType *data, PCType count, PCType step, PCType vec, FLType *line)
+{
+    memset(line, 0, sizeof(FLType) * vec * 2);
+    memset(line + (count + 2) * vec, 0, sizeof(FLType) * vec * 2);
+
+    for (PCType n = 0; n < count; ++n)
+    {
+        memcpy(line + (n + 2) * vec, data + n * step, sizeof(FLType) * vec);
+    }
+
+    for (PCType n = 0; n < count; ++n)
+    {
+        const FLType *l = line + n * vec;
+        FLType *p = data + n * step;
+
+        for (PCType v = 0; v < vec; ++v)
+        {
+            p[v] = (l[v] + l[v + vec * 4] + (l[v + vec] + l[v + vec * 3]) * 4 + l[v + vec * 2] * 6) * FLType(1.0 / 16);
+        }
+    }
+}
+
+
+// Implementation of cross/joint Bilateral filter with the bilateral grid from "Jiawen Chen, Sylvain Paris, Fredo Durand - Real-time Edge-Aware Image Processing with the Bilateral Grid"
+// The pixels are splatted linearly into the 3D grid of (x, y, ref) downsampled by gridS and gridR, the grid is blurred along each axis,
+// and the result is sliced by trilinear interpolation, thus the cost per pixel is about constant for large sigmaS and sigmaR.
+Plane &Bilateral2D_4(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane)
+{
+    const PCType pad = 2;
+
+    const PCType height = ref.Height();
+    const PCType width = ref.Width();
+    const PCType stride = ref.Stride();
+    const PCType sstride = src.Stride();
+    const PCType dstride = dst.Stride();
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    const DType rLower = ref.Floor();
+    const DType rUpper = ref.Ceil();
+
+    const FLType ss = static_cast<FLType>(d.gridS[plane]);
+    const FLType sr = static_cast<FLType>(d.gridR[plane] * ((1 << ref.BitDepth()) - 1));
+
+    // The size of the grid is checked in floating point first, since tiny sigmas would overflow PCType,
+    // within the limit the indexes of the cells fit in PCType
+    const double cw = std::floor((width - 1) / ss) + 1 + pad * 2;
+    const double ch = std::floor((height - 1) / ss) + 1 + pad * 2;
+    const double cd = std::floor((rUpper - rLower) / sr) + 1 + pad * 2;
+
+    if (cw * ch * cd > static_cast<double>(GridCellLimit))
+    {
+        return Bilateral2D_1(dst, src, ref, d, plane);
+    }
+
+    // Each cell holds the sum of weights and the weighted sum of src, the range axis is the innermost
+    const PCType gw = static_cast<PCType>(cw);
+    const PCType gh = static_cast<PCType>(ch);
+    const PCType gd = static_cast<PCType>(cd);
+    const PCType xstep = gd * 2;
+    const PCType ystep = gw * xstep;
+
+    std::vector<FLType> grid(static_cast<size_t>(gh) * ystep, 0);
+    FLType *gridp = grid.data();
+
+    // Grid position of each column
+    std::vector<PCType> gx(width);
+    std::vector<FLType> wx(width);
+
+    for (PCType i = 0; i < width; ++i)
+    {
+        const FLType fx = i / ss;
+        gx[i] = static_cast<PCType>(fx);
+        wx[i] = fx - gx[i];
+        gx[i] += pad;
+    }
+
+    const DType *srcp = src.data();
+    const DType *refp = ref.data();
+    DType *dstp = dst.data();
+
+    // Splat, each row of the grid gathers the pixel rows next to it, thus the rows of the grid are written in parallel
+    _Parallel_for(PCType(0), gh, [&](PCType y)
+    {
+        FLType *row = gridp + y * ystep;
+        const PCType lower = Max(PCType(0), static_cast<PCType>((y - pad - 1) * ss));
+        const PCType upper = Min(height, static_cast<PCType>((y - pad + 1) * ss) + 2);
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            const FLType fy = j / ss;
+            const PCType iy = static_cast<PCType>(fy) + pad;
+            const FLType wy = iy == y ? 1 - (fy - (iy - pad)) : iy + 1 == y ? fy - (iy - pad) : 0;
+
+            if (wy <= 0) continue;
+
+            for (PCType i = 0; i < width; ++i)
+            {
+                const FLType fz = (Clip(refp[stride * j + i], rLower, rUpper) - rLower) / sr;
+                const PCType iz = static_cast<PCType>(fz);
+                const FLType wz = fz - iz;
+                const FLType w1 = wy * wx[i];
+                const FLType w0 = wy - w1;
+                const FLType v = static_cast<FLType>(srcp[sstride * j + i]);
+
+                FLType *c0 = row + gx[i] * xstep + (iz + pad) * 2;
+                FLType *c1 = c0 + xstep;
+
+                c0[0] += w0 * (1 - wz); c0[1] += w0 * (1 - wz) * v;
+                c0[2] += w0 * wz; c0[3] += w0 * wz * v;
+                c1[0] += w1 * (1 - wz); c1[1] += w1 * (1 - wz) * v;
+                c1[2] += w1 * wz; c1[3] += w1 * wz * v;
+            }
+        }
+    });
+
+    // Blur along the range and the x axes for each row, then along the y axis for each column
+    _Parallel_for(PCType(0), gh, [&](PCType y)
+    {
+        std::vector<FLType> line((Max(gw, gd) + 4) * xstep);
+        FLType *row = gridp + y * ystep;
+
+        for (PCType x = 0; x < gw; ++x)
+        {
+            Bilateral2D_4_Blur(row + x * xstep, gd, 2, 2, line.data());
+        }
+
+        Bilateral2D_4_Blur(row, gw, xstep, xstep, line.data());
+    });
+
+    _Parallel_for(PCType(0), gw, [&](PCType x)
+    {
+        std::vector<FLType> line((gh + 4) * xstep);
+
+        Bilateral2D_4_Blur(gridp + x * xstep, gh, ystep, xstep, line.data());
+    });
+
+    // Slice
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            const FLType fy = j / ss;
+            const PCType iy = static_cast<PCType>(fy);
+            const FLType wy = fy - iy;
+            const FLType *row0 = gridp + (iy + pad) * ystep;
+            const FLType *row1 = row0 + ystep;
+
+            for (PCType i = 0; i < width; ++i)
+            {
+                const FLType fz = (Clip(refp[stride * j + i], rLower, rUpper) - rLower) / sr;
+                const PCType iz = static_cast<PCType>(fz);
+                const FLType wz = fz - iz;
+                const PCType offset = gx[i] * xstep + (iz + pad) * 2;
+                const FLType w[4] = { (1 - wy) * (1 - wx[i]), (1 - wy) * wx[i], wy * (1 - wx[i]), wy * wx[i] };
+                const FLType *c[4] = { row0 + offset, row0 + offset + xstep, row1 + offset, row1 + offset + xstep };
+
+                FLType WeightSum = 0;
+                FLType Sum = 0;
+
+                for (int n = 0; n < 4; ++n)
+                {
+                    WeightSum += w[n] * (c[n][0] + (c[n][2] - c[n][0]) * wz);
+                    Sum += w[n] * (c[n][1] + (c[n][3] - c[n][1]) * wz);
+                }
+
+                dstp[dstride * j + i] = WeightSum > 0 ? dst.Quantize(Sum / WeightSum) : srcp[sstride * j + i];
+            }
+        }
+    });
+
+    return dst;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Permutohedral lattice from "Andrew Adams, Jongmin Baek, Myers Abraham Davis - Fast High-Dimensional Filtering Using the Permutohedral Lattice"
+// The values are splatted to the vertices of the enclosing simplex of each position scaled by the inverse standard deviations,
+// blurred by [1 2 1] / 4 along each of the d + 1 lattice directions, and sliced with the same barycentric weights.
+// The lattice points are kept in a hash table, thus the memory is proportional to the occupied points rather than the volume.
+// Splat is not thread-safe, while Slice can be called in parallel.
+class PermutohedralLattice
+{
+public:
+    typedef PermutohedralLattice _Myt;
+
+    static const int MaxDim = 8;
+
+protected:
+    int d; // dimensions of the positions
+    int vd; // dimensions of the values
+
+    FLType scale[MaxDim];
+    int canonical[(MaxDim + 1) * (MaxDim + 1)];
+
+    std::vector<sint32> keys; // d coordinates of each lattice point
+    std::vector<FLType> values; // vd values of each lattice point
+    std::vector<PCType> table; // open addressing hash table of the lattice points, -1 for empty
+
+public:
+    PermutohedralLattice(int _d, int _vd)
+        : d(_d), vd(_vd), table(1 << 16, -1)
+    {
+        const FLType inv_std_dev = static_cast<FLType>(sqrt(2.0 / 3.0) * (d + 1));
+
+        for (int i = 0; i < d; ++i)
+        {
+            scale[i] = static_cast<FLType>(1 / sqrt(static_cast<double>((i + 1) * (i + 2)))) * inv_std_dev;
+        }
+
+        for (int i = 0; i <= d; ++i)
+        {
+            for (int j = 0; j <= d - i; ++j) canonical[i * (d + 1) + j] = i;
+            for (int j = d - i + 1; j <= d; ++j) canonical[i * (d + 1) + j] = i - (d + 1);
+        }
+    }
+
+    void Splat(const FLType *position, const FLType *value)
+    {
+        sint32 key[(MaxDim + 1) * MaxDim];
+        FLType barycentric[MaxDim + 2];
+
+        Simplex(key, barycentric, position);
+
+        for (int r = 0; r <= d; ++r)
+        {
+            const PCType n = Insert(key + r * d);
+            FLType *v = values.data() + n * vd;
+
+            for (int k = 0; k < vd; ++k)
+            {
+                v[k] += barycentric[r] * value[k];
+            }
+        }
+    }
+
+    void Blur()
+    {
+        const PCType count = static_cast<PCType>(values.size() / vd);
+        const PCType pieces = (count + 4095) / 4096;
+        std::vector<FLType> next(values.size());
+
+        for (int j = 0; j <= d; ++j)
+        {
+            _Parallel_for(PCType(0), pieces, [&](PCType p)
+            {
+                sint32 n1[MaxDim], n2[MaxDim];
+                const PCType upper = Min(count, (p + 1) * 4096);
+
+                for (PCType i = p * 4096; i < upper; ++i)
+                {
+                    const sint32 *key = keys.data() + i * d;
+
+                    for (int k = 0; k < d; ++k)
+                    {
+                        n1[k] = key[k] + 1;
+                        n2[k] = key[k] - 1;
+                    }
+
+                    if (j < d)
+                    {
+                        n1[j] = key[j] - d;
+                        n2[j] = key[j] + d;
+                    }
+
+                    const PCType i1 = Find(n1);
+                    const PCType i2 = Find(n2);
+                    const FLType *v0 = values.data() + i * vd;
+                    FLType *v = next.data() + i * vd;
+
+                    for (int k = 0; k < vd; ++k)
+                    {
+                        v[k] = v0[k] * FLType(0.5)
+                            + ((i1 < 0 ? 0 : values[i1 * vd + k]) + (i2 < 0 ? 0 : values[i2 * vd + k])) * FLType(0.25);
+                    }
+                }
+            });
+
+            values.swap(next);
+        }
+    }
+
+    void Slice(FLType *value, const FLType *position) const
+    {
+        sint32 key[(MaxDim + 1) * MaxDim];
+        FLType barycentric[MaxDim + 2];
+
+        Simplex(key, barycentric, position);
+
+        for (int k = 0; k < vd; ++k)
+        {
+            value[k] = 0;
+        }
+
+        for (int r = 0; r <= d; ++r)
+        {
+            const PCType n = Find(key + r * d);
+
+            if (n < 0) continue;
+
+            for (int k = 0; k < vd; ++k)
+            {
+                value[k] += barycentric[r] * values[n * vd + k];
+            }
+        }
+    }
+
+protected:
+    // Keys of the d + 1 vertices of the simplex enclosing the position and the barycentric weights of them
+    void Simplex(sint32 *key, FLType *barycentric, const FLType *position) const
+    {
+        FLType elevated[MaxDim + 1];
+        sint32 greedy[MaxDim + 1];
+        int rank[MaxDim + 1];
+
+        // Elevate the position onto the hyperplane of the lattice
+        FLType sm = 0;
+
+        for (int i = d; i > 0; --i)
+        {
+            const FLType cf = position[i - 1] * scale[i - 1];
+            elevated[i] = sm - i * cf;
+            sm += cf;
+        }
+
+        elevated[0] = sm;
+
+        // Find the closest 0-colored lattice point
+        const FLType down_factor = FLType(1) / (d + 1);
+        sint32 sum = 0;
+
+        for (int i = 0; i <= d; ++i)
+        {
+            const FLType v = elevated[i] * down_factor;
+            const sint32 up = static_cast<sint32>(std::ceil(v)) * (d + 1);
+            const sint32 down = static_cast<sint32>(std::floor(v)) * (d + 1);
+
+            greedy[i] = up - elevated[i] < elevated[i] - down ? up : down;
+            sum += greedy[i];
+        }
+
+        sum /= d + 1;
+
+        // Rank the differential to find the permutation of the simplex
+        for (int i = 0; i <= d; ++i)
+        {
+            rank[i] = 0;
+        }
+
+        for (int i = 0; i < d; ++i)
+        {
+            for (int j = i + 1; j <= d; ++j)
+            {
+                if (elevated[i] - greedy[i] < elevated[j] - greedy[j]) ++rank[i];
+                else ++rank[j];
+            }
+        }
+
+        // Wrap the point back onto the hyperplane if it's off
+        if (sum > 0)
+        {
+            for (int i = 0; i <= d; ++i)
+            {
+                if (rank[i] >= d + 1 - sum)
+                {
+                    greedy[i] -= d + 1;
+                    rank[i] += sum - (d + 1);
+                }
+                else rank[i] += sum;
+            }
+        }
+        else if (sum < 0)
+        {
+            for (int i = 0; i <= d; ++i)
+            {
+                if (rank[i] < -sum)
+                {
+                    greedy[i] += d + 1;
+                    rank[i] += (d + 1) + sum;
+                }
+                else rank[i] += sum;
+            }
+        }
+
+        // Barycentric coordinates
+        for (int i = 0; i <= d + 1; ++i)
+        {
+            barycentric[i] = 0;
+        }
+
+        for (int i = 0; i <= d; ++i)
+        {
+            const FLType v = (elevated[i] - greedy[i]) * down_factor;
+            barycentric[d - rank[i]] += v;
+            barycentric[d + 1 - rank[i]] -= v;
+        }
+
+        barycentric[0] += 1 + barycentric[d + 1];
+
+        for (int r = 0; r <= d; ++r)
+        {
+            for (int i = 0; i < d; ++i)
+            {
+                key[r * d + i] = greedy[i] + canonical[r * (d + 1) + rank[i]];
+            }
+        }
+    }
+
+    size_t Hash(const sint32 *key) const
+    {
+        size_t k = 0;
+
+        for (int i = 0; i < d; ++i)
+        {
+            k += key[i];
+            k *= 2531011;
+        }
+
+        return k;
+    }
+
+    PCType Find(const sint32 *key) const
+    {
+        const size_t mask = table.size() - 1;
+
+        for (size_t h = Hash(key) & mask;; h = (h + 1) & mask)
+        {
+            const PCType n = table[h];
+
+            if (n < 0 || memcmp(keys.data() + n * d, key, sizeof(sint32) * d) == 0)
+            {
+                return n;
+            }
+        }
+    }
+
+    PCType Insert(const sint32 *key)
+    {
+        const PCType count = static_cast<PCType>(values.size() / vd);
+
+        // Keep the load factor below 0.5
+        if (static_cast<size_t>(count) * 2 >= table.size())
+        {
+            table.assign(table.size() * 2, -1);
+
+            for (PCType n = 0; n < count; ++n)
+            {
+                size_t h = Hash(keys.data() + n * d) & (table.size() - 1);
+                while (table[h] >= 0) h = (h + 1) & (table.size() - 1);
+                table[h] = n;
+            }
+        }
+
+        const size_t mask = table.size() - 1;
+        size_t h = Hash(key) & mask;
+
+        for (; table[h] >= 0; h = (h + 1) & mask)
+        {
+            if (memcmp(keys.data() + table[h] * d, key, sizeof(sint32) * d) == 0)
+            {
+                return table[h];
+            }
+        }
+
+        table[h] = count;
+        keys.insert(keys.end(), key, key + d);
+        values.resize(values.size() + vd, 0);
+
+        return count;
+    }
+};
+
+
+// Bilateral filter of the planes in src guided by the planes in ref with the permutohedral lattice,
+// the positions are (x, y) / sigmaS and the values of ref normalized by sigmaR of each plane
+static void Bilateral2D_5_Lattice(const std::vector<Plane *> &dst, const std::vector<const Plane *> &src,
+    const std::vector<const Plane *> &ref, double sigmaS, const std::vector<double> &sigmaR)
+{
+    const int d = static_cast<int>(ref.size()) + 2;
+    const int vd = static_cast<int>(src.size()) + 1;
+
+    const PCType height = ref[0]->Height();
+    const PCType width = ref[0]->Width();
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    std::vector<FLType> rScale(ref.size());
+
+    for (size_t p = 0; p < ref.size(); ++p)
+    {
+        rScale[p] = static_cast<FLType>(1 / (sigmaR[p] * ((1 << ref[p]->BitDepth()) - 1)));
+    }
+
+    const FLType sScale = static_cast<FLType>(1 / sigmaS);
+
+    auto position = [&](FLType *pos, PCType j, PCType i)
+    {
+        pos[0] = i * sScale;
+        pos[1] = j * sScale;
+
+        for (size_t p = 0; p < ref.size(); ++p)
+        {
+            pos[p + 2] = (*ref[p])(j, i) * rScale[p];
+        }
+    };
+
+    PermutohedralLattice lattice(d, vd);
+    FLType pos[PermutohedralLattice::MaxDim];
+    FLType value[PermutohedralLattice::MaxDim + 1];
+
+    for (PCType j = 0; j < height; ++j)
+    {
+        for (PCType i = 0; i < width; ++i)
+        {
+            position(pos, j, i);
+
+            for (size_t p = 0; p < src.size(); ++p)
+            {
+                value[p] = static_cast<FLType>((*src[p])(j, i));
+            }
+
+            value[vd - 1] = 1;
+            lattice.Splat(pos, value);
+        }
+    }
+
+    lattice.Blur();
+
+    std::vector<DType *> dstp(dst.size());
+
+    for (size_t p = 0; p < dst.size(); ++p)
+    {
+        dstp[p] = dst[p]->data();
+    }
+
+    _Parallel_for(PCType(0), pNum, [&](PCType n)
+    {
+        const PCType lower = n * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+        FLType pos[PermutohedralLattice::MaxDim];
+        FLType value[PermutohedralLattice::MaxDim + 1];
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            for (PCType i = 0; i < width; ++i)
+            {
+                position(pos, j, i);
+                lattice.Slice(value, pos);
+
+                for (size_t p = 0; p < dst.size(); ++p)
+                {
+                    dstp[p][dst[p]->Stride() * j + i] = value[vd - 1] > 0 ? dst[p]->Quantize(value[p] / value[vd - 1]) : (*src[p])(j, i);
+                }
+            }
+        }
+    });
+}
+
+
+// Implementation of cross/joint Bilateral filter with the permutohedral lattice of (x, y, ref)
+Plane &Bilateral2D_5(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane)
+{
+    Bilateral2D_5_Lattice({ &dst }, { &src }, { &ref }, d.sigmaS[plane], { d.sigmaR[plane] });
+
+    return dst;
+}
+
+
+// Implementation of cross/joint Bilateral filter with the permutohedral lattice of (x, y) and all the planes of ref,
+// thus the edges of any plane of the guidance are preserved in all the planes
+Frame &Bilateral2D_5(Frame &dst, const Frame &src, const Frame &ref, const Bilateral2D_Data &d)
+{
+    std::vector<Plane *> dsts;
+    std::vector<const Plane *> srcs, refs;
+
+    for (Frame::PlaneCountType i = 0; i < src.PlaneCount(); i++)
+    {
+        dsts.push_back(&dst.P(i));
+        srcs.push_back(&src.P(i));
+        refs.push_back(&ref.P(i));
+    }
+
+    Bilateral2D_5_Lattice(dsts, srcs, refs, d.sigmaS[0], d.sigmaR);
+
+    return dst;
+}
+
+
+bool Bilateral2D_Color(const Frame &src, const Frame &ref, const Bilateral2D_Data &d)
+{
+    const Frame::PlaneCountType count = src.PlaneCount();
+
+    if (count < 2 || ref.PlaneCount() != count || count + 2 > PermutohedralLattice::MaxDim)
+    {
+        return false;
+    }
+
+    for (Frame::PlaneCountType i = 0; i < count; i++)
+    {
+        if (!d.process[i] || d.algorithm[i] != 5 || d.sigmaS[i] != d.sigmaS[0]
+            || src.P(i).Width() != src.P(0).Width() || src.P(i).Height() != src.P(0).Height()
+            || ref.P(i).Width() != src.P(0).Width() || ref.P(i).Height() != src.P(0).Height())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,750 @@
+#include <vector>
+#include "Block_SIMD.h"
+#include "Memory_Pool.h"
+
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86_
+#endif
+
+#ifdef SIMD_X86_
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET(isa)
+#else
+// Keep separate multiply and add as the scalar loop does, otherwise the distances wouldn't be bit-exact
+#pragma GCC optimize ("fp-contract=off")
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// AVX-512 intrinsics are declared since VS2017 (v141)
+#if !defined(_MSC_VER) || _MSC_VER >= 1910
+#define SIMD_AVX512_
+#endif
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+static SIMD_Level DetectSIMDLevel()
+{
+#if defined(SIMD_X86_) && defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    const int ids = info[0];
+
+    __cpuid(info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    const bool ymm = (xcr0 & 0x06) == 0x06;
+    const bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+    bool avx2 = false;
+    bool avx512 = false;
+
+    if (ids >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = ymm && (info[1] & (1 << 5)) != 0;
+        avx512 = zmm && (info[1] & (1 << 16)) != 0;
+    }
+
+#ifdef SIMD_AVX512_
+    if (avx512) return SIMD_Level::AVX512;
+#endif
+    if (avx2) return SIMD_Level::AVX2;
+    if (sse2) return SIMD_Level::SSE2;
+#elif defined(SIMD_X86_)
+    __builtin_cpu_init();
+
+#ifdef SIMD_AVX512_
+    if (__builtin_cpu_supports("avx512f")) return SIMD_Level::AVX512;
+#endif
+    if (__builtin_cpu_supports("avx2")) return SIMD_Level::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SIMD_Level::SSE2;
+#endif
+
+    return SIMD_Level::None;
+}
+
+
+// Not a function-local static, see THREAD_LOCAL in Thread_Pool.h
+static SIMD_Level SIMDLevelLimit = DetectSIMDLevel();
+
+SIMD_Level GetSIMDLevel()
+{
+    return SIMDLevelLimit;
+}
+
+void SetSIMDLevel(SIMD_Level level)
+{
+    SIMD_Level detected = DetectSIMDLevel();
+    SIMDLevelLimit = level < detected ? level : detected;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifdef SIMD_X86_
+
+
+// Vector operations of each instruction set
+struct SIMD_SSE2_D
+{
+    typedef double value_type;
+    typedef __m128d vec;
+    typedef const PCType *index_type;
+    static const PCType lanes = 2;
+
+    SIMD_TARGET("sse2") static vec zero() { return _mm_setzero_pd(); }
+    SIMD_TARGET("sse2") static vec set1(value_type x) { return _mm_set1_pd(x); }
+    SIMD_TARGET("sse2") static index_type index(const PCType *offset) { return offset; }
+    SIMD_TARGET("sse2") static vec load(const value_type *p) { return _mm_loadu_pd(p); }
+    SIMD_TARGET("sse2") static vec gather(const value_type *p, index_type i) { return _mm_loadh_pd(_mm_load_sd(p + i[0]), p + i[1]); }
+    SIMD_TARGET("sse2") static vec sub(vec a, vec b) { return _mm_sub_pd(a, b); }
+    SIMD_TARGET("sse2") static vec mul(vec a, vec b) { return _mm_mul_pd(a, b); }
+    SIMD_TARGET("sse2") static vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+    SIMD_TARGET("sse2") static vec max(vec a, vec b) { return _mm_max_pd(a, b); }
+    SIMD_TARGET("sse2") static bool all_gt(vec a, vec b) { return _mm_movemask_pd(_mm_cmpgt_pd(a, b)) == 0x3; }
+    SIMD_TARGET("sse2") static void store(value_type *p, vec a) { _mm_storeu_pd(p, a); }
+};
+
+struct SIMD_SSE2_S
+{
+    typedef float value_type;
+    typedef __m128 vec;
+    typedef const PCType *index_type;
+    static const PCType lanes = 4;
+
+    SIMD_TARGET("sse2") static vec zero() { return _mm_setzero_ps(); }
+    SIMD_TARGET("sse2") static vec set1(value_type x) { return _mm_set1_ps(x); }
+    SIMD_TARGET("sse2") static index_type index(const PCType *offset) { return offset; }
+    SIMD_TARGET("sse2") static vec load(const value_type *p) { return _mm_loadu_ps(p); }
+    SIMD_TARGET("sse2") static vec gather(const value_type *p, index_type i) { return _mm_set_ps(p[i[3]], p[i[2]], p[i[1]], p[i[0]]); }
+    SIMD_TARGET("sse2") static vec sub(vec a, vec b) { return _mm_sub_ps(a, b); }
+    SIMD_TARGET("sse2") static vec mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+    SIMD_TARGET("sse2") static vec add(vec a, vec b) { return _mm_add_ps(a, b); }
+    SIMD_TARGET("sse2") static vec max(vec a, vec b) { return _mm_max_ps(a, b); }
+    SIMD_TARGET("sse2") static bool all_gt(vec a, vec b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)) == 0xF; }
+    SIMD_TARGET("sse2") static void store(value_type *p, vec a) { _mm_storeu_ps(p, a); }
+};
+
+struct SIMD_AVX2_D
+{
+    typedef double value_type;
+    typedef __m256d vec;
+    typedef __m128i index_type;
+    static const PCType lanes = 4;
+
+    SIMD_TARGET("avx2") static vec zero() { return _mm256_setzero_pd(); }
+    SIMD_TARGET("avx2") static vec set1(value_type x) { return _mm256_set1_pd(x); }
+    SIMD_TARGET("avx2") static index_type index(const PCType *offset) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(offset)); }
+    SIMD_TARGET("avx2") static vec load(const value_type *p) { return _mm256_loadu_pd(p); }
+    SIMD_TARGET("avx2") static vec gather(const value_type *p, index_type i) { return _mm256_i32gather_pd(p, i, 8); }
+    SIMD_TARGET("avx2") static vec sub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+    SIMD_TARGET("avx2") static vec mul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+    SIMD_TARGET("avx2") static vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+    SIMD_TARGET("avx2") static vec max(vec a, vec b) { return _mm256_max_pd(a, b); }
+    SIMD_TARGET("avx2") static bool all_gt(vec a, vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ)) == 0xF; }
+    SIMD_TARGET("avx2") static void store(value_type *p, vec a) { _mm256_storeu_pd(p, a); }
+};
+
+struct SIMD_AVX2_S
+{
+    typedef float value_type;
+    typedef __m256 vec;
+    typedef __m256i index_type;
+    static const PCType lanes = 8;
+
+    SIMD_TARGET("avx2") static vec zero() { return _mm256_setzero_ps(); }
+    SIMD_TARGET("avx2") static vec set1(value_type x) { return _mm256_set1_ps(x); }
+    SIMD_TARGET("avx2") static index_type index(const PCType *offset) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offset)); }
+    SIMD_TARGET("avx2") static vec load(const value_type *p) { return _mm256_loadu_ps(p); }
+    SIMD_TARGET("avx2") static vec gather(const value_type *p, index_type i) { return _mm256_i32gather_ps(p, i, 4); }
+    SIMD_TARGET("avx2") static vec sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+    SIMD_TARGET("avx2") static vec mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+    SIMD_TARGET("avx2") static vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+    SIMD_TARGET("avx2") static vec max(vec a, vec b) { return _mm256_max_ps(a, b); }
+    SIMD_TARGET("avx2") static bool all_gt(vec a, vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)) == 0xFF; }
+    SIMD_TARGET("avx2") static void store(value_type *p, vec a) { _mm256_storeu_ps(p, a); }
+};
+
+#ifdef SIMD_AVX512_
+struct SIMD_AVX512_D
+{
+    typedef double value_type;
+    typedef __m512d vec;
+    typedef __m256i index_type;
+    static const PCType lanes = 8;
+
+    SIMD_TARGET("avx512f") static vec zero() { return _mm512_setzero_pd(); }
+    SIMD_TARGET("avx512f") static vec set1(value_type x) { return _mm512_set1_pd(x); }
+    SIMD_TARGET("avx512f") static index_type index(const PCType *offset) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offset)); }
+    SIMD_TARGET("avx512f") static vec load(const value_type *p) { return _mm512_loadu_pd(p); }
+    SIMD_TARGET("avx512f") static vec gather(const value_type *p, index_type i) { return _mm512_i32gather_pd(i, p, 8); }
+    SIMD_TARGET("avx512f") static vec sub(vec a, vec b) { return _mm512_sub_pd(a, b); }
+    SIMD_TARGET("avx512f") static vec mul(vec a, vec b) { return _mm512_mul_pd(a, b); }
+    SIMD_TARGET("avx512f") static vec add(vec a, vec b) { return _mm512_add_pd(a, b); }
+    SIMD_TARGET("avx512f") static vec max(vec a, vec b) { return _mm512_max_pd(a, b); }
+    SIMD_TARGET("avx512f") static bool all_gt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ) == 0xFF; }
+    SIMD_TARGET("avx512f") static void store(value_type *p, vec a) { _mm512_storeu_pd(p, a); }
+};
+
+struct SIMD_AVX512_S
+{
+    typedef float value_type;
+    typedef __m512 vec;
+    typedef __m512i index_type;
+    static const PCType lanes = 16;
+
+    SIMD_TARGET("avx512f") static vec zero() { return _mm512_setzero_ps(); }
+    SIMD_TARGET("avx512f") static vec set1(value_type x) { return _mm512_set1_ps(x); }
+    SIMD_TARGET("avx512f") static index_type index(const PCType *offset) { return _mm512_loadu_si512(offset); }
+    SIMD_TARGET("avx512f") static vec load(const value_type *p) { return _mm512_loadu_ps(p); }
+    SIMD_TARGET("avx512f") static vec gather(const value_type *p, index_type i) { return _mm512_i32gather_ps(i, p, 4); }
+    SIMD_TARGET("avx512f") static vec sub(vec a, vec b) { return _mm512_sub_ps(a, b); }
+    SIMD_TARGET("avx512f") static vec mul(vec a, vec b) { return _mm512_mul_ps(a, b); }
+    SIMD_TARGET("avx512f") static vec add(vec a, vec b) { return _mm512_add_ps(a, b); }
+    SIMD_TARGET("avx512f") static vec max(vec a, vec b) { return _mm512_max_ps(a, b); }
+    SIMD_TARGET("avx512f") static bool all_gt(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ) == 0xFFFF; }
+    SIMD_TARGET("avx512f") static void store(value_type *p, vec a) { _mm512_storeu_ps(p, a); }
+};
+#endif
+
+
+// Each lane accumulates one candidate, two vectors are interleaved to hide the latency of the add chain.
+// BH and BW are the block size known at compile time, or 0 for any block size.
+// Returns the number of processed candidates, the remainder is left to the scalar loop.
+// The kernel body is a macro because the target attribute of GCC can't be a template parameter.
+#define BLOCK_SSD_KERNEL(Name, Target, V) \
+template < PCType BH, PCType BW > \
+Target static PCType Name(V::value_type *dist, const V::value_type *ref, PCType height, PCType width, \
+    const V::value_type *src, PCType src_stride, const PCType *offset, PCType count, V::value_type thSSE) \
+{ \
+    const PCType h = BH > 0 ? BH : height; \
+    const PCType w = BW > 0 ? BW : width; \
+    const V::vec th = V::set1(thSSE); \
+    \
+    PCType k = 0; \
+    \
+    for (; k + V::lanes * 2 <= count; k += V::lanes * 2) \
+    { \
+        const V::index_type idx0 = V::index(offset + k); \
+        const V::index_type idx1 = V::index(offset + k + V::lanes); \
+        \
+        V::vec sum0 = V::zero(); \
+        V::vec sum1 = V::zero(); \
+        \
+        auto refp = ref; \
+        \
+        for (PCType y = 0; y < h; ++y) \
+        { \
+            auto srcp = src + y * src_stride; \
+            \
+            for (PCType x = 0; x < w; ++x, ++refp) \
+            { \
+                const V::vec r = V::set1(*refp); \
+                const V::vec d0 = V::sub(r, V::gather(srcp + x, idx0)); \
+                const V::vec d1 = V::sub(r, V::gather(srcp + x, idx1)); \
+                sum0 = V::add(sum0, V::mul(d0, d0)); \
+                sum1 = V::add(sum1, V::mul(d1, d1)); \
+            } \
+            \
+            if (V::all_gt(sum0, th) && V::all_gt(sum1, th)) break; \
+        } \
+        \
+        V::store(dist + k, sum0); \
+        V::store(dist + k + V::lanes, sum1); \
+    } \
+    \
+    return k; \
+}
+
+BLOCK_SSD_KERNEL(BlockSSD_SSE2_D, SIMD_TARGET("sse2"), SIMD_SSE2_D)
+BLOCK_SSD_KERNEL(BlockSSD_SSE2_S, SIMD_TARGET("sse2"), SIMD_SSE2_S)
+BLOCK_SSD_KERNEL(BlockSSD_AVX2_D, SIMD_TARGET("avx2"), SIMD_AVX2_D)
+BLOCK_SSD_KERNEL(BlockSSD_AVX2_S, SIMD_TARGET("avx2"), SIMD_AVX2_S)
+#ifdef SIMD_AVX512_
+BLOCK_SSD_KERNEL(BlockSSD_AVX512_D, SIMD_TARGET("avx512f"), SIMD_AVX512_D)
+BLOCK_SSD_KERNEL(BlockSSD_AVX512_S, SIMD_TARGET("avx512f"), SIMD_AVX512_S)
+#endif
+
+#undef BLOCK_SSD_KERNEL
+
+
+// One lane per element, returns the number of processed elements
+#define SQR_DIFF_ACC_KERNEL(Name, Target, V) \
+Target static PCType Name(V::value_type *acc, const V::value_type *src1, const V::value_type *src2, PCType count) \
+{ \
+    PCType x = 0; \
+    \
+    for (; x + V::lanes <= count; x += V::lanes) \
+    { \
+        const V::vec d = V::sub(V::load(src1 + x), V::load(src2 + x)); \
+        V::store(acc + x, V::add(V::load(acc + x), V::mul(d, d))); \
+    } \
+    \
+    return x; \
+}
+
+SQR_DIFF_ACC_KERNEL(SqrDiffAccumulate_SSE2_D, SIMD_TARGET("sse2"), SIMD_SSE2_D)
+SQR_DIFF_ACC_KERNEL(SqrDiffAccumulate_AVX2_D, SIMD_TARGET("avx2"), SIMD_AVX2_D)
+#ifdef SIMD_AVX512_
+SQR_DIFF_ACC_KERNEL(SqrDiffAccumulate_AVX512_D, SIMD_TARGET("avx512f"), SIMD_AVX512_D)
+#endif
+
+#undef SQR_DIFF_ACC_KERNEL
+
+
+// Columns of n pixels from each of the rows to the buffer with the pixels of a column adjacent, and back
+// 4x4 blocks of float and 2x2 blocks of double are transposed in registers, rows is a multiple of the block size.
+SIMD_TARGET("sse2") static void TransposeToLanes(float *buffer, const float *src, PCType n, PCType rows, PCType stride)
+{
+    for (PCType r = 0; r < rows; r += 4)
+    {
+        const float *s0 = src + r * stride;
+        const float *s1 = s0 + stride;
+        const float *s2 = s1 + stride;
+        const float *s3 = s2 + stride;
+        PCType x = 0;
+
+        for (; x + 4 <= n; x += 4)
+        {
+            __m128 v0 = _mm_loadu_ps(s0 + x);
+            __m128 v1 = _mm_loadu_ps(s1 + x);
+            __m128 v2 = _mm_loadu_ps(s2 + x);
+            __m128 v3 = _mm_loadu_ps(s3 + x);
+            _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+            _mm_storeu_ps(buffer + x * rows + r, v0);
+            _mm_storeu_ps(buffer + (x + 1) * rows + r, v1);
+            _mm_storeu_ps(buffer + (x + 2) * rows + r, v2);
+            _mm_storeu_ps(buffer + (x + 3) * rows + r, v3);
+        }
+
+        for (; x < n; ++x)
+        {
+            _mm_storeu_ps(buffer + x * rows + r, _mm_set_ps(s3[x], s2[x], s1[x], s0[x]));
+        }
+    }
+}
+
+SIMD_TARGET("sse2") static void TransposeFromLanes(float *dst, const float *buffer, PCType n, PCType rows, PCType stride)
+{
+    for (PCType r = 0; r < rows; r += 4)
+    {
+        float *d0 = dst + r * stride;
+        float *d1 = d0 + stride;
+        float *d2 = d1 + stride;
+        float *d3 = d2 + stride;
+        PCType x = 0;
+
+        for (; x + 4 <= n; x += 4)
+        {
+            __m128 v0 = _mm_loadu_ps(buffer + x * rows + r);
+            __m128 v1 = _mm_loadu_ps(buffer + (x + 1) * rows + r);
+            __m128 v2 = _mm_loadu_ps(buffer + (x + 2) * rows + r);
+            __m128 v3 = _mm_loadu_ps(buffer + (x + 3) * rows + r);
+            _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+            _mm_storeu_ps(d0 + x, v0);
+            _mm_storeu_ps(d1 + x, v1);
+            _mm_storeu_ps(d2 + x, v2);
+            _mm_storeu_ps(d3 + x, v3);
+        }
+
+        for (; x < n; ++x)
+        {
+            const float *p = buffer + x * rows + r;
+            d0[x] = p[0];
+            d1[x] = p[1];
+            d2[x] = p[2];
+            d3[x] = p[3];
+        }
+    }
+}
+
+SIMD_TARGET("sse2") static void TransposeToLanes(double *buffer, const double *src, PCType n, PCType rows, PCType stride)
+{
+    for (PCType r = 0; r < rows; r += 2)
+    {
+        const double *s0 = src + r * stride;
+        const double *s1 = s0 + stride;
+        PCType x = 0;
+
+        for (; x + 2 <= n; x += 2)
+        {
+            const __m128d v0 = _mm_loadu_pd(s0 + x);
+            const __m128d v1 = _mm_loadu_pd(s1 + x);
+            _mm_storeu_pd(buffer + x * rows + r, _mm_unpacklo_pd(v0, v1));
+            _mm_storeu_pd(buffer + (x + 1) * rows + r, _mm_unpackhi_pd(v0, v1));
+        }
+
+        for (; x < n; ++x)
+        {
+            buffer[x * rows + r] = s0[x];
+            buffer[x * rows + r + 1] = s1[x];
+        }
+    }
+}
+
+SIMD_TARGET("sse2") static void TransposeFromLanes(double *dst, const double *buffer, PCType n, PCType rows, PCType stride)
+{
+    for (PCType r = 0; r < rows; r += 2)
+    {
+        double *d0 = dst + r * stride;
+        double *d1 = d0 + stride;
+        PCType x = 0;
+
+        for (; x + 2 <= n; x += 2)
+        {
+            const __m128d v0 = _mm_loadu_pd(buffer + x * rows + r);
+            const __m128d v1 = _mm_loadu_pd(buffer + (x + 1) * rows + r);
+            _mm_storeu_pd(d0 + x, _mm_unpacklo_pd(v0, v1));
+            _mm_storeu_pd(d1 + x, _mm_unpackhi_pd(v0, v1));
+        }
+
+        for (; x < n; ++x)
+        {
+            d0[x] = buffer[x * rows + r];
+            d1[x] = buffer[x * rows + r + 1];
+        }
+    }
+}
+
+// Each lane runs the recursion of one row, two vectors of rows are interleaved to hide the latency of the recursion.
+// The rows are transposed to a buffer first, thus each step of the recursion loads one column of the rows,
+// then both passes run in the buffer, and the result is transposed back.
+// The buffer comes from the memory pool, since the callers invoke the kernel for every piece of rows.
+// Returns the number of processed rows, the remainder is left to the scalar loop.
+#define RECURSIVE_GAUSSIAN_H_KERNEL(Name, Target, V) \
+Target static PCType Name(V::value_type *dst, const V::value_type *src, PCType height, PCType width, PCType stride, \
+    V::value_type B, V::value_type B1, V::value_type B2, V::value_type B3, bool allow_negative) \
+{ \
+    const PCType rows = V::lanes * 2; \
+    \
+    if (height < rows) \
+    { \
+        return 0; \
+    } \
+    \
+    const V::vec b = V::set1(B); \
+    const V::vec b1 = V::set1(B1); \
+    const V::vec b2 = V::set1(B2); \
+    const V::vec b3 = V::set1(B3); \
+    const V::vec zero = V::zero(); \
+    \
+    V::value_type *bufp = nullptr; \
+    PoolMalloc(bufp, width * rows); \
+    \
+    PCType j = 0; \
+    \
+    for (; j + rows <= height; j += rows) \
+    { \
+        V::vec P0a, P1a, P2a, P3a, P0b, P1b, P2b, P3b; \
+        V::value_type *p = bufp; \
+        \
+        TransposeToLanes(bufp, src + j * stride, width, rows, stride); \
+        \
+        P3a = P2a = P1a = V::load(p); \
+        P3b = P2b = P1b = V::load(p + V::lanes); \
+        \
+        for (PCType x = 1; x < width; ++x) \
+        { \
+            p += rows; \
+            P0a = V::add(V::add(V::add(V::mul(b, V::load(p)), V::mul(b1, P1a)), V::mul(b2, P2a)), V::mul(b3, P3a)); \
+            P0b = V::add(V::add(V::add(V::mul(b, V::load(p + V::lanes)), V::mul(b1, P1b)), V::mul(b2, P2b)), V::mul(b3, P3b)); \
+            P3a = P2a; P2a = P1a; P1a = P0a; \
+            P3b = P2b; P2b = P1b; P1b = P0b; \
+            V::store(p, P0a); \
+            V::store(p + V::lanes, P0b); \
+        } \
+        \
+        P3a = P2a = P1a = V::load(p); \
+        P3b = P2b = P1b = V::load(p + V::lanes); \
+        \
+        for (PCType x = width - 1; x > 0; --x) \
+        { \
+            p -= rows; \
+            P0a = V::add(V::add(V::add(V::mul(b, V::load(p)), V::mul(b1, P1a)), V::mul(b2, P2a)), V::mul(b3, P3a)); \
+            P0b = V::add(V::add(V::add(V::mul(b, V::load(p + V::lanes)), V::mul(b1, P1b)), V::mul(b2, P2b)), V::mul(b3, P3b)); \
+            P3a = P2a; P2a = P1a; P1a = P0a; \
+            P3b = P2b; P2b = P1b; P1b = P0b; \
+            V::store(p, allow_negative ? P0a : V::max(P0a, zero)); \
+            V::store(p + V::lanes, allow_negative ? P0b : V::max(P0b, zero)); \
+        } \
+        \
+        TransposeFromLanes(dst + j * stride, bufp, width, rows, stride); \
+    } \
+    \
+    PoolFree(bufp); \
+    return j; \
+}
+
+RECURSIVE_GAUSSIAN_H_KERNEL(RecursiveGaussianH_SSE2_D, SIMD_TARGET("sse2"), SIMD_SSE2_D)
+RECURSIVE_GAUSSIAN_H_KERNEL(RecursiveGaussianH_SSE2_S, SIMD_TARGET("sse2"), SIMD_SSE2_S)
+RECURSIVE_GAUSSIAN_H_KERNEL(RecursiveGaussianH_AVX2_D, SIMD_TARGET("avx2"), SIMD_AVX2_D)
+RECURSIVE_GAUSSIAN_H_KERNEL(RecursiveGaussianH_AVX2_S, SIMD_TARGET("avx2"), SIMD_AVX2_S)
+#ifdef SIMD_AVX512_
+RECURSIVE_GAUSSIAN_H_KERNEL(RecursiveGaussianH_AVX512_D, SIMD_TARGET("avx512f"), SIMD_AVX512_D)
+RECURSIVE_GAUSSIAN_H_KERNEL(RecursiveGaussianH_AVX512_S, SIMD_TARGET("avx512f"), SIMD_AVX512_S)
+#endif
+
+#undef RECURSIVE_GAUSSIAN_H_KERNEL
+
+
+// The weights of rows k and k + 1 are packed into each 32-bit lane, and the pixels of the 2 rows are interleaved,
+// then pmaddwd gives weight[k] * src[k][x] + weight[k + 1] * src[k + 1][x] in 32-bit.
+// Returns the number of processed pixels, the remainder is left to the scalar loop.
+static sint32 WeightPair(const sint16 *weight, PCType k, PCType count)
+{
+    const uint32 w0 = static_cast<uint16>(weight[k]);
+    const uint32 w1 = k + 1 < count ? static_cast<uint16>(weight[k + 1]) : 0;
+    return static_cast<sint32>(w0 | (w1 << 16));
+}
+
+SIMD_TARGET("sse2") static PCType WeightedSum_SSE2(sint32 *dst, const sint16 *const *src, const sint16 *weight,
+    PCType count, PCType width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    PCType x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i lo = zero;
+        __m128i hi = zero;
+
+        for (PCType k = 0; k < count; k += 2)
+        {
+            const __m128i w = _mm_set1_epi32(WeightPair(weight, k, count));
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[k] + x));
+            const __m128i b = k + 1 < count ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[k + 1] + x)) : zero;
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 4), hi);
+    }
+
+    return x;
+}
+
+// The unpacking works in 128-bit halves, thus the halves of the results are permuted back to the order of the pixels
+SIMD_TARGET("avx2") static PCType WeightedSum_AVX2(sint32 *dst, const sint16 *const *src, const sint16 *weight,
+    PCType count, PCType width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    PCType x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i lo = zero;
+        __m256i hi = zero;
+
+        for (PCType k = 0; k < count; k += 2)
+        {
+            const __m256i w = _mm256_set1_epi32(WeightPair(weight, k, count));
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src[k] + x));
+            const __m256i b = k + 1 < count ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src[k + 1] + x)) : zero;
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    return x;
+}
+
+
+// Select the fast path of 8x8 or 11x11 blocks
+#define BLOCK_SSD_SIZE_DISPATCH(Name) \
+    (height == 8 && width == 8 ? Name<8, 8>(dist, ref, height, width, src, src_stride, offset, count, thSSE) \
+    : height == 11 && width == 11 ? Name<11, 11>(dist, ref, height, width, src, src_stride, offset, count, thSSE) \
+    : Name<0, 0>(dist, ref, height, width, src, src_stride, offset, count, thSSE))
+
+
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+void BlockSSD_Multi(double *dist, const double *ref, PCType height, PCType width,
+    const double *src, PCType src_stride, const PCType *offset, PCType count, double thSSE)
+{
+    PCType done = 0;
+
+#ifdef SIMD_X86_
+    switch (GetSIMDLevel())
+    {
+#ifdef SIMD_AVX512_
+    case SIMD_Level::AVX512:
+        done = BLOCK_SSD_SIZE_DISPATCH(BlockSSD_AVX512_D);
+        break;
+#endif
+    case SIMD_Level::AVX2:
+        done = BLOCK_SSD_SIZE_DISPATCH(BlockSSD_AVX2_D);
+        break;
+    case SIMD_Level::SSE2:
+        done = BLOCK_SSD_SIZE_DISPATCH(BlockSSD_SSE2_D);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    BlockSSD_Multi<double, double, double>(dist + done, ref, height, width,
+        src, src_stride, offset + done, count - done, thSSE);
+}
+
+void BlockSSD_Multi(float *dist, const float *ref, PCType height, PCType width,
+    const float *src, PCType src_stride, const PCType *offset, PCType count, float thSSE)
+{
+    PCType done = 0;
+
+#ifdef SIMD_X86_
+    switch (GetSIMDLevel())
+    {
+#ifdef SIMD_AVX512_
+    case SIMD_Level::AVX512:
+        done = BLOCK_SSD_SIZE_DISPATCH(BlockSSD_AVX512_S);
+        break;
+#endif
+    case SIMD_Level::AVX2:
+        done = BLOCK_SSD_SIZE_DISPATCH(BlockSSD_AVX2_S);
+        break;
+    case SIMD_Level::SSE2:
+        done = BLOCK_SSD_SIZE_DISPATCH(BlockSSD_SSE2_S);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    BlockSSD_Multi<float, float, float>(dist + done, ref, height, width,
+        src, src_stride, offset + done, count - done, thSSE);
+}
+
+
+void SqrDiffAccumulate(double *acc, const double *src1, const double *src2, PCType count)
+{
+    PCType done = 0;
+
+#ifdef SIMD_X86_
+    switch (GetSIMDLevel())
+    {
+#ifdef SIMD_AVX512_
+    case SIMD_Level::AVX512:
+        done = SqrDiffAccumulate_AVX512_D(acc, src1, src2, count);
+        break;
+#endif
+    case SIMD_Level::AVX2:
+        done = SqrDiffAccumulate_AVX2_D(acc, src1, src2, count);
+        break;
+    case SIMD_Level::SSE2:
+        done = SqrDiffAccumulate_SSE2_D(acc, src1, src2, count);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    SqrDiffAccumulate<double, double>(acc + done, src1 + done, src2 + done, count - done);
+}
+
+
+void RecursiveGaussianH(float *dst, const float *src, PCType height, PCType width, PCType stride,
+    float B, float B1, float B2, float B3, bool allow_negative)
+{
+    PCType done = 0;
+
+#ifdef SIMD_X86_
+    switch (GetSIMDLevel())
+    {
+#ifdef SIMD_AVX512_
+    case SIMD_Level::AVX512:
+        done = RecursiveGaussianH_AVX512_S(dst, src, height, width, stride, B, B1, B2, B3, allow_negative);
+        break;
+#endif
+    case SIMD_Level::AVX2:
+        done = RecursiveGaussianH_AVX2_S(dst, src, height, width, stride, B, B1, B2, B3, allow_negative);
+        break;
+    case SIMD_Level::SSE2:
+        done = RecursiveGaussianH_SSE2_S(dst, src, height, width, stride, B, B1, B2, B3, allow_negative);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    RecursiveGaussianH<float>(dst + done * stride, src + done * stride, height - done, width, stride,
+        B, B1, B2, B3, allow_negative);
+}
+
+void RecursiveGaussianH(double *dst, const double *src, PCType height, PCType width, PCType stride,
+    double B, double B1, double B2, double B3, bool allow_negative)
+{
+    PCType done = 0;
+
+#ifdef SIMD_X86_
+    switch (GetSIMDLevel())
+    {
+#ifdef SIMD_AVX512_
+    case SIMD_Level::AVX512:
+        done = RecursiveGaussianH_AVX512_D(dst, src, height, width, stride, B, B1, B2, B3, allow_negative);
+        break;
+#endif
+    case SIMD_Level::AVX2:
+        done = RecursiveGaussianH_AVX2_D(dst, src, height, width, stride, B, B1, B2, B3, allow_negative);
+        break;
+    case SIMD_Level::SSE2:
+        done = RecursiveGaussianH_SSE2_D(dst, src, height, width, stride, B, B1, B2, B3, allow_negative);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    RecursiveGaussianH<double>(dst + done * stride, src + done * stride, height - done, width, stride,
+        B, B1, B2, B3, allow_negative);
+}
+
+
+void WeightedSum(sint32 *dst, const sint16 *const *src, const sint16 *weight, PCType count, PCType width)
+{
+    PCType done = 0;
+
+#ifdef SIMD_X86_
+    switch (GetSIMDLevel())
+    {
+    case SIMD_Level::AVX512: // pmaddwd of 512-bit needs AVX-512BW
+    case SIMD_Level::AVX2:
+        done = WeightedSum_AVX2(dst, src, weight, count, width);
+        break;
+    case SIMD_Level::SSE2:
+        done = WeightedSum_SSE2(dst, src, weight, count, width);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    if (done < width)
+    {
+        std::vector<const sint16 *> rest(src, src + count);
+
+        for (auto &p : rest)
+        {
+            p += done;
+        }
+
+        WeightedSum<sint32, sint16, sint16>(dst + done, rest.data(), weight, count, width - done);
+    }
+}
@@ -14,7 +14,7 @@ void CUDA_Haze_Removal_Retinex::Init(const Frame &src)
 {
     height = src.Height();
     width = src.Width();
-    stride = src.Stride();
+    stride = width; // device buffers are not padded
 
     pcount = src.R().PixelCount();
     sFloor = src.R().Floor();
@@ -25,9 +25,9 @@ void CUDA_Haze_Removal_Retinex::Init(const Frame &src)
     CUDA_Malloc(GdevInt, pcount);
     CUDA_Malloc(BdevInt, pcount);
 
-    CUDA_MemcpyH2D(RdevInt, src.R().data(), pcount);
-    CUDA_MemcpyH2D(GdevInt, src.G().data(), pcount);
-    CUDA_MemcpyH2D(BdevInt, src.B().data(), pcount);
+    CUDA_Memcpy2DH2D(RdevInt, stride, src.R().data(), src.R().Stride(), height, width);
+    CUDA_Memcpy2DH2D(GdevInt, stride, src.G().data(), src.G().Stride(), height, width);
+    CUDA_Memcpy2DH2D(BdevInt, stride, src.B().data(), src.B().Stride(), height, width);
 }
 
 void CUDA_Haze_Removal_Retinex::End()
@@ -77,7 +77,7 @@ Frame &CUDA_Haze_Removal_Retinex::process_Frame(Frame &dst, const Frame &src)
 {
     height = dst.Height();
     width = dst.Width();
-    stride = dst.Stride();
+    stride = width;
 
     if (src.isYUV() || dst.isYUV())
     {
@@ -462,9 +462,9 @@ void CUDA_Haze_Removal_Retinex::StoreResult(Frame &dst)
         (RdevInt, GdevInt, BdevInt, Rdev, Gdev, Bdev, pcount,
         gain1, offset1, transfer, dFloor, dCeil);
 
-    CUDA_MemcpyD2H(dstR.data(), RdevInt, pcount);
-    CUDA_MemcpyD2H(dstG.data(), GdevInt, pcount);
-    CUDA_MemcpyD2H(dstB.data(), BdevInt, pcount);
+    CUDA_Memcpy2DD2H(dstR.data(), dstR.Stride(), RdevInt, stride, height, width);
+    CUDA_Memcpy2DD2H(dstG.data(), dstG.Stride(), GdevInt, stride, height, width);
+    CUDA_Memcpy2DD2H(dstB.data(), dstB.Stride(), BdevInt, stride, height, width);
 
     CUDA_Free(RdevInt);
     CUDA_Free(GdevInt);
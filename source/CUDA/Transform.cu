@@ -105,7 +105,22 @@ _St1 &CUDA_Transpose(_St1 &dst, const _St1 &src, CudaMemMode mem_mode = CudaMemM
     // Change Plane info
     dst.ReSize(src_height, src_width);
 
-    CUDA_Transpose(dst.data(), src.data(), src_height, src_width, mem_mode);
+    if (src.Stride() == src_width && dst.Stride() == src_height)
+    {
+        CUDA_Transpose(dst.data(), src.data(), src_height, src_width, mem_mode);
+    }
+    else
+    {
+        // The kernels work on unpadded data
+        typedef typename _St1::value_type value_type;
+
+        std::vector<value_type> dst_data(src_width * src_height);
+        std::vector<value_type> src_data(src_width * src_height);
+
+        MatCopy(src_data.data(), src.data(), src_height, src_width, src_width, src.Stride());
+        CUDA_Transpose(dst_data.data(), src_data.data(), src_height, src_width, mem_mode);
+        MatCopy(dst.data(), dst_data.data(), src_width, src_height, dst.Stride(), src_height);
+    }
 
     return dst;
 }
@@ -1,8 +1,183 @@
 #include <cstring>
+#include <cmath>
 #include "Convolution.h"
+#include "Block_SIMD.h"
+
+
+// Fixed-point path of the 3x3 convolutions for integer kernels, K[row * 3 + col] for rows and cols of -1, 0, 1.
+// The pixels and the non-zero taps are 16-bit and the sums N of the kernel(s) are accumulated in 32-bit by WeightedSum,
+// thus R = N * 2 / (sum * 2) is an exact fraction for the sums (multiples of 0.5) set up by the callers,
+// and the result trunc(R + 0.5) is computed by an exact integer division by 2 * sum * 2.
+// It matches the floating point path except where the error of the normalized float kernel moves R across a tie
+// of rounding, e.g. R = 1.5 for sum = 3.
+// Returns false if any kernel value is not a 16-bit integer or the sums may overflow 32-bit integer.
+template < typename _Ty >
+static bool Convolution3_Int(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, const FLType *KA, const FLType *KB,
+    FLType sum, bool absVal, bool clip)
+{
+    // The pixels of 16-bit are biased to signed 16-bit, which adds bias * sum of kernel to N
+    const sint32 bias = src.Ceil() > 32767 ? 32768 : 0;
+
+    if (src.Floor() < 0 || src.Ceil() > 65535)
+    {
+        return false;
+    }
+
+    sint16 WA[9], WB[9];
+    PCType TA[9], TB[9];
+    PCType countA = 0, countB = 0;
+    sint32 offsetA = 0, offsetB = 0;
+    ldbl sumAbs = 0;
+
+    for (int k = 0; k < 9; ++k)
+    {
+        const FLType ka = KA[k];
+        const FLType kb = KB ? KB[k] : FLType(0);
+
+        if (ka != std::floor(ka) || kb != std::floor(kb) || Abs(ka) > 32767 || Abs(kb) > 32767)
+        {
+            return false;
+        }
+
+        if (ka != 0)
+        {
+            WA[countA] = static_cast<sint16>(ka);
+            TA[countA++] = k;
+            offsetA += static_cast<sint32>(ka) * bias;
+        }
+
+        if (kb != 0)
+        {
+            WB[countB] = static_cast<sint16>(kb);
+            TB[countB++] = k;
+            offsetB += static_cast<sint32>(kb) * bias;
+        }
+
+        sumAbs += Abs(ka) + Abs(kb);
+    }
+
+    // R = N * mul / div with div > 0
+    sint32 mul = 1;
+    sint32 div = 1;
+
+    if (sum != 0)
+    {
+        mul = sum < 0 ? -2 : 2;
+        div = static_cast<sint32>(Abs(sum) * 2 + FLType(0.5));
+    }
+
+    const ldbl maxVal = Max(static_cast<ldbl>(src.Ceil()), static_cast<ldbl>(bias));
+    const ldbl maxClip = Max(Abs(static_cast<ldbl>(dst.Floor())), Abs(static_cast<ldbl>(dst.Ceil()))) * div;
+
+    if ((sumAbs * maxVal * 2 + div) * 2 >= 2147483647.0L || maxClip * 2 + div >= 2147483647.0L)
+    {
+        return false;
+    }
+
+    const sint32 FloorI = static_cast<sint32>(dst.Floor()) * div;
+    const sint32 CeilI = static_cast<sint32>(dst.Ceil()) * div;
+
+    // trunc(n / (2 * div)) by shift for power of 2, otherwise by multiply-shift, exact for |n| < 2^31
+    const sint32 div2 = div * 2;
+    int shift = 31;
+    while ((sint64(1) << (shift - 31)) < div2) ++shift;
+    const uint64 magic = ((uint64(1) << shift) + div2 - 1) / div2;
+    const int log2 = (div2 & (div2 - 1)) == 0 ? shift - 31 : -1;
+
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+    const PCType src_stride = src.Stride();
+    const PCType dst_stride = dst.Stride();
+    const PCType pitch = width + 2;
+
+    const _Ty *srcp = src.data();
+    _Ty *dstp = dst.data();
+
+    std::vector<sint16> rows(pitch * 3);
+    std::vector<sint32> RA(width), RB(width);
+    const sint16 *tapsA[9], *tapsB[9];
+    PCType cached[3] = { -1, -1, -1 };
+
+    for (PCType j = 0; j < height; ++j)
+    {
+        const sint16 *line[3];
+
+        // The 3 rows extended by 1 with the edge pixels, each source row is converted once into the slot y % 3
+        for (int r = 0; r < 3; ++r)
+        {
+            const PCType y = Clip(j + r - 1, PCType(0), height - 1);
+            sint16 *p = rows.data() + pitch * (y % 3);
+            line[r] = p;
+
+            if (cached[y % 3] != y)
+            {
+                const _Ty *s = srcp + y * src_stride;
+
+                p[0] = static_cast<sint16>(s[0] - bias);
+                for (PCType i = 0; i < width; ++i) p[i + 1] = static_cast<sint16>(s[i] - bias);
+                p[width + 1] = static_cast<sint16>(s[width - 1] - bias);
+                cached[y % 3] = y;
+            }
+        }
+
+        for (PCType k = 0; k < countA; ++k) tapsA[k] = line[TA[k] / 3] + TA[k] % 3;
+        for (PCType k = 0; k < countB; ++k) tapsB[k] = line[TB[k] / 3] + TB[k] % 3;
+
+        WeightedSum(RA.data(), tapsA, WA, countA, width);
+        for (PCType i = 0; i < width; ++i) RA[i] += offsetA;
+
+        if (KB)
+        {
+            WeightedSum(RB.data(), tapsB, WB, countB, width);
+            for (PCType i = 0; i < width; ++i) RB[i] += offsetB;
+        }
+
+        // R = N * mul, clipped to [Floor, Ceil] * div
+        if (absVal)
+        {
+            const sint32 absMul = Abs(mul);
+
+            if (KB) for (PCType i = 0; i < width; ++i) RA[i] = (Abs(RA[i]) + Abs(RB[i])) * absMul;
+            else for (PCType i = 0; i < width; ++i) RA[i] = Abs(RA[i]) * absMul;
+        }
+        else
+        {
+            if (KB) for (PCType i = 0; i < width; ++i) RA[i] = (RA[i] + RB[i]) * mul;
+            else for (PCType i = 0; i < width; ++i) RA[i] *= mul;
+        }
+
+        if (clip)
+        {
+            for (PCType i = 0; i < width; ++i) RA[i] = Clip(RA[i], FloorI, CeilI);
+        }
 
- 
-Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm)
+        _Ty *d = dstp + j * dst_stride;
+
+        if (log2 >= 0)
+        {
+            for (PCType i = 0; i < width; ++i)
+            {
+                const sint32 n = RA[i] * 2 + div;
+                d[i] = static_cast<_Ty>((n + ((n >> 31) & (div2 - 1))) >> log2);
+            }
+        }
+        else
+        {
+            for (PCType i = 0; i < width; ++i)
+            {
+                const sint32 n = RA[i] * 2 + div;
+                d[i] = static_cast<_Ty>(n >= 0 ? sint32((uint64(n) * magic) >> shift)
+                    : -sint32((uint64(-n) * magic) >> shift));
+            }
+        }
+    }
+
+    return true;
+}
+
+
+template < typename _Ty >
+static PlaneT<_Ty> & Convolution3V_Tile(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm)
 {
     PCType i0, i1, i2, j, upper;
     FLType P0, P1, P2;
@@ -12,11 +187,13 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
 
+    const FLType K[9] = { 0, K0, 0, 0, K1, 0, 0, K2, 0 };
+
     FLType sum = K0 + K1 + K2;
     bool absVal = false;
     bool clip = false;
@@ -54,6 +231,11 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
         clip = true;
     }
 
+    if (Convolution3_Int(dst, src, K, nullptr, norm ? sum : 0, absVal, clip))
+    {
+        return dst;
+    }
+
     for (j = 0; j < height; j++)
     {
         i1 = stride * j;
@@ -69,7 +251,7 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1] = static_cast<DType>(R + FLType(0.5));
+            dst[i1] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -77,7 +259,8 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 }
 
 
-Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm)
+template < typename _Ty >
+static PlaneT<_Ty> & Convolution3H_Tile(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm)
 {
     PCType i, j, upper;
     FLType P0, P1, P2;
@@ -87,11 +270,13 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
 
+    const FLType K[9] = { 0, 0, 0, K0, K1, K2, 0, 0, 0 };
+
     FLType sum = K0 + K1 + K2;
     bool absVal = false;
     bool clip = false;
@@ -129,6 +314,11 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
         clip = true;
     }
 
+    if (Convolution3_Int(dst, src, K, nullptr, norm ? sum : 0, absVal, clip))
+    {
+        return dst;
+    }
+
     for (j = 0; j < height; j++)
     {
         i = stride * j + radius;
@@ -144,7 +334,7 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i - radius] = static_cast<DType>(R + FLType(0.5));
+            dst[i - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
 
         for (upper = stride * j + width + radius; i < upper; i++)
@@ -155,7 +345,7 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i - radius] = static_cast<DType>(R + FLType(0.5));
+            dst[i - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -163,7 +353,8 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 }
 
 
-Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm)
+template < typename _Ty >
+static PlaneT<_Ty> & Convolution3_Tile(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm)
 {
     PCType i0, i1, i2, j, upper;
     FLType P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -173,11 +364,13 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
 
+    const FLType K[9] = { K0, K1, K2, K3, K4, K5, K6, K7, K8 };
+
     FLType sum = K0 + K1 + K2 + K3 + K4 + K5 + K6 + K7 + K8;
     bool absVal = false;
     bool clip = false;
@@ -221,6 +414,11 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
         clip = true;
     }
 
+    if (Convolution3_Int(dst, src, K, nullptr, norm ? sum : 0, absVal, clip))
+    {
+        return dst;
+    }
+
     for (j = 0; j < height; j++)
     {
         i1 = stride * j + radius;
@@ -240,7 +438,7 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2 + K3 * P3 + K4 * P4 + K5 * P5 + K6 * P6 + K7 * P7 + K8 * P8;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dst[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -252,7 +450,7 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2 + K3 * P3 + K4 * P4 + K5 * P5 + K6 * P6 + K7 * P7 + K8 * P8;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dst[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -260,7 +458,8 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 }
 
 
-Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm)
+template < typename _Ty >
+static PlaneT<_Ty> & FirstOrderDerivative3_Tile(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm)
 {
     PCType i0, i1, i2, j, upper;
     FLType P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -270,11 +469,14 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
 
+    const FLType KA[9] = { K0, K1, K2, 0, 0, 0, K6, K7, K8 };
+    const FLType KB[9] = { K0, 0, K6, K1, 0, K7, K2, 0, K8 };
+
     FLType sum = (K0 + K1 + K2 + K6 + K7 + K8) * 2;
     bool absVal = false;
     bool clip = false;
@@ -315,6 +517,11 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
         clip = true;
     }
 
+    if (Convolution3_Int(dst, src, KA, KB, norm ? sum : 0, absVal, clip))
+    {
+        return dst;
+    }
+
     for (j = 0; j < height; j++)
     {
         i1 = stride * j + radius;
@@ -337,7 +544,7 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
             if (absVal) R = Abs(R0) + Abs(R1);
             else R = R0 + R1;
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dst[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -352,7 +559,7 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
             if (absVal) R = Abs(R0) + Abs(R1);
             else R = R0 + R1;
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dst[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -360,7 +567,46 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
 }
 
 
-Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
+// The 3x3 convolutions are processed in tiles of TILE_HP x TILE_WP, see TileExecute
+template < typename _Ty >
+PlaneT<_Ty> & Convolution3V(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm)
+{
+    return TileExecute(dst, src, Convolution3_Halo, 1, [&](PlaneT<_Ty> &dstTile, const PlaneT<_Ty> &srcTile)
+    {
+        Convolution3V_Tile(dstTile, srcTile, K0, K1, K2, norm);
+    });
+}
+
+template < typename _Ty >
+PlaneT<_Ty> & Convolution3H(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm)
+{
+    return TileExecute(dst, src, Convolution3_Halo, 1, [&](PlaneT<_Ty> &dstTile, const PlaneT<_Ty> &srcTile)
+    {
+        Convolution3H_Tile(dstTile, srcTile, K0, K1, K2, norm);
+    });
+}
+
+template < typename _Ty >
+PlaneT<_Ty> & Convolution3(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm)
+{
+    return TileExecute(dst, src, Convolution3_Halo, 1, [&](PlaneT<_Ty> &dstTile, const PlaneT<_Ty> &srcTile)
+    {
+        Convolution3_Tile(dstTile, srcTile, K0, K1, K2, K3, K4, K5, K6, K7, K8, norm);
+    });
+}
+
+template < typename _Ty >
+PlaneT<_Ty> & FirstOrderDerivative3(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm)
+{
+    return TileExecute(dst, src, Convolution3_Halo, 1, [&](PlaneT<_Ty> &dstTile, const PlaneT<_Ty> &srcTile)
+    {
+        FirstOrderDerivative3_Tile(dstTile, srcTile, K0, K1, K2, K6, K7, K8, norm);
+    });
+}
+
+
+template < typename _Ty >
+PlaneT<_Ty> & EdgeDetect_Sobel(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -370,7 +616,7 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     dst.ReQuantize(dst.BitDepth(), QuantRange::PC, false);
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -395,7 +641,7 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
             R0 = R + P6 + 2 * (P7 - P1) - P2;
             R1 = R + P2 + 2 * (P5 - P3) - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -408,7 +654,7 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
             R0 = R + P6 + 2 * (P7 - P1) - P2;
             R1 = R + P2 + 2 * (P5 - P3) - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -416,7 +662,8 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
+template < typename _Ty >
+PlaneT<_Ty> & EdgeDetect_Prewitt(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -426,7 +673,7 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     dst.ReQuantize(dst.BitDepth(), QuantRange::PC, false);
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -451,7 +698,7 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
             R0 = R + P6 + P7 - P1 - P2;
             R1 = R + P2 + P5 - P3 - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(6));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -464,7 +711,7 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
             R0 = R + P6 + P7 - P1 - P2;
             R1 = R + P2 + P5 - P3 - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(6));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -472,7 +719,8 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
+template < typename _Ty >
+PlaneT<_Ty> & EdgeDetect_Laplace1(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -482,7 +730,7 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     sint32 Floor = static_cast<sint32>(dst.Floor());
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -505,7 +753,7 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 
             R = 4 * P4 - (P1 + P3 + P5 + P7);
             R = RoundDiv(Abs(R), sint32(4));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -516,7 +764,7 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 
             R = 4 * P4 - (P1 + P3 + P5 + P7);
             R = RoundDiv(Abs(R), sint32(4));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -524,7 +772,8 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
+template < typename _Ty >
+PlaneT<_Ty> & EdgeDetect_Laplace2(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -534,7 +783,7 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     sint32 Floor = static_cast<sint32>(dst.Floor());
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -557,7 +806,7 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 
             R = 8 * P4 - (P0 + P1 + P2 + P3 + P5 + P6 + P7 + P8);
             R = RoundDiv(Abs(R), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -568,7 +817,7 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 
             R = 8 * P4 - (P0 + P1 + P2 + P3 + P5 + P6 + P7 + P8);
             R = RoundDiv(Abs(R), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -576,7 +825,8 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
+template < typename _Ty >
+PlaneT<_Ty> & EdgeDetect_Laplace3(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -586,7 +836,7 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     sint32 Floor = static_cast<sint32>(dst.Floor());
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -609,7 +859,7 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 
             R = 12 * P4 - 2 * (P1 + P3 + P5 + P7) - (P0 + P2 + P6 + P8);
             R = RoundDiv(Abs(R), sint32(12));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -620,7 +870,7 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 
             R = 12 * P4 - 2 * (P1 + P3 + P5 + P7) - (P0 + P2 + P6 + P8);
             R = RoundDiv(Abs(R), sint32(12));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dst[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -628,7 +878,8 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect(Plane &dst, const Plane &src, EdgeKernel Kernel)
+template < typename _Ty >
+PlaneT<_Ty> & EdgeDetect(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, EdgeKernel Kernel)
 {
     switch (Kernel)
     {
@@ -651,3 +902,24 @@ Plane & EdgeDetect(Plane &dst, const Plane &src, EdgeKernel Kernel)
 
     return dst;
 }
+
+
+template Plane & Convolution3V<DType>(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm);
+template Plane16 & Convolution3V<uint16>(Plane16 &dst, const Plane16 &src, FLType K0, FLType K1, FLType K2, bool norm);
+template Plane8 & Convolution3V<uint8>(Plane8 &dst, const Plane8 &src, FLType K0, FLType K1, FLType K2, bool norm);
+
+template Plane & Convolution3H<DType>(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm);
+template Plane16 & Convolution3H<uint16>(Plane16 &dst, const Plane16 &src, FLType K0, FLType K1, FLType K2, bool norm);
+template Plane8 & Convolution3H<uint8>(Plane8 &dst, const Plane8 &src, FLType K0, FLType K1, FLType K2, bool norm);
+
+template Plane & Convolution3<DType>(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm);
+template Plane16 & Convolution3<uint16>(Plane16 &dst, const Plane16 &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm);
+template Plane8 & Convolution3<uint8>(Plane8 &dst, const Plane8 &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm);
+
+template Plane & FirstOrderDerivative3<DType>(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm);
+template Plane16 & FirstOrderDerivative3<uint16>(Plane16 &dst, const Plane16 &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm);
+template Plane8 & FirstOrderDerivative3<uint8>(Plane8 &dst, const Plane8 &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm);
+
+template Plane & EdgeDetect<DType>(Plane &dst, const Plane &src, EdgeKernel Kernel);
+template Plane16 & EdgeDetect<uint16>(Plane16 &dst, const Plane16 &src, EdgeKernel Kernel);
+template Plane8 & EdgeDetect<uint8>(Plane8 &dst, const Plane8 &src, EdgeKernel Kernel);
@@ -1,8 +1,10 @@
 #define ENABLE_PPL
 
 
+#include <limits>
 #include "Gaussian.h"
 #include "Conversion.hpp"
+#include "Block_SIMD.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -15,7 +17,107 @@ const Gaussian2D_Para Gaussian2D_Default;
 // Public functions of class Gaussian2D
 
 
+PCType Gaussian2D::TileHalo() const
+{
+    if (para.sigma <= 0)
+    {
+        return 0;
+    }
+
+    PCType halo = 0;
+
+    for (bool integer : { true, false })
+    {
+        const int algorithm = Algorithm(para.sigma, para.algorithm, integer);
+
+        if (algorithm == 2)
+        {
+            halo = Max(halo, BoxGaussian(para.sigma).Radius(integer));
+        }
+        else if (algorithm == 3)
+        {
+            halo = Max(halo, FixedPointGaussian(para.sigma).Radius());
+        }
+        else
+        {
+            // TiledRecursiveGaussian splits the plane into tiles itself
+            return -1;
+        }
+    }
+
+    return halo;
+}
+
+
+int Gaussian2D::Algorithm(ldbl sigma, int algorithm, bool integer)
+{
+    if (algorithm == 3 && !integer)
+    {
+        return 1;
+    }
+
+    if (algorithm > 0)
+    {
+        return algorithm;
+    }
+
+    // Per pixel, the stacked box filters cost about 1.8 (integer) and 2.2 (float) times of the recursive Gaussian filter
+    // in my tests for any sigma, and the tiled recursive Gaussian filter costs less than 2 times without halo.
+    // The fixed-point FIR avoids the conversions of Plane, and is faster than them with the IIR up to sigma = 8.
+    return integer && sigma <= 8 ? 3 : 1;
+}
+
+
+Plane_FL &Gaussian2D::process_Plane_FL(Plane_FL &dst, const Plane_FL &src)
+{
+    if (para.sigma <= 0)
+    {
+        dst = src;
+        return dst;
+    }
+
+    if (Algorithm(para.sigma, para.algorithm, false) == 2)
+    {
+        BoxGaussian GFilter(para.sigma);
+        GFilter(dst, src);
+    }
+    else
+    {
+        TiledRecursiveGaussian GFilter(para.sigma, true);
+        GFilter(dst, src);
+    }
+
+    return dst;
+}
+
 Plane &Gaussian2D::process_Plane(Plane &dst, const Plane &src)
+{
+    return process_PlaneT(dst, src);
+}
+
+Plane16 &Gaussian2D::process_Plane16(Plane16 &dst, const Plane16 &src)
+{
+    return process_PlaneT(dst, src);
+}
+
+Plane8 &Gaussian2D::process_Plane8(Plane8 &dst, const Plane8 &src)
+{
+    return process_PlaneT(dst, src);
+}
+
+Frame16 &Gaussian2D::process_Frame16(Frame16 &dst, const Frame16 &src)
+{
+    return process_Planes(dst, src);
+}
+
+Frame8 &Gaussian2D::process_Frame8(Frame8 &dst, const Frame8 &src)
+{
+    return process_Planes(dst, src);
+}
+
+
+template < typename _Ty >
+PlaneT<_Ty> &Gaussian2D::process_PlaneT(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src)
 {
     if (para.sigma <= 0)
     {
@@ -23,10 +125,26 @@ Plane &Gaussian2D::process_Plane(Plane &dst, const Plane &src)
         return dst;
     }
 
+    // The integer box filters and the fixed-point FIR keep the range of src
+    const int algorithm = Algorithm(para.sigma, para.algorithm, true);
+    const bool same_range = dst.Floor() == src.Floor() && dst.Ceil() == src.Ceil();
+
+    if (algorithm == 2 && same_range)
+    {
+        BoxGaussian GFilter(para.sigma);
+        GFilter(dst, src);
+        return dst;
+    }
+
+    if (algorithm == 3 && same_range && FixedPointGaussian::isValid(src))
+    {
+        FixedPointGaussian GFilter(para.sigma);
+        GFilter(dst, src);
+        return dst;
+    }
+
     Plane_FL data(src);
-    RecursiveGaussian GFilter(para.sigma, true);
-    
-    GFilter(data, data);
+    process_Plane_FL(data, data);
     RangeConvert(dst, data, true);
     
     return dst;
@@ -90,6 +208,18 @@ void RecursiveGaussian::setPara(ldbl sigma, bool _allow_negative)
 }
 
 
+ldbl RecursiveGaussian::Variance() const
+{
+    // The causal pass has the variance m2 / B + (m1 / B)^2 with the k-th moments mk of the feedback coefficients,
+    // and the anti-causal pass adds the same
+    const ldbl m1 = static_cast<ldbl>(B1) + 2 * static_cast<ldbl>(B2) + 3 * static_cast<ldbl>(B3);
+    const ldbl m2 = static_cast<ldbl>(B1) + 4 * static_cast<ldbl>(B2) + 9 * static_cast<ldbl>(B3);
+    const ldbl mean = m1 / B;
+
+    return iter * 2 * (m2 / B + mean * mean);
+}
+
+
 void RecursiveGaussian::filterV(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride)
 {
     _Dt d;
@@ -159,6 +289,16 @@ void RecursiveGaussian::filter(Plane_FL &dst, const Plane_FL &src)
 
 
 void RecursiveGaussian::filterV_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const
+{
+    filterV_Causal(dst, src, height, width, stride);
+
+    LOOP_Hinv_PPL(height, width, stride, [&](const PCType j, const PCType lower, const PCType upper)
+    {
+        filterV_AntiCausal(dst, j, height, lower, upper, stride);
+    });
+}
+
+void RecursiveGaussian::filterV_Causal(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const
 {
     if (dst != src)
     {
@@ -177,57 +317,1072 @@ void RecursiveGaussian::filterV_Kernel(FLType *dst, const FLType *src, PCType he
             dst[i0] = B * src[i0] + B1 * dst[i1] + B2 * dst[i2] + B3 * dst[i3];
         }
     });
+}
 
-    LOOP_Hinv_PPL(height, width, stride, [&](const PCType j, const PCType lower, const PCType upper)
+void RecursiveGaussian::filterV_AntiCausal(FLType *dst, PCType j, PCType height, PCType lower, PCType upper, PCType stride) const
+{
+    PCType i0 = lower;
+    PCType i1 = j >= height - 1 ? i0 : i0 + stride;
+    PCType i2 = j >= height - 2 ? i1 : i1 + stride;
+    PCType i3 = j >= height - 3 ? i2 : i2 + stride;
+
+    for (; i0 < upper; ++i0, ++i1, ++i2, ++i3)
     {
-        PCType i0 = lower;
-        PCType i1 = j >= height - 1 ? i0 : i0 + stride;
-        PCType i2 = j >= height - 2 ? i1 : i1 + stride;
-        PCType i3 = j >= height - 3 ? i2 : i2 + stride;
+        FLType res = B * dst[i0] + B1 * dst[i1] + B2 * dst[i2] + B3 * dst[i3];
+        if (allow_negative || res >= 0) dst[i0] = res;
+        else dst[i0] = 0;
+    }
+}
 
-        for (; i0 < upper; ++i0, ++i1, ++i2, ++i3)
+void RecursiveGaussian::filterH_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const
+{
+    // Each task filters a piece of rows, which the SIMD kernel processes several at a time
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        RecursiveGaussianH(dst + lower * stride, src + lower * stride, upper - lower, width, stride,
+            B, B1, B2, B3, allow_negative);
+    });
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class TiledRecursiveGaussian
+
+
+void TiledRecursiveGaussian::setPara(ldbl sigma, bool _allow_negative, PCType _tile_height, PCType _tile_width)
+{
+    _Mybase::setPara(sigma, _allow_negative);
+
+    tile_height = _tile_height;
+    tile_width = _tile_width;
+
+    const ldbl eps = std::numeric_limits<FLType>::epsilon();
+    const size_t max_length = 1 << 20;
+
+    ldbl y[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } }; // { y[n-1], y[n-2], y[n-3] } starting from each state
+
+    response.clear();
+
+    for (size_t n = 0; n < max_length; ++n)
+    {
+        ldbl peak = 0;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const ldbl y0 = B1 * y[c][0] + B2 * y[c][1] + B3 * y[c][2];
+            y[c][2] = y[c][1];
+            y[c][1] = y[c][0];
+            y[c][0] = y0;
+            peak = Max(peak, Max(Abs(y[c][0]), Max(Abs(y[c][1]), Abs(y[c][2]))));
+        }
+
+        if (peak < eps)
+        {
+            break;
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            response.push_back(static_cast<FLType>(y[c][0]));
+        }
+    }
+}
+
+
+void TiledRecursiveGaussian::filterV_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const
+{
+    if (tile_height <= 0 || tile_height >= height)
+    {
+        _Mybase::filterV_Kernel(dst, src, height, width, stride);
+        return;
+    }
+
+    filterLines(dst, src, height, width, stride, 1, tile_height, tile_width > 0 ? tile_width : PPL_WP);
+}
+
+void TiledRecursiveGaussian::filterH_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const
+{
+    if (tile_width <= 0 || tile_width >= width)
+    {
+        _Mybase::filterH_Kernel(dst, src, height, width, stride);
+        return;
+    }
+
+    // The rows of a task are interleaved, thus they are limited for the touched cache lines to stay in L1
+    const PCType rows = 32;
+
+    filterLines(dst, src, width, height, 1, stride, tile_width, tile_height > 0 ? Min(tile_height, rows) : rows);
+}
+
+
+// Recursion of lanes lines over length pixels from dst/src in the direction of step,
+// starting from the state of the first pixel as the border, dst can be the same as src
+static void RecursiveLines(FLType *dst, const FLType *src, PCType length, PCType lanes, PCType step, PCType lane_step,
+    FLType B, FLType B1, FLType B2, FLType B3)
+{
+    if (dst != src)
+    {
+        for (PCType l = 0; l < lanes; ++l)
+        {
+            dst[l * lane_step] = src[l * lane_step];
+        }
+    }
+
+    for (PCType n = 1; n < length; ++n)
+    {
+        FLType *d0 = dst + n * step;
+        const FLType *s0 = src + n * step;
+        const FLType *d1 = d0 - step;
+        const FLType *d2 = n < 2 ? d1 : d1 - step;
+        const FLType *d3 = n < 3 ? d2 : d2 - step;
+
+        for (PCType l = 0; l < lanes; ++l)
+        {
+            const PCType i = l * lane_step;
+            d0[i] = B * s0[i] + B1 * d1[i] + B2 * d2[i] + B3 * d3[i];
+        }
+    }
+}
+
+void TiledRecursiveGaussian::filterLines(FLType *dst, const FLType *src, PCType length, PCType lanes, PCType step, PCType lane_step,
+    PCType seg, PCType lane_piece) const
+{
+    // Segments of at least 3 pixels hold the whole state, a shorter remainder is merged into the last segment
+    seg = Max(seg, PCType(3));
+    PCType count = (length + seg - 1) / seg;
+    if (count > 1 && length - (count - 1) * seg < 3) --count;
+
+    const PCType pieces = (lanes + lane_piece - 1) / lane_piece;
+    const PCType resp_length = static_cast<PCType>(response.size() / 3);
+    const FLType *const resp = response.data();
+
+    // delta[(k * 3 + c) * lanes + l] is the actual state y[-1-c] of segment k minus the assumed one
+    std::vector<FLType> delta(count * 3 * lanes);
+    FLType *const deltap = delta.data();
+
+    // The first pixel of segment k in the direction of the recursion, and the k-th segment in the order of the recursion
+    const auto lower = [&](PCType k) { return k * seg; };
+    const auto upper = [&](PCType k) { return k == count - 1 ? length : (k + 1) * seg; };
+    const auto first = [&](bool causal, PCType k) { return causal ? lower(k) : upper(k) - 1; };
+    const auto order = [&](bool causal, PCType n) { return causal ? n : count - 1 - n; };
+
+    // Each segment from its own border, the causal recursion reads src and the anti-causal one works in place
+    const auto recurse = [&](bool causal, PCType k, PCType l0)
+    {
+        const PCType offset = first(causal, k) * step + l0 * lane_step;
+
+        RecursiveLines(dst + offset, (causal ? src : dst) + offset, upper(k) - lower(k), Min(lanes - l0, lane_piece),
+            causal ? step : -step, lane_step, B, B1, B2, B3);
+    };
+
+    // Hand over the actual states in the order of the recursion,
+    // the last pixels of the previous segment are corrected by its own delta on the fly
+    const auto handover = [&](bool causal)
+    {
+        const FLType *const in = causal ? src : dst;
+
+        _Parallel_for(PCType(0), pieces, [&](PCType p)
         {
-            FLType res = B * dst[i0] + B1 * dst[i1] + B2 * dst[i2] + B3 * dst[i3];
-            if (allow_negative || res >= 0) dst[i0] = res;
-            else dst[i0] = 0;
+            const PCType l0 = p * lane_piece;
+            const PCType l1 = Min(lanes, l0 + lane_piece);
+
+            for (PCType n = 1; n < count; ++n)
+            {
+                const PCType k = order(causal, n);
+                const PCType prev = order(causal, n - 1);
+                FLType *const d = deltap + k * 3 * lanes;
+                const FLType *const pd = deltap + prev * 3 * lanes;
+                const FLType *const x = in + first(causal, k) * step;
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    const PCType pos = upper(prev) - lower(prev) - 1 - c; // Position of state y[-1-c] in the previous segment
+                    const FLType *const y = dst + (first(causal, prev) + (causal ? pos : -pos)) * step;
+                    const FLType *const h = resp + pos * 3;
+                    const bool corrected = n > 1 && pos < resp_length;
+
+                    for (PCType l = l0; l < l1; ++l)
+                    {
+                        FLType actual = y[l * lane_step];
+                        if (corrected) actual += h[0] * pd[l] + h[1] * pd[lanes + l] + h[2] * pd[lanes * 2 + l];
+                        d[c * lanes + l] = actual - x[l * lane_step];
+                    }
+                }
+            }
+        });
+    };
+
+    // Add the response to the delta to the head of each segment but the first one in the order of the recursion,
+    // and set negative results to 0 after the anti-causal recursion
+    const auto correct = [&](bool causal, PCType k, PCType l0)
+    {
+        const PCType l1 = Min(lanes, l0 + lane_piece);
+        const PCType seg_length = upper(k) - lower(k);
+        const PCType rstep = causal ? step : -step;
+        const FLType *const d = deltap + k * 3 * lanes;
+
+        if (k != order(causal, 0))
+        {
+            const PCType corr_length = Min(seg_length, resp_length);
+
+            for (PCType n = 0; n < corr_length; ++n)
+            {
+                FLType *const y = dst + first(causal, k) * step + n * rstep;
+                const FLType *const h = resp + n * 3;
+
+                for (PCType l = l0; l < l1; ++l)
+                {
+                    y[l * lane_step] += h[0] * d[l] + h[1] * d[lanes + l] + h[2] * d[lanes * 2 + l];
+                }
+            }
+        }
+
+        if (!causal && !allow_negative)
+        {
+            for (PCType n = 0; n < seg_length; ++n)
+            {
+                FLType *const y = dst + first(causal, k) * step + n * rstep;
+
+                for (PCType l = l0; l < l1; ++l)
+                {
+                    if (y[l * lane_step] < 0) y[l * lane_step] = 0;
+                }
+            }
         }
+    };
+
+    _Parallel_for(PCType(0), count * pieces, [&](PCType t)
+    {
+        recurse(true, t / pieces, t % pieces * lane_piece);
+    });
+
+    handover(true);
+
+    // The anti-causal recursion of a segment only reads the causal results of itself
+    _Parallel_for(PCType(0), count * pieces, [&](PCType t)
+    {
+        correct(true, t / pieces, t % pieces * lane_piece);
+        recurse(false, t / pieces, t % pieces * lane_piece);
+    });
+
+    handover(false);
+
+    _Parallel_for(PCType(0), count * pieces, [&](PCType t)
+    {
+        correct(false, t / pieces, t % pieces * lane_piece);
     });
 }
 
-void RecursiveGaussian::filterH_Kernel(FLType *dst, const FLType *src, PCType height, PCType width, PCType stride) const
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class PyramidGaussian
+
+
+PCType PyramidGaussian::Factor(ldbl sigma, ldbl error)
+{
+    // In my tests, the error against RecursiveGaussian is about k * sqrt(factor / sigma) except the borders,
+    // mostly due to the different shapes of the recursive filter at different sigmas rather than the interpolation,
+    // while the error against the ideal Gaussian is about the same as that of RecursiveGaussian itself.
+    // The decimated sigma is kept large enough for the recursive Gaussian filter to be accurate.
+    const ldbl k = 0.03L;
+    const ldbl min_sigma = 4.0L;
+
+    if (error <= 0 || sigma <= 0)
+    {
+        return 1;
+    }
+
+    const ldbl ratio = error / k;
+    const ldbl factor = Min(sigma * ratio * ratio, sigma / min_sigma);
+
+    return factor < 2 ? 1 : static_cast<PCType>(factor);
+}
+
+
+void PyramidGaussian::setPara(ldbl sigma, ldbl error, bool allow_negative)
+{
+    factor = Factor(sigma, error);
+    GFilter.setPara(sigma, allow_negative);
+
+    if (factor <= 1)
+    {
+        return;
+    }
+
+    // Block averaging adds a variance of (factor^2 - 1) / 12 and bilinear interpolation adds about factor^2 / 6,
+    // the sigma on the decimated plane is searched to match the variance of the recursive Gaussian filter of sigma
+    const ldbl f2 = static_cast<ldbl>(factor) * factor;
+    const ldbl target = (GFilter.Variance() - (f2 - 1) / 12 - f2 / 6) / f2;
+
+    ldbl lower = 0.5L;
+    ldbl upper = sigma / factor * 2;
+
+    for (int i = 0; i < 40; ++i)
+    {
+        const ldbl mid = (lower + upper) / 2;
+        RecursiveGaussian(mid, allow_negative).Variance() < target ? lower = mid : upper = mid;
+    }
+
+    GFilter.setPara((lower + upper) / 2, allow_negative);
+}
+
+
+Plane_FL &PyramidGaussian::operator()(Plane_FL &dst, const Plane_FL &src) const
 {
-    LOOP_V_PPL(height, [&](const PCType j)
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+    const PCType stride = src.Stride();
+
+    if (!isDecimated())
+    {
+        FLType *dstp = dst.data();
+
+        GFilter.filterH_Kernel(dstp, src.data(), height, width, stride);
+        GFilter.filterV_Kernel(dstp, dstp, height, width, stride);
+
+        for (int i = 1; i < GFilter.iter; ++i)
+        {
+            GFilter.filterH_Kernel(dstp, dstp, height, width, stride);
+            GFilter.filterV_Kernel(dstp, dstp, height, width, stride);
+        }
+
+        return dst;
+    }
+
+    // Decimate by averaging blocks of factor x factor pixels, the blocks at the right and bottom borders may be smaller
+    const PCType dheight = (height + factor - 1) / factor;
+    const PCType dwidth = (width + factor - 1) / factor;
+
+    Plane_FL dec(src.Floor(), dwidth, dheight, src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), false);
+
+    const PCType dstride = dec.Stride();
+    FLType *decp = dec.data();
+    const FLType *srcp = src.data();
+
+    _Parallel_for(PCType(0), dheight, [&](PCType y)
     {
-        const PCType lower = j * stride;
-        const PCType upper = lower + width - 1;
+        const PCType jLower = y * factor;
+        const PCType jUpper = Min(height, jLower + factor);
+        FLType *decRow = decp + y * dstride;
+
+        for (PCType x = 0; x < dwidth; ++x)
+        {
+            decRow[x] = 0;
+        }
+
+        for (PCType j = jLower; j < jUpper; ++j)
+        {
+            const FLType *srcRow = srcp + j * stride;
+
+            for (PCType x = 0, i = 0; x < dwidth; ++x)
+            {
+                const PCType iUpper = Min(width, i + factor);
+                FLType sum = 0;
+
+                for (; i < iUpper; ++i)
+                {
+                    sum += srcRow[i];
+                }
+
+                decRow[x] += sum;
+            }
+        }
 
-        PCType i = lower;
-        FLType P0, P1, P2, P3;
-        P3 = P2 = P1 = src[i];
-        dst[i] = src[i];
+        const PCType rows = jUpper - jLower;
 
-        while (i < upper)
+        for (PCType x = 0; x < dwidth; ++x)
         {
-            ++i;
-            P0 = B * src[i] + B1 * P1 + B2 * P2 + B3 * P3;
-            P3 = P2;
-            P2 = P1;
-            P1 = P0;
-            dst[i] = P0;
+            const PCType cols = Min(width, (x + 1) * factor) - x * factor;
+            decRow[x] /= static_cast<FLType>(rows * cols);
         }
+    });
+
+    GFilter.filterH_Kernel(decp, decp, dheight, dwidth, dstride);
+    GFilter.filterV_Kernel(decp, decp, dheight, dwidth, dstride);
+
+    for (int i = 1; i < GFilter.iter; ++i)
+    {
+        GFilter.filterH_Kernel(decp, decp, dheight, dwidth, dstride);
+        GFilter.filterV_Kernel(decp, decp, dheight, dwidth, dstride);
+    }
+
+    // Bilinear interpolation from the centers of the blocks, clamped at the borders
+    struct Tap
+    {
+        PCType lower;
+        PCType upper;
+        FLType weight;
+    };
 
-        P3 = P2 = P1 = dst[i];
+    const auto taps = [&](PCType size, PCType dsize)
+    {
+        std::vector<Tap> result(size);
 
-        while (i > lower)
+        for (PCType i = 0; i < size; ++i)
         {
-            --i;
-            P0 = B * dst[i] + B1 * P1 + B2 * P2 + B3 * P3;
-            P3 = P2;
-            P2 = P1;
-            P1 = P0;
-            if (allow_negative || P0 >= 0) dst[i] = P0;
-            else dst[i] = 0;
+            const FLType pos = Clip((static_cast<FLType>(i) + FLType(0.5)) / factor - FLType(0.5),
+                FLType(0), static_cast<FLType>(dsize - 1));
+            const PCType lower = Min(static_cast<PCType>(pos), dsize - 1);
+
+            result[i] = Tap{ lower, Min(lower + 1, dsize - 1), pos - lower };
         }
+
+        return result;
+    };
+
+    const std::vector<Tap> tapH = taps(width, dwidth);
+    const std::vector<Tap> tapV = taps(height, dheight);
+
+    FLType *dstp = dst.data();
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType upper = Min(height, (p + 1) * PPL_HP);
+        std::vector<FLType> row(dwidth);
+
+        for (PCType j = p * PPL_HP; j < upper; ++j)
+        {
+            const Tap &v = tapV[j];
+            const FLType *row0 = decp + v.lower * dstride;
+            const FLType *row1 = decp + v.upper * dstride;
+            FLType *dstRow = dstp + j * stride;
+
+            for (PCType x = 0; x < dwidth; ++x)
+            {
+                row[x] = row0[x] + (row1[x] - row0[x]) * v.weight;
+            }
+
+            for (PCType i = 0; i < width; ++i)
+            {
+                const Tap &h = tapH[i];
+                dstRow[i] = row[h.lower] + (row[h.upper] - row[h.lower]) * h.weight;
+            }
+        }
+    });
+
+    return dst;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class BoxGaussian
+
+
+// Fractional bits of the intermediate result between the horizontal and the vertical passes for Plane
+static const int BoxFracBits = 8;
+
+
+// Lines are interleaved in multiples of this, and filtered in chunks of this with the sums in registers
+static const PCType BoxLanes = 16;
+
+
+// Stacked box filters of radii r[0], r[1]... on lanes interleaved lines, each line has length elements,
+// and the result is stored in place in the first length - 2 * (r[0] + r[1] + ...) elements.
+// The passes run in a single sweep, each one lagging behind the previous one, and storing its result
+// over the elements the previous one no longer needs, thus the lines are read and written only once.
+template < typename _Ty >
+static void BoxPasses(_Ty *buf, PCType length, PCType lanes, const PCType *r, int count)
+{
+    for (PCType c = 0; c < lanes; c += BoxLanes)
+    {
+        _Ty acc[BoxGaussian::PassNum][BoxLanes] = {};
+
+        for (PCType s = 0; s < length; ++s)
+        {
+            PCType e = s;
+
+            for (int k = 0; k < count; ++k)
+            {
+                const _Ty *pe = buf + e * lanes + c;
+
+                for (PCType l = 0; l < BoxLanes; ++l)
+                {
+                    acc[k][l] += pe[l];
+                }
+
+                if (e < 2 * r[k]) break;
+
+                e -= 2 * r[k];
+                _Ty *pm = buf + e * lanes + c;
+                _Ty first[BoxLanes];
+
+                for (PCType l = 0; l < BoxLanes; ++l)
+                {
+                    first[l] = pm[l];
+                }
+
+                for (PCType l = 0; l < BoxLanes; ++l)
+                {
+                    pm[l] = acc[k][l];
+                    acc[k][l] -= first[l];
+                }
+            }
+        }
+    }
+}
+
+
+// Stacked extended box filters of radius r + 1, whose ends are weighted by weightEnd and the others by weight,
+// in a single sweep the same as BoxPasses, the result is in the first length - 2 * (r + 1) * count elements
+template < typename _Ty >
+static void ExtendedBoxPasses(_Ty *buf, PCType length, PCType lanes, PCType r, int count, _Ty weight, _Ty weightEnd)
+{
+    const PCType span = 2 * r + 2;
+
+    for (PCType c = 0; c < lanes; c += BoxLanes)
+    {
+        _Ty acc[BoxGaussian::PassNum][BoxLanes] = {};
+
+        for (PCType s = 0; s < length; ++s)
+        {
+            PCType e = s;
+
+            for (int k = 0; k < count; ++k)
+            {
+                if (e < 2) break;
+
+                // The sum of the inner elements of the window [e - span, e]
+                const _Ty *pi = buf + (e - 1) * lanes + c;
+
+                for (PCType l = 0; l < BoxLanes; ++l)
+                {
+                    acc[k][l] += pi[l];
+                }
+
+                if (e < span) break;
+
+                e -= span;
+                _Ty *pm = buf + e * lanes + c;
+                const _Ty *pn = pm + lanes;
+                const _Ty *pe = pm + span * lanes;
+                _Ty ends[BoxLanes];
+                _Ty next[BoxLanes];
+
+                for (PCType l = 0; l < BoxLanes; ++l)
+                {
+                    ends[l] = pm[l] + pe[l];
+                    next[l] = pn[l];
+                }
+
+                for (PCType l = 0; l < BoxLanes; ++l)
+                {
+                    pm[l] = acc[k][l] * weight + ends[l] * weightEnd;
+                    acc[k][l] -= next[l];
+                }
+            }
+        }
+    }
+}
+
+
+// Groups of rows of src are extended by radius with the edge pixels, interleaved so that the passes run on the rows together,
+// filtered by _Passes(buf, length, lanes), and stored to dst by _Store
+template < typename _Ty, typename _Dt1, typename _St1, typename _Fn1, typename _Fn2 >
+static void BoxFilterH(_Dt1 *dst, const _St1 *src, PCType height, PCType width, PCType dst_stride, PCType src_stride,
+    PCType radius, _Fn1 &&_Passes, _Fn2 &&_Store)
+{
+    const PCType lanes = BoxLanes;
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType upper = Min(height, (p + 1) * PPL_HP);
+        const PCType length = width + 2 * radius;
+        _Ty *buf = nullptr;
+        PoolMalloc(buf, length * lanes);
+
+        for (PCType j = p * PPL_HP; j < upper; j += lanes)
+        {
+            const PCType rows = Min(upper - j, lanes);
+
+            // The lanes without rows are filled with the last row
+            for (PCType l = 0; l < lanes; ++l)
+            {
+                const _St1 *srcp = src + (j + Min(l, rows - 1)) * src_stride;
+                _Ty *bufp = buf + l;
+                const _Ty left = static_cast<_Ty>(srcp[0]);
+                const _Ty right = static_cast<_Ty>(srcp[width - 1]);
+                PCType t = 0;
+
+                for (; t < radius; ++t) bufp[t * lanes] = left;
+                for (; t < radius + width; ++t) bufp[t * lanes] = static_cast<_Ty>(srcp[t - radius]);
+                for (; t < length; ++t) bufp[t * lanes] = right;
+            }
+
+            _Passes(buf, width, lanes);
+
+            for (PCType l = 0; l < rows; ++l)
+            {
+                _Dt1 *dstp = dst + (j + l) * dst_stride;
+                const _Ty *bufp = buf + l;
+
+                for (PCType i = 0; i < width; ++i)
+                {
+                    dstp[i] = _Store(bufp[i * lanes]);
+                }
+            }
+        }
+
+        PoolFree(buf);
+    });
+}
+
+
+// Strips of columns of src are extended by radius with the edge rows, filtered as interleaved lines,
+// and stored to dst by _Store
+template < typename _Ty, typename _Dt1, typename _St1, typename _Fn1, typename _Fn2 >
+static void BoxFilterV(_Dt1 *dst, const _St1 *src, PCType height, PCType width, PCType dst_stride, PCType src_stride,
+    PCType radius, _Fn1 &&_Passes, _Fn2 &&_Store)
+{
+    const PCType pNum = (width + BoxLanes - 1) / BoxLanes;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType offset = p * BoxLanes;
+        const PCType cols = Min(width - offset, BoxLanes);
+        const PCType lanes = (cols + BoxLanes - 1) / BoxLanes * BoxLanes;
+        const PCType length = height + 2 * radius;
+        _Ty *buf = nullptr;
+        PoolMalloc(buf, length * lanes);
+
+        // The lanes without columns are filled with the last column
+        for (PCType t = 0; t < length; ++t)
+        {
+            const _St1 *srcp = src + Clip(t - radius, PCType(0), height - 1) * src_stride + offset;
+            _Ty *bufp = buf + t * lanes;
+            PCType l = 0;
+
+            for (; l < cols; ++l) bufp[l] = static_cast<_Ty>(srcp[l]);
+            for (; l < lanes; ++l) bufp[l] = static_cast<_Ty>(srcp[cols - 1]);
+        }
+
+        _Passes(buf, height, lanes);
+
+        for (PCType j = 0; j < height; ++j)
+        {
+            _Dt1 *dstp = dst + j * dst_stride + offset;
+            const _Ty *bufp = buf + j * lanes;
+
+            for (PCType l = 0; l < cols; ++l)
+            {
+                dstp[l] = _Store(bufp[l]);
+            }
+        }
+
+        PoolFree(buf);
+    });
+}
+
+
+void BoxGaussian::setPara(ldbl sigma)
+{
+    const ldbl var = sigma > 0 ? sigma * sigma : 0;
+
+    // Plain box filters of widths wl and wl + 2, mixed to approximate the variance
+    PCType wl = static_cast<PCType>(sqrt(12 * var / PassNum + 1));
+    if (wl % 2 == 0) --wl;
+
+    const ldbl m = (12 * var - PassNum * wl * wl - 4 * PassNum * wl - 3 * PassNum) / (-4 * wl - 4);
+    const int mInt = Clip(static_cast<int>(m + 0.5L), 0, PassNum);
+
+    for (int k = 0; k < PassNum; ++k)
+    {
+        radiusInt[k] = (k < mInt ? wl : wl + 2) / 2;
+    }
+
+    // Extended box filters with the same variance var / PassNum for each pass
+    const ldbl v = var / PassNum;
+    const PCType r = static_cast<PCType>((sqrt(12 * v + 1) - 1) / 2);
+    const ldbl alpha = (2 * r + 1) * (r * (r + 1) - 3 * v) / (6 * (v - (r + 1) * (r + 1)));
+    const ldbl weight = 1 / (2 * r + 1 + 2 * alpha);
+
+    radiusFL = r;
+    weightFL = static_cast<FLType>(weight);
+    weightEnd = static_cast<FLType>(alpha * weight);
+}
+
+
+PCType BoxGaussian::Radius(bool integer) const
+{
+    PCType radius = 0;
+
+    for (int k = 0; k < PassNum; ++k)
+    {
+        radius += integer ? radiusInt[k] : radiusFL + 1;
+    }
+
+    return radius;
+}
+
+
+bool BoxGaussian::isIntegerValid() const
+{
+    // The sums of 16-bit values with fractional bits are kept below 2^62
+    sint64 product = 1;
+
+    for (int k = 0; k < PassNum; ++k)
+    {
+        product *= 2 * radiusInt[k] + 1;
+    }
+
+    return product <= (sint64(1) << (62 - 16 - BoxFracBits));
+}
+
+
+Plane_FL &BoxGaussian::operator()(Plane_FL &dst, const Plane_FL &src) const
+{
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+    const PCType radius = Radius(false);
+
+    const auto passes = [&](FLType *buf, PCType length, PCType lanes)
+    {
+        ExtendedBoxPasses(buf, length + 2 * radius, lanes, radiusFL, PassNum, weightFL, weightEnd);
+    };
+
+    const auto store = [](FLType x) { return x; };
+
+    Plane_FL temp(src, false);
+
+    BoxFilterH<FLType>(temp.data(), src.data(), height, width, temp.Stride(), src.Stride(), radius, passes, store);
+    BoxFilterV<FLType>(dst.data(), temp.data(), height, width, dst.Stride(), temp.Stride(), radius, passes, store);
+
+    return dst;
+}
+
+
+template < typename _Ty >
+PlaneT<_Ty> &BoxGaussian::operator()(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src) const
+{
+    if (!isIntegerValid())
+    {
+        Plane_FL data(src);
+        operator()(data, data);
+        RangeConvert(dst, data, true);
+        return dst;
+    }
+
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+    const PCType radius = Radius(true);
+
+    sint64 product = 1;
+
+    for (int k = 0; k < PassNum; ++k)
+    {
+        product *= 2 * radiusInt[k] + 1;
+    }
+
+    const auto passes = [&](sint64 *buf, PCType length, PCType lanes)
+    {
+        BoxPasses(buf, length + 2 * radius, lanes, radiusInt, PassNum);
+    };
+
+    // The sums are divided by the product of the widths with rounding, keeping fractional bits in the intermediate result
+    const auto divide = [](sint64 x, sint64 div)
+    {
+        return x >= 0 ? (x + div / 2) / div : -((div / 2 - x) / div);
+    };
+
+    sint32 *temp = nullptr;
+    PoolMalloc(temp, height * width);
+
+    BoxFilterH<sint64>(temp, src.data(), height, width, width, src.Stride(), radius, passes, [&](sint64 x)
+    {
+        return static_cast<sint32>(divide(x << BoxFracBits, product));
+    });
+
+    const sint64 Floor = dst.Floor();
+    const sint64 Ceil = dst.Ceil();
+
+    // Clipped before narrowing, as the unsigned storage types can't hold the undershoot
+    BoxFilterV<sint64>(dst.data(), temp, height, width, dst.Stride(), width, radius, passes, [&](sint64 x)
+    {
+        return static_cast<_Ty>(Clip(divide(x, product << BoxFracBits), Floor, Ceil));
+    });
+
+    PoolFree(temp);
+
+    return dst;
+}
+
+template Plane &BoxGaussian::operator()<DType>(Plane &dst, const Plane &src) const;
+template Plane16 &BoxGaussian::operator()<uint16>(Plane16 &dst, const Plane16 &src) const;
+template Plane8 &BoxGaussian::operator()<uint8>(Plane8 &dst, const Plane8 &src) const;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class FixedPointGaussian
+
+
+void FixedPointGaussian::setPara(ldbl sigma)
+{
+    const sint32 total = sint32(1) << WeightBits;
+
+    weight.assign(1, static_cast<sint16>(total));
+
+    if (sigma <= 0)
+    {
+        return;
+    }
+
+    // The Gaussian truncated at 6 sigma is quantized, then the tails rounded to 0 are dropped
+    const PCType max_radius = static_cast<PCType>(ceil(sigma * 6));
+    std::vector<ldbl> kernel(max_radius + 1);
+    ldbl sum = 0;
+
+    for (PCType k = 0; k <= max_radius; ++k)
+    {
+        kernel[k] = exp(-ldbl(k * k) / (2 * sigma * sigma));
+        sum += k > 0 ? kernel[k] * 2 : kernel[k];
+    }
+
+    const ldbl scale = total / sum;
+    PCType radius = max_radius;
+
+    while (radius > 0 && static_cast<sint32>(kernel[radius] * scale + 0.5L) == 0)
+    {
+        --radius;
+    }
+
+    weight.resize(radius * 2 + 1);
+    sint32 rounded = 0;
+
+    for (PCType k = -radius; k <= radius; ++k)
+    {
+        weight[k + radius] = static_cast<sint16>(kernel[Abs(k)] * scale + 0.5L);
+        rounded += weight[k + radius];
+    }
+
+    // The error of rounding goes to the center weight, thus the weights sum to 1 << WeightBits exactly
+    weight[radius] += static_cast<sint16>(total - rounded);
+}
+
+
+template < typename _Ty >
+PlaneT<_Ty> &FixedPointGaussian::operator()(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src) const
+{
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+    const PCType radius = Radius();
+    const PCType count = static_cast<PCType>(weight.size());
+    const sint16 *const weightp = weight.data();
+
+    // The intermediate result keeps 16 - bit depth fractional bits in 16-bit
+    int bits = 1;
+    while (bits < 16 && (sint32(1) << bits) <= src.Ceil()) ++bits;
+
+    const int frac = Min(16 - bits, WeightBits);
+    const int shiftH = WeightBits - frac;
+    const int shiftV = WeightBits + frac;
+    const sint32 roundH = shiftH > 0 ? sint32(1) << (shiftH - 1) : 0;
+    const sint32 roundV = sint32(1) << (shiftV - 1);
+
+    // The pixels are biased to signed 16-bit, and the bias of the sums is the bias times the sum of the weights
+    const sint32 bias = 32768;
+    const sint32 offset = bias << WeightBits;
+
+    sint16 *temp = nullptr;
+    PoolMalloc(temp, height * width);
+
+    const _Ty *srcp = src.data();
+    const PCType src_stride = src.Stride();
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    // Each row is extended by radius with the edge pixels, and the taps are the shifted pointers of the extended row
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        std::vector<sint16> line(width + radius * 2);
+        std::vector<const sint16 *> taps(count);
+        std::vector<sint32> sum(width);
+
+        for (PCType k = 0; k < count; ++k)
+        {
+            taps[k] = line.data() + k;
+        }
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            const _Ty *s = srcp + j * src_stride;
+            sint16 *t = temp + j * width;
+
+            for (PCType x = 0; x < radius; ++x)
+            {
+                line[x] = static_cast<sint16>(s[0] - bias);
+                line[radius + width + x] = static_cast<sint16>(s[width - 1] - bias);
+            }
+
+            for (PCType x = 0; x < width; ++x)
+            {
+                line[radius + x] = static_cast<sint16>(s[x] - bias);
+            }
+
+            WeightedSum(sum.data(), taps.data(), weightp, count, width);
+
+            for (PCType x = 0; x < width; ++x)
+            {
+                t[x] = static_cast<sint16>(((sum[x] + offset + roundH) >> shiftH) - bias);
+            }
+        }
+    });
+
+    _Ty *dstp = dst.data();
+    const PCType dst_stride = dst.Stride();
+
+    // The rows beyond the plane are the edge rows
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType lower = p * PPL_HP;
+        const PCType upper = Min(height, lower + PPL_HP);
+
+        std::vector<const sint16 *> taps(count);
+        std::vector<sint32> sum(width);
+
+        for (PCType j = lower; j < upper; ++j)
+        {
+            _Ty *d = dstp + j * dst_stride;
+
+            for (PCType k = 0; k < count; ++k)
+            {
+                taps[k] = temp + Clip(j + k - radius, PCType(0), height - 1) * width;
+            }
+
+            WeightedSum(sum.data(), taps.data(), weightp, count, width);
+
+            for (PCType x = 0; x < width; ++x)
+            {
+                d[x] = static_cast<_Ty>((sum[x] + offset + roundV) >> shiftV);
+            }
+        }
+    });
+
+    PoolFree(temp);
+
+    return dst;
+}
+
+template Plane &FixedPointGaussian::operator()<DType>(Plane &dst, const Plane &src) const;
+template Plane16 &FixedPointGaussian::operator()<uint16>(Plane16 &dst, const Plane16 &src) const;
+template Plane8 &FixedPointGaussian::operator()<uint8>(Plane8 &dst, const Plane8 &src) const;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class RecursiveGaussianBank
+
+
+RecursiveGaussianBank::RecursiveGaussianBank(const std::vector<ldbl> &sigmaVector, bool allow_negative, ldbl error)
+    : sigma(sigmaVector)
+{
+    filters.reserve(sigma.size());
+
+    for (auto s : sigma)
+    {
+        filters.emplace_back(s > 0 ? s : 1, error, allow_negative);
+    }
+}
+
+
+void RecursiveGaussianBank::operator()(const Plane_FL &src, const Combiner &_Func) const
+{
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+    const PCType stride = src.Stride();
+    const size_t scount = sigma.size();
+
+    // Rows of src filtered by all the scales while they stay in cache
+    const PCType group = 32;
+
+    std::vector<Plane_FL> planes;
+    std::vector<const RecursiveGaussian *> active;
+    std::vector<FLType *> dstp;
+    std::vector<const FLType *> gauss(scount, src.data());
+
+    planes.reserve(scount);
+
+    for (size_t s = 0; s < scount; ++s)
+    {
+        if (sigma[s] > 0)
+        {
+            planes.emplace_back(src, false);
+            gauss[s] = planes.back().data();
+
+            if (filters[s].isDecimated())
+            {
+                filters[s](planes.back(), src);
+            }
+            else
+            {
+                active.push_back(&filters[s].GFilter);
+                dstp.push_back(planes.back().data());
+            }
+        }
+    }
+
+    if (active.empty())
+    {
+        LOOP_Hinv_PPL(height, width, stride, [&](const PCType j, const PCType lower, const PCType upper)
+        {
+            _Func(j, lower, upper, gauss.data());
+        });
+
+        return;
+    }
+
+    const size_t acount = active.size();
+    const FLType *srcp = src.data();
+
+    // The first horizontal pass of all the scales, sharing the reads of src
+    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+
+    _Parallel_for(PCType(0), pNum, [&](PCType p)
+    {
+        const PCType upper = Min(height, (p + 1) * PPL_HP);
+
+        for (PCType lower = p * PPL_HP; lower < upper; lower += group)
+        {
+            const PCType rows = Min(upper - lower, group);
+
+            for (size_t s = 0; s < acount; ++s)
+            {
+                const RecursiveGaussian &f = *active[s];
+                RecursiveGaussianH(dstp[s] + lower * stride, srcp + lower * stride, rows, width, stride,
+                    f.B, f.B1, f.B2, f.B3, f.allow_negative);
+            }
+        }
+    });
+
+    // The remaining iterations of large sigmas, and the causal part of the last vertical pass
+    for (size_t s = 0; s < acount; ++s)
+    {
+        const RecursiveGaussian &f = *active[s];
+
+        for (int i = 1; i < f.iter; ++i)
+        {
+            f.filterV_Kernel(dstp[s], dstp[s], height, width, stride);
+            f.filterH_Kernel(dstp[s], dstp[s], height, width, stride);
+        }
+
+        f.filterV_Causal(dstp[s], dstp[s], height, width, stride);
+    }
+
+    // The anti-causal part of the last vertical pass of all the scales in lockstep, each row combined when finished
+    LOOP_Hinv_PPL(height, width, stride, [&](const PCType j, const PCType lower, const PCType upper)
+    {
+        for (size_t s = 0; s < acount; ++s)
+        {
+            active[s]->filterV_AntiCausal(dstp[s], j, height, lower, upper, stride);
+        }
+
+        _Func(j, lower, upper, gauss.data());
     });
 }
 
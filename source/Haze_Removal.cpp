@@ -73,34 +73,40 @@ void Haze_Removal::RemoveHaze()
     const FLType mulG = para.strength / AL_G;
     const FLType mulB = para.strength / AL_B;
 
+    // The pointers are taken once, so that the loops don't check the sharing of the planes for every pixel
+    FLType *Rp = dataR.data();
+    FLType *Gp = dataG.data();
+    FLType *Bp = dataB.data();
+    const FLType *tMapp = tMapInv.data();
+
     if (para.debug == 2)
     {
         LOOP_VH_PPL(height, width, stride, [&](PCType i)
         {
-            dataR[i] = tMapInv[i];
-            dataG[i] = tMapInv[i];
-            dataB[i] = tMapInv[i];
+            Rp[i] = tMapp[i];
+            Gp[i] = tMapp[i];
+            Bp[i] = tMapp[i];
         });
     }
     else if (para.debug == 3)
     {
         LOOP_VH_PPL(height, width, stride, [&](PCType i)
         {
-            dataR[i] = Max(para.tMapMin, para.tMapMax - tMapInv[i] * mulR);
-            dataG[i] = Max(para.tMapMin, para.tMapMax - tMapInv[i] * mulG);
-            dataB[i] = Max(para.tMapMin, para.tMapMax - tMapInv[i] * mulB);
+            Rp[i] = Max(para.tMapMin, para.tMapMax - tMapp[i] * mulR);
+            Gp[i] = Max(para.tMapMin, para.tMapMax - tMapp[i] * mulG);
+            Bp[i] = Max(para.tMapMin, para.tMapMax - tMapp[i] * mulB);
         });
     }
     else
     {
         LOOP_VH_PPL(height, width, stride, [&](PCType i)
         {
-            const FLType divR = Max(para.tMapMin, para.tMapMax - tMapInv[i] * mulR);
-            const FLType divG = Max(para.tMapMin, para.tMapMax - tMapInv[i] * mulG);
-            const FLType divB = Max(para.tMapMin, para.tMapMax - tMapInv[i] * mulB);
-            dataR[i] = (dataR[i] - AL_R) / divR + AL_R;
-            dataG[i] = (dataG[i] - AL_G) / divG + AL_G;
-            dataB[i] = (dataB[i] - AL_B) / divB + AL_B;
+            const FLType divR = Max(para.tMapMin, para.tMapMax - tMapp[i] * mulR);
+            const FLType divG = Max(para.tMapMin, para.tMapMax - tMapp[i] * mulG);
+            const FLType divB = Max(para.tMapMin, para.tMapMax - tMapp[i] * mulB);
+            Rp[i] = (Rp[i] - AL_R) / divR + AL_R;
+            Gp[i] = (Gp[i] - AL_G) / divG + AL_G;
+            Bp[i] = (Bp[i] - AL_B) / divB + AL_B;
         });
     }
 }
@@ -173,7 +179,7 @@ void Haze_Removal_Retinex::GetTMapInv()
     if (scount == 1 && para.sigmaVector[0] > 0) // single-scale Gaussian filter
     {
         Plane_FL gauss(refY, false);
-        RecursiveGaussian GFilter(para.sigmaVector[0], true);
+        PyramidGaussian GFilter(para.sigmaVector[0], para.approx_error, true);
         GFilter(gauss, refY);
 
         tMapInv = Plane_FL(refY, false);
@@ -190,69 +196,52 @@ void Haze_Removal_Retinex::GetTMapInv()
             }
         });
     }
-    else if (scount == 2 && para.sigmaVector[0] > 0 && para.sigmaVector[1] > 0) // double-scale Gaussian filter
+    else // multi-scale Gaussian filter
     {
-        Plane_FL gauss0(refY, false);
-        RecursiveGaussian GFilter0(para.sigmaVector[0], true);
-        GFilter0(gauss0, refY);
-
-        Plane_FL gauss1(refY, false);
-        RecursiveGaussian GFilter1(para.sigmaVector[1], true);
-        GFilter1(gauss1, refY);
-
         tMapInv = Plane_FL(refY, false);
 
-        LOOP_VH_PPL(height, width, stride, [&](PCType i)
-        {
-            if (gauss0[i] > 0 && gauss1[i] > 0)
-            {
-                tMapInv[i] = sqrt(gauss0[i] * gauss1[i]);
-            }
-            else
-            {
-                tMapInv[i] = 0;
-            }
-        });
-    }
-    else // multi-scale Gaussian filter
-    {
-        tMapInv = Plane_FL(refY, true, 1);
-        Plane_FL gauss(refY, false);
+        FLType *tMapInvp = tMapInv.data();
+        const FLType *refYp = refY.data();
+
+        // All the scales are filtered in a single sweep, and each row is combined as soon as it's finished
+        RecursiveGaussianBank GBank(para.sigmaVector, true, para.approx_error);
 
-        for (s = 0; s < scount; ++s)
+        if (scount == 2 && para.sigmaVector[0] > 0 && para.sigmaVector[1] > 0) // double-scale Gaussian filter
         {
-            if (para.sigmaVector[s] > 0)
+            GBank(refY, [&](const PCType j, const PCType lower, const PCType upper, const FLType *const *gauss)
             {
-                RecursiveGaussian GFilter(para.sigmaVector[s], true);
-                GFilter(gauss, refY);
-
-                LOOP_VH_PPL(height, width, stride, [&](PCType i)
+                for (PCType i = lower; i < upper; ++i)
                 {
-                    if (gauss[i] > 0)
+                    if (gauss[0][i] > 0 && gauss[1][i] > 0)
                     {
-                        tMapInv[i] *= gauss[i];
+                        tMapInvp[i] = sqrt(gauss[0][i] * gauss[1][i]);
                     }
                     else
                     {
-                        tMapInv[i] = 0;
+                        tMapInvp[i] = 0;
                     }
-                });
-            }
-            else
+                }
+            });
+        }
+        else
+        {
+            const FLType scountRec = FLType(1) / static_cast<FLType>(scount);
+
+            GBank(refY, [&](const PCType j, const PCType lower, const PCType upper, const FLType *const *gauss)
             {
-                LOOP_VH_PPL(height, width, stride, [&](PCType i)
+                for (PCType i = lower; i < upper; ++i)
                 {
-                    tMapInv[i] *= refY[i];
-                });
-            }
-        }
+                    FLType prod = 1;
 
-        // Calculate geometric mean of multiple scales
-        const FLType scountRec = FLType(1) / static_cast<FLType>(scount);
+                    for (size_t s = 0; s < scount; ++s)
+                    {
+                        const FLType g = gauss[s][i];
+                        prod *= para.sigmaVector[s] <= 0 ? refYp[i] : g > 0 ? g : FLType(0);
+                    }
 
-        LOOP_VH_PPL(height, width, stride, [&](PCType i)
-        {
-            tMapInv[i] = pow(tMapInv[i], scountRec);
-        });
+                    tMapInvp[i] = pow(prod, scountRec);
+                }
+            });
+        }
     }
 }
@@ -18,8 +18,10 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
     Plane &dstG = dst.G();
     Plane &dstB = dst.B();
 
-    PCType i;
-    PCType pcount = srcR.PixelCount();
+    PCType i, j, upper;
+    PCType height = srcR.Height();
+    PCType width = srcR.Width();
+    PCType stride = srcR.Stride();
     DType ValueRange = srcR.ValueRange();
 
     DType R, G, B;
@@ -37,30 +39,34 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
 
     // Compute σ_max at every pixel using the src image and store it as a grayscale image.
     // Compute λ_max at every pixel using the src image and store it as a grayscale image.
-    for (i = 0; i < pcount; i++)
+    for (j = 0; j < height; j++)
     {
-        R = srcR[i];
-        G = srcG[i];
-        B = srcB[i];
+        i = stride * j;
+        for (upper = i + width; i < upper; i++)
+        {
+            R = srcR[i];
+            G = srcG[i];
+            B = srcB[i];
 
-        RGBsum = (FLType)(R + G + B);
+            RGBsum = (FLType)(R + G + B);
 
-        if (RGBsum == 0)
-        {
-            sigma_R = sigma_G = sigma_B = FLType(1. / 3.);
-        }
-        else
-        {
-            sigma_R = (FLType)R / RGBsum;
-            sigma_G = (FLType)G / RGBsum;
-            sigma_B = (FLType)B / RGBsum;
-        }
+            if (RGBsum == 0)
+            {
+                sigma_R = sigma_G = sigma_B = FLType(1. / 3.);
+            }
+            else
+            {
+                sigma_R = (FLType)R / RGBsum;
+                sigma_G = (FLType)G / RGBsum;
+                sigma_B = (FLType)B / RGBsum;
+            }
 
-        sigmaMax = Max(Max(sigma_R, sigma_G), sigma_B);
-        sigmaMin = Min(Min(sigma_R, sigma_G), sigma_B);
+            sigmaMax = Max(Max(sigma_R, sigma_G), sigma_B);
+            sigmaMin = Min(Min(sigma_R, sigma_G), sigma_B);
 
-        PsigmaMax[i] = (DType)(sigmaMax * ValueRange + 0.5);
-        PlambdaMax[i] = sigmaMax == sigmaMin ? 0 : (DType)((sigmaMax - sigmaMin) / (1 - 3 * sigmaMin) * ValueRange + 0.5);
+            PsigmaMax[i] = (DType)(sigmaMax * ValueRange + 0.5);
+            PlambdaMax[i] = sigmaMax == sigmaMin ? 0 : (DType)((sigmaMax - sigmaMin) / (1 - 3 * sigmaMin) * ValueRange + 0.5);
+        }
     }
 
     // repeat until σ_maxF − σ_max < 0.03 at every pixel.
@@ -76,47 +82,55 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
         Bilateral2D(PsigmaMaxF, PsigmaMax, PlambdaMax, blData);
 
         // For each pixel p, σ_max(p) = max(σ_max(p), σ_maxF(p))
-        for (i = 0, flag = 0; i < pcount; i++)
+        for (j = 0, flag = 0; j < height; j++)
         {
-            if (PsigmaMaxF[i] > PsigmaMax[i])
+            i = stride * j;
+            for (upper = i + width; i < upper; i++)
             {
-                if (PsigmaMaxF[i] - PsigmaMax[i] > diffthr)
+                if (PsigmaMaxF[i] > PsigmaMax[i])
                 {
-                    flag++;
-                }
+                    if (PsigmaMaxF[i] - PsigmaMax[i] > diffthr)
+                    {
+                        flag++;
+                    }
 
-                PsigmaMax[i] = PsigmaMaxF[i];
+                    PsigmaMax[i] = PsigmaMaxF[i];
+                }
             }
         }
     }
 
     // Compute diffuse component
-    for (i = 0; i < pcount; i++)
+    for (j = 0; j < height; j++)
     {
-        R = srcR[i];
-        G = srcG[i];
-        B = srcB[i];
-        sigmaMax = (FLType)PsigmaMax[i] / ValueRange;
-
-        if (PsigmaMax[i] * 3 <= ValueRange)
-        {
-            dstR[i] = R;
-            dstG[i] = G;
-            dstB[i] = B;
-        }
-        else
+        i = stride * j;
+        for (upper = i + width; i < upper; i++)
         {
-            specular_component = (Max(Max(R, G), B) - sigmaMax*(R + G + B)) / (1 - 3 * sigmaMax);
-            dstR[i] = dstR.Quantize(R - specular_component);
-            dstG[i] = dstG.Quantize(G - specular_component);
-            dstB[i] = dstB.Quantize(B - specular_component);
+            R = srcR[i];
+            G = srcG[i];
+            B = srcB[i];
+            sigmaMax = (FLType)PsigmaMax[i] / ValueRange;
+
+            if (PsigmaMax[i] * 3 <= ValueRange)
+            {
+                dstR[i] = R;
+                dstG[i] = G;
+                dstB[i] = B;
+            }
+            else
+            {
+                specular_component = (Max(Max(R, G), B) - sigmaMax*(R + G + B)) / (1 - 3 * sigmaMax);
+                dstR[i] = dstR.Quantize(R - specular_component);
+                dstG[i] = dstG.Quantize(G - specular_component);
+                dstB[i] = dstB.Quantize(B - specular_component);
+            }
+            /*dst.R()[i] = PsigmaMax[i];
+            dst.G()[i] = PsigmaMax[i];
+            dst.B()[i] = PsigmaMax[i];*/
+            /*dst.R()[i] = PlambdaMax[i];
+            dst.G()[i] = PlambdaMax[i];
+            dst.B()[i] = PlambdaMax[i];*/
         }
-        /*dst.R()[i] = PsigmaMax[i];
-        dst.G()[i] = PsigmaMax[i];
-        dst.B()[i] = PsigmaMax[i];*/
-        /*dst.R()[i] = PlambdaMax[i];
-        dst.G()[i] = PlambdaMax[i];
-        dst.B()[i] = PlambdaMax[i];*/
     }
 
     // Output
@@ -1,7 +1,8 @@
 #include "Histogram_Equalization.h"
 
 
-LUT<DType> Equalization_LUT(const Histogram<DType> &hist, const Plane &dst, const Plane &src, FLType strength)
+template < typename _Ty >
+LUT<DType> Equalization_LUT(const Histogram<DType> &hist, const PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType strength)
 {
     typedef Histogram<DType> HistType;
     typedef LUT<DType> LUTType;
@@ -64,7 +65,8 @@ LUT<DType> Equalization_LUT(const Histogram<DType> &hist, const Plane &dst, cons
     return _LUT;
 }
 
-LUT<FLType> Equalization_LUT_Gain(const Histogram<DType> &hist, const Plane &dst, const Plane &src, FLType strength)
+template < typename _Ty >
+LUT<FLType> Equalization_LUT_Gain(const Histogram<DType> &hist, const PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType strength)
 {
     typedef Histogram<DType> HistType;
     typedef LUT<FLType> LUTType;
@@ -126,7 +128,8 @@ LUT<FLType> Equalization_LUT_Gain(const Histogram<DType> &hist, const Plane &dst
 }
 
 
-Plane & Histogram_Equalization(Plane &dst, const Plane &src, FLType strength)
+template < typename _Ty >
+PlaneT<_Ty> & Histogram_Equalization(PlaneT<_Ty> &dst, const PlaneT<_Ty> &src, FLType strength)
 {
     Histogram<DType> hist(src);
     auto _LUT = Equalization_LUT(hist, dst, strength);
@@ -137,17 +140,18 @@ Plane & Histogram_Equalization(Plane &dst, const Plane &src, FLType strength)
 }
 
 
-Frame & Histogram_Equalization(Frame &dst, const Frame &src, FLType strength, bool separate)
+template < typename _Ty >
+FrameT<_Ty> & Histogram_Equalization(FrameT<_Ty> &dst, const FrameT<_Ty> &src, FLType strength, bool separate)
 {
     PCType i, j, upper;
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     if (src.isYUV())
     {
-        const Plane &srcY = src.Y();
-        Plane &dstY = dst.Y();
+        const PlaneT<_Ty> &srcY = src.Y();
+        PlaneT<_Ty> &dstY = dst.Y();
 
         Histogram<DType> hist(srcY);
         auto _LUT = Equalization_LUT_Gain(hist, dstY, strength);
@@ -158,12 +162,12 @@ Frame & Histogram_Equalization(Frame &dst, const Frame &src, FLType strength, bo
     {
         if (separate)
         {
-            const Plane &srcR = src.R();
-            const Plane &srcG = src.G();
-            const Plane &srcB = src.B();
-            Plane &dstR = dst.R();
-            Plane &dstG = dst.G();
-            Plane &dstB = dst.B();
+            const PlaneT<_Ty> &srcR = src.R();
+            const PlaneT<_Ty> &srcG = src.G();
+            const PlaneT<_Ty> &srcB = src.B();
+            PlaneT<_Ty> &dstR = dst.R();
+            PlaneT<_Ty> &dstG = dst.G();
+            PlaneT<_Ty> &dstB = dst.B();
 
             Histogram_Equalization(dstR, srcR, strength);
             Histogram_Equalization(dstG, srcG, strength);
@@ -171,21 +175,21 @@ Frame & Histogram_Equalization(Frame &dst, const Frame &src, FLType strength, bo
         }
         else
         {
-            const Plane &srcR = src.R();
-            const Plane &srcG = src.G();
-            const Plane &srcB = src.B();
-            Plane &dstR = dst.R();
-            Plane &dstG = dst.G();
-            Plane &dstB = dst.B();
+            const PlaneT<_Ty> &srcR = src.R();
+            const PlaneT<_Ty> &srcG = src.G();
+            const PlaneT<_Ty> &srcB = src.B();
+            PlaneT<_Ty> &dstR = dst.R();
+            PlaneT<_Ty> &dstG = dst.G();
+            PlaneT<_Ty> &dstB = dst.B();
 
-            Plane srcY(srcR, false);
+            PlaneT<_Ty> srcY(srcR, false);
 
             for (j = 0; j < height; j++)
             {
                 i = stride * j;
                 for (upper = i + width; i < upper; i++)
                 {
-                    srcY[i] = RoundDiv((srcR[i] + srcG[i] + srcB[i]), DType(3));
+                    srcY[i] = static_cast<_Ty>(RoundDiv((srcR[i] + srcG[i] + srcB[i]), DType(3)));
                 }
             }
 
@@ -198,3 +202,20 @@ Frame & Histogram_Equalization(Frame &dst, const Frame &src, FLType strength, bo
 
     return dst;
 }
+
+
+template LUT<DType> Equalization_LUT<DType>(const Histogram<DType> &hist, const Plane &dst, const Plane &src, FLType strength);
+template LUT<DType> Equalization_LUT<uint16>(const Histogram<DType> &hist, const Plane16 &dst, const Plane16 &src, FLType strength);
+template LUT<DType> Equalization_LUT<uint8>(const Histogram<DType> &hist, const Plane8 &dst, const Plane8 &src, FLType strength);
+
+template LUT<FLType> Equalization_LUT_Gain<DType>(const Histogram<DType> &hist, const Plane &dst, const Plane &src, FLType strength);
+template LUT<FLType> Equalization_LUT_Gain<uint16>(const Histogram<DType> &hist, const Plane16 &dst, const Plane16 &src, FLType strength);
+template LUT<FLType> Equalization_LUT_Gain<uint8>(const Histogram<DType> &hist, const Plane8 &dst, const Plane8 &src, FLType strength);
+
+template Plane & Histogram_Equalization<DType>(Plane &dst, const Plane &src, FLType strength);
+template Plane16 & Histogram_Equalization<uint16>(Plane16 &dst, const Plane16 &src, FLType strength);
+template Plane8 & Histogram_Equalization<uint8>(Plane8 &dst, const Plane8 &src, FLType strength);
+
+template Frame & Histogram_Equalization<DType>(Frame &dst, const Frame &src, FLType strength, bool separate);
+template Frame16 & Histogram_Equalization<uint16>(Frame16 &dst, const Frame16 &src, FLType strength, bool separate);
+template Frame8 & Histogram_Equalization<uint8>(Frame8 &dst, const Frame8 &src, FLType strength, bool separate);
@@ -4,12 +4,12 @@
 #include <cstdlib>
 #include <cctype>
 #include <ctime>
+#include <fstream>
 #include "ISP_MW.h"
 
 
 //#define Test
-#define Test_Func Test_Speed
-//#define Test_Func Test_Write
+#define Test_Func Test_Write
 //#define Test_Func Test_Other
 
 //#define Convolution_
@@ -35,77 +35,6 @@
 #endif
 
 
-int Test_Speed()
-{
-    const int Loop = 100;
-
-    //Frame IFrame = ImageReader("D:\\Test Images\\Haze\\20150202_132636.jpg");
-    Frame IFrame = ImageReader("D:\\Test Images\\BM3D\\_DSC8263.1noised.png");
-    Frame PFrame(IFrame, false);
-    const Plane &srcR = IFrame.R();
-    Plane dstR(srcR, false);
-
-    for (int l = 0; l < Loop; l++)
-    {
-#if defined(Convolution_)
-        Convolution3V(IFrame, 1, 2, 1);
-        //Convolution3(IFrame, 1, 2, 1, 2, 4, 2, 1, 2, 1);
-#elif defined(EdgeDetect_)
-        EdgeDetect(IFrame, EdgeKernel::Laplace2);
-#elif defined(Gaussian_)
-        Gaussian2D filter;
-        filter(IFrame);
-#elif defined(CUDA_Gaussian_)
-        CUDA_Gaussian2D filter;
-        filter(IFrame);
-#elif defined(Bilateral_)
-        Bilateral2D_Para para;
-        para.sigmaS = 3.0;
-        para.sigmaR = 0.08;
-        para.algorithm = 1;
-        Bilateral2D_Data bldata(IFrame, para);
-        Bilateral2D(IFrame, bldata);
-#elif defined(Transpose_)
-        Transpose(PFrame, IFrame);
-#elif defined(CUDA_Transpose_)
-        CUDA_Transpose(PFrame, IFrame);
-#elif defined(Specular_Highlight_Removal_)
-        Specular_Highlight_Removal(IFrame);
-#elif defined(Retinex_MSRCP_)
-        Retinex_MSRCP filter;
-        filter(IFrame);
-#elif defined(Retinex_MSRCR_)
-        Retinex_MSRCR filter;
-        filter(IFrame);
-#elif defined(Retinex_MSRCR_GIMP_)
-        Retinex_MSRCR_GIMP filter;
-        filter(IFrame);
-#elif defined(Histogram_Equalization_)
-        Histogram_Equalization(IFrame, 1.0, false);
-#elif defined(NLMeans_)
-        NLMeans filter;
-        filter(IFrame);
-#elif defined(BM3D_)
-        BM3D filter;
-        filter(IFrame);
-#elif defined(Haze_Removal_)
-        Haze_Removal_Retinex filter;
-        filter(IFrame);
-#elif defined(CUDA_Haze_Removal_)
-        CUDA_Haze_Removal_Retinex filter;
-        filter(IFrame);
-#else
-        const PCType pzero = 0;
-        const PCType pcount = dstR.PixelCount();
-        const PCType height = dstR.Height();
-        const PCType width = dstR.Width();
-        const PCType stride = dstR.Stride();
-#endif
-    }
-
-    return 0;
-}
-
 int Test_Write()
 {
     Frame IFrame = ImageReader("D:\\Test Images\\BM3D\\_DSC8263.1noised.png");
@@ -219,71 +148,257 @@ int Filtering(const int argc, char ** argv)
         args[i] = argv[i + 2];
     }
 
-    FilterIO *filterIOPtr = nullptr;
+    if (FilterName == "--chain")
+    {
+        return Filtering_Chain(argc2, args);
+    }
+
+    if (FilterName == "--bench")
+    {
+        return Benchmarking(argc2, args);
+    }
+
+    FilterIO *filterIOPtr = CreateFilterIO(FilterName);
+
+    if (filterIOPtr == nullptr)
+    {
+        return 1;
+    }
+
+    filterIOPtr->SetArgs(argc2, args);
+    filterIOPtr->operator()();
+    delete filterIOPtr;
+
+    return 0;
+}
+
+
+// Filters are chained as
+// --chain [common arguments and inputs] --filter1 [arguments of filter1] --filter2 [arguments of filter2] ...
+// Each filter name starts a new stage, the common arguments are those of FilterIO, such as --tag and --workers
+int Filtering_Chain(const int argc, const std::vector<std::string> &args)
+{
+    std::vector<std::unique_ptr<FilterIO>> stages;
+    std::vector<std::vector<std::string>> stageArgs;
+    std::vector<std::string> commonArgs;
+
+    for (int i = 0; i < argc; i++)
+    {
+        std::unique_ptr<FilterIO> stage(CreateFilterIO(args[i]));
+
+        if (stage)
+        {
+            stages.push_back(std::move(stage));
+            stageArgs.emplace_back();
+        }
+        else if (stages.size() == 0)
+        {
+            commonArgs.push_back(args[i]);
+        }
+        else
+        {
+            stageArgs.back().push_back(args[i]);
+        }
+    }
+
+    if (stages.size() == 0)
+    {
+        std::cout << "No filter specified for the chain.\n";
+        return 1;
+    }
+
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        stages[s]->SetArgs(static_cast<int>(stageArgs[s].size()), stageArgs[s]);
+    }
+
+    Filter_Chain_IO chain(std::move(stages));
+    chain.SetArgs(static_cast<int>(commonArgs.size()), commonArgs);
+    chain();
+
+    return 0;
+}
+
+
+// Benchmark of a filter is run as
+// --bench [--warmup N] [--iterations N] [--size WxH]... [--json file] [inputs] --filter [arguments of filter]
+// Synthetic images are used for each --size, 1920x1080 by default when neither sizes nor inputs are given.
+// The statistics are written as JSON to the file or the standard output.
+int Benchmarking(const int argc, const std::vector<std::string> &args)
+{
+    Benchmark_Para para;
+    std::string FilterName;
+    std::unique_ptr<FilterIO> filter;
+    std::vector<std::string> filterArgs;
+
+    int i = 0;
+
+    for (; i < argc && !filter; i++)
+    {
+        filter.reset(CreateFilterIO(args[i]));
+        if (filter) FilterName = args[i];
+    }
+
+    if (!filter)
+    {
+        std::cout << "No filter specified for the benchmark.\n";
+        return 1;
+    }
+
+    filterArgs.assign(args.begin() + i, args.begin() + argc);
+
+    const int argc2 = i - 1;
+    Args ArgsObj(argc2, args);
+
+    for (i = 0; i < argc2; i++)
+    {
+        if (args[i] == "--warmup")
+        {
+            ArgsObj.GetPara(i, para.warmup);
+            continue;
+        }
+        if (args[i] == "--iterations")
+        {
+            ArgsObj.GetPara(i, para.iterations);
+            continue;
+        }
+        if (args[i] == "--size")
+        {
+            std::string size;
+            ArgsObj.GetPara(i, size);
+
+            size_t sep = size.find_first_of("xX");
+            PCType width = sep == std::string::npos ? 0 : std::atoi(size.substr(0, sep).c_str());
+            PCType height = sep == std::string::npos ? 0 : std::atoi(size.substr(sep + 1).c_str());
+
+            if (width <= 0 || height <= 0)
+            {
+                std::cout << "Invalid size \"" << size << "\", should be WxH.\n";
+                return 1;
+            }
+
+            para.sizes.push_back(std::make_pair(width, height));
+            continue;
+        }
+        if (args[i] == "--json")
+        {
+            ArgsObj.GetPara(i, para.output);
+            continue;
+        }
+        if (args[i][0] == '-')
+        {
+            i++;
+            continue;
+        }
+
+        para.inputs.push_back(args[i]);
+    }
+
+    ArgsObj.Check();
+
+    if (para.sizes.size() == 0 && para.inputs.size() == 0)
+    {
+        para.sizes.push_back(std::make_pair(PCType(1920), PCType(1080)));
+    }
+
+    filter->SetArgs(static_cast<int>(filterArgs.size()), filterArgs);
+    filter->ParseArgs();
+
+    std::vector<Benchmark_Result> results;
+
+    for (const auto &size : para.sizes)
+    {
+        const Frame16 src(SyntheticFrame(size.first, size.second));
+        results.push_back(Benchmark(*filter, src, para, "synthetic"));
+    }
+
+    for (const auto &input : para.inputs)
+    {
+        const Frame16 src = ImageReader<uint16>(input);
+        results.push_back(Benchmark(*filter, src, para, input));
+    }
+
+    const std::string json = BenchmarkJSON(FilterName, para, results);
+
+    if (para.output.size() == 0)
+    {
+        std::cout << json;
+    }
+    else
+    {
+        std::ofstream file(para.output);
+        file << json;
+
+        if (!file)
+        {
+            std::cerr << "Failed to write the benchmark result to " << para.output << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+// Create the FilterIO object of a filter by its command line name, returns nullptr for unknown names
+FilterIO *CreateFilterIO(std::string FilterName)
+{
+    std::transform(FilterName.begin(), FilterName.end(), FilterName.begin(), tolower);
 
     if (FilterName == "--gaussian")
     {
-        filterIOPtr = new _Gaussian2D_IO;
+        return new _Gaussian2D_IO;
     }
     else if (FilterName == "--bilateral")
     {
-        filterIOPtr = new Bilateral2D_IO;
+        return new Bilateral2D_IO;
     }
     else if (FilterName == "--agtm" || FilterName == "--adaptive_global_tone_mapping")
     {
-        filterIOPtr = new Adaptive_Global_Tone_Mapping_IO;
+        return new Adaptive_Global_Tone_Mapping_IO;
     }
     else if (FilterName == "--retinex_msrcp" || FilterName == "--msrcp" || FilterName == "--retinex_msr" || FilterName == "--msr" || FilterName == "--retinex")
     {
-        filterIOPtr = new Retinex_MSRCP_IO;
+        return new Retinex_MSRCP_IO;
     }
     else if (FilterName == "--retinex_msrcr" || FilterName == "--msrcr")
     {
-        filterIOPtr = new Retinex_MSRCR_IO;
+        return new Retinex_MSRCR_IO;
     }
     else if (FilterName == "--retinex_msrcr_gimp" || FilterName == "--msrcr_gimp")
     {
-        filterIOPtr = new Retinex_MSRCR_GIMP_IO;
+        return new Retinex_MSRCR_GIMP_IO;
     }
     else if (FilterName == "--he" || FilterName == "--histogram_equalization")
     {
-        filterIOPtr = new Histogram_Equalization_IO;
+        return new Histogram_Equalization_IO;
     }
     else if (FilterName == "--awb1")
     {
-        filterIOPtr = new AWB1_IO;
+        return new AWB1_IO;
     }
     else if (FilterName == "--awb2")
     {
-        filterIOPtr = new AWB2_IO;
+        return new AWB2_IO;
     }
     else if (FilterName == "--ed" || FilterName == "--edgedetect")
     {
-        filterIOPtr = new EdgeDetect_IO;
+        return new EdgeDetect_IO;
     }
     else if (FilterName == "--nlm" || FilterName == "--nlmeans" || FilterName == "--nonlocalmeans")
     {
-        filterIOPtr = new NLMeans_IO;
+        return new NLMeans_IO;
     }
     else if (FilterName == "--bm3d")
     {
-        filterIOPtr = new BM3D_IO;
+        return new BM3D_IO;
     }
     else if (FilterName == "--hrr" || FilterName == "--haze_removal" || FilterName == "--haze_removal_retinex")
     {
-        filterIOPtr = new _Haze_Removal_Retinex_IO;
+        return new _Haze_Removal_Retinex_IO;
     }
     else
     {
-        return 1;
+        return nullptr;
     }
-
-    if (filterIOPtr != nullptr)
-    {
-        filterIOPtr->SetArgs(argc2, args);
-        filterIOPtr->operator()();
-        delete filterIOPtr;
-    }
-
-    return 0;
 }
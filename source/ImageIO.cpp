@@ -1,4 +1,10 @@
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <io.h>
+#include <sys/stat.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "ImageIO.h"
@@ -6,30 +12,29 @@
 #include "LUT.h"
 
 
-Frame ImageReader(const std::string &filename, const FCType FrameNum, const DType BitDepth)
+template < typename _Ty >
+bool ImageRead(FrameT<_Ty> &dst, const std::string &filename, const FCType FrameNum, const DType BitDepth)
 {
     cv::Mat image = cv::imread(filename, cv::IMREAD_COLOR);
 
     if (!image.data) // Check for invalid input
     {
         std::cerr << "Could not open or find the image file: " << filename << std::endl;
-
-        Frame src(FrameNum, PixelType::RGB, 1920, 1080, BitDepth, true);
-        return src;
+        return false;
     }
 
     const PCType sw = image.cols;
     const PCType sh = image.rows;
 
-    Frame src(FrameNum, PixelType::RGB, sw, sh, BitDepth, false);
+    FrameT<_Ty> src(FrameNum, PixelType::RGB, sw, sh, static_cast<_Ty>(BitDepth), false);
 
     const PCType height = src.Height();
     const PCType width = src.Width();
     const PCType stride = src.Stride();
 
-    Plane &R = src.R();
-    Plane &G = src.G();
-    Plane &B = src.B();
+    PlaneT<_Ty> &R = src.R();
+    PlaneT<_Ty> &G = src.G();
+    PlaneT<_Ty> &B = src.B();
 
     if (R.Floor() == 0 && R.Ceil() == 65535)
     {
@@ -40,9 +45,9 @@ Frame ImageReader(const std::string &filename, const FCType FrameNum, const DTyp
 
             for (const PCType upper = i + width; i < upper; ++i)
             {
-                B[i] = static_cast<DType>(*p++) * DType(257);
-                G[i] = static_cast<DType>(*p++) * DType(257);
-                R[i] = static_cast<DType>(*p++) * DType(257);
+                B[i] = static_cast<_Ty>(static_cast<DType>(*p++) * DType(257));
+                G[i] = static_cast<_Ty>(static_cast<DType>(*p++) * DType(257));
+                R[i] = static_cast<_Ty>(static_cast<DType>(*p++) * DType(257));
             }
         }
     }
@@ -55,17 +60,17 @@ Frame ImageReader(const std::string &filename, const FCType FrameNum, const DTyp
 
             for (const PCType upper = i + width; i < upper; ++i)
             {
-                B[i] = static_cast<DType>(*p++);
-                G[i] = static_cast<DType>(*p++);
-                R[i] = static_cast<DType>(*p++);
+                B[i] = static_cast<_Ty>(*p++);
+                G[i] = static_cast<_Ty>(*p++);
+                R[i] = static_cast<_Ty>(*p++);
             }
         }
     }
     else
     {
-        LUT<Plane::value_type>::LevelType k;
-        const LUT<Plane::value_type>::LevelType iLevels = 256;
-        LUT<Plane::value_type> ConvertLUT(iLevels);
+        typename LUT<_Ty>::LevelType k;
+        const typename LUT<_Ty>::LevelType iLevels = 256;
+        LUT<_Ty> ConvertLUT(iLevels);
 
         for (k = 0; k < iLevels; k++)
         {
@@ -86,24 +91,45 @@ Frame ImageReader(const std::string &filename, const FCType FrameNum, const DTyp
         }
     }
 
+    dst = std::move(src);
+    return true;
+}
+
+template < typename _Ty >
+FrameT<_Ty> ImageReader(const std::string &filename, const FCType FrameNum, const DType BitDepth)
+{
+    FrameT<_Ty> src;
+
+    if (!ImageRead(src, filename, FrameNum, BitDepth))
+    {
+        return FrameT<_Ty>(FrameNum, PixelType::RGB, 1920, 1080, static_cast<_Ty>(BitDepth), true);
+    }
+
     return src;
 }
 
+Frame ImageReader(const std::string &filename, const FCType FrameNum, const DType BitDepth)
+{
+    return ImageReader<DType>(filename, FrameNum, BitDepth);
+}
+
 
-bool ImageWriter(const Frame &src, const std::string &filename)
+template < typename _Ty >
+bool ImageWriter(const FrameT<_Ty> &src, const std::string &filename)
 {
     return ImageWriter(src, filename, CV_8UC3);
 }
 
-bool ImageWriter(const Frame &src, const std::string &filename, int _type)
+template < typename _Ty >
+bool ImageWriter(const FrameT<_Ty> &src, const std::string &filename, int _type)
 {
     const PCType height = src.Height();
     const PCType width = src.Width();
     const PCType stride = src.Stride();
 
-    const Plane &R = src.R();
-    const Plane &G = src.G();
-    const Plane &B = src.B();
+    const PlaneT<_Ty> &R = src.R();
+    const PlaneT<_Ty> &G = src.G();
+    const PlaneT<_Ty> &B = src.B();
 
     cv::Mat image(height, width, _type);
 
@@ -116,9 +142,9 @@ bool ImageWriter(const Frame &src, const std::string &filename, int _type)
 
             for (const PCType upper = i + width; i < upper; ++i)
             {
-                *p++ = static_cast<uchar>(RoundDiv(B[i], DType(257)));
-                *p++ = static_cast<uchar>(RoundDiv(G[i], DType(257)));
-                *p++ = static_cast<uchar>(RoundDiv(R[i], DType(257)));
+                *p++ = static_cast<uchar>(RoundDiv(static_cast<DType>(B[i]), DType(257)));
+                *p++ = static_cast<uchar>(RoundDiv(static_cast<DType>(G[i]), DType(257)));
+                *p++ = static_cast<uchar>(RoundDiv(static_cast<DType>(R[i]), DType(257)));
             }
         }
     }
@@ -141,7 +167,7 @@ bool ImageWriter(const Frame &src, const std::string &filename, int _type)
     {
         LUT<uchar> ConvertLUT(R);
 
-        ConvertLUT.Set(R, [&](Plane::value_type i)
+        ConvertLUT.Set(R, [&](_Ty i)
         {
             return static_cast<uchar>(R.GetFL(i) * FLType(255) + FLType(0.5));
         });
@@ -160,7 +186,218 @@ bool ImageWriter(const Frame &src, const std::string &filename, int _type)
         }
     }
     
-    cv::imwrite(filename, image);
+    return cv::imwrite(filename, image);
+}
+
+
+// Explicit instantiation of the storage types
+template bool ImageRead<DType>(FrameT<DType> &dst, const std::string &filename, const FCType FrameNum, const DType BitDepth);
+template bool ImageRead<uint16>(FrameT<uint16> &dst, const std::string &filename, const FCType FrameNum, const DType BitDepth);
+template bool ImageRead<uint8>(FrameT<uint8> &dst, const std::string &filename, const FCType FrameNum, const DType BitDepth);
+
+template FrameT<DType> ImageReader<DType>(const std::string &filename, const FCType FrameNum, const DType BitDepth);
+template FrameT<uint16> ImageReader<uint16>(const std::string &filename, const FCType FrameNum, const DType BitDepth);
+template FrameT<uint8> ImageReader<uint8>(const std::string &filename, const FCType FrameNum, const DType BitDepth);
+
+template bool ImageWriter<DType>(const FrameT<DType> &src, const std::string &filename);
+template bool ImageWriter<uint16>(const FrameT<uint16> &src, const std::string &filename);
+template bool ImageWriter<uint8>(const FrameT<uint8> &src, const std::string &filename);
+template bool ImageWriter<DType>(const FrameT<DType> &src, const std::string &filename, int _type);
+template bool ImageWriter<uint16>(const FrameT<uint16> &src, const std::string &filename, int _type);
+template bool ImageWriter<uint8>(const FrameT<uint8> &src, const std::string &filename, int _type);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+static PCType ReadBE16(const unsigned char *p)
+{
+    return (static_cast<PCType>(p[0]) << 8) | p[1];
+}
+
+static PCType ReadBE32(const unsigned char *p)
+{
+    return (static_cast<PCType>(p[0]) << 24) | (static_cast<PCType>(p[1]) << 16) | (static_cast<PCType>(p[2]) << 8) | p[3];
+}
+
+static PCType ReadLE16(const unsigned char *p)
+{
+    return (static_cast<PCType>(p[1]) << 8) | p[0];
+}
+
+static PCType ReadLE32(const unsigned char *p)
+{
+    return static_cast<sint32>((static_cast<uint32>(p[3]) << 24) | (static_cast<uint32>(p[2]) << 16)
+        | (static_cast<uint32>(p[1]) << 8) | p[0]);
+}
+
+// Next number of the PNM header, skipping white spaces and comments
+static bool ReadPNMNumber(std::istream &file, PCType &value)
+{
+    int c = file.get();
+
+    while (c == '#' || std::isspace(c))
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF) c = file.get();
+        }
+
+        c = file.get();
+    }
+
+    if (!std::isdigit(c)) return false;
+
+    for (value = 0; std::isdigit(c); c = file.get())
+    {
+        value = value * 10 + (c - '0');
+    }
 
     return true;
 }
+
+bool ImageSize(const std::string &filename, PCType &width, PCType &height)
+{
+    std::ifstream file(filename, std::ios::binary);
+    unsigned char h[26];
+
+    if (!file.read(reinterpret_cast<char *>(h), 2)) return false;
+
+    if (h[0] == 0x89 && h[1] == 'P') // PNG, the IHDR chunk comes first
+    {
+        if (!file.read(reinterpret_cast<char *>(h + 2), 22) || std::memcmp(h + 12, "IHDR", 4) != 0) return false;
+
+        width = ReadBE32(h + 16);
+        height = ReadBE32(h + 20);
+    }
+    else if (h[0] == 'B' && h[1] == 'M') // BMP, the height is negative for top-down bitmaps
+    {
+        if (!file.read(reinterpret_cast<char *>(h + 2), 24)) return false;
+
+        if (ReadLE32(h + 14) == 12)
+        {
+            width = ReadLE16(h + 18);
+            height = ReadLE16(h + 20);
+        }
+        else
+        {
+            width = ReadLE32(h + 18);
+            height = Abs(ReadLE32(h + 22));
+        }
+    }
+    else if (h[0] == 0xFF && h[1] == 0xD8) // JPEG, the size is in the start of frame segment
+    {
+        while (true)
+        {
+            if (!file.read(reinterpret_cast<char *>(h), 4) || h[0] != 0xFF) return false;
+
+            const int marker = h[1];
+            const PCType length = ReadBE16(h + 2);
+
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                if (!file.read(reinterpret_cast<char *>(h), 5)) return false;
+
+                height = ReadBE16(h + 1);
+                width = ReadBE16(h + 3);
+                break;
+            }
+
+            if (length < 2 || !file.seekg(length - 2, std::ios::cur)) return false;
+        }
+    }
+    else if (h[0] == 'P' && h[1] >= '1' && h[1] <= '6') // PNM
+    {
+        if (!ReadPNMNumber(file, width) || !ReadPNMNumber(file, height)) return false;
+    }
+    else
+    {
+        return false;
+    }
+
+    return width > 0 && height > 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+bool IsDirectory(const std::string &path)
+{
+    struct _stat64 info;
+
+    if (_stat64(path.c_str(), &info) != 0) return false;
+
+    return (info.st_mode & _S_IFDIR) != 0;
+}
+
+
+std::vector<std::string> ImageFileList(const std::string &dir)
+{
+    static const char *const Extensions[] = { ".bmp", ".dib", ".jpg", ".jpeg", ".jpe", ".jp2", ".png", ".webp",
+        ".pbm", ".pgm", ".ppm", ".sr", ".ras", ".tif", ".tiff" };
+
+    std::vector<std::string> files;
+    std::string prefix = dir;
+
+    if (prefix.size() > 0 && prefix.back() != '\\' && prefix.back() != '/') prefix += '\\';
+
+    struct _finddata64i32_t info;
+    intptr_t handle = _findfirst64i32((prefix + "*").c_str(), &info);
+
+    if (handle == -1) return files;
+
+    do
+    {
+        if (info.attrib & _A_SUBDIR) continue;
+
+        std::string name = info.name;
+        size_t dot = name.find_last_of('.');
+        if (dot == std::string::npos) continue;
+
+        std::string ext = name.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), tolower);
+
+        for (auto e : Extensions)
+        {
+            if (ext == e)
+            {
+                files.push_back(prefix + name);
+                break;
+            }
+        }
+    } while (_findnext64i32(handle, &info) == 0);
+
+    _findclose(handle);
+
+    std::sort(files.begin(), files.end());
+
+    return files;
+}
+
+
+std::vector<std::string> ReadFileList(const std::string &filename)
+{
+    std::vector<std::string> files;
+    std::ifstream list(filename);
+
+    if (!list)
+    {
+        std::cerr << "Could not open the file list: " << filename << std::endl;
+        return files;
+    }
+
+    std::string line;
+
+    while (std::getline(list, line))
+    {
+        // Trim spaces and the carriage return left by files with CRLF line endings
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        size_t last = line.find_last_not_of(" \t\r");
+        files.push_back(line.substr(first, last - first + 1));
+    }
+
+    return files;
+}
@@ -1,20 +1,37 @@
 #define ENABLE_PPL
 
 
+#include <mutex>
 #include "Image_Type.h"
 #include "Conversion.hpp"
 
 
+PCType PLANE_ALIGN = 16;
+bool PLANE_SKEW = true;
+
+// Serializes making shared buffers unique, so that concurrent writers of the same copy don't both copy it
+static std::mutex UnshareMutex;
+
+void SetPlaneStride(PCType align, int skew)
+{
+    if (align > 0) PLANE_ALIGN = align;
+    if (skew >= 0) PLANE_SKEW = skew != 0;
+}
+
+
 // Functions of class Plane
-void Plane::DefaultPara(bool Chroma, value_type _BitDepth, QuantRange _QuantRange)
+template < typename _Ty >
+void PlaneT<_Ty>::DefaultPara(bool Chroma, value_type _BitDepth, QuantRange _QuantRange)
 {
     Quantize_Value(Floor_, Neutral_, Ceil_, _BitDepth, _QuantRange, Chroma);
 }
 
-void Plane::CopyParaFrom(const _Myt &src)
+template < typename _Ty >
+void PlaneT<_Ty>::CopyParaFrom(const _Myt &src)
 {
     Width_ = src.Width();
     Height_ = src.Height();
+    Stride_ = src.Stride();
     PixelCount_ = src.PixelCount();
     BitDepth_ = src.BitDepth();
     Floor_ = src.Floor();
@@ -23,7 +40,8 @@ void Plane::CopyParaFrom(const _Myt &src)
     TransferChar_ = src.GetTransferChar();
 }
 
-void Plane::InitValue(value_type Value, bool Init)
+template < typename _Ty >
+void PlaneT<_Ty>::InitValue(value_type Value, bool Init)
 {
     if (Init)
     {
@@ -36,135 +54,289 @@ void Plane::InitValue(value_type Value, bool Init)
                 x = Value;
             });
         }
-        else
+        else if (!isView())
         {
             memset(data(), Value, sizeof(value_type) * size());
         }
+        else
+        {
+            for (PCType j = 0; j < Height(); ++j)
+            {
+                memset(data() + j * Stride(), Value, sizeof(value_type) * Width());
+            }
+        }
     }
 }
 
 
-Plane::Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
     : _Myt(Value, _Width, _Height, _BitDepth, 0, 0, (value_type(1) << _BitDepth) - 1,
     TransferChar_Default(_Width, _Height, true), Init)
 {}
 
-Plane::Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init)
-    : Width_(_Width), Height_(_Height), PixelCount_(_Width * _Height), BitDepth_(_BitDepth),
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init, PCType _Stride)
+    : Width_(_Width), Height_(_Height), Stride_(_Stride > 0 ? ::Max(_Stride, _Width) : PlaneStride(_Width)), PixelCount_(_Width * _Height), BitDepth_(_BitDepth),
     Floor_(_Floor), Neutral_(_Neutral), Ceil_(_Ceil), TransferChar_(_TransferChar)
 {
     const char *FunctionName = "class Plane constructor";
-    if (_BitDepth > MaxBitDepth)
+    if (_BitDepth > StorageBitDepth<value_type>())
     {
-        std::cerr << FunctionName << ": \"BitDepth=" << _BitDepth << "\" is invalid, maximum allowed bit depth is " << MaxBitDepth << ".\n";
+        std::cerr << FunctionName << ": \"BitDepth=" << DType(_BitDepth) << "\" is invalid, maximum allowed bit depth is " << StorageBitDepth<value_type>() << ".\n";
         DEBUG_BREAK;
     }
     if (_Ceil <= _Floor)
     {
-        std::cerr << FunctionName << ": invalid values of \"Floor=" << _Floor << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
+        std::cerr << FunctionName << ": invalid values of \"Floor=" << DType(_Floor) << "\" and \"Ceil=" << DType(_Ceil) << "\" are set.\n";
         DEBUG_BREAK;
     }
     if (ValueRange() >= value_type(1) << _BitDepth)
     {
-        std::cerr << FunctionName << ": \"Ceil-Floor=" << ValueRange() << "\" exceeds \"BitDepth=" << _BitDepth << "\" limit.\n";
+        std::cerr << FunctionName << ": \"Ceil-Floor=" << DType(ValueRange()) << "\" exceeds \"BitDepth=" << DType(_BitDepth) << "\" limit.\n";
         DEBUG_BREAK;
     }
     if (_Neutral > _Floor && _Neutral != (_Floor + _Ceil + 1) / 2)
     {
-        std::cerr << FunctionName << ": invalid values of \"Floor=" << _Floor << "\", \"Neutral=" << _Neutral << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
+        std::cerr << FunctionName << ": invalid values of \"Floor=" << DType(_Floor) << "\", \"Neutral=" << DType(_Neutral) << "\" and \"Ceil=" << DType(_Ceil) << "\" are set.\n";
         DEBUG_BREAK;
     }
 
-    AlignedMalloc(Data_, size());
+    PoolMalloc(Buffer_, size());
+    Data_ = Buffer_;
 
     InitValue(Value, Init);
 }
 
-Plane::Plane(const _Myt &src)
-    : _Myt(src, false)
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(const _Myt &src)
 {
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+    CopyParaFrom(src);
+
+    // The buffer is shared, while the memory of a view is copied
+    if (src.isView())
+    {
+        PoolMalloc(Buffer_, size());
+        Data_ = Buffer_;
+        MatCopy(Data_, src.data(), Height(), Width(), Stride(), src.Stride());
+    }
+    else
+    {
+        PoolRetain(src.Buffer_);
+        Data_ = src.Data_;
+        Buffer_ = src.Buffer_;
+    }
 }
 
-Plane::Plane(const _Myt &src, bool Init, value_type Value)
-    : _Myt(Value, src.Width(), src.Height(), src.BitDepth(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), Init)
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(const _Myt &src, bool Init, value_type Value)
+    : _Myt(Value, src.Width(), src.Height(), src.BitDepth(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), Init, src.Stride())
 {}
 
-Plane::Plane(_Myt &&src)
-    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), BitDepth_(src.BitDepth()),
-    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(_Myt &&src)
+    : Width_(src.Width()), Height_(src.Height()), Stride_(src.Stride()), PixelCount_(src.PixelCount()), BitDepth_(src.BitDepth()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar()), Data_(src.Data_), Buffer_(src.Buffer_), View_(src.isView())
 {
-    Data_ = src.data();
+    // The frame keeps its reference to the slab
+    if (src.Slab_) PoolRetain(Buffer_);
 
     src.Width_ = 0;
     src.Height_ = 0;
+    src.Stride_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Buffer_ = nullptr;
+    src.View_ = false;
+    src.Slab_ = false;
 }
 
-Plane::Plane(const Plane_FL &src, value_type _BitDepth)
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(const Plane_FL &src, value_type _BitDepth)
     : _Myt(src, _BitDepth, 0, 0, (value_type(1) << _BitDepth) - 1)
 {}
 
-Plane::Plane(const Plane_FL &src, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil)
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(const Plane_FL &src, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil)
     : _Myt(src, false, 0, _BitDepth, _Floor, _Neutral, _Ceil)
 {
     RangeConvert(*this, src);
 }
 
-Plane::Plane(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth)
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth)
     : _Myt(src, Init, Value, _BitDepth, 0, 0, (value_type(1) << _BitDepth) - 1)
 {}
 
-Plane::Plane(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil)
-    : _Myt(Value, src.Width(), src.Height(), _BitDepth, _Floor, _Neutral, _Ceil, src.GetTransferChar(), Init)
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil)
+    : _Myt(Value, src.Width(), src.Height(), _BitDepth, _Floor, _Neutral, _Ceil, src.GetTransferChar(), Init, src.Stride())
 {}
 
 
-Plane::~Plane()
+template < typename _Ty >
+PlaneT<_Ty>::PlaneT(pointer Data, PCType _Stride, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar)
+    : Width_(_Width), Height_(_Height), Stride_(_Stride), PixelCount_(_Width * _Height), BitDepth_(_BitDepth),
+    Floor_(_Floor), Neutral_(_Neutral), Ceil_(_Ceil), TransferChar_(_TransferChar), Data_(Data), View_(true)
+{
+    if (_Stride < _Width)
+    {
+        std::cerr << "class Plane constructor: \"Stride=" << _Stride << "\" is less than \"Width=" << _Width << "\".\n";
+        DEBUG_BREAK;
+    }
+}
+
+
+template < typename _Ty >
+PlaneT<_Ty>::~PlaneT()
+{
+    Release();
+}
+
+
+template < typename _Ty >
+void PlaneT<_Ty>::Release()
 {
-    AlignedFree(Data_);
+    if (!Slab_) PoolFree(Buffer_);
+
+    Width_ = 0;
+    Height_ = 0;
+    Stride_ = 0;
+    PixelCount_ = 0;
+    Data_ = nullptr;
+    Buffer_ = nullptr;
+    View_ = false;
+    Slab_ = false;
 }
 
+template < typename _Ty >
+void PlaneT<_Ty>::SlabAttach(pointer Data, pointer Slab)
+{
+    if (!Slab_) PoolFree(Buffer_);
 
-Plane &Plane::operator=(const _Myt &src)
+    Data_ = Data;
+    Buffer_ = Slab;
+    View_ = false;
+    Slab_ = true;
+}
+
+template < typename _Ty >
+void PlaneT<_Ty>::Unshare()
+{
+    std::lock_guard<std::mutex> lock(UnshareMutex);
+
+    // Another thread may have made the buffer unique meanwhile
+    if (Buffer_ == nullptr || !PoolShared(Buffer_))
+    {
+        return;
+    }
+
+    pointer data;
+    PoolMalloc(data, size());
+    MatCopy(data, Data_, Height(), Width(), Stride(), Stride());
+
+    if (!Slab_) PoolFree(Buffer_);
+
+    Data_ = data;
+    Buffer_ = data;
+    Slab_ = false;
+}
+
+
+template < typename _Ty >
+PlaneT<_Ty> &PlaneT<_Ty>::operator=(const _Myt &src)
 {
     if (this == &src)
     {
         return *this;
     }
 
-    CopyParaFrom(src);
+    if (isView())
+    {
+        if (Width() != src.Width() || Height() != src.Height())
+        {
+            DEBUG_FAIL("Plane::operator=: a view can only be assigned from a plane of the same size.");
+        }
+
+        const PCType _Stride = Stride();
+        CopyParaFrom(src);
+        Stride_ = _Stride;
+    }
+    else if (!src.isView())
+    {
+        // Share the buffer
+        PoolRetain(src.Buffer_);
+        if (!Slab_) PoolFree(Buffer_);
 
-    AlignedFree(Data_);
-    AlignedMalloc(Data_, size());
+        CopyParaFrom(src);
+        Data_ = src.Data_;
+        Buffer_ = src.Buffer_;
+        Slab_ = false;
 
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+        return *this;
+    }
+    else
+    {
+        const size_type originSize = size();
+
+        CopyParaFrom(src);
+
+        // Leave the storage of the frame when the size changes or it's shared
+        if (Slab_ && (size() != originSize || PoolShared(Buffer_)))
+        {
+            Buffer_ = nullptr;
+            Slab_ = false;
+        }
+
+        if (!Slab_)
+        {
+            PoolRealloc(Buffer_, size());
+            Data_ = Buffer_;
+        }
+    }
+
+    MatCopy(Data_, src.data(), Height(), Width(), Stride(), src.Stride());
 
     return *this;
 }
 
-Plane &Plane::operator=(_Myt &&src)
+template < typename _Ty >
+PlaneT<_Ty> &PlaneT<_Ty>::operator=(_Myt &&src)
 {
     if (this == &src)
     {
         return *this;
     }
 
-    CopyParaFrom(src);
+    if (isView())
+    {
+        return *this = static_cast<const _Myt &>(src);
+    }
+
+    // The frame keeps its reference to the slab
+    if (src.Slab_) PoolRetain(src.Buffer_);
+    if (!Slab_) PoolFree(Buffer_);
 
-    AlignedFree(Data_);
-    Data_ = src.data();
+    CopyParaFrom(src);
+    Data_ = src.Data_;
+    Buffer_ = src.Buffer_;
+    View_ = src.isView();
+    Slab_ = false;
 
     src.Width_ = 0;
     src.Height_ = 0;
+    src.Stride_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Buffer_ = nullptr;
+    src.View_ = false;
+    src.Slab_ = false;
 
     return *this;
 }
 
-bool Plane::operator==(const _Myt &b) const
+template < typename _Ty >
+bool PlaneT<_Ty>::operator==(const _Myt &b) const
 {
     if (this == &b)
     {
@@ -177,35 +349,44 @@ bool Plane::operator==(const _Myt &b) const
         return false;
     }
 
-    PCType i;
-    for (i = 0; Data_[i] == b.Data_[i] && i < PixelCount(); i++);
-    if (i < PixelCount())
-    {
-        return false;
-    }
-    else
+    for (PCType j = 0; j < Height(); ++j)
     {
-        return true;
+        const_pointer p0 = data() + j * Stride();
+        const_pointer p1 = b.data() + j * b.Stride();
+
+        for (PCType i = 0; i < Width(); ++i)
+        {
+            if (p0[i] != p1[i])
+            {
+                return false;
+            }
+        }
     }
+
+    return true;
 }
 
 
-Plane::value_type Plane::Min() const
+template < typename _Ty >
+typename PlaneT<_Ty>::value_type PlaneT<_Ty>::Min() const
 {
     return GetMin(*this);
 }
 
-Plane::value_type Plane::Max() const
+template < typename _Ty >
+typename PlaneT<_Ty>::value_type PlaneT<_Ty>::Max() const
 {
     return GetMax(*this);
 }
 
-void Plane::MinMax(reference min, reference max) const
+template < typename _Ty >
+void PlaneT<_Ty>::MinMax(reference min, reference max) const
 {
     GetMinMax(*this, min, max);
 }
 
-FLType Plane::Mean() const
+template < typename _Ty >
+FLType PlaneT<_Ty>::Mean() const
 {
     uint64 Sum = 0;
 
@@ -217,7 +398,8 @@ FLType Plane::Mean() const
     return static_cast<FLType>(Sum) / PixelCount();
 }
 
-FLType Plane::Variance(FLType Mean) const
+template < typename _Ty >
+FLType PlaneT<_Ty>::Variance(FLType Mean) const
 {
     FLType diff;
     FLType Sum = 0;
@@ -232,45 +414,72 @@ FLType Plane::Variance(FLType Mean) const
 }
 
 
-Plane &Plane::ReSize(PCType _Width, PCType _Height)
+template < typename _Ty >
+PlaneT<_Ty> PlaneT<_Ty>::MakeView(PCType y, PCType x, PCType height, PCType width) const
 {
-    if (Width() != _Width || Height() != _Height)
+    if (y < 0 || x < 0 || height < 0 || width < 0 || y + height > Height() || x + width > Width())
     {
-        auto newPC = _Width * _Height;
+        std::cerr << "Plane::View: the rectangle of " << width << "x" << height << " at (" << x << ", " << y
+            << ") is out of the plane of " << Width() << "x" << Height() << ".\n";
+        DEBUG_BREAK;
+    }
+
+    return _Myt(Data_ + y * Stride() + x, Stride(), width, height, BitDepth(), Floor(), Neutral(), Ceil(), GetTransferChar());
+}
+
 
-        if (PixelCount() != newPC)
+template < typename _Ty >
+PlaneT<_Ty> &PlaneT<_Ty>::ReSize(PCType _Width, PCType _Height, PCType _Stride)
+{
+    const PCType newStride = _Stride > 0 ? ::Max(_Stride, _Width) : PlaneStride(_Width);
+
+    if (Width() != _Width || Height() != _Height || (_Stride > 0 && Stride() != newStride && !isView()))
+    {
+        if (isView())
         {
-            auto originPC = PixelCount();
-            PixelCount_ = newPC;
+            DEBUG_FAIL("Plane::ReSize: a view can't be resized.");
+        }
 
-            if (newPC == 0)
+        const size_type newSize = static_cast<size_type>(newStride) * _Height;
+
+        if (size() != newSize)
+        {
+            // Leave the storage of the frame
+            if (Slab_)
             {
-                AlignedFree(Data_);
+                Buffer_ = nullptr;
+                Slab_ = false;
             }
-            else if (originPC == 0)
+
+            if (newSize == 0)
             {
-                AlignedMalloc(Data_, newPC);
+                PoolFree(Buffer_);
             }
             else
             {
-                AlignedRealloc(Data_, newPC);
+                PoolRealloc(Buffer_, newSize);
             }
+
+            Data_ = Buffer_;
         }
 
         Width_ = _Width;
         Height_ = _Height;
+        Stride_ = newStride;
+        PixelCount_ = _Width * _Height;
     }
 
     return *this;
 }
 
-Plane &Plane::ReQuantize(value_type _BitDepth, QuantRange _QuantRange, bool scale, bool clip)
+template < typename _Ty >
+PlaneT<_Ty> &PlaneT<_Ty>::ReQuantize(value_type _BitDepth, QuantRange _QuantRange, bool scale, bool clip)
 {
     const char *FunctionName = "Plane::ReQuantize";
-    if (_BitDepth > MaxBitDepth)
+    if (_BitDepth > StorageBitDepth<value_type>())
     {
-        std::cerr << FunctionName << ": \"BitDepth=" << _BitDepth
-            << "\" is invalid, maximum allowed bit depth is " << MaxBitDepth << ".\n";
+        std::cerr << FunctionName << ": \"BitDepth=" << DType(_BitDepth)
+            << "\" is invalid, maximum allowed bit depth is " << StorageBitDepth<value_type>() << ".\n";
         DEBUG_BREAK;
     }
 
@@ -279,33 +488,34 @@ Plane &Plane::ReQuantize(value_type _BitDepth, QuantRange _QuantRange, bool scal
     return ReQuantize(_BitDepth, _Floor, _Neutral, _Ceil, scale, clip);
 }
 
-Plane &Plane::ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale, bool clip)
+template < typename _Ty >
+PlaneT<_Ty> &PlaneT<_Ty>::ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale, bool clip)
 {
     value_type _ValueRange = _Ceil - _Floor;
 
     const char *FunctionName = "Plane::ReQuantize";
-    if (_BitDepth > MaxBitDepth)
+    if (_BitDepth > StorageBitDepth<value_type>())
     {
-        std::cerr << FunctionName << ": \"BitDepth=" << _BitDepth
-            << "\" is invalid, maximum allowed bit depth is " << MaxBitDepth << ".\n";
+        std::cerr << FunctionName << ": \"BitDepth=" << DType(_BitDepth)
+            << "\" is invalid, maximum allowed bit depth is " << StorageBitDepth<value_type>() << ".\n";
         DEBUG_BREAK;
     }
     if (_Ceil <= _Floor)
     {
         std::cerr << FunctionName << ": invalid values of \"Floor="
-            << _Floor << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
+            << DType(_Floor) << "\" and \"Ceil=" << DType(_Ceil) << "\" are set.\n";
         DEBUG_BREAK;
     }
     if (_ValueRange >= value_type(1) << _BitDepth)
     {
-        std::cerr << FunctionName << ": \"Ceil-Floor=" << _ValueRange
-            << "\" exceeds \"BitDepth=" << _BitDepth << "\" limit.\n";
+        std::cerr << FunctionName << ": \"Ceil-Floor=" << DType(_ValueRange)
+            << "\" exceeds \"BitDepth=" << DType(_BitDepth) << "\" limit.\n";
         DEBUG_BREAK;
     }
     if (_Neutral > _Floor && _Neutral != (_Floor + _Ceil + 1) / 2)
     {
-        std::cerr << FunctionName << ": invalid values of \"Floor=" << _Floor
-            << "\", \"Neutral=" << _Neutral << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
+        std::cerr << FunctionName << ": invalid values of \"Floor=" << DType(_Floor)
+            << "\", \"Neutral=" << DType(_Neutral) << "\" and \"Ceil=" << DType(_Ceil) << "\" are set.\n";
         DEBUG_BREAK;
     }
 
@@ -342,7 +552,8 @@ Plane &Plane::ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Ne
 }
 
 
-Plane &Plane::Binarize(const _Myt &src, value_type lower_thrD, value_type upper_thrD)
+template < typename _Ty >
+PlaneT<_Ty> &PlaneT<_Ty>::Binarize(const _Myt &src, value_type lower_thrD, value_type upper_thrD)
 {
     double lower_thr = static_cast<double>(lower_thrD - src.Floor()) / src.ValueRange();
     double upper_thr = static_cast<double>(upper_thrD - src.Floor()) / src.ValueRange();
@@ -350,7 +561,8 @@ Plane &Plane::Binarize(const _Myt &src, value_type lower_thrD, value_type upper_
     return Binarize_ratio(src, lower_thr, upper_thr);
 }
 
-Plane &Plane::Binarize_ratio(const _Myt &src, double lower_thr, double upper_thr)
+template < typename _Ty >
+PlaneT<_Ty> &PlaneT<_Ty>::Binarize_ratio(const _Myt &src, double lower_thr, double upper_thr)
 {
     auto &dst = *this;
 
@@ -424,6 +636,7 @@ void Plane_FL::CopyParaFrom(const _Myt &src)
 {
     Width_ = src.Width();
     Height_ = src.Height();
+    Stride_ = src.Stride();
     PixelCount_ = src.PixelCount();
     Floor_ = src.Floor();
     Neutral_ = src.Neutral();
@@ -445,56 +658,76 @@ void Plane_FL::InitValue(value_type Value, bool Init)
 
 
 Plane_FL::Plane_FL(value_type Value, PCType _Width, PCType _Height, bool RGB, bool Chroma, bool Init)
-    : Width_(_Width), Height_(_Height), PixelCount_(_Width * _Height), TransferChar_(!RGB&&Chroma ? TransferChar::linear : TransferChar_Default(_Width, _Height, RGB))
+    : Width_(_Width), Height_(_Height), Stride_(PlaneStride(_Width)), PixelCount_(_Width * _Height), TransferChar_(!RGB&&Chroma ? TransferChar::linear : TransferChar_Default(_Width, _Height, RGB))
 {
     DefaultPara(!RGB&&Chroma);
 
-    AlignedMalloc(Data_, size());
+    PoolMalloc(Buffer_, size());
+    Data_ = Buffer_;
 
     InitValue(Value, Init);
 }
 
-Plane_FL::Plane_FL(value_type Value, PCType _Width, PCType _Height, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init)
-    : Width_(_Width), Height_(_Height), PixelCount_(_Width * _Height),
+Plane_FL::Plane_FL(value_type Value, PCType _Width, PCType _Height, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init, PCType _Stride)
+    : Width_(_Width), Height_(_Height), Stride_(_Stride > 0 ? ::Max(_Stride, _Width) : PlaneStride(_Width)), PixelCount_(_Width * _Height),
     Floor_(_Floor), Neutral_(_Neutral), Ceil_(_Ceil), TransferChar_(_TransferChar)
 {
-    AlignedMalloc(Data_, size());
+    PoolMalloc(Buffer_, size());
+    Data_ = Buffer_;
 
     InitValue(Value, Init);
 }
 
 Plane_FL::Plane_FL(const _Myt &src)
-    : _Myt(src, false)
 {
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+    CopyParaFrom(src);
+
+    // The buffer is shared, while the memory of a view is copied
+    if (src.isView())
+    {
+        PoolMalloc(Buffer_, size());
+        Data_ = Buffer_;
+        MatCopy(Data_, src.data(), Height(), Width(), Stride(), src.Stride());
+    }
+    else
+    {
+        PoolRetain(src.Buffer_);
+        Data_ = src.Data_;
+        Buffer_ = src.Buffer_;
+    }
 }
 
 Plane_FL::Plane_FL(const _Myt &src, bool Init, value_type Value)
-    : _Myt(Value, src.Width(), src.Height(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), Init)
+    : _Myt(Value, src.Width(), src.Height(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), Init, src.Stride())
 {}
 
 Plane_FL::Plane_FL(_Myt &&src)
-    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()),
-    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
+    : Width_(src.Width()), Height_(src.Height()), Stride_(src.Stride()), PixelCount_(src.PixelCount()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar()),
+    Data_(src.Data_), Buffer_(src.Buffer_), View_(src.isView())
 {
-    Data_ = src.data();
-
     src.Width_ = 0;
     src.Height_ = 0;
+    src.Stride_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Buffer_ = nullptr;
+    src.View_ = false;
 }
 
-Plane_FL::Plane_FL(const Plane &src, value_type range)
+template < typename _St1 >
+Plane_FL::Plane_FL(const PlaneT<_St1> &src, value_type range)
     : _Myt(src, false, 0, range)
 {
     RangeConvert(*this, src);
 }
 
-Plane_FL::Plane_FL(const Plane &src, bool Init, value_type Value, value_type range)
-    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), TransferChar_(src.GetTransferChar())
+template < typename _St1 >
+Plane_FL::Plane_FL(const PlaneT<_St1> &src, bool Init, value_type Value, value_type range)
+    : Width_(src.Width()), Height_(src.Height()), Stride_(src.Stride()), PixelCount_(src.PixelCount()), TransferChar_(src.GetTransferChar())
 {
-    AlignedMalloc(Data_, size());
+    PoolMalloc(Buffer_, size());
+    Data_ = Buffer_;
 
     if (range > 0)
     {
@@ -511,9 +744,42 @@ Plane_FL::Plane_FL(const Plane &src, bool Init, value_type Value, value_type ran
 }
 
 
+Plane_FL::Plane_FL(pointer Data, PCType _Stride, PCType _Width, PCType _Height, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar)
+    : Width_(_Width), Height_(_Height), Stride_(_Stride), PixelCount_(_Width * _Height),
+    Floor_(_Floor), Neutral_(_Neutral), Ceil_(_Ceil), TransferChar_(_TransferChar), Data_(Data), View_(true)
+{
+    if (_Stride < _Width)
+    {
+        std::cerr << "class Plane_FL constructor: \"Stride=" << _Stride << "\" is less than \"Width=" << _Width << "\".\n";
+        DEBUG_BREAK;
+    }
+}
+
+
 Plane_FL::~Plane_FL()
 {
-    AlignedFree(Data_);
+    PoolFree(Buffer_);
+}
+
+
+void Plane_FL::Unshare()
+{
+    std::lock_guard<std::mutex> lock(UnshareMutex);
+
+    // Another thread may have made the buffer unique meanwhile
+    if (Buffer_ == nullptr || !PoolShared(Buffer_))
+    {
+        return;
+    }
+
+    pointer data;
+    PoolMalloc(data, size());
+    MatCopy(data, Data_, Height(), Width(), Stride(), Stride());
+
+    PoolFree(Buffer_);
+
+    Data_ = data;
+    Buffer_ = data;
 }
 
 
@@ -524,12 +790,38 @@ Plane_FL &Plane_FL::operator=(const _Myt &src)
         return *this;
     }
 
-    CopyParaFrom(src);
+    if (isView())
+    {
+        if (Width() != src.Width() || Height() != src.Height())
+        {
+            DEBUG_FAIL("Plane_FL::operator=: a view can only be assigned from a plane of the same size.");
+        }
 
-    AlignedFree(Data_);
-    AlignedMalloc(Data_, size());
+        const PCType _Stride = Stride();
+        CopyParaFrom(src);
+        Stride_ = _Stride;
+    }
+    else if (!src.isView())
+    {
+        // Share the buffer
+        PoolRetain(src.Buffer_);
+        PoolFree(Buffer_);
+
+        CopyParaFrom(src);
+        Data_ = src.Data_;
+        Buffer_ = src.Buffer_;
 
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+        return *this;
+    }
+    else
+    {
+        CopyParaFrom(src);
+
+        PoolRealloc(Buffer_, size());
+        Data_ = Buffer_;
+    }
+
+    MatCopy(Data_, src.data(), Height(), Width(), Stride(), src.Stride());
 
     return *this;
 }
@@ -541,15 +833,25 @@ Plane_FL &Plane_FL::operator=(_Myt &&src)
         return *this;
     }
 
-    CopyParaFrom(src);
+    if (isView())
+    {
+        return *this = static_cast<const _Myt &>(src);
+    }
 
-    AlignedFree(Data_);
-    Data_ = src.data();
+    PoolFree(Buffer_);
+
+    CopyParaFrom(src);
+    Data_ = src.Data_;
+    Buffer_ = src.Buffer_;
+    View_ = src.isView();
 
     src.Width_ = 0;
     src.Height_ = 0;
+    src.Stride_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Buffer_ = nullptr;
+    src.View_ = false;
 
     return *this;
 }
@@ -567,16 +869,21 @@ bool Plane_FL::operator==(const _Myt &b) const
         return false;
     }
 
-    PCType i;
-    for (i = 0; Data_[i] == b.Data_[i] && i < PixelCount(); i++);
-    if (i < PixelCount())
-    {
-        return false;
-    }
-    else
+    for (PCType j = 0; j < Height(); ++j)
     {
-        return true;
+        const_pointer p0 = data() + j * Stride();
+        const_pointer p1 = b.data() + j * b.Stride();
+
+        for (PCType i = 0; i < Width(); ++i)
+        {
+            if (p0[i] != p1[i])
+            {
+                return false;
+            }
+        }
     }
+
+    return true;
 }
 
 
@@ -622,33 +929,50 @@ Plane_FL::value_type Plane_FL::Variance(value_type Mean) const
 }
 
 
-Plane_FL &Plane_FL::ReSize(PCType _Width, PCType _Height)
+Plane_FL Plane_FL::MakeView(PCType y, PCType x, PCType height, PCType width) const
 {
-    if (Width() != _Width || Height() != _Height)
+    if (y < 0 || x < 0 || height < 0 || width < 0 || y + height > Height() || x + width > Width())
     {
-        auto newPC = _Width * _Height;
+        std::cerr << "Plane_FL::View: the rectangle of " << width << "x" << height << " at (" << x << ", " << y
+            << ") is out of the plane of " << Width() << "x" << Height() << ".\n";
+        DEBUG_BREAK;
+    }
+
+    return _Myt(Data_ + y * Stride() + x, Stride(), width, height, Floor(), Neutral(), Ceil(), GetTransferChar());
+}
 
-        if (PixelCount() != newPC)
+
+Plane_FL &Plane_FL::ReSize(PCType _Width, PCType _Height, PCType _Stride)
+{
+    const PCType newStride = _Stride > 0 ? ::Max(_Stride, _Width) : PlaneStride(_Width);
+
+    if (Width() != _Width || Height() != _Height || (_Stride > 0 && Stride() != newStride && !isView()))
+    {
+        if (isView())
         {
-            auto originPC = PixelCount();
-            PixelCount_ = newPC;
+            DEBUG_FAIL("Plane_FL::ReSize: a view can't be resized.");
+        }
 
-            if (newPC == 0)
-            {
-                AlignedFree(Data_);
-            }
-            else if (originPC == 0)
+        const size_type newSize = static_cast<size_type>(newStride) * _Height;
+
+        if (size() != newSize)
+        {
+            if (newSize == 0)
             {
-                AlignedMalloc(Data_, newPC);
+                PoolFree(Buffer_);
             }
             else
             {
-                AlignedRealloc(Data_, newPC);
+                PoolRealloc(Buffer_, newSize);
             }
+
+            Data_ = Buffer_;
         }
 
         Width_ = _Width;
         Height_ = _Height;
+        Stride_ = newStride;
+        PixelCount_ = _Width * _Height;
     }
 
     return *this;
@@ -656,8 +980,6 @@ Plane_FL &Plane_FL::ReSize(PCType _Width, PCType _Height)
 
 Plane_FL &Plane_FL::ReQuantize(value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale, bool clip)
 {
-    PCType i;
-
     const char *FunctionName = "Plane_FL::ReQuantize";
     if (_Ceil <= _Floor)
     {
@@ -679,17 +1001,17 @@ Plane_FL &Plane_FL::ReQuantize(value_type _Floor, value_type _Neutral, value_typ
 
         if (clip)
         {
-            for (i = 0; i < PixelCount(); i++)
+            transform([&](value_type x)
             {
-                Data_[i] = Clip(Data_[i] * gain + offset, _Floor, _Ceil);
-            }
+                return Clip(x * gain + offset, _Floor, _Ceil);
+            });
         }
         else
         {
-            for (i = 0; i < PixelCount(); i++)
+            transform([&](value_type x)
             {
-                Data_[i] = Data_[i] * gain + offset;
-            }
+                return x * gain + offset;
+            });
         }
     }
 
@@ -712,6 +1034,8 @@ Plane_FL &Plane_FL::Binarize(const _Myt &src, value_type lower_thrD, value_type
     double lower_thr = static_cast<double>(lower_thrD - src.Floor()) / src.ValueRange();
     double upper_thr = static_cast<double>(upper_thrD - src.Floor()) / src.ValueRange();
 
+    Detach();
+
     if (upper_thr <= lower_thr || lower_thr >= 1 || upper_thr < 0)
     {
         for (j = 0; j < height; j++)
@@ -787,7 +1111,98 @@ Plane_FL &Plane_FL::Binarize_ratio(const _Myt &src, double lower_thr, double upp
 
 
 // Functions of class Frame
-void Frame::InitPlanes(PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
+template < typename _Ty >
+typename FrameT<_Ty>::_Mysub *FrameT<_Ty>::AddPlane(PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, PCType _Stride)
+{
+    // The data is placed in the slab by AllocPlanes()
+    _Mysub &dst = P_[PlaneCount_++];
+    dst = _Mysub(nullptr, _Stride > 0 ? ::Max(_Stride, _Width) : PlaneStride(_Width), _Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, _TransferChar);
+    return &dst;
+}
+
+template < typename _Ty >
+typename FrameT<_Ty>::_Mysub *FrameT<_Ty>::AddPlane(const _Mysub &src)
+{
+    return AddPlane(src.Width(), src.Height(), src.BitDepth(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), src.Stride());
+}
+
+template < typename _Ty >
+void FrameT<_Ty>::AllocPlanes(bool Init)
+{
+    const size_type align = MEMORY_ALIGNMENT / sizeof(value_type);
+    size_type offset[MaxPlaneCount];
+
+    SlabSize_ = 0;
+
+    for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+    {
+        offset[i] = SlabSize_;
+        SlabSize_ += (P_[i].size() + align - 1) / align * align;
+    }
+
+    PoolMalloc(Slab_, SlabSize_);
+
+    // Neutral is the same as Floor for planes other than chroma
+    for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+    {
+        P_[i].SlabAttach(Slab_ + offset[i], Slab_);
+        P_[i].InitValue(P_[i].Neutral(), Init);
+    }
+}
+
+template < typename _Ty >
+bool FrameT<_Ty>::isContiguous() const
+{
+    if (Slab_ == nullptr)
+    {
+        return false;
+    }
+
+    for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+    {
+        if (!P_[i].Slab_) return false;
+    }
+
+    return true;
+}
+
+template < typename _Ty >
+void FrameT<_Ty>::Detach()
+{
+    if (isContiguous() && PoolShared(Slab_))
+    {
+        std::lock_guard<std::mutex> lock(UnshareMutex);
+
+        // Another thread may have made the slab unique meanwhile
+        if (!PoolShared(Slab_))
+        {
+            return;
+        }
+
+        pointer slab;
+        PoolMalloc(slab, SlabSize_);
+        memcpy(slab, Slab_, sizeof(value_type) * SlabSize_);
+
+        for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+        {
+            P_[i].SlabAttach(slab + (P_[i].Data_ - Slab_), slab);
+        }
+
+        PoolFree(Slab_);
+        Slab_ = slab;
+    }
+    else
+    {
+        for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+        {
+            P_[i].Detach();
+        }
+    }
+}
+
+
+template < typename _Ty >
+void FrameT<_Ty>::InitPlanes(PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
 {
     value_type _Floor, _Neutral, _Ceil;
 
@@ -799,23 +1214,17 @@ void Frame::InitPlanes(PCType _Width, PCType _Height, value_type _BitDepth, bool
 
         if (PixelType_ == PixelType::RGB || PixelType_ == PixelType::R)
         {
-            R_ = new _Mysub(_Floor, _Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_, Init);
-
-            P_[PlaneCount_++] = R_;
+            R_ = AddPlane(_Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_);
         }
 
         if (PixelType_ == PixelType::RGB || PixelType_ == PixelType::G)
         {
-            G_ = new _Mysub(_Floor, _Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_, Init);
-
-            P_[PlaneCount_++] = G_;
+            G_ = AddPlane(_Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_);
         }
 
         if (PixelType_ == PixelType::RGB || PixelType_ == PixelType::B)
         {
-            B_ = new _Mysub(_Floor, _Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_, Init);
-
-            P_[PlaneCount_++] = B_;
+            B_ = AddPlane(_Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_);
         }
     }
     else if (isYUV())
@@ -838,9 +1247,7 @@ void Frame::InitPlanes(PCType _Width, PCType _Height, value_type _BitDepth, bool
 
             Quantize_Value(_Floor, _Neutral, _Ceil, _BitDepth, QuantRange_, false);
 
-            Y_ = new _Mysub(_Floor, _Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_, Init);
-
-            P_[PlaneCount_++] = Y_;
+            Y_ = AddPlane(_Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar_);
         }
 
         if (PixelType_ != PixelType::Y)
@@ -863,22 +1270,21 @@ void Frame::InitPlanes(PCType _Width, PCType _Height, value_type _BitDepth, bool
 
             if (PixelType_ != PixelType::V)
             {
-                U_ = new _Mysub(_Neutral, _Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar::linear, Init);
-
-                P_[PlaneCount_++] = U_;
+                U_ = AddPlane(_Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar::linear);
             }
 
             if (PixelType_ != PixelType::U)
             {
-                V_ = new _Mysub(_Neutral, _Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar::linear, Init);
-
-                P_[PlaneCount_++] = V_;
+                V_ = AddPlane(_Width, _Height, _BitDepth, _Floor, _Neutral, _Ceil, TransferChar::linear);
             }
         }
     }
+
+    AllocPlanes(Init);
 }
 
-void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
+template < typename _Ty >
+void FrameT<_Ty>::CopyPlanes(const _Myt &src, bool Copy, bool Init)
 {
     value_type _Floor, _Neutral, _Ceil;
 
@@ -890,45 +1296,42 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
         {
             if (Copy)
             {
-                R_ = new _Mysub(src.R());
+                R_ = AddPlane(src.R());
             }
             else
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.R().BitDepth(), QuantRange_, false);
 
-                R_ = new _Mysub(_Floor, src.R().Width(), src.R().Height(), src.R().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                R_ = AddPlane(src.R().Width(), src.R().Height(), src.R().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, src.R().Stride());
             }
-            P_[PlaneCount_++] = R_;
         }
 
         if (PixelType_ == PixelType::RGB || PixelType_ == PixelType::G)
         {
             if (Copy)
             {
-                G_ = new _Mysub(src.G());
+                G_ = AddPlane(src.G());
             }
             else
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.G().BitDepth(), QuantRange_, false);
 
-                G_ = new _Mysub(_Floor, src.G().Width(), src.G().Height(), src.G().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                G_ = AddPlane(src.G().Width(), src.G().Height(), src.G().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, src.G().Stride());
             }
-            P_[PlaneCount_++] = G_;
         }
 
         if (PixelType_ == PixelType::RGB || PixelType_ == PixelType::B)
         {
             if (Copy)
             {
-                B_ = new _Mysub(src.B());
+                B_ = AddPlane(src.B());
             }
             else
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.B().BitDepth(), QuantRange_, false);
 
-                B_ = new _Mysub(_Floor, src.B().Width(), src.B().Height(), src.B().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                B_ = AddPlane(src.B().Width(), src.B().Height(), src.B().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, src.B().Stride());
             }
-            P_[PlaneCount_++] = B_;
         }
     }
     else if (isYUV())
@@ -937,15 +1340,14 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
         {
             if (Copy)
             {
-                Y_ = new _Mysub(src.Y());
+                Y_ = AddPlane(src.Y());
             }
             else
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.Y().BitDepth(), QuantRange_, false);
 
-                Y_ = new _Mysub(_Floor, src.Y().Width(), src.Y().Height(), src.Y().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                Y_ = AddPlane(src.Y().Width(), src.Y().Height(), src.Y().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, src.Y().Stride());
             }
-            P_[PlaneCount_++] = Y_;
         }
 
         if (PixelType_ != PixelType::Y)
@@ -954,49 +1356,96 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
             {
                 if (Copy)
                 {
-                    U_ = new _Mysub(src.U());
+                    U_ = AddPlane(src.U());
                 }
                 else
                 {
                     Quantize_Value(_Floor, _Neutral, _Ceil, src.U().BitDepth(), QuantRange_, true);
 
-                    U_ = new _Mysub(_Neutral, src.U().Width(), src.U().Height(), src.U().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar::linear, Init);
+                    U_ = AddPlane(src.U().Width(), src.U().Height(), src.U().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar::linear, src.U().Stride());
                 }
-                P_[PlaneCount_++] = U_;
             }
 
             if (PixelType_ != PixelType::U)
             {
                 if (Copy)
                 {
-                    V_ = new _Mysub(src.V());
+                    V_ = AddPlane(src.V());
                 }
                 else
                 {
                     Quantize_Value(_Floor, _Neutral, _Ceil, src.V().BitDepth(), QuantRange_, true);
 
-                    V_ = new _Mysub(_Neutral, src.V().Width(), src.V().Height(), src.V().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar::linear, Init);
+                    V_ = AddPlane(src.V().Width(), src.V().Height(), src.V().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar::linear, src.V().Stride());
                 }
-                P_[PlaneCount_++] = V_;
             }
         }
     }
+
+    if (!Copy)
+    {
+        AllocPlanes(Init);
+    }
+    else if (src.isContiguous())
+    {
+        // Share the slab
+        PoolRetain(src.Slab_);
+        Slab_ = src.Slab_;
+        SlabSize_ = src.SlabSize_;
+
+        for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+        {
+            P_[i].SlabAttach(Slab_ + (src.P_[i].Data_ - src.Slab_), Slab_);
+        }
+    }
+    else if (src.isView())
+    {
+        AllocPlanes(false);
+
+        for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+        {
+            MatCopy(P_[i].Data_, src.P_[i].Data_, P_[i].Height(), P_[i].Width(), P_[i].Stride(), src.P_[i].Stride());
+        }
+    }
+    else
+    {
+        // Share the buffer of each plane
+        for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+        {
+            P_[i].Release();
+            P_[i] = src.P_[i];
+        }
+    }
 }
 
-void Frame::MovePlanes(_Myt &src)
+template < typename _Ty >
+void FrameT<_Ty>::MovePlanes(_Myt &src)
 {
     PlaneCount_ = src.PlaneCount_;
 
-    P_ = std::move(src.P_);
-    src.P_.insert(src.P_.end(), MaxPlaneCount, nullptr);
+    // The planes in the slab are taken along with it
+    for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+    {
+        const bool slab = src.P_[i].Slab_;
+        src.P_[i].Slab_ = false;
+        P_[i] = std::move(src.P_[i]);
+        P_[i].Slab_ = slab;
+    }
+
+    Slab_ = src.Slab_;
+    SlabSize_ = src.SlabSize_;
 
-    R_ = src.R_;
-    G_ = src.G_;
-    B_ = src.B_;
-    Y_ = src.Y_;
-    U_ = src.U_;
-    V_ = src.V_;
-    A_ = src.A_;
+    R_ = MapPlane(src, src.R_);
+    G_ = MapPlane(src, src.G_);
+    B_ = MapPlane(src, src.B_);
+    Y_ = MapPlane(src, src.Y_);
+    U_ = MapPlane(src, src.U_);
+    V_ = MapPlane(src, src.V_);
+    A_ = MapPlane(src, src.A_);
+
+    src.PlaneCount_ = 0;
+    src.Slab_ = nullptr;
+    src.SlabSize_ = 0;
 
     src.R_ = nullptr;
     src.G_ = nullptr;
@@ -1007,16 +1456,19 @@ void Frame::MovePlanes(_Myt &src)
     src.A_ = nullptr;
 }
 
-void Frame::FreePlanes()
+template < typename _Ty >
+void FrameT<_Ty>::FreePlanes()
 {
-    PlaneCount_ = 0;
-
-    for (auto x : P_)
+    for (PlaneCountType i = 0; i < PlaneCount_; ++i)
     {
-        delete x;
-        x = nullptr;
+        P_[i].Release();
     }
 
+    PlaneCount_ = 0;
+
+    PoolFree(Slab_);
+    SlabSize_ = 0;
+
     R_ = nullptr;
     G_ = nullptr;
     B_ = nullptr;
@@ -1027,40 +1479,45 @@ void Frame::FreePlanes()
 }
 
 
-Frame::Frame(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
+template < typename _Ty >
+FrameT<_Ty>::FrameT(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
     : _Myt(_FrameNum, _PixelType, _Width, _Height, _BitDepth, isYUV(_PixelType) ? QuantRange::TV : QuantRange::PC, ChromaPlacement::MPEG2, Init)
 {}
 
-Frame::Frame(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth,
+template < typename _Ty >
+FrameT<_Ty>::FrameT(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth,
     QuantRange _QuantRange, ChromaPlacement _ChromaPlacement, bool Init)
     : _Myt(_FrameNum, _PixelType, _Width, _Height, _BitDepth, _QuantRange, _ChromaPlacement,
     ColorPrim_Default(_Width, _Height, isRGB(_PixelType)), TransferChar_Default(_Width, _Height, isRGB(_PixelType)), ColorMatrix_Default(_Width, _Height))
 {}
 
-Frame::Frame(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth, QuantRange _QuantRange,
+template < typename _Ty >
+FrameT<_Ty>::FrameT(FCType _FrameNum, PixelType _PixelType, PCType _Width, PCType _Height, value_type _BitDepth, QuantRange _QuantRange,
     ChromaPlacement _ChromaPlacement, ColorPrim _ColorPrim, TransferChar _TransferChar, ColorMatrix _ColorMatrix, bool Init)
     : FrameNum_(_FrameNum), PixelType_(_PixelType), QuantRange_(_QuantRange), ChromaPlacement_(_ChromaPlacement),
-    ColorPrim_(_ColorPrim), TransferChar_(_TransferChar), ColorMatrix_(_ColorMatrix), P_(MaxPlaneCount, nullptr)
+    ColorPrim_(_ColorPrim), TransferChar_(_TransferChar), ColorMatrix_(_ColorMatrix)
 {
     const char *FunctionName = "class Frame constructor";
-    if (_BitDepth > MaxBitDepth)
+    if (_BitDepth > StorageBitDepth<value_type>())
     {
-        std::cerr << FunctionName << ": \"BitDepth=" << _BitDepth
-            << "\" is invalid, maximum allowed bit depth is " << MaxBitDepth << ".\n";
+        std::cerr << FunctionName << ": \"BitDepth=" << DType(_BitDepth)
+            << "\" is invalid, maximum allowed bit depth is " << StorageBitDepth<value_type>() << ".\n";
         DEBUG_BREAK;
     }
 
     InitPlanes(_Width, _Height, _BitDepth, Init);
 }
 
-Frame::Frame(const _Myt &src, bool Copy, bool Init)
+template < typename _Ty >
+FrameT<_Ty>::FrameT(const _Myt &src, bool Copy, bool Init)
     : FrameNum_(src.FrameNum()), PixelType_(src.GetPixelType()), QuantRange_(src.GetQuantRange()), ChromaPlacement_(src.GetChromaPlacement()),
-    ColorPrim_(src.GetColorPrim()), TransferChar_(src.GetTransferChar()), ColorMatrix_(src.GetColorMatrix()), P_(MaxPlaneCount, nullptr)
+    ColorPrim_(src.GetColorPrim()), TransferChar_(src.GetTransferChar()), ColorMatrix_(src.GetColorMatrix())
 {
     CopyPlanes(src, Copy, Init);
 }
 
-Frame::Frame(_Myt &&src)
+template < typename _Ty >
+FrameT<_Ty>::FrameT(_Myt &&src)
     : FrameNum_(src.FrameNum()), PixelType_(src.GetPixelType()), QuantRange_(src.GetQuantRange()), ChromaPlacement_(src.GetChromaPlacement()),
     ColorPrim_(src.GetColorPrim()), TransferChar_(src.GetTransferChar()), ColorMatrix_(src.GetColorMatrix())
 {
@@ -1068,13 +1525,15 @@ Frame::Frame(_Myt &&src)
 }
 
 
-Frame::~Frame()
+template < typename _Ty >
+FrameT<_Ty>::~FrameT()
 {
     FreePlanes();
 }
 
 
-Frame &Frame::operator=(const _Myt &src)
+template < typename _Ty >
+FrameT<_Ty> &FrameT<_Ty>::operator=(const _Myt &src)
 {
     if (this == &src)
     {
@@ -1089,18 +1548,39 @@ Frame &Frame::operator=(const _Myt &src)
     TransferChar_ = src.GetTransferChar();
     ColorMatrix_ = src.GetColorMatrix();
 
-    CopyPlanes(src, true);
+    if (isView())
+    {
+        if (PlaneCount() != src.PlaneCount())
+        {
+            DEBUG_FAIL("Frame::operator=: a view can only be assigned from a frame of the same planes.");
+        }
+
+        for (PlaneCountType i = 0; i < PlaneCount(); ++i)
+        {
+            P(i) = src.P(i);
+        }
+    }
+    else
+    {
+        CopyPlanes(src, true);
+    }
 
     return *this;
 }
 
-Frame &Frame::operator=(_Myt &&src)
+template < typename _Ty >
+FrameT<_Ty> &FrameT<_Ty>::operator=(_Myt &&src)
 {
     if (this == &src)
     {
         return *this;
     }
 
+    if (isView())
+    {
+        return *this = static_cast<const _Myt &>(src);
+    }
+
     FrameNum_ = src.FrameNum();
     PixelType_ = src.GetPixelType();
     QuantRange_ = src.GetQuantRange();
@@ -1116,7 +1596,42 @@ Frame &Frame::operator=(_Myt &&src)
     return *this;
 }
 
-bool Frame::operator==(const _Myt &b) const
+template < typename _Ty >
+FrameT<_Ty> FrameT<_Ty>::MakeView(PCType y, PCType x, PCType height, PCType width) const
+{
+    _Myt dst;
+
+    dst.FrameNum_ = FrameNum_;
+    dst.PixelType_ = PixelType_;
+    dst.QuantRange_ = QuantRange_;
+    dst.ChromaPlacement_ = ChromaPlacement_;
+    dst.ColorPrim_ = ColorPrim_;
+    dst.TransferChar_ = TransferChar_;
+    dst.ColorMatrix_ = ColorMatrix_;
+
+    for (PlaneCountType i = 0; i < PlaneCount_; ++i)
+    {
+        const _Mysub &src = P_[i];
+        const PCType sw = Width() / src.Width();
+        const PCType sh = Height() / src.Height();
+
+        dst.P_[dst.PlaneCount_++] = src.MakeView(y / sh, x / sw, height / sh, width / sw);
+    }
+
+    dst.R_ = dst.MapPlane(*this, R_);
+    dst.G_ = dst.MapPlane(*this, G_);
+    dst.B_ = dst.MapPlane(*this, B_);
+    dst.Y_ = dst.MapPlane(*this, Y_);
+    dst.U_ = dst.MapPlane(*this, U_);
+    dst.V_ = dst.MapPlane(*this, V_);
+    dst.A_ = dst.MapPlane(*this, A_);
+
+    return dst;
+}
+
+
+template < typename _Ty >
+bool FrameT<_Ty>::operator==(const _Myt &b) const
 {
     if (this == &b)
     {
@@ -1169,3 +1684,20 @@ bool Frame::operator==(const _Myt &b) const
 
     return true;
 }
+
+
+// Explicit instantiation of the storage types
+template class PlaneT<DType>;
+template class PlaneT<uint16>;
+template class PlaneT<uint8>;
+
+template Plane_FL::Plane_FL(const PlaneT<DType> &src, value_type range);
+template Plane_FL::Plane_FL(const PlaneT<uint16> &src, value_type range);
+template Plane_FL::Plane_FL(const PlaneT<uint8> &src, value_type range);
+template Plane_FL::Plane_FL(const PlaneT<DType> &src, bool Init, value_type Value, value_type range);
+template Plane_FL::Plane_FL(const PlaneT<uint16> &src, bool Init, value_type Value, value_type range);
+template Plane_FL::Plane_FL(const PlaneT<uint8> &src, bool Init, value_type Value, value_type range);
+
+template class FrameT<DType>;
+template class FrameT<uint16>;
+template class FrameT<uint8>;
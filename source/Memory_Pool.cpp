@@ -0,0 +1,246 @@
+#include <cstdlib>
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include "Memory_Pool.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Each buffer is preceded by a header of MEMORY_ALIGNMENT bytes holding its capacity and reference count
+class Memory_Pool
+{
+public:
+    typedef Memory_Pool _Myt;
+
+private:
+    std::mutex mutex;
+    std::unordered_map<size_t, std::vector<void *>> buckets;
+
+    size_t cached = 0;
+    size_t limit = 0;
+
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+
+    static size_t &Capacity(void *Memory)
+    {
+        return *reinterpret_cast<size_t *>(reinterpret_cast<char *>(Memory) - MEMORY_ALIGNMENT);
+    }
+
+    // 64 bytes granularity up to 4 KiB, then 4 buckets per power of 2, wasting at most 25% of the size
+    static size_t BucketSize(size_t Size)
+    {
+        const size_t small = 4096;
+
+        if (Size <= small)
+        {
+            return Max((Size + MEMORY_ALIGNMENT - 1) / MEMORY_ALIGNMENT, size_t(1)) * MEMORY_ALIGNMENT;
+        }
+
+        size_t power = small;
+        while (power * 2 < Size) power *= 2;
+
+        const size_t step = power / 4;
+        return (Size + step - 1) / step * step;
+    }
+
+    static size_t DefaultLimit()
+    {
+        const char *env = std::getenv("ISP_MW_POOL_LIMIT");
+
+        if (env != nullptr)
+        {
+            double mib = std::atof(env);
+            if (mib >= 0) return static_cast<size_t>(mib * 1024 * 1024);
+        }
+
+        return size_t(1024) * 1024 * 1024;
+    }
+
+    // Called with the mutex locked
+    void Trim()
+    {
+        for (auto &bucket : buckets)
+        {
+            while (cached > limit && !bucket.second.empty())
+            {
+                void *base = reinterpret_cast<char *>(bucket.second.back()) - MEMORY_ALIGNMENT;
+                bucket.second.pop_back();
+                cached -= bucket.first;
+                AlignedFree(&base);
+            }
+        }
+    }
+
+public:
+    Memory_Pool()
+        : limit(DefaultLimit()), hits(0), misses(0)
+    {}
+
+    Memory_Pool(const _Myt &src) = delete;
+    _Myt &operator=(const _Myt &src) = delete;
+
+    void *Malloc(size_t Size)
+    {
+        const size_t capacity = BucketSize(Size);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto iter = buckets.find(capacity);
+
+            if (iter != buckets.end() && !iter->second.empty())
+            {
+                void *Memory = iter->second.back();
+                iter->second.pop_back();
+                cached -= capacity;
+                ++hits;
+                return Memory;
+            }
+        }
+
+        ++misses;
+
+        void *Memory = reinterpret_cast<char *>(AlignedMalloc(capacity + MEMORY_ALIGNMENT)) + MEMORY_ALIGNMENT;
+        Capacity(Memory) = capacity;
+        new (&PoolRefCount(Memory)) std::atomic<size_t>(0);
+        return Memory;
+    }
+
+    void Free(void *Memory)
+    {
+        if (Memory == nullptr)
+        {
+            return;
+        }
+
+        const size_t capacity = Capacity(Memory);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (cached + capacity <= limit)
+            {
+                buckets[capacity].push_back(Memory);
+                cached += capacity;
+                return;
+            }
+        }
+
+        void *base = reinterpret_cast<char *>(Memory) - MEMORY_ALIGNMENT;
+        AlignedFree(&base);
+    }
+
+    void SetLimit(size_t _limit)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        limit = _limit;
+        Trim();
+    }
+
+    void Release()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const size_t _limit = limit;
+        limit = 0;
+        Trim();
+        limit = _limit;
+
+        buckets.clear();
+    }
+
+    Memory_Pool_Stats Stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Memory_Pool_Stats stats;
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.cached = cached;
+        stats.limit = limit;
+        return stats;
+    }
+
+    static size_t CapacityOf(const void *Memory)
+    {
+        return Capacity(const_cast<void *>(Memory));
+    }
+};
+
+
+// Constructed on first use and never destroyed, so that it outlives the static objects of other translation units.
+// Published by compare-exchange (see THREAD_LOCAL in Thread_Pool.h), a thread losing the race deletes its instance.
+static std::atomic<Memory_Pool *> PoolInstance;
+
+static Memory_Pool &Pool()
+{
+    Memory_Pool *pool = PoolInstance.load(std::memory_order_acquire);
+
+    if (pool == nullptr)
+    {
+        Memory_Pool *created = new Memory_Pool;
+
+        if (PoolInstance.compare_exchange_strong(pool, created, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            pool = created;
+        }
+        else
+        {
+            delete created;
+        }
+    }
+
+    return *pool;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+void SetMemoryPoolLimit(size_t limit)
+{
+    Pool().SetLimit(limit);
+}
+
+Memory_Pool_Stats GetMemoryPoolStats()
+{
+    return Pool().Stats();
+}
+
+void MemoryPoolRelease()
+{
+    Pool().Release();
+}
+
+
+void *PoolMalloc(size_t Size)
+{
+    void *Memory = Pool().Malloc(Size);
+    PoolRefCount(Memory).store(1, std::memory_order_relaxed);
+    return Memory;
+}
+
+void PoolFree(void *Memory)
+{
+    if (Memory != nullptr && PoolRefCount(Memory).fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        Pool().Free(Memory);
+    }
+}
+
+void PoolRetain(const void *Memory)
+{
+    if (Memory != nullptr)
+    {
+        PoolRefCount(Memory).fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t PoolCapacity(const void *Memory)
+{
+    return Memory_Pool::CapacityOf(Memory);
+}
@@ -1,11 +1,12 @@
 #include "NLMeans.h"
 #include "Conversion.hpp"
+#include "Expression.hpp"
 
 
 // Get the filtered block through weighted averaging of matched blocks in Plane src
 template < typename _St1 >
 void NLMeans::WeightedAverage(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-    const PosPairCode &code)
+    const PosPairCode &code, block_type &sumX1) const
 {
     PCType GroupSize = static_cast<PCType>(code.size());
     // When para.GroupSize > 0, limit GroupSize up to para.GroupSize
@@ -24,7 +25,7 @@ void NLMeans::WeightedAverage(block_type &dstBlock, const block_type &refBlock,
         dstBlock.SetPos(refBlock.GetPos());
     }
 
-    block_type sumX1(refBlock, true, 0);
+    sumX1.InitValue(true, 0);
 
     FLType exponentMul = static_cast<FLType>(-1 / (para.strength * para.strength));
     FLType weightSum = 0;
@@ -66,7 +67,7 @@ void NLMeans::WeightedAverage(block_type &dstBlock, const block_type &refBlock,
 // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
 template < typename _St1 >
 void NLMeans::WeightedAverage_Correction(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-    const PosPairCode &code)
+    const PosPairCode &code, block_type &sumX1, block_type &sumX2) const
 {
     PCType GroupSize = static_cast<PCType>(code.size());
     // When para.GroupSize > 0, limit GroupSize up to para.GroupSize
@@ -85,8 +86,8 @@ void NLMeans::WeightedAverage_Correction(block_type &dstBlock, const block_type
         dstBlock.SetPos(refBlock.GetPos());
     }
 
-    block_type sumX1(refBlock, true, 0);
-    block_type sumX2(refBlock, true, 0);
+    sumX1.InitValue(true, 0);
+    sumX2.InitValue(true, 0);
 
     FLType exponentMul = static_cast<FLType>(-1 / (para.strength * para.strength));
     FLType weightSum = 0;
@@ -146,6 +147,28 @@ void NLMeans::WeightedAverage_Correction(block_type &dstBlock, const block_type
 }
 
 
+// Incremental block matching pays off when the reference blocks overlap a lot, but it's only used on request,
+// since the distances may differ in the last bits and so may the output, returns nullptr for the direct matching
+std::unique_ptr<NLMeans::matcher_type> NLMeans::CreateMatcher(const Plane_FL &ref,
+    const std::vector<PCType> &rows, const std::vector<PCType> &cols) const
+{
+    if (para.BMalgorithm != 2)
+    {
+        return nullptr;
+    }
+
+    return std::unique_ptr<matcher_type>(new matcher_type(ref, para.BlockSize, para.BlockSize, rows, cols,
+        para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true));
+}
+
+
+// Rows of reference blocks matched together by the incremental block matching
+PCType NLMeans::MatchRows() const
+{
+    return (para.BlockSize + para.BlockStep - 1) / para.BlockStep * 2;
+}
+
+
 // Non-local Means denoising algorithm based on block matching and weighted average of grouped blocks
 Plane_FL &NLMeans::process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref)
 {
@@ -159,71 +182,73 @@ Plane_FL &NLMeans::process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Pl
     PCType height = src.Height();
     PCType width = src.Width();
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
-
     block_type dstBlock(para.BlockSize, para.BlockSize, Pos(0, 0), false);
     block_type srcBlock(para.BlockSize, para.BlockSize, Pos(0, 0), false);
     block_type refBlock(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+    block_type sumX1(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+    block_type sumX2(para.BlockSize, para.BlockSize, Pos(0, 0), false);
 
     Plane_FL ResNum(dst, true, 0);
     Plane_FL ResDen(dst, true, 0);
 
-    for (PCType j = 0;; j += para.BlockStep)
+    const std::vector<PCType> rows = BlockGridPos(height, para.BlockSize, para.BlockStep);
+    const std::vector<PCType> cols = BlockGridPos(width, para.BlockSize, para.BlockStep);
+
+    const PCType rowCount = static_cast<PCType>(rows.size());
+    const PCType colCount = static_cast<PCType>(cols.size());
+
+    // With incremental block matching, a batch of rows is matched at a time
+    const auto matcher = CreateMatcher(ref, rows, cols);
+    const PCType matchRows = matcher ? MatchRows() : 1;
+
+    // All the buffers are reused, no allocation happens in the loop once they're large enough
+    std::vector<PosPairCode> matchCodes(matcher ? matchRows * colCount : 0);
+    matcher_type::Buffer matcherBuffer;
+    PosPairCode directCode;
+
+    for (PCType r0 = 0; r0 < rowCount; r0 += matchRows)
     {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
-        {
-            break;
-        }
-        else if (j > BlockPosBottom)
-        {
-            j = BlockPosBottom;
-        }
+        const PCType r1 = Min(rowCount, r0 + matchRows);
 
-        for (PCType i = 0;; i += para.BlockStep)
+        if (matcher) matcher->Match(matchCodes.data(), colCount, matcherBuffer, r0, r1, 0, colCount);
+
+        for (PCType r = r0; r < r1; ++r)
         {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
-            {
-                break;
-            }
-            else if (i > BlockPosRight)
+            for (PCType c = 0; c < colCount; ++c)
             {
-                i = BlockPosRight;
-            }
+                const Pos pos(rows[r], cols[c]);
 
-            // Get source block from src
-            srcBlock.From(src, Pos(j, i));
+                // Get source block from src
+                srcBlock.From(src, pos);
 
-            // Get reference block from ref
-            refBlock.From(ref, Pos(j, i));
+                // Get reference block from ref
+                refBlock.From(ref, pos);
 
-            // Form a group by block matching between reference block and its neighborhood in reference plane
-            PosPairCode matchCode = refBlock.BlockMatchingMulti(ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+                // Form a group by block matching between reference block and its neighborhood in reference plane
+                if (!matcher) refBlock.BlockMatchingMulti(directCode, ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
 
-            // Get the filtered block through weighted averaging of matched blocks in Plane src
-            // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
-            if (para.correction)
-            {
-                WeightedAverage_Correction(dstBlock, srcBlock, src, matchCode);
-            }
-            else
-            {
-                WeightedAverage(dstBlock, srcBlock, src, matchCode);
-            }
+                const PosPairCode &matchCode = matcher ? matchCodes[(r - r0) * colCount + c] : directCode;
 
-            // The filtered blocks are sumed and averaged to form the final filtered image
-            dstBlock.AddTo(ResNum);
-            dstBlock.CountTo(ResDen);
+                // Get the filtered block through weighted averaging of matched blocks in Plane src
+                // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
+                if (para.correction)
+                {
+                    WeightedAverage_Correction(dstBlock, srcBlock, src, matchCode, sumX1, sumX2);
+                }
+                else
+                {
+                    WeightedAverage(dstBlock, srcBlock, src, matchCode, sumX1);
+                }
+
+                // The filtered blocks are sumed and averaged to form the final filtered image
+                dstBlock.AddTo(ResNum);
+                dstBlock.CountTo(ResDen);
+            }
         }
     }
 
     // The filtered blocks are sumed and averaged to form the final filtered image
-    _Transform(dst, ResNum, ResDen, [](FLType num, FLType den)
-    {
-        return num / den;
-    });
+    Evaluate(dst, ResNum / ResDen);
 
     return dst;
 }
@@ -280,9 +305,6 @@ Frame &NLMeans::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
     Plane_FL refY(ref.P(0), false);
     ConvertToY(refY, ref, ColorMatrix::OPP);
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
-
     block_type dstBlock0(para.BlockSize, para.BlockSize, Pos(0, 0), false);
     block_type dstBlock1(para.BlockSize, para.BlockSize, Pos(0, 0), false);
     block_type dstBlock2(para.BlockSize, para.BlockSize, Pos(0, 0), false);
@@ -290,86 +312,85 @@ Frame &NLMeans::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
     block_type srcBlock1(para.BlockSize, para.BlockSize, Pos(0, 0), false);
     block_type srcBlock2(para.BlockSize, para.BlockSize, Pos(0, 0), false);
     block_type refBlockY(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+    block_type sumX1(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+    block_type sumX2(para.BlockSize, para.BlockSize, Pos(0, 0), false);
 
     Plane_FL ResNum0(dst0, true, 0);
     Plane_FL ResNum1(dst1, true, 0);
     Plane_FL ResNum2(dst2, true, 0);
     Plane_FL ResDen(dst0, true, 0);
 
-    for (PCType j = 0;; j += para.BlockStep)
-    {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
-        {
-            break;
-        }
-        else if (j > BlockPosBottom)
-        {
-            j = BlockPosBottom;
-        }
+    const std::vector<PCType> rows = BlockGridPos(height, para.BlockSize, para.BlockStep);
+    const std::vector<PCType> cols = BlockGridPos(width, para.BlockSize, para.BlockStep);
 
-        for (PCType i = 0;; i += para.BlockStep)
-        {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
-            {
-                break;
-            }
-            else if (i > BlockPosRight)
-            {
-                i = BlockPosRight;
-            }
+    const PCType rowCount = static_cast<PCType>(rows.size());
+    const PCType colCount = static_cast<PCType>(cols.size());
 
-            // Get reference block from ref
-            refBlockY.From(refY, Pos(j, i));
+    // With incremental block matching, a batch of rows is matched at a time
+    const auto matcher = CreateMatcher(refY, rows, cols);
+    const PCType matchRows = matcher ? MatchRows() : 1;
 
-            // Get source block from src
-            srcBlock0.From(src0, Pos(j, i));
-            srcBlock1.From(src1, Pos(j, i));
-            srcBlock2.From(src2, Pos(j, i));
+    // All the buffers are reused, no allocation happens in the loop once they're large enough
+    std::vector<PosPairCode> matchCodes(matcher ? matchRows * colCount : 0);
+    matcher_type::Buffer matcherBuffer;
+    PosPairCode directCode;
 
-            // Form a group by block matching between reference block and its neighborhood in reference plane
-            PosPairCode matchCode = refBlockY.BlockMatchingMulti(refY, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+    for (PCType r0 = 0; r0 < rowCount; r0 += matchRows)
+    {
+        const PCType r1 = Min(rowCount, r0 + matchRows);
 
-            // Get the filtered block through weighted averaging of matched blocks in Plane src
-            // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
-            if (para.correction)
-            {
-                WeightedAverage_Correction(dstBlock0, srcBlock0, src0, matchCode);
-                WeightedAverage_Correction(dstBlock1, srcBlock1, src1, matchCode);
-                WeightedAverage_Correction(dstBlock2, srcBlock2, src2, matchCode);
-            }
-            else
+        if (matcher) matcher->Match(matchCodes.data(), colCount, matcherBuffer, r0, r1, 0, colCount);
+
+        for (PCType r = r0; r < r1; ++r)
+        {
+            for (PCType c = 0; c < colCount; ++c)
             {
-                WeightedAverage(dstBlock0, srcBlock0, src0, matchCode);
-                WeightedAverage(dstBlock1, srcBlock1, src1, matchCode);
-                WeightedAverage(dstBlock2, srcBlock2, src2, matchCode);
+                const Pos pos(rows[r], cols[c]);
+
+                // Get reference block from ref
+                refBlockY.From(refY, pos);
+
+                // Get source block from src
+                srcBlock0.From(src0, pos);
+                srcBlock1.From(src1, pos);
+                srcBlock2.From(src2, pos);
+
+                // Form a group by block matching between reference block and its neighborhood in reference plane
+                if (!matcher) refBlockY.BlockMatchingMulti(directCode, refY, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+
+                const PosPairCode &matchCode = matcher ? matchCodes[(r - r0) * colCount + c] : directCode;
+
+                // Get the filtered block through weighted averaging of matched blocks in Plane src
+                // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
+                if (para.correction)
+                {
+                    WeightedAverage_Correction(dstBlock0, srcBlock0, src0, matchCode, sumX1, sumX2);
+                    WeightedAverage_Correction(dstBlock1, srcBlock1, src1, matchCode, sumX1, sumX2);
+                    WeightedAverage_Correction(dstBlock2, srcBlock2, src2, matchCode, sumX1, sumX2);
+                }
+                else
+                {
+                    WeightedAverage(dstBlock0, srcBlock0, src0, matchCode, sumX1);
+                    WeightedAverage(dstBlock1, srcBlock1, src1, matchCode, sumX1);
+                    WeightedAverage(dstBlock2, srcBlock2, src2, matchCode, sumX1);
+                }
+
+                // The filtered blocks are sumed and averaged to form the final filtered image
+                dstBlock0.AddTo(ResNum0);
+                dstBlock1.AddTo(ResNum1);
+                dstBlock2.AddTo(ResNum2);
+
+                dstBlock0.CountTo(ResDen);
             }
-
-            // The filtered blocks are sumed and averaged to form the final filtered image
-            dstBlock0.AddTo(ResNum0);
-            dstBlock1.AddTo(ResNum1);
-            dstBlock2.AddTo(ResNum2);
-
-            dstBlock0.CountTo(ResDen);
         }
     }
 
     // The filtered blocks are sumed and averaged to form the final filtered image
-    _Transform(dst0, ResNum0, ResDen, [](Plane_FL::value_type num, Plane_FL::value_type den)
-    {
-        return static_cast<Plane::value_type>(num / den + Plane_FL::value_type(0.5));
-    });
+    Evaluate(dst0, Quantize(ResNum0 / ResDen, dst0.Floor(), dst0.Ceil()));
 
-    _Transform(dst1, ResNum1, ResDen, [](Plane_FL::value_type num, Plane_FL::value_type den)
-    {
-        return static_cast<Plane::value_type>(num / den + Plane_FL::value_type(0.5));
-    });
+    Evaluate(dst1, Quantize(ResNum1 / ResDen, dst1.Floor(), dst1.Ceil()));
 
-    _Transform(dst2, ResNum2, ResDen, [](Plane_FL::value_type num, Plane_FL::value_type den)
-    {
-        return static_cast<Plane::value_type>(num / den + Plane_FL::value_type(0.5));
-    });
+    Evaluate(dst2, Quantize(ResNum2 / ResDen, dst2.Floor(), dst2.Ceil()));
 
     return dst;
 }
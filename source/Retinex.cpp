@@ -1,6 +1,10 @@
+#define ENABLE_PPL
+
+
 #include "Retinex.h"
 #include "Conversion.hpp"
 #include "Gaussian.h"
+#include "Expression.hpp"
 
 
 // Functions of class Retinex
@@ -19,78 +23,41 @@ Plane_FL &Retinex::Kernel(Plane_FL &dst, const Plane_FL &src)
         return dst;
     }
 
-    PCType i, j, upper;
-    PCType height = src.Height();
-    PCType width = src.Width();
-    PCType stride = src.Stride();
-
-    Plane_FL gauss(src, false);
-
     if (scount == 1 && para.sigmaVector[0] > 0) // single-scale Gaussian filter
     {
-        RecursiveGaussian GFilter(para.sigmaVector[0], true);
+        Plane_FL gauss(src, false);
+        PyramidGaussian GFilter(para.sigmaVector[0], para.approx_error, true);
         GFilter(gauss, src);
 
-        for (j = 0; j < height; ++j)
+        Evaluate(dst, Transform(src, gauss, [](FLType x, FLType g)
         {
-            i = j * stride;
-            for (upper = i + width; i < upper; ++i)
-            {
-                dst[i] = gauss[i] <= 0 ? 0 : log(src[i] / gauss[i] + 1);
-            }
-        }
+            return g <= 0 ? 0 : log(x / g + 1);
+        }));
     }
     else // multi-scale Gaussian filter
     {
-        if (dst.data() == src.data())
-        {
-            DEBUG_FAIL("Retinex::Kernel: Data of Plane_FL \"dst\" and Plane_FL \"src\" can not be of the same address for multi-scale.");
-        }
+        const FLType scountRec = 1 / static_cast<FLType>(scount);
+        FLType *dstp = dst.data();
+        const FLType *srcp = src.data();
 
-        dst.InitValue(1);
+        // All the scales are filtered in a single sweep, and each row is combined as soon as it's finished
+        RecursiveGaussianBank GBank(para.sigmaVector, true, para.approx_error);
 
-        for (s = 0; s < scount; ++s)
+        GBank(src, [&](const PCType j, const PCType lower, const PCType upper, const FLType *const *gauss)
         {
-            if (para.sigmaVector[s] > 0)
+            for (PCType i = lower; i < upper; ++i)
             {
-                RecursiveGaussian GFilter(para.sigmaVector[s], true);
-                GFilter(gauss, src);
+                FLType prod = 1;
 
-                for (j = 0; j < height; ++j)
+                for (size_t s = 0; s < scount; ++s)
                 {
-                    i = j * stride;
-                    for (upper = i + width; i < upper; ++i)
-                    {
-                        if (gauss[i] > 0)
-                        {
-                            dst[i] *= src[i] / gauss[i] + 1;
-                        }
-                    }
+                    const FLType g = gauss[s][i];
+                    prod *= para.sigmaVector[s] <= 0 ? FLType(2) : g > 0 ? srcp[i] / g + 1 : FLType(1);
                 }
-            }
-            else
-            {
-                for (j = 0; j < height; ++j)
-                {
-                    i = j * stride;
-                    for (upper = i + width; i < upper; ++i)
-                    {
-                        dst[i] *= FLType(2);
-                    }
-                }
-            }
-        }
 
-        FLType scountRec = 1 / static_cast<FLType>(scount);
-
-        for (j = 0; j < height; ++j)
-        {
-            i = j * stride;
-            for (upper = i + width; i < upper; ++i)
-            {
-                dst[i] = log(dst[i]) * scountRec;
+                dstp[i] = std::log(prod) * scountRec;
             }
-        }
+        });
     }
 
     return dst;
@@ -0,0 +1,208 @@
+#include <cstdlib>
+#include "Thread_Pool.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+PCType PPL_HP = 256;
+PCType PPL_WP = 256;
+
+static int ThreadCount = -1;
+
+
+static int DefaultThreadCount()
+{
+    const char *env = std::getenv("ISP_MW_THREADS");
+
+    if (env != nullptr)
+    {
+        int count = std::atoi(env);
+        if (count > 0) return count;
+    }
+
+    int count = static_cast<int>(std::thread::hardware_concurrency());
+    return count > 0 ? count : 1;
+}
+
+
+void SetThreadCount(int count)
+{
+    ThreadCount = count > 0 ? count : DefaultThreadCount();
+
+#ifdef _PPL_NATIVE_
+    concurrency::CurrentScheduler::Create(concurrency::SchedulerPolicy(2,
+        concurrency::MinConcurrency, ThreadCount, concurrency::MaxConcurrency, ThreadCount));
+#else
+    Thread_Pool::Reset(ThreadCount);
+#endif
+}
+
+int GetThreadCount()
+{
+    if (ThreadCount < 0) ThreadCount = DefaultThreadCount();
+
+    return ThreadCount;
+}
+
+void SetPPLPieceSize(PCType height_piece, PCType width_piece)
+{
+    if (height_piece > 0) PPL_HP = height_piece;
+    if (width_piece > 0) PPL_WP = width_piece;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Functions of class Thread_Pool
+THREAD_LOCAL int Thread_Pool::worker_index = -1;
+
+Thread_Pool::Thread_Pool(int count)
+    : pending(0), next_queue(0)
+{
+    if (count <= 0) count = GetThreadCount();
+
+    // The calling thread always takes part in parallel_for, so one less worker is enough
+    const int num = count - 1;
+
+    for (int i = 0; i < num; ++i)
+    {
+        workers.emplace_back(new Worker);
+    }
+
+    for (int i = 0; i < num; ++i)
+    {
+        threads.emplace_back(&Thread_Pool::WorkerLoop, this, i);
+    }
+}
+
+Thread_Pool::~Thread_Pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+
+    cv.notify_all();
+
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+}
+
+
+void Thread_Pool::Submit(Task task)
+{
+    if (workers.size() == 0)
+    {
+        task();
+        return;
+    }
+
+    // Tasks submitted from a worker go to its own deque, others are distributed round-robin
+    const size_t index = worker_index >= 0 ? worker_index : next_queue++ % workers.size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pending;
+    }
+
+    cv.notify_one();
+}
+
+
+bool Thread_Pool::PopTask(int index, Task &task)
+{
+    Worker &w = *workers[index];
+    std::lock_guard<std::mutex> lock(w.mutex);
+
+    if (w.tasks.empty()) return false;
+
+    task = std::move(w.tasks.back());
+    w.tasks.pop_back();
+    return true;
+}
+
+bool Thread_Pool::StealTask(int index, Task &task)
+{
+    const int num = static_cast<int>(workers.size());
+
+    for (int i = 1; i < num; ++i)
+    {
+        Worker &w = *workers[(index + i) % num];
+        std::lock_guard<std::mutex> lock(w.mutex);
+
+        if (!w.tasks.empty())
+        {
+            task = std::move(w.tasks.front());
+            w.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Thread_Pool::WorkerLoop(int index)
+{
+    worker_index = index;
+
+    Task task;
+
+    while (true)
+    {
+        if (PopTask(index, task) || StealTask(index, task))
+        {
+            --pending;
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return stop || pending > 0; });
+
+        if (stop && pending == 0) break;
+    }
+}
+
+
+// Not function-local statics, see THREAD_LOCAL in Thread_Pool.h
+static std::mutex PoolMutex;
+static std::unique_ptr<Thread_Pool> PoolOwner;
+static std::atomic<Thread_Pool *> PoolPointer(nullptr);
+
+Thread_Pool &Thread_Pool::Instance()
+{
+    Thread_Pool *pool = PoolPointer.load(std::memory_order_acquire);
+
+    if (pool) return *pool;
+
+    std::lock_guard<std::mutex> lock(PoolMutex);
+    pool = PoolPointer.load(std::memory_order_relaxed);
+
+    if (!pool)
+    {
+        PoolOwner.reset(new Thread_Pool(GetThreadCount()));
+        pool = PoolOwner.get();
+        PoolPointer.store(pool, std::memory_order_release);
+    }
+
+    return *pool;
+}
+
+void Thread_Pool::Reset(int count)
+{
+    std::lock_guard<std::mutex> lock(PoolMutex);
+
+    std::unique_ptr<Thread_Pool> pool(new Thread_Pool(count));
+    PoolPointer.store(pool.get(), std::memory_order_release);
+    PoolOwner.swap(pool);
+}
@@ -0,0 +1,15 @@
+#include "Tile.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+PCType TILE_HP = 0;
+PCType TILE_WP = 0;
+
+
+void SetTileSize(PCType height_piece, PCType width_piece)
+{
+    if (height_piece >= 0) TILE_HP = height_piece;
+    if (width_piece >= 0) TILE_WP = width_piece;
+}
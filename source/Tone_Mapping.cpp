@@ -3,11 +3,12 @@
 #include "Conversion.hpp"
 
 
-Frame &Adaptive_Global_Tone_Mapping(Frame &dst, const Frame &src)
+template < typename _Ty >
+FrameT<_Ty> &Adaptive_Global_Tone_Mapping(FrameT<_Ty> &dst, const FrameT<_Ty> &src)
 {
     if (src.isYUV())
     {
-        const Plane &srcY = src.Y();
+        const PlaneT<_Ty> &srcY = src.Y();
 
         LUT<FLType> _LUT = Adaptive_Global_Tone_Mapping_Gain_LUT_Generation(srcY);
 
@@ -15,7 +16,7 @@ Frame &Adaptive_Global_Tone_Mapping(Frame &dst, const Frame &src)
     }
     else if (src.isRGB())
     {
-        Plane srcY(src.R(), false);
+        PlaneT<_Ty> srcY(src.R(), false);
         ConvertToY(srcY, src, ColorMatrix::OPP);
 
         LUT<FLType> _LUT = Adaptive_Global_Tone_Mapping_Gain_LUT_Generation(srcY);
@@ -27,12 +28,13 @@ Frame &Adaptive_Global_Tone_Mapping(Frame &dst, const Frame &src)
 }
 
 
-LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation(const Plane &src)
+template < typename _Ty >
+LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation(const PlaneT<_Ty> &src)
 {
     PCType pcount = src.PixelCount();
 
     // Convert src plane to linear scale
-    Plane ilinear(src, false);
+    PlaneT<_Ty> ilinear(src, false);
 
     TransferConvert(ilinear, src, TransferChar::linear);
 
@@ -219,3 +221,12 @@ LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation(const Plane &src)
     // Output
     return LUT_Gain;
 }
+
+
+template Frame &Adaptive_Global_Tone_Mapping<DType>(Frame &dst, const Frame &src);
+template Frame16 &Adaptive_Global_Tone_Mapping<uint16>(Frame16 &dst, const Frame16 &src);
+template Frame8 &Adaptive_Global_Tone_Mapping<uint8>(Frame8 &dst, const Frame8 &src);
+
+template LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation<DType>(const Plane &src);
+template LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation<uint16>(const Plane16 &src);
+template LUT<FLType> Adaptive_Global_Tone_Mapping_Gain_LUT_Generation<uint8>(const Plane8 &src);
@@ -0,0 +1,82 @@
+#include <iostream>
+#include "Gaussian.h"
+#include "Tile.h"
+
+
+// Tiled processing of Frame with subsampled chroma planes
+// Gaussian2D is applied to YUV420 and YUV422 frames with and without tiling, the results shall be the same.
+// Built with the sources of ISP_MW except ISP_MW.cpp, returns non-zero on failure.
+
+
+static Frame TestFrame(PixelType _PixelType, PCType width, PCType height)
+{
+    Frame frame(0, _PixelType, width, height, 16, false);
+
+    for (Frame::PlaneCountType p = 0; p < frame.PlaneCount(); ++p)
+    {
+        Plane &plane = frame.P(p);
+
+        for (PCType j = 0; j < plane.Height(); ++j)
+        {
+            for (PCType i = 0; i < plane.Width(); ++i)
+            {
+                plane(j, i) = static_cast<DType>((i * 7919 + j * 104729 + p * 31) % 60000 + 1000);
+            }
+        }
+    }
+
+    return frame;
+}
+
+
+static bool TestTiledFrame(PixelType _PixelType, const char *name)
+{
+    const Frame src = TestFrame(_PixelType, 301, 203);
+
+    Gaussian2D_Para para;
+    para.sigma = 2.0L;
+    para.algorithm = 2; // stacked box filters, processed in tiles with a finite halo
+    Gaussian2D filter(para);
+
+    Frame whole(src, false);
+    SetTileSize(0, 0);
+    filter.process(whole, src);
+
+    Frame tiled(src, false);
+    SetTileSize(64, 48);
+    filter.process(tiled, src);
+    SetTileSize(0, 0);
+
+    DType maxDiff = 0;
+
+    for (Frame::PlaneCountType p = 0; p < src.PlaneCount(); ++p)
+    {
+        const Plane &a = whole.P(p);
+        const Plane &b = tiled.P(p);
+
+        for (PCType j = 0; j < a.Height(); ++j)
+        {
+            for (PCType i = 0; i < a.Width(); ++i)
+            {
+                maxDiff = Max(maxDiff, Abs(a(j, i) - b(j, i)));
+            }
+        }
+    }
+
+    const bool pass = maxDiff == 0;
+
+    std::cout << name << ": max difference " << maxDiff << (pass ? ", passed\n" : ", FAILED\n");
+
+    return pass;
+}
+
+
+int main()
+{
+    bool pass = true;
+
+    pass &= TestTiledFrame(PixelType::YUV420, "YUV420");
+    pass &= TestTiledFrame(PixelType::YUV422, "YUV422");
+
+    return pass ? 0 : 1;
+}